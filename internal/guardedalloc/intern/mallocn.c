@@ -123,6 +123,14 @@ void mem_use_lockfree_allocator(void)
 #ifndef NDEBUG
   MEM_name_ptr = mem_lockfree_name_ptr;
 #endif
+
+  mem_lockfree_thread_cache_set(false);
+}
+
+void mem_use_lockfree_thread_cache_allocator(void)
+{
+  mem_use_lockfree_allocator();
+  mem_lockfree_thread_cache_set(true);
 }
 
 void mem_use_guarded_allocator(void)
@@ -125,6 +125,7 @@ size_t mem_lockfree_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
 #ifndef NDEBUG
 const char *mem_lockfree_name_ptr(void *vmemh);
 #endif
+void mem_lockfree_thread_cache_set(bool enable);
 
 /* Prototypes for fully guarded allocator functions */
 size_t mem_guarded_allocn_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
@@ -1,5 +1,6 @@
 /** Memory allocation which keeps track on allocated memory counters */
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h> /* printf */
 #include <stdlib.h>
@@ -32,12 +33,17 @@ static void (*error_cb)(const char *) = NULL;
 
 enum {
   MEMHEAD_ALIGN_FLAG = 1,
+  /* Block is allocated from a size class of the thread cache. */
+  MEMHEAD_THREAD_CACHE_FLAG = 2,
 };
 
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned *)ptr) - 1)
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t)MEMHEAD_ALIGN_FLAG)
+#define MEMHEAD_IS_THREAD_CACHED(memhead) ((memhead)->len & (size_t)MEMHEAD_THREAD_CACHE_FLAG)
+#define MEMHEAD_LEN(memhead) \
+  ((memhead)->len & ~((size_t)(MEMHEAD_ALIGN_FLAG | MEMHEAD_THREAD_CACHE_FLAG)))
 
 /* Uncomment this to have proper peak counter. */
 #define USE_ATOMIC_MAX
@@ -70,10 +76,293 @@ print_error(const char *str, ...)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** Thread cache
+ *
+ * Optional fast path for small blocks, enabled by #mem_use_lockfree_thread_cache_allocator.
+ *
+ * Small blocks are grouped in size classes and are served from per-thread free lists
+ * (magazines), which are exchanged in bulk with a global depot. The depot is protected by a lock,
+ * but it is only touched once per #MAGAZINE_CAPACITY allocations or frees of a class.
+ *
+ * Counters of small blocks are accumulated per thread and flushed to the global counters lazily,
+ * so that worker threads do not fight over the cache lines of the global counters. The counters
+ * are read by summing the global ones with the pending ones of all caches, without a lock. The
+ * peak memory is updated with that sum on every flush and every read of the counters.
+ *
+ * Memory of small blocks is not returned to the system, it is kept in the caches for reuse.
+ */
+
+/* Block size includes the MemHead. */
+#define SIZE_CLASS_GRANULARITY 16
+#define SIZE_CLASS_MAX_BLOCK_SIZE 1024
+#define NUM_SIZE_CLASSES (SIZE_CLASS_MAX_BLOCK_SIZE / SIZE_CLASS_GRANULARITY)
+
+#define SIZE_CLASS_FROM_BLOCK_SIZE(block_size) \
+  ((unsigned int)(((block_size)-1) / SIZE_CLASS_GRANULARITY))
+#define SIZE_CLASS_BLOCK_SIZE(size_class) (((size_t)(size_class) + 1) * SIZE_CLASS_GRANULARITY)
+
+/* Number of blocks moved between a thread cache and the depot at once. */
+#define MAGAZINE_CAPACITY 64
+
+#define PENDING_MEM_FLUSH_THRESHOLD (256 * 1024)
+
+#ifdef _MSC_VER
+#  define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEM_THREAD_LOCAL __thread
+#endif
+
+/* Overlays the beginning of a free block (including its MemHead). */
+typedef struct FreeBlock {
+  struct FreeBlock *next;
+  /* Only used by the first block of a magazine stored in the depot. */
+  struct FreeBlock *next_magazine;
+} FreeBlock;
+
+typedef struct Magazine {
+  FreeBlock *first;
+  unsigned int num_blocks;
+} Magazine;
+
+typedef struct ThreadCache {
+  struct ThreadCache *next;
+  /* Cache is owned by a running thread. Caches of exited threads are re-used by new threads. */
+  bool is_used;
+  Magazine magazines[NUM_SIZE_CLASSES];
+  /* Counters which are not yet flushed to the global ones. They wrap around when a thread frees
+   * more than it allocated, which is fine since only their sum with the global ones matters. */
+  unsigned int pending_blocks;
+  size_t pending_mem;
+} ThreadCache;
+
+static bool use_thread_cache = false;
+
+static pthread_mutex_t thread_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t thread_cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_cache_key;
+/* All caches ever created. Caches are never freed, new ones are pushed under #thread_cache_lock
+ * and published atomically, so the list can be walked without the lock. */
+static ThreadCache *thread_caches = NULL;
+/* Stacks of full magazines, protected by #thread_cache_lock. */
+static FreeBlock *depot[NUM_SIZE_CLASSES] = {NULL};
+
+static MEM_THREAD_LOCAL ThreadCache *thread_cache = NULL;
+
+static void thread_caches_pending_counters(unsigned int *r_blocks, size_t *r_mem)
+{
+  unsigned int blocks = 0;
+  size_t mem = 0;
+  for (ThreadCache *cache = (ThreadCache *)atomic_load_ptr((void *const *)&thread_caches);
+       cache != NULL;
+       cache = cache->next)
+  {
+    blocks += atomic_load_uint32(&cache->pending_blocks);
+    mem += atomic_load_z(&cache->pending_mem);
+  }
+  *r_blocks = blocks;
+  *r_mem = mem;
+}
+
+/* Memory in use including the pending counters of the thread caches, the peak is updated with
+ * it. */
+static size_t thread_caches_memory_in_use_update_peak(void)
+{
+  unsigned int pending_blocks;
+  size_t pending_mem;
+  thread_caches_pending_counters(&pending_blocks, &pending_mem);
+  const size_t memory_in_use = atomic_load_z(&mem_in_use) + pending_mem;
+  update_maximum(&peak_mem, memory_in_use);
+  return memory_in_use;
+}
+
+static void thread_cache_flush_counters(ThreadCache *cache)
+{
+  const unsigned int pending_blocks = atomic_load_uint32(&cache->pending_blocks);
+  const size_t pending_mem = atomic_load_z(&cache->pending_mem);
+  /* Remove the pending counters before adding them to the global ones, so that a concurrent sum
+   * of both may miss them for a moment, but never counts them twice in the peak. */
+  atomic_sub_and_fetch_u(&cache->pending_blocks, pending_blocks);
+  atomic_sub_and_fetch_z(&cache->pending_mem, pending_mem);
+  atomic_add_and_fetch_u(&totblock, pending_blocks);
+  atomic_add_and_fetch_z(&mem_in_use, pending_mem);
+  thread_caches_memory_in_use_update_peak();
+}
+
+/* Called on thread exit. */
+static void thread_cache_release(void *cache_v)
+{
+  ThreadCache *cache = (ThreadCache *)cache_v;
+  thread_cache_flush_counters(cache);
+  /* Cached blocks stay in the magazines, and are used by the next thread taking this cache. */
+  pthread_mutex_lock(&thread_cache_lock);
+  cache->is_used = false;
+  pthread_mutex_unlock(&thread_cache_lock);
+  /* The cache may be taken by another thread now, allocations from later destructors of this
+   * thread take a cache again. */
+  thread_cache = NULL;
+}
+
+static void thread_cache_key_init(void)
+{
+  pthread_key_create(&thread_cache_key, thread_cache_release);
+}
+
+static ThreadCache *thread_cache_ensure(void)
+{
+  if (LIKELY(thread_cache != NULL)) {
+    return thread_cache;
+  }
+
+  pthread_once(&thread_cache_key_once, thread_cache_key_init);
+
+  pthread_mutex_lock(&thread_cache_lock);
+  ThreadCache *cache = thread_caches;
+  while (cache != NULL && cache->is_used) {
+    cache = cache->next;
+  }
+  if (cache == NULL) {
+    cache = (ThreadCache *)calloc(1, sizeof(ThreadCache));
+    if (UNLIKELY(cache == NULL)) {
+      pthread_mutex_unlock(&thread_cache_lock);
+      return NULL;
+    }
+    cache->next = thread_caches;
+    atomic_store_ptr((void **)&thread_caches, cache);
+  }
+  cache->is_used = true;
+  pthread_mutex_unlock(&thread_cache_lock);
+
+  pthread_setspecific(thread_cache_key, cache);
+  thread_cache = cache;
+  return cache;
+}
+
+/* Fill an empty magazine with a magazine from the depot, or with blocks of a new slab. */
+static bool magazine_refill(Magazine *magazine, const unsigned int size_class)
+{
+  pthread_mutex_lock(&thread_cache_lock);
+  FreeBlock *first = depot[size_class];
+  if (first != NULL) {
+    depot[size_class] = first->next_magazine;
+  }
+  pthread_mutex_unlock(&thread_cache_lock);
+
+  if (first == NULL) {
+    const size_t block_size = SIZE_CLASS_BLOCK_SIZE(size_class);
+    char *slab = (char *)malloc(block_size * MAGAZINE_CAPACITY);
+    if (UNLIKELY(slab == NULL)) {
+      return false;
+    }
+    for (unsigned int i = 0; i < MAGAZINE_CAPACITY; i++) {
+      FreeBlock *block = (FreeBlock *)(slab + i * block_size);
+      block->next = (i + 1 < MAGAZINE_CAPACITY) ? (FreeBlock *)(slab + (i + 1) * block_size) :
+                                                   NULL;
+    }
+    first = (FreeBlock *)slab;
+  }
+
+  magazine->first = first;
+  magazine->num_blocks = MAGAZINE_CAPACITY;
+  return true;
+}
+
+/* Move the blocks exceeding #MAGAZINE_CAPACITY to the depot as a single magazine. */
+static void magazine_spill(Magazine *magazine, const unsigned int size_class)
+{
+  FreeBlock *last_kept = magazine->first;
+  for (unsigned int i = 1; i < MAGAZINE_CAPACITY; i++) {
+    last_kept = last_kept->next;
+  }
+  FreeBlock *spilled = last_kept->next;
+  last_kept->next = NULL;
+  magazine->num_blocks = MAGAZINE_CAPACITY;
+
+  pthread_mutex_lock(&thread_cache_lock);
+  spilled->next_magazine = depot[size_class];
+  depot[size_class] = spilled;
+  pthread_mutex_unlock(&thread_cache_lock);
+}
+
+MEM_INLINE void thread_cache_counters_add(ThreadCache *cache, unsigned int blocks, size_t len)
+{
+  /* Atomics are only needed because other threads read the counters, the cache line of the
+   * counters is not shared with other writers. */
+  atomic_add_and_fetch_u(&cache->pending_blocks, blocks);
+  const size_t pending_mem = atomic_add_and_fetch_z(&cache->pending_mem, len);
+  const ptrdiff_t pending_mem_signed = (ptrdiff_t)pending_mem;
+  if (UNLIKELY(pending_mem_signed > PENDING_MEM_FLUSH_THRESHOLD ||
+               pending_mem_signed < -PENDING_MEM_FLUSH_THRESHOLD))
+  {
+    thread_cache_flush_counters(cache);
+  }
+}
+
+/* Allocate a block for `len` bytes of user data (already aligned to 4), returns NULL when the
+ * thread cache can not be used for this allocation. */
+static MemHead *thread_cache_alloc(const size_t len)
+{
+  ThreadCache *cache = thread_cache_ensure();
+  if (UNLIKELY(cache == NULL)) {
+    return NULL;
+  }
+
+  const unsigned int size_class = SIZE_CLASS_FROM_BLOCK_SIZE(len + sizeof(MemHead));
+  Magazine *magazine = &cache->magazines[size_class];
+  if (UNLIKELY(magazine->first == NULL)) {
+    if (!magazine_refill(magazine, size_class)) {
+      return NULL;
+    }
+  }
+
+  MemHead *memh = (MemHead *)magazine->first;
+  magazine->first = magazine->first->next;
+  magazine->num_blocks--;
+
+  memh->len = len | (size_t)MEMHEAD_THREAD_CACHE_FLAG;
+  thread_cache_counters_add(cache, 1, len);
+  return memh;
+}
+
+static void thread_cache_free(MemHead *memh, const size_t len)
+{
+  ThreadCache *cache = thread_cache_ensure();
+  if (UNLIKELY(cache == NULL)) {
+    /* Can only happen when out of memory, leak the block rather than corrupting the caches. */
+    atomic_sub_and_fetch_u(&totblock, 1);
+    atomic_sub_and_fetch_z(&mem_in_use, len);
+    return;
+  }
+
+  const unsigned int size_class = SIZE_CLASS_FROM_BLOCK_SIZE(len + sizeof(MemHead));
+  Magazine *magazine = &cache->magazines[size_class];
+  FreeBlock *block = (FreeBlock *)memh;
+  block->next = magazine->first;
+  magazine->first = block;
+  magazine->num_blocks++;
+  if (UNLIKELY(magazine->num_blocks == 2 * MAGAZINE_CAPACITY)) {
+    magazine_spill(magazine, size_class);
+  }
+
+  thread_cache_counters_add(cache, (unsigned int)-1, (size_t)0 - len);
+}
+
+MEM_INLINE bool thread_cache_use_for_len(const size_t len)
+{
+  return use_thread_cache && len + sizeof(MemHead) <= SIZE_CLASS_MAX_BLOCK_SIZE;
+}
+
+void mem_lockfree_thread_cache_set(bool enable)
+{
+  use_thread_cache = enable;
+}
+
+/* -------------------------------------------------------------------- */
+
 size_t men_lockfree_allocn_len(const void *vmemh)
 {
   if (vmemh) {
-    return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t)(MEMHEAD_ALIGN_FLAG));
+    return MEMHEAD_LEN(MEMHEAD_FROM_PTR(vmemh));
   }
 
   return 0;
@@ -96,12 +385,18 @@ void mem_lockfree_freen(void *vmemh)
     return;
   }
 
-  atomic_sub_and_fetch_u(&totblock, 1);
-  atomic_sub_and_fetch_z(&mem_in_use, len);
-
   if (UNLIKELY(malloc_debug_memset && len)) {
     memset(memh + 1, 255, len);
   }
+
+  if (MEMHEAD_IS_THREAD_CACHED(memh)) {
+    thread_cache_free(memh, len);
+    return;
+  }
+
+  atomic_sub_and_fetch_u(&totblock, 1);
+  atomic_sub_and_fetch_z(&mem_in_use, len);
+
   if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
     MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
     aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
@@ -213,6 +508,14 @@ void *mem_lockfree_callocn(size_t len, const char *str)
 
   len = SIZET_ALIGN_4(len);
 
+  if (thread_cache_use_for_len(len)) {
+    memh = thread_cache_alloc(len);
+    if (LIKELY(memh)) {
+      memset(memh + 1, 0, len);
+      return PTR_FROM_MEMHEAD(memh);
+    }
+  }
+
   memh = (MemHead *)calloc(1, len + sizeof(MemHead));
 
   if (LIKELY(memh)) {
@@ -254,6 +557,16 @@ void *mem_lockfree_mallocn(size_t len, const char *str)
 
   len = SIZET_ALIGN_4(len);
 
+  if (thread_cache_use_for_len(len)) {
+    memh = thread_cache_alloc(len);
+    if (LIKELY(memh)) {
+      if (UNLIKELY(malloc_debug_memset && len)) {
+        memset(memh + 1, 255, len);
+      }
+      return PTR_FROM_MEMHEAD(memh);
+    }
+  }
+
   memh = (MemHead *)malloc(len + sizeof(MemHead));
 
   if (LIKELY(memh)) {
@@ -362,8 +675,10 @@ void mem_lockfree_cbmemlist(void (*func)(void *))
 
 void mem_lockfree_printmemlist_stats(void)
 {
-  printf("\ntotal memory len: %.3f MB\n", (double)mem_in_use / (double)(1024 * 1024));
-  printf("peak memory len: %.3f MB\n", (double)peak_mem / (double)(1024 * 1024));
+  printf("\ntotal memory len: %.3f MB\n",
+         (double)mem_lockfree_get_memory_in_use() / (double)(1024 * 1024));
+  printf("peak memory len: %.3f MB\n",
+         (double)mem_lockfree_get_peak_memory() / (double)(1024 * 1024));
   printf(
       "\nFor more detailed per-block statistics run Blender with memory debugging command line "
       "argument.\n");
@@ -391,23 +706,30 @@ void mem_lockfree_set_memory_debug(void)
 
 size_t mem_lockfree_get_memory_in_use(void)
 {
-  return mem_in_use;
+  return thread_caches_memory_in_use_update_peak();
 }
 
 unsigned int mem_lockfree_get_memory_blocks_in_use(void)
 {
-  return totblock;
+  unsigned int pending_blocks;
+  size_t pending_mem;
+  thread_caches_pending_counters(&pending_blocks, &pending_mem);
+  return atomic_load_uint32(&totblock) + pending_blocks;
 }
 
 /* dummy */
 void mem_lockfree_reset_peak_memory(void)
 {
-  peak_mem = mem_in_use;
+  unsigned int pending_blocks;
+  size_t pending_mem;
+  thread_caches_pending_counters(&pending_blocks, &pending_mem);
+  atomic_store_z(&peak_mem, atomic_load_z(&mem_in_use) + pending_mem);
 }
 
 size_t mem_lockfree_get_peak_memory(void)
 {
-  return peak_mem;
+  thread_caches_memory_in_use_update_peak();
+  return atomic_load_z(&peak_mem);
 }
 
 #ifndef NDEBUG
@@ -223,6 +223,16 @@ void mem_enable_fail_on_memleak(void);
  * NOTE: The switch between allocator types can only happen before any allocation did happen. */
 void MEM_use_lockfree_allocator(void);
 
+/* Same as #MEM_use_lockfree_allocator, but small blocks are allocated from size classes cached
+ * per thread, and their counters are accumulated per thread and aggregated lazily.
+ *
+ * Use when many threads allocate small blocks concurrently (field evaluation, mesh operators).
+ * The memory of small blocks is kept in the caches after being freed and is not returned to the
+ * system. The peak memory might be under-estimated by a few hundred kilobytes per thread.
+ *
+ * NOTE: The switch between allocator types can only happen before any allocation did happen. */
+void mem_use_lockfree_thread_cache_allocator(void);
+
 /* Switch allocator to slow fully guarded mode.
  *
  * Use for debug purposes. This allocator contains lock section around every allocator call, which
@@ -13,6 +13,19 @@ class LockFreeAllocatorTest : public ::testing::Test {
   }
 };
 
+class LockFreeThreadCacheAllocatorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp()
+  {
+    mem_use_lockfree_thread_cache_allocator();
+  }
+
+  virtual void TearDown()
+  {
+    mem_use_lockfree_allocator();
+  }
+};
+
 class GuardedAllocatorTest : public ::testing::Test {
  protected:
   virtual void SetUp()
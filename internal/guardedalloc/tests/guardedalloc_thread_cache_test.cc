@@ -0,0 +1,109 @@
+#include "testing/testing.h"
+
+#include <thread>
+#include <vector>
+
+#include "mem_guardedalloc.h"
+
+#include "guardedalloc_test_base.h"
+
+TEST_F(LockFreeThreadCacheAllocatorTest, AllocLen)
+{
+  /* Sizes are rounded up to 4 bytes, same as the lock-free allocator without caches. */
+  for (size_t len : {1, 4, 17, 100, 1000, 1016, 1017, 100000}) {
+    void *mem = mem_mallocn(len, __func__);
+    EXPECT_EQ(mem_allocn_len(mem), (len + 3) & ~size_t(3));
+    mem_freen(mem);
+  }
+}
+
+TEST_F(LockFreeThreadCacheAllocatorTest, Calloc)
+{
+  /* Re-used blocks are to be cleared as well. */
+  char *mem = (char *)mem_mallocn(64, __func__);
+  memset(mem, 1, 64);
+  mem_freen(mem);
+
+  char *zeroed = (char *)mem_callocn(64, __func__);
+  for (int i = 0; i < 64; i++) {
+    EXPECT_EQ(zeroed[i], 0);
+  }
+  mem_freen(zeroed);
+}
+
+TEST_F(LockFreeThreadCacheAllocatorTest, Counters)
+{
+  const unsigned int blocks_before = mem_get_memory_blocks_in_use();
+  const size_t mem_before = mem_get_memory_in_use();
+
+  std::vector<void *> blocks;
+  for (int i = 0; i < 1000; i++) {
+    blocks.push_back(mem_mallocn(32, __func__));
+  }
+  EXPECT_EQ(mem_get_memory_blocks_in_use(), blocks_before + 1000);
+  EXPECT_EQ(mem_get_memory_in_use(), mem_before + 1000 * 32);
+  EXPECT_GE(mem_get_peak_memory(), mem_before + 1000 * 32);
+
+  for (void *mem : blocks) {
+    mem_freen(mem);
+  }
+  EXPECT_EQ(mem_get_memory_blocks_in_use(), blocks_before);
+  EXPECT_EQ(mem_get_memory_in_use(), mem_before);
+}
+
+TEST_F(LockFreeThreadCacheAllocatorTest, PeakOfPendingCounters)
+{
+  mem_reset_peak_memory();
+  const size_t mem_before = mem_get_memory_in_use();
+
+  /* Less than is flushed to the global counters at once. */
+  std::vector<void *> blocks;
+  for (int i = 0; i < 100; i++) {
+    blocks.push_back(mem_mallocn(512, __func__));
+  }
+  EXPECT_EQ(mem_get_memory_in_use(), mem_before + 100 * 512);
+  for (void *mem : blocks) {
+    mem_freen(mem);
+  }
+
+  /* Reading the memory in use accounted the pending counters in the peak. */
+  EXPECT_GE(mem_get_peak_memory(), mem_before + 100 * 512);
+}
+
+TEST_F(LockFreeThreadCacheAllocatorTest, FreeFromOtherThread)
+{
+  const unsigned int blocks_before = mem_get_memory_blocks_in_use();
+  const size_t mem_before = mem_get_memory_in_use();
+
+  const int num_threads = 8;
+  const int blocks_per_thread = 10000;
+  std::vector<std::vector<void *>> blocks(num_threads);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < blocks_per_thread; i++) {
+        blocks[t].push_back(mem_mallocn(size_t(i % 200) * 4 + 4, __func__));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  /* Free everything from different threads than the ones which allocated the blocks. */
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      for (void *mem : blocks[(t + 1) % num_threads]) {
+        mem_freen(mem);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(mem_get_memory_blocks_in_use(), blocks_before);
+  EXPECT_EQ(mem_get_memory_in_use(), mem_before);
+}
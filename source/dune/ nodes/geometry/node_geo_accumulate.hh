@@ -0,0 +1,217 @@
+#pragma once
+
+/** Accumulation of field values by group, for the Accumulate Field node. */
+
+#include <optional>
+
+#include "lib_array.hh"
+#include "lib_map.hh"
+#include "lib_offset_indices.hh"
+#include "lib_set.hh"
+#include "lib_task.hh"
+#include "lib_vector.hh"
+#include "lib_virtual_array.hh"
+
+namespace dune::nodes {
+
+enum class AccumulationMode { Leading = 0, Trailing = 1 };
+
+/* Values are accumulated in chunks of a fixed size, so the order of the additions, and thus
+ * the float results, don't depend on the number of threads. */
+static constexpr int64_t accumulate_chunk_size = 4096;
+
+inline int64_t accumulate_chunks_num(const int64_t size)
+{
+  return (size + accumulate_chunk_size - 1) / accumulate_chunk_size;
+}
+
+inline IndexRange accumulate_chunk_range(const int64_t chunk, const int64_t size)
+{
+  const int64_t start = chunk * accumulate_chunk_size;
+  return IndexRange(start, std::min(accumulate_chunk_size, size - start));
+}
+
+/**
+ * Find the runs of equal group indices. Returns nothing as soon as a group index starts a second
+ * run, then the groups aren't contiguous and can't be accumulated with a segmented scan.
+ */
+inline std::optional<Vector<int>> find_contiguous_group_offsets(const Span<int> group_indices)
+{
+  Vector<int> offsets;
+  Set<int> groups;
+  for (const int64_t i : group_indices.index_range()) {
+    if (i == 0 || group_indices[i] != group_indices[i - 1]) {
+      if (!groups.add(group_indices[i])) {
+        return std::nullopt;
+      }
+      offsets.append(int(i));
+    }
+  }
+  offsets.append(int(group_indices.size()));
+  return offsets;
+}
+
+/**
+ * Parallel prefix sum: the sums of the chunks are computed in parallel, then accumulated, and
+ * finally the sums within each chunk are computed in parallel again, starting at the sum of the
+ * previous chunks.
+ *
+ * \param group_indices: When not empty, the sums restart at every change of group index
+ * (a segmented scan), so each run of equal group indices is accumulated separately.
+ */
+template<typename T>
+void accumulate_values(const Span<T> values,
+                       const Span<int> group_indices,
+                       const AccumulationMode mode,
+                       MutableSpan<T> r_outputs)
+{
+  const int64_t size = values.size();
+  auto is_group_start = [&](const int64_t i) {
+    return !group_indices.is_empty() && i > 0 && group_indices[i] != group_indices[i - 1];
+  };
+
+  /* Sum of the values in each chunk following the last group start, if it has one. */
+  const int64_t chunks_num = accumulate_chunks_num(size);
+  Array<T> chunk_sums(chunks_num);
+  Array<bool> chunk_has_group_start(chunks_num);
+  threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange range) {
+    for (const int64_t chunk : range) {
+      T sum = T();
+      bool has_group_start = false;
+      for (const int64_t i : accumulate_chunk_range(chunk, size)) {
+        if (is_group_start(i)) {
+          sum = T();
+          has_group_start = true;
+        }
+        sum = values[i] + sum;
+      }
+      chunk_sums[chunk] = sum;
+      chunk_has_group_start[chunk] = has_group_start;
+    }
+  });
+
+  Array<T> chunk_offsets(chunks_num);
+  T offset = T();
+  for (const int64_t chunk : IndexRange(chunks_num)) {
+    chunk_offsets[chunk] = offset;
+    offset = chunk_has_group_start[chunk] ? chunk_sums[chunk] : chunk_sums[chunk] + offset;
+  }
+
+  threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange range) {
+    for (const int64_t chunk : range) {
+      T accumulation = chunk_offsets[chunk];
+      if (mode == AccumulationMode::Leading) {
+        for (const int64_t i : accumulate_chunk_range(chunk, size)) {
+          if (is_group_start(i)) {
+            accumulation = T();
+          }
+          accumulation = values[i] + accumulation;
+          r_outputs[i] = accumulation;
+        }
+      }
+      else {
+        for (const int64_t i : accumulate_chunk_range(chunk, size)) {
+          if (is_group_start(i)) {
+            accumulation = T();
+          }
+          r_outputs[i] = accumulation;
+          accumulation = values[i] + accumulation;
+        }
+      }
+    }
+  });
+}
+
+template<typename T> T sum_values(const Span<T> values)
+{
+  const int64_t chunks_num = accumulate_chunks_num(values.size());
+  Array<T> chunk_sums(chunks_num);
+  threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange range) {
+    for (const int64_t chunk : range) {
+      T sum = T();
+      for (const int64_t i : accumulate_chunk_range(chunk, values.size())) {
+        sum = values[i] + sum;
+      }
+      chunk_sums[chunk] = sum;
+    }
+  });
+  T sum = T();
+  for (const T &chunk_sum : chunk_sums) {
+    sum = chunk_sum + sum;
+  }
+  return sum;
+}
+
+/**
+ * The running totals of the values in each group. Contiguous groups are accumulated in parallel,
+ * groups with several runs of indices serially.
+ */
+template<typename T>
+void accumulate_group_values(const Span<T> values,
+                             const VArray<int> &group_indices,
+                             const AccumulationMode mode,
+                             MutableSpan<T> r_outputs)
+{
+  if (group_indices.is_single()) {
+    accumulate_values<T>(values, {}, mode, r_outputs);
+    return;
+  }
+  const VArraySpan<int> group_indices_span(group_indices);
+  if (find_contiguous_group_offsets(group_indices_span)) {
+    accumulate_values<T>(values, group_indices_span, mode, r_outputs);
+    return;
+  }
+  Map<int, T> accumulations;
+  if (mode == AccumulationMode::Leading) {
+    for (const int i : values.index_range()) {
+      T &accumulation_value = accumulations.lookup_or_add_default(group_indices_span[i]);
+      accumulation_value += values[i];
+      r_outputs[i] = accumulation_value;
+    }
+  }
+  else {
+    for (const int i : values.index_range()) {
+      T &accumulation_value = accumulations.lookup_or_add_default(group_indices_span[i]);
+      r_outputs[i] = accumulation_value;
+      accumulation_value += values[i];
+    }
+  }
+}
+
+/** The total of the values in the group of each value. */
+template<typename T>
+VArray<T> total_group_values(const Span<T> values, const VArray<int> &group_indices)
+{
+  if (group_indices.is_single()) {
+    return VArray<T>::ForSingle(sum_values<T>(values), values.size());
+  }
+  const VArraySpan<int> group_indices_span(group_indices);
+  Array<T> outputs(values.size());
+  if (const std::optional<Vector<int>> group_offsets = find_contiguous_group_offsets(
+          group_indices_span))
+  {
+    /* The total of a group is its last leading accumulation. */
+    accumulate_values<T>(values, group_indices_span, AccumulationMode::Leading, outputs);
+    const OffsetIndices<int> groups = group_offsets->as_span();
+    threading::parallel_for(groups.index_range(), 1024, [&](const IndexRange range) {
+      for (const int group : range) {
+        const IndexRange group_range = groups[group];
+        const T total = outputs[group_range.last()];
+        outputs.as_mutable_span().slice(group_range).fill(total);
+      }
+    });
+  }
+  else {
+    Map<int, T> accumulations;
+    for (const int i : values.index_range()) {
+      T &value = accumulations.lookup_or_add_default(group_indices_span[i]);
+      value = value + values[i];
+    }
+    for (const int i : values.index_range()) {
+      outputs[i] = accumulations.lookup(group_indices_span[i]);
+    }
+  }
+  return VArray<T>::ForContainer(std::move(outputs));
+}
+
+}  // namespace dune::nodes
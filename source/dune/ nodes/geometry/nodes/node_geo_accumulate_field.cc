@@ -9,6 +9,7 @@
 
 #include "api_enum_types.hh"
 
+#include "node_geo_accumulate.hh"
 #include "node_geometry_util.hh"
 
 #include "ui.hh"
@@ -76,8 +77,6 @@ static void node_init(bNodeTree * /*tree*/, bNode *node)
   node->storage = data;
 }
 
-enum class AccumulationMode { Leading = 0, Trailing = 1 };
-
 static std::optional<eCustomDataType> node_type_from_other_socket(const NodeSocket &socket)
 {
   switch (socket.type) {
@@ -184,41 +183,8 @@ class AccumulateFieldInput final : public dune::GeometryFieldInput {
       using T = decltype(dummy);
       if constexpr (is_same_any_v<T, int, float, float3>) {
         Array<T> outputs(domain_size);
-        const VArray<T> vals = g_vals.typed<T>();
-
-        if (group_indices.is_single()) {
-          T accumulation = T();
-          if (accumulation_mode_ == AccumulationMode::Leading) {
-            for (const int i : values.index_range()) {
-              accumulation = values[i] + accumulation;
-              outputs[i] = accumulation;
-            }
-          }
-          else {
-            for (const int i : values.index_range()) {
-              outputs[i] = accumulation;
-              accumulation = values[i] + accumulation;
-            }
-          }
-        }
-        else {
-          Map<int, T> accumulations;
-          if (accumulation_mode_ == AccumulationMode::Leading) {
-            for (const int i : values.index_range()) {
-              T &accumulation_value = accumulations.lookup_or_add_default(group_indices[i]);
-              accumulation_value += values[i];
-              outputs[i] = accumulation_value;
-            }
-          }
-          else {
-            for (const int i : values.index_range()) {
-              T &accumulation_value = accumulations.lookup_or_add_default(group_indices[i]);
-              outputs[i] = accumulation_value;
-              accumulation_value += values[i];
-            }
-          }
-        }
-
+        const VArraySpan<T> values(g_vals.typed<T>());
+        accumulate_group_values<T>(values, group_indices, accumulation_mode_, outputs);
         g_output = VArray<T>::ForContainer(std::move(outputs));
       }
     });
@@ -288,26 +254,8 @@ class TotalFieldInput final : public bke::GeometryFieldInput {
     dune::attribute_math::convert_to_static_type(g_vals.type(), [&](auto dummy) {
       using T = decltype(dummy);
       if constexpr (is_same_any_v<T, int, float, float3>) {
-        const VArray<T> vals = g_vals.typed<T>();
-        if (group_indices.is_single()) {
-          T accumulation = {};
-          for (const int i : values.index_range()) {
-            accumulation = values[i] + accumulation;
-          }
-          g_outputs = VArray<T>::ForSingle(accumulation, domain_size);
-        }
-        else {
-          Map<int, T> accumulations;
-          for (const int i : vals.index_range()) {
-            T &value = accumulations.lookup_or_add_default(group_indices[i]);
-            value = value + values[i];
-          }
-          Array<T> outputs(domain_size);
-          for (const int i : vals.index_range()) {
-            outputs[i] = accumulations.lookup(group_indices[i]);
-          }
-          g_outputs = VArray<T>::ForContainer(std::move(outputs));
-        }
+        const VArraySpan<T> values(g_vals.typed<T>());
+        g_outputs = total_group_values<T>(values, group_indices);
       }
     });
 
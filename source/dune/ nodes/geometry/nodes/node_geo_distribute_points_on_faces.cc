@@ -1,4 +1,3 @@
-#include "BLI_kdtree.h"
 #include "BLI_math_geom.h"
 #include "BLI_math_rotation.h"
 #include "BLI_math_rotation.hh"
@@ -19,6 +18,7 @@
 #include "UI_interface.hh"
 #include "UI_resources.hh"
 
+#include "GEO_eliminate_close_points.hh"
 #include "GEO_randomize.hh"
 
 #include "node_geometry_util.hh"
@@ -148,55 +148,6 @@ static void sample_mesh_surface(const Mesh &mesh,
   }
 }
 
-BLI_NOINLINE static KDTree_3d *build_kdtree(Span<float3> positions)
-{
-  KDTree_3d *kdtree = BLI_kdtree_3d_new(positions.size());
-
-  int i_point = 0;
-  for (const float3 position : positions) {
-    BLI_kdtree_3d_insert(kdtree, i_point, position);
-    i_point++;
-  }
-
-  BLI_kdtree_3d_balance(kdtree);
-  return kdtree;
-}
-
-BLI_NOINLINE static void update_elimination_mask_for_close_points(
-    Span<float3> positions, const float minimum_distance, MutableSpan<bool> elimination_mask)
-{
-  if (minimum_distance <= 0.0f) {
-    return;
-  }
-
-  KDTree_3d *kdtree = build_kdtree(positions);
-  BLI_SCOPED_DEFER([&]() { BLI_kdtree_3d_free(kdtree); });
-
-  for (const int i : positions.index_range()) {
-    if (elimination_mask[i]) {
-      continue;
-    }
-
-    struct CallbackData {
-      int index;
-      MutableSpan<bool> elimination_mask;
-    } callback_data = {i, elimination_mask};
-
-    BLI_kdtree_3d_range_search_cb(
-        kdtree,
-        positions[i],
-        minimum_distance,
-        [](void *user_data, int index, const float * /*co*/, float /*dist_sq*/) {
-          CallbackData &callback_data = *static_cast<CallbackData *>(user_data);
-          if (index != callback_data.index) {
-            callback_data.elimination_mask[index] = true;
-          }
-          return true;
-        },
-        &callback_data);
-  }
-}
-
 BLI_NOINLINE static void update_elimination_mask_based_on_density_factors(
     const Mesh &mesh,
     const Span<float> density_factors,
@@ -488,7 +439,7 @@ static void distribute_points_poisson_disk(const Mesh &mesh,
   sample_mesh_surface(mesh, max_density, {}, seed, positions, bary_coords, tri_indices);
 
   Array<bool> elimination_mask(positions.size(), false);
-  update_elimination_mask_for_close_points(positions, minimum_distance, elimination_mask);
+  geometry::eliminate_close_points(positions, minimum_distance, elimination_mask);
 
   const Array<float> density_factors = calc_full_density_factors_with_selection(
       mesh, density_factor_field, selection_field);
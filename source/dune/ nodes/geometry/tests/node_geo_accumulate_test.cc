@@ -0,0 +1,126 @@
+#include "testing/testing.h"
+
+#include "lib_array.hh"
+#include "lib_map.hh"
+
+#include "node_geo_accumulate.hh"
+
+namespace dune::nodes::tests {
+
+/* Values that aren't all equal, over several accumulation chunks. */
+static Array<int> test_values(const int size)
+{
+  Array<int> values(size);
+  for (const int i : values.index_range()) {
+    values[i] = (i * 7) % 13 - 4;
+  }
+  return values;
+}
+
+/* The serial accumulation in index order, that the grouped accumulation has to match. */
+static void accumulate_serial(const Span<int> values,
+                              const Span<int> group_indices,
+                              MutableSpan<int> r_leading,
+                              MutableSpan<int> r_trailing,
+                              MutableSpan<int> r_total)
+{
+  Map<int, int> accumulations;
+  for (const int i : values.index_range()) {
+    int &accumulation = accumulations.lookup_or_add_default(group_indices[i]);
+    r_trailing[i] = accumulation;
+    accumulation += values[i];
+    r_leading[i] = accumulation;
+  }
+  for (const int i : values.index_range()) {
+    r_total[i] = accumulations.lookup(group_indices[i]);
+  }
+}
+
+static void test_accumulate_groups(const Span<int> values, const VArray<int> &group_indices)
+{
+  const int size = values.size();
+  const VArraySpan<int> group_indices_span(group_indices);
+  Array<int> leading_expected(size), trailing_expected(size), total_expected(size);
+  accumulate_serial(
+      values, group_indices_span, leading_expected, trailing_expected, total_expected);
+
+  Array<int> leading(size), trailing(size);
+  accumulate_group_values<int>(values, group_indices, AccumulationMode::Leading, leading);
+  accumulate_group_values<int>(values, group_indices, AccumulationMode::Trailing, trailing);
+  const VArray<int> total = total_group_values<int>(values, group_indices);
+
+  for (const int i : values.index_range()) {
+    EXPECT_EQ(leading[i], leading_expected[i]) << "value " << i;
+    EXPECT_EQ(trailing[i], trailing_expected[i]) << "value " << i;
+    EXPECT_EQ(total[i], total_expected[i]) << "value " << i;
+  }
+}
+
+TEST(node_geo_accumulate, contiguous_groups)
+{
+  /* Runs of different lengths, some across the chunk boundaries, some in a single chunk. */
+  const int size = accumulate_chunk_size * 3 + 100;
+  Array<int> group_indices(size);
+  int runs_num = 0;
+  int run_end = 0;
+  for (const int i : group_indices.index_range()) {
+    if (i == run_end) {
+      runs_num++;
+      run_end += (i < accumulate_chunk_size) ? 1 + i % 5 : 1000 + i % 300;
+    }
+    /* Group indices in no particular order. */
+    group_indices[i] = (runs_num % 2) ? runs_num : -runs_num * 3;
+  }
+
+  const std::optional<Vector<int>> offsets = find_contiguous_group_offsets(group_indices);
+  ASSERT_TRUE(offsets.has_value());
+  EXPECT_EQ(offsets->size(), runs_num + 1);
+  EXPECT_EQ(offsets->first(), 0);
+  EXPECT_EQ(offsets->last(), size);
+  for (const int i : offsets->index_range().drop_back(1)) {
+    const int start = (*offsets)[i];
+    EXPECT_TRUE(start == 0 || group_indices[start] != group_indices[start - 1]);
+  }
+
+  const Array<int> values = test_values(size);
+  test_accumulate_groups(values, VArray<int>::ForSpan(group_indices));
+}
+
+TEST(node_geo_accumulate, non_contiguous_groups)
+{
+  /* The groups alternate, the first one starting a second run at the end only. */
+  const int size = accumulate_chunk_size * 2 + 10;
+  Array<int> group_indices(size);
+  for (const int i : group_indices.index_range()) {
+    group_indices[i] = (i == size - 1) ? 0 : i / 100;
+  }
+  EXPECT_FALSE(find_contiguous_group_offsets(group_indices).has_value());
+
+  const Array<int> values = test_values(size);
+  test_accumulate_groups(values, VArray<int>::ForSpan(group_indices));
+
+  for (const int i : group_indices.index_range()) {
+    group_indices[i] = i % 3;
+  }
+  EXPECT_FALSE(find_contiguous_group_offsets(group_indices).has_value());
+  test_accumulate_groups(values, VArray<int>::ForSpan(group_indices));
+}
+
+TEST(node_geo_accumulate, single_group)
+{
+  const int size = accumulate_chunk_size * 2 + 10;
+  const Array<int> values = test_values(size);
+  const Array<int> group_indices(size, 3);
+
+  const std::optional<Vector<int>> offsets = find_contiguous_group_offsets(group_indices);
+  ASSERT_TRUE(offsets.has_value());
+  ASSERT_EQ(offsets->size(), 2);
+  EXPECT_EQ((*offsets)[0], 0);
+  EXPECT_EQ((*offsets)[1], size);
+
+  /* The same group index as a single value and as an array. */
+  test_accumulate_groups(values, VArray<int>::ForSingle(3, size));
+  test_accumulate_groups(values, VArray<int>::ForSpan(group_indices));
+}
+
+}  // namespace dune::nodes::tests
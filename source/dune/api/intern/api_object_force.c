@@ -97,6 +97,7 @@ static const EnumPropItem empty_vortex_shape_items[] = {
 #  include "dune_context.h"
 #  include "dune_modifier.h"
 #  include "dune_pointcache.h"
+#  include "dune_pointcache_ex.h"
 
 #  include "graph.h"
 #  include "graph_build.h"
@@ -233,6 +234,24 @@ static void api_Cache_toggle_disk_cache(Main *UNUSED(main), Scene *UNUSED(scene)
   }
 }
 
+static void api_Cache_toggle_disk_pack(Main *UNUSED(main), Scene *UNUSED(scene), ApiPtr *ptr)
+{
+  Object *ob = NULL;
+  Scene *scene = NULL;
+
+  if (!api_Cache_get_valid_owner_Id(ptr, &ob, &scene)) {
+    return;
+  }
+
+  PointCache *cache = (PointCache *)ptr->data;
+
+  PTCacheID pid = dune_ptcache_id_find(ob, scene, cache);
+
+  if (pid.cache) {
+    dune_ptcache_toggle_disk_pack(&pid);
+  }
+}
+
 static void api_Cache_idname_change(Main *UNUSED(bmain), Scene *UNUSED(scene), PointerRNA *ptr)
 {
   Object *ob = NULL;
@@ -926,6 +945,7 @@ static void api_def_pointcache_common(ApiStruct *srna)
       {PTCACHE_COMPRESS_NO, "NO", 0, "None", "No compression"},
       {PTCACHE_COMPRESS_LZO, "LIGHT", 0, "Lite", "Fast but not so effective compression"},
       {PTCACHE_COMPRESS_LZMA, "HEAVY", 0, "Heavy", "Effective but slow compression"},
+      {PTCACHE_COMPRESS_ZSTD, "ZSTD", 0, "Zstandard", "Effective compression, fast to read"},
       {0, NULL, 0, NULL, NULL},
   };
 
@@ -978,6 +998,14 @@ static void api_def_pointcache_common(ApiStruct *srna)
       prop, "Disk Cache", "Save cache files to disk (.dune file must be saved first)");
   api_def_prop_update(prop, NC_OBJECT, "api_Cache_toggle_disk_cache");
 
+  prop = api_def_prop(sapi, "use_disk_pack", PROP_BOOL, PROP_NONE);
+  api_def_prop_bool_stype(prop, NULL, "flag", PTCACHE_DISK_PACKED);
+  api_def_prop_ui_text(prop,
+                       "Packed Disk Cache",
+                       "Save all frames of the disk cache to one memory mapped file, "
+                       "read without copying uncompressed data");
+  api_def_prop_update(prop, NC_OBJECT, "api_Cache_toggle_disk_pack");
+
   prop = api_def_prop(sapi, "is_outdated", PROP_BOOLEAN, PROP_NONE);
   api_def_prop_bool_stype(prop, NULL, "flag", PTCACHE_OUTDATED);
   api_def_prop_clear_flag(prop, PROP_EDITABLE);
@@ -5,6 +5,7 @@
 #include "DNA_vec_types.h"
 
 #include "BLI_math.h"
+#include "BLI_rect.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_context.h"
@@ -12,6 +13,7 @@
 #include "BIF_glutil.h"
 
 #include "IMB_colormanagement.h"
+#include "imbuf_colormanagement_ex.h"
 #include "IMB_imbuf_types.h"
 
 #include "GPU_immediate.h"
@@ -502,9 +504,21 @@ void ED_draw_imbuf_clipping(ImBuf *ibuf,
   if (need_fallback) {
     uchar *display_buffer;
     void *cache_handle;
+    rcti region;
+    const bool use_clipping = (clip_min_x < clip_max_x) && (clip_min_y < clip_max_y) &&
+                              (zoom_x > 0.0f) && (zoom_y > 0.0f);
+
+    if (use_clipping) {
+      /* Only transform the pixels inside the clipping region, with a margin for filtering. */
+      BLI_rcti_init(&region,
+                    (int)floorf((clip_min_x - x) / zoom_x) - 1,
+                    (int)ceilf((clip_max_x - x) / zoom_x) + 1,
+                    (int)floorf((clip_min_y - y) / zoom_y) - 1,
+                    (int)ceilf((clip_max_y - y) / zoom_y) + 1);
+    }
 
-    display_buffer = IMB_display_buffer_acquire(
-        ibuf, view_settings, display_settings, &cache_handle);
+    display_buffer = IMB_display_buffer_acquire_region(
+        ibuf, view_settings, display_settings, use_clipping ? &region : NULL, &cache_handle);
 
     if (display_buffer) {
       IMMDrawPixelsTexState state = immDrawPixelsTexSetup(GPU_SHADER_2D_IMAGE_COLOR);
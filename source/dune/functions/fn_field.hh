@@ -28,6 +28,8 @@
  * Whenever possible, multiple fields should be eval'd together to avoid dup work when
  * they share common sub-fields and a common cxt. */
 
+#include <optional>
+
 #include "lib_fn_ref.hh"
 #include "lib_generic_virtual_arr.hh"
 #include "lib_string_ref.hh"
@@ -36,6 +38,10 @@
 
 #include "fn_multi_builder.hh"
 
+namespace dune {
+class ImplicitSharingInfo;
+}
+
 namespace dune::fn {
 
 class FieldInput;
@@ -197,6 +203,8 @@ class FieldOp : public FieldNode {
 
   Span<GField> inputs() const;
   const MultiFn &multi_fn() const;
+  /* True when the multi-fn is owned by this node, so it lives as long as the node. */
+  bool owns_fn() const;
 
   const CPPType &output_cpp_type(int output_index) const override;
 };
@@ -261,6 +269,15 @@ struct FieldInputs {
   VectorSet<std::reference_wrapper<const FieldInput>> deduplicated_nodes;
 };
 
+/* Identifies the data that a FieldCxt provides the inputs of a field eval from. */
+struct FieldCxtCacheKey {
+  /* The shared data the inputs are read from, e.g. the attributes of a geometry component.
+   * Evaluated results are reused as long as its version doesn't change. */
+  const ImplicitSharingInfo *sharing_info = nullptr;
+  /* Distinguishes contexts providing inputs from the same data, e.g. the attribute domain. */
+  int domain = 0;
+};
+
 /* Provides inputs for a specific field eval */
 class FieldCxt {
  public:
@@ -269,6 +286,14 @@ class FieldCxt {
   virtual GVArray get_varray_for_input(const FieldInput &field_input,
                                        IndexMask mask,
                                        ResourceScope &scope) const;
+
+  /* A cxt that only provides inputs from shared data may return its key, then the results of
+   * fields evaluated by a FieldEvaluator in the cxt are cached and reused (when all indices are
+   * evaluated), until the version of the data changes. See set_field_eval_cache_budget. */
+  virtual std::optional<FieldCxtCacheKey> cache_key() const
+  {
+    return std::nullopt;
+  }
 };
 
 /* Util class that makes it easier to eval fields. */
@@ -412,6 +437,14 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
                                 const FieldContext &cxt,
                                 Span<GVMutableArray> dst_varrays = {});
 
+/* Set the mem budget of the cache of evaluated fields (see FieldCxt::cache_key), the least
+ * recently used results are freed when it's exceeded. Zero disables the cache. Results of
+ * fields containing an op with a multi-fn it doesn't own are never cached, another fn
+ * may be allocated at the same address once it's freed. */
+void set_field_eval_cache_budget(int64_t bytes);
+/* Free all cached results, e.g. before exiting. */
+void clear_field_eval_cache();
+
 /* Util fns for simple field creation and evaluation */
 void evaluate_constant_field(const GField &field, void *r_val);
 
@@ -552,6 +585,11 @@ inline const MultiFunction &FieldOperation::multi_function() const
   return *function_;
 }
 
+inline bool FieldOp::owns_fn() const
+{
+  return owned_fn_ != nullptr;
+}
+
 inline const CPPType &FieldOperation::output_cpp_type(int output_index) const
 {
   int output_counter = 0;
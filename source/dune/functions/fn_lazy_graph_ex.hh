@@ -2,6 +2,9 @@
 
 /* This file provides means to create a LazyFn from Graph (could then be used in
  * another Graph again). */
+#include <memory>
+#include <mutex>
+
 #include "lib_vector.hh"
 #include "lib_vector_set.hh"
 #include "fn_lazy_fn_graph.hh"
@@ -56,6 +59,8 @@ class GraphExNodeExWrapper {
                        const Cxt &cxt) const = 0;
 };
 
+struct GraphExReusableStates;
+
 class GraphEx : public LazyFn {
  public:
   using Logger = GraphExLogger;
@@ -89,6 +94,12 @@ class GraphEx : public LazyFn {
     int total_size;
   } init_buf_info_;
 
+  /* Node states that are kept alive between evals, see #enable_state_reuse. There is more than
+   * one when the graph is evaluated multiple times at once. */
+  bool reuse_states_ = false;
+  mutable std::mutex reusable_states_mutex_;
+  mutable Vector<std::unique_ptr<GraphExReusableStates>> reusable_states_pool_;
+
   friend class Ex;
 
  public:
@@ -98,6 +109,13 @@ class GraphEx : public LazyFn {
                 const Logger *logger,
                 const SideEffectProvider *side_effect_provider,
                 const NodeExWrapper *node_exwrapper);
+  ~GraphEx();
+
+  /* Keep the states of all nodes alive after an eval, to reuse them in later evals instead of
+   * allocating and initializing them again. Only the states of nodes that have been touched are
+   * reset after an eval. Meant for graphs that are evaluated many times, e.g. once per frame.
+   * Must be called before the first eval. */
+  void enable_state_reuse();
 
   void *init_storage(LinearAllocator<> &allocator) const override;
   void destruct_storage(void *storage) const override;
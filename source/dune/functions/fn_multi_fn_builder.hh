@@ -2,11 +2,24 @@
 
 /* Utils to create multi-fns w less redundant code. */
 #include <functional>
+#include <type_traits>
+#include <typeinfo>
 
 #include "fn_multi_fn.hh"
 
 namespace dune::fn {
 
+/* The type of an element fn without state (e.g. a lambda without captures), null otherwise.
+ * Custom multi-fns created again from the same stateless type compute the same vals, so they
+ * compare equal, see #MultiFn::equals. */
+template<typename ElemFnT> const std::type_info *stateless_elem_fn_type()
+{
+  if constexpr (std::is_empty_v<ElemFnT>) {
+    return &typeid(ElemFnT);
+  }
+  return nullptr;
+}
+
 /* Gen a multi-fn w the following params:
  * 1. single input (SI) of type In1
  * 2. single output (SO) of type Out1
@@ -18,6 +31,8 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFn {
   using FnT = std::fn<void(IndexMask, const VArray<In1> &, MutableSpan<Out1>)>;
   FnT fn_;
   MFSignature signature_;
+  /* Set when the fn is created from a stateless element fn, see #stateless_elem_fn_type. */
+  const std::type_info *elem_fn_type_ = nullptr;
 
  public:
   CustomMF_SI_SO(const char *name, FnT fn) : fn_(std::move(fn))
@@ -33,6 +48,7 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFn {
   CustomMF_SI_SO(const char *name, ElemFnT elem_fn)
       : CustomMF_SI_SO(name, CustomMF_SI_SO::create_fn(element_fn))
   {
+    elem_fn_type_ = stateless_elem_fn_type<ElemFnT>();
   }
 
   template<typename ElementFnT> static FnT create_fn(ElemFnT elem_fn)
@@ -52,6 +68,18 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFn {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(1);
     fn_(mask, in1, out1);
   }
+
+  uint64_t hash() const override
+  {
+    return elem_fn_type_ ? get_default_hash(elem_fn_type_->hash_code()) : MultiFn::hash();
+  }
+
+  bool equals(const MultiFn &other) const override
+  {
+    const CustomMF_SI_SO *other_fn = dynamic_cast<const CustomMF_SI_SO *>(&other);
+    return other_fn != nullptr && elem_fn_type_ != nullptr && other_fn->elem_fn_type_ != nullptr &&
+           *elem_fn_type_ == *other_fn->elem_fn_type_;
+  }
 };
 
 /* Gen a multi-fn w the following params:
@@ -65,6 +93,8 @@ class CustomMF_SI_SI_SO : public MultiFn {
       std::fn<void(IndexMask, const VArray<In1> &, const VArray<In2> &, MutableSpan<Out1>)>;
   FnT fn_;
   MFSignature signature_;
+  /* Set when the fn is created from a stateless element fn, see #stateless_elem_fn_type. */
+  const std::type_info *elem_fn_type_ = nullptr;
 
  public:
   CustomMF_SI_SI_SO(const char *name, FnT fn) : fn_(std::move(fn))
@@ -81,6 +111,7 @@ class CustomMF_SI_SI_SO : public MultiFn {
   CustomMF_SI_SI_SO(const char *name, ElemFnT elem_fn)
       : CustomMF_SI_SI_SO(name, CustomMF_SI_SI_SO::create_fn(elem_fn))
   {
+    elem_fn_type_ = stateless_elem_fn_type<ElemFnT>();
   }
 
   template<typename ElemFnT> static FnT create_fn(ElemFnT elem_fn)
@@ -104,6 +135,18 @@ class CustomMF_SI_SI_SO : public MultiFn {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(2);
     function_(mask, in1, in2, out1);
   }
+
+  uint64_t hash() const override
+  {
+    return elem_fn_type_ ? get_default_hash(elem_fn_type_->hash_code()) : MultiFn::hash();
+  }
+
+  bool equals(const MultiFn &other) const override
+  {
+    const CustomMF_SI_SI_SO *other_fn = dynamic_cast<const CustomMF_SI_SI_SO *>(&other);
+    return other_fn != nullptr && elem_fn_type_ != nullptr && other_fn->elem_fn_type_ != nullptr &&
+           *elem_fn_type_ == *other_fn->elem_fn_type_;
+  }
 };
 
 /* Gen a multi-fn wi the following params:
@@ -121,6 +164,8 @@ class CustomMF_SI_SI_SI_SO : public MultiFn {
                                        MutableSpan<Out1>)>;
   FnT fn_;
   MFSignature signature_;
+  /* Set when the fn is created from a stateless element fn, see #stateless_elem_fn_type. */
+  const std::type_info *elem_fn_type_ = nullptr;
 
  public:
   CustomMF_SI_SI_SI_SO(const char *name, FnT fn) : fn_(std::move(fn))
@@ -138,6 +183,7 @@ class CustomMF_SI_SI_SI_SO : public MultiFn {
   CustomMF_SI_SI_SI_SO(const char *name, ElemFnT elem_fn)
       : CustomMF_SI_SI_SI_SO(name, CustomMF_SI_SI_SI_SO::create_fn(elem_fn))
   {
+    elem_fn_type_ = stateless_elem_fn_type<ElemFnT>();
   }
 
   template<typename ElemFnT> static FnT create_fn(ElemFn elem_fn)
@@ -161,6 +207,18 @@ class CustomMF_SI_SI_SI_SO : public MultiFn {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(3);
     function_(mask, in1, in2, in3, out1);
   }
+
+  uint64_t hash() const override
+  {
+    return elem_fn_type_ ? get_default_hash(elem_fn_type_->hash_code()) : MultiFn::hash();
+  }
+
+  bool equals(const MultiFn &other) const override
+  {
+    const CustomMF_SI_SI_SI_SO *other_fn = dynamic_cast<const CustomMF_SI_SI_SI_SO *>(&other);
+    return other_fn != nullptr && elem_fn_type_ != nullptr && other_fn->elem_fn_type_ != nullptr &&
+           *elem_fn_type_ == *other_fn->elem_fn_type_;
+  }
 };
 
 /**
@@ -182,6 +240,8 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
                                        MutableSpan<Out1>)>;
   FunctionT function_;
   MFSignature signature_;
+  /* Set when the fn is created from a stateless element fn, see #stateless_elem_fn_type. */
+  const std::type_info *elem_fn_type_ = nullptr;
 
  public:
   CustomMF_SI_SI_SI_SI_SO(const char *name, FunctionT function) : function_(std::move(function))
@@ -200,6 +260,7 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
   CustomMF_SI_SI_SI_SI_SO(const char *name, ElementFuncT element_fn)
       : CustomMF_SI_SI_SI_SI_SO(name, CustomMF_SI_SI_SI_SI_SO::create_function(element_fn))
   {
+    elem_fn_type_ = stateless_elem_fn_type<ElementFuncT>();
   }
 
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
@@ -225,6 +286,19 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(4);
     function_(mask, in1, in2, in3, in4, out1);
   }
+
+  uint64_t hash() const override
+  {
+    return elem_fn_type_ ? get_default_hash(elem_fn_type_->hash_code()) : MultiFunction::hash();
+  }
+
+  bool equals(const MultiFunction &other) const override
+  {
+    const CustomMF_SI_SI_SI_SI_SO *other_fn = dynamic_cast<const CustomMF_SI_SI_SI_SI_SO *>(
+        &other);
+    return other_fn != nullptr && elem_fn_type_ != nullptr && other_fn->elem_fn_type_ != nullptr &&
+           *elem_fn_type_ == *other_fn->elem_fn_type_;
+  }
 };
 
 /**
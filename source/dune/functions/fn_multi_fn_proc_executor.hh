@@ -9,6 +9,9 @@ class MFProcExecutor : public MultiFn {
  private:
   MFSignature signature_;
   const MFProc &proc_;
+  /* True when the proc is a chain of calls that can be executed in small chunks of indices, so
+   * that intermediate arrays stay in the CPU cache. */
+  bool fuse_calls_ = false;
 
  public:
   MFProcExecutor(const MFProc &proc);
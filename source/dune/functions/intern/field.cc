@@ -1,4 +1,8 @@
+#include <mutex>
+
 #include "lib_array_utils.hh"
+#include "lib_generic_array.hh"
+#include "lib_implicit_sharing.hh"
 #include "lib_map.hh"
 #include "lib_multi_val_map.hh"
 #include "lib_set.hh"
@@ -686,6 +690,263 @@ GPtr FieldConstant::val() const
   return {type_, val_};
 }
 
+/* Field Eval Cache
+ * Results of fields evaluated by a FieldEvaluator in a cxt with a cache key, reused when the same
+ * field tree is evaluated again on the same version of the data. */
+
+/* Hash of the structure of the field tree, equal for trees computing the same vals. Operations are
+ * identified by the hash of their multi-fn rather than its address, so that the trees built again
+ * for every evaluation (e.g. of a node tree) are found. Empty when the tree contains an op with a
+ * multi-fn it doesn't own, see set_field_eval_cache_budget. */
+static std::optional<uint64_t> field_structure_hash(
+    const GFieldRef field, Map<GFieldRef, std::optional<uint64_t>> &r_hashes)
+{
+  if (const std::optional<uint64_t> *hash = r_hashes.lookup_ptr(field)) {
+    return *hash;
+  }
+  std::optional<uint64_t> hash;
+  const FieldNode &node = field.node();
+  switch (node.node_type()) {
+    case FieldNodeType::Input: {
+      hash = node.hash();
+      break;
+    }
+    case FieldNodeType::Constant: {
+      const GPtr val = static_cast<const FieldConstant &>(node).val();
+      hash = val.type()->hash_or_fallback(val.get(), get_default_hash(val.type()));
+      break;
+    }
+    case FieldNodeType::Op: {
+      const FieldOp &op = static_cast<const FieldOp &>(node);
+      if (!op.owns_fn()) {
+        break;
+      }
+      hash = get_default_hash_2(op.multi_fn().hash(), field.node_output_index());
+      for (const GFieldRef input : op.inputs()) {
+        const std::optional<uint64_t> input_hash = field_structure_hash(input, r_hashes);
+        if (!input_hash) {
+          hash.reset();
+          break;
+        }
+        *hash = (*hash * 33) ^ *input_hash;
+      }
+      break;
+    }
+  }
+  r_hashes.add_new(field, hash);
+  return hash;
+}
+
+/* Check that both field trees compute the same vals. Pairs of nodes known to be equal are added
+ * to r_equal_nodes, sub-trees are often shared. */
+static bool field_structures_equal(
+    const GFieldRef a,
+    const GFieldRef b,
+    Set<std::pair<const FieldNode *, const FieldNode *>> &r_equal_nodes)
+{
+  if (a.node_output_index() != b.node_output_index()) {
+    return false;
+  }
+  const FieldNode &a_node = a.node();
+  const FieldNode &b_node = b.node();
+  if (&a_node == &b_node || r_equal_nodes.contains({&a_node, &b_node})) {
+    return true;
+  }
+  if (a_node.node_type() != b_node.node_type()) {
+    return false;
+  }
+  switch (a_node.node_type()) {
+    case FieldNodeType::Input: {
+      if (a_node != b_node) {
+        return false;
+      }
+      break;
+    }
+    case FieldNodeType::Constant: {
+      const GPtr a_val = static_cast<const FieldConstant &>(a_node).val();
+      const GPtr b_val = static_cast<const FieldConstant &>(b_node).val();
+      if (a_val.type() != b_val.type() ||
+          !a_val.type()->is_equal_or_false(a_val.get(), b_val.get())) {
+        return false;
+      }
+      break;
+    }
+    case FieldNodeType::Op: {
+      const FieldOp &a_op = static_cast<const FieldOp &>(a_node);
+      const FieldOp &b_op = static_cast<const FieldOp &>(b_node);
+      const MultiFn &a_fn = a_op.multi_fn();
+      const MultiFn &b_fn = b_op.multi_fn();
+      if ((&a_fn != &b_fn && !a_fn.equals(b_fn)) || a_op.inputs().size() != b_op.inputs().size())
+      {
+        return false;
+      }
+      for (const int i : a_op.inputs().index_range()) {
+        if (!field_structures_equal(a_op.inputs()[i], b_op.inputs()[i], r_equal_nodes)) {
+          return false;
+        }
+      }
+      break;
+    }
+  }
+  r_equal_nodes.add({&a_node, &b_node});
+  return true;
+}
+
+/* Virtual array referencing a cached result, which is kept alive when it's removed from the
+ * cache. */
+class GVArrayImpl_For_CachedFieldResult final : public GVArrayImpl_For_GSpan {
+ private:
+  std::shared_ptr<GArray<>> result_;
+
+ public:
+  GVArrayImpl_For_CachedFieldResult(std::shared_ptr<GArray<>> result)
+      : GVArrayImpl_For_GSpan(result->as_mutable_span()), result_(std::move(result))
+  {
+  }
+};
+
+struct FieldEvalCacheEntry {
+  /* Kept to compare the structure of the field tree, which also keeps the owned multi-fns
+   * alive. */
+  GField field;
+  /* The data the result was computed from, holding a weak user. */
+  const ImplicitSharingInfo *sharing_info;
+  int64_t version;
+  int domain;
+  std::shared_ptr<GArray<>> result;
+  int64_t bytes;
+  /* Val of FieldEvalCache::use_clock when last used. */
+  int64_t last_use;
+
+  ~FieldEvalCacheEntry()
+  {
+    sharing_info->remove_weak_user_and_delete_if_last();
+  }
+};
+
+struct FieldEvalCache {
+  std::mutex mutex;
+  int64_t budget = 256 * 1024 * 1024;
+  int64_t bytes = 0;
+  int64_t use_clock = 0;
+  /* Entries by field structure hash. */
+  Map<uint64_t, Vector<std::unique_ptr<FieldEvalCacheEntry>>> entries;
+
+  /* Remove entries computed from data that was freed or changed since, then the least recently
+   * used ones until bytes_to_add fits in the budget. */
+  void free_entries(const int64_t bytes_to_add)
+  {
+    for (Vector<std::unique_ptr<FieldEvalCacheEntry>> &bucket : this->entries.values()) {
+      for (int64_t i = bucket.size() - 1; i >= 0; i--) {
+        const FieldEvalCacheEntry &entry = *bucket[i];
+        if (entry.sharing_info->is_expired() ||
+            entry.sharing_info->version() != entry.version) {
+          this->bytes -= entry.bytes;
+          bucket.remove_and_reorder(i);
+        }
+      }
+    }
+    while (this->bytes + bytes_to_add > this->budget && this->bytes > 0) {
+      Vector<std::unique_ptr<FieldEvalCacheEntry>> *lru_bucket = nullptr;
+      int64_t lru_index = -1;
+      for (Vector<std::unique_ptr<FieldEvalCacheEntry>> &bucket : this->entries.values()) {
+        for (const int64_t i : bucket.index_range()) {
+          if (!lru_bucket || bucket[i]->last_use < (*lru_bucket)[lru_index]->last_use) {
+            lru_bucket = &bucket;
+            lru_index = i;
+          }
+        }
+      }
+      this->bytes -= (*lru_bucket)[lru_index]->bytes;
+      lru_bucket->remove_and_reorder(lru_index);
+    }
+    this->entries.remove_if([](const auto item) { return item.value.is_empty(); });
+  }
+};
+
+static FieldEvalCache &get_field_eval_cache()
+{
+  static FieldEvalCache cache;
+  return cache;
+}
+
+static GVArray field_eval_cache_lookup(const GField &field,
+                                       const uint64_t hash,
+                                       const FieldCxtCacheKey &key,
+                                       const int64_t version,
+                                       const int64_t size)
+{
+  FieldEvalCache &cache = get_field_eval_cache();
+  std::lock_guard lock{cache.mutex};
+  Vector<std::unique_ptr<FieldEvalCacheEntry>> *bucket = cache.entries.lookup_ptr(hash);
+  if (!bucket) {
+    return {};
+  }
+  Set<std::pair<const FieldNode *, const FieldNode *>> equal_nodes;
+  for (std::unique_ptr<FieldEvalCacheEntry> &entry : *bucket) {
+    if (entry->sharing_info != key.sharing_info || entry->version != version ||
+        entry->domain != key.domain || entry->result->size() != size ||
+        !field_structures_equal(entry->field, field, equal_nodes))
+    {
+      continue;
+    }
+    entry->last_use = ++cache.use_clock;
+    return GVArray::For<GVArrayImpl_For_CachedFieldResult>(entry->result);
+  }
+  return {};
+}
+
+/* Check if a result of `bytes` may be cached at all, before evaluating it into a shared array. */
+static bool field_eval_cache_fits(const int64_t bytes)
+{
+  FieldEvalCache &cache = get_field_eval_cache();
+  std::lock_guard lock{cache.mutex};
+  return bytes <= cache.budget;
+}
+
+/* Add the evaluated `result`, which is shared with the caller rather than copied. */
+static void field_eval_cache_add(const GField &field,
+                                 const uint64_t hash,
+                                 const FieldCxtCacheKey &key,
+                                 const int64_t version,
+                                 std::shared_ptr<GArray<>> result)
+{
+  const int64_t bytes = result->type().size() * result->size();
+  FieldEvalCache &cache = get_field_eval_cache();
+  std::lock_guard lock{cache.mutex};
+  cache.free_entries(bytes);
+  if (cache.bytes + bytes > cache.budget) {
+    return;
+  }
+  key.sharing_info->add_weak_user();
+  auto entry = std::make_unique<FieldEvalCacheEntry>();
+  entry->field = field;
+  entry->sharing_info = key.sharing_info;
+  entry->version = version;
+  entry->domain = key.domain;
+  entry->result = std::move(result);
+  entry->bytes = bytes;
+  entry->last_use = ++cache.use_clock;
+  cache.bytes += bytes;
+  cache.entries.lookup_or_add_default(hash).append(std::move(entry));
+}
+
+void set_field_eval_cache_budget(const int64_t bytes)
+{
+  FieldEvalCache &cache = get_field_eval_cache();
+  std::lock_guard lock{cache.mutex};
+  cache.budget = std::max<int64_t>(bytes, 0);
+  cache.free_entries(0);
+}
+
+void clear_field_eval_cache()
+{
+  FieldEvalCache &cache = get_field_eval_cache();
+  std::lock_guard lock{cache.mutex};
+  cache.entries.clear();
+  cache.bytes = 0;
+}
+
 /* FieldEval */
 static IndexMask index_mask_from_selection(const IndexMask full_mask,
                                            const VArray<bool> &sel,
@@ -739,17 +1000,98 @@ static IndexMask eval_selection(const Field<bool> &selection_field,
   return full_mask;
 }
 
+/* The result of a field evaluation from a cached array, copied into the destination provided by
+ * the caller when there is one. */
+static GVArray cached_result_to_dst(GVArray cached, GVMutableArray &dst_varray)
+{
+  if (!dst_varray) {
+    return cached;
+  }
+  const GSpan src = cached.get_internal_span();
+  if (dst_varray.is_span()) {
+    array_utils::copy(src, dst_varray.get_internal_span().take_front(src.size()));
+  }
+  else {
+    threading::parallel_for(src.index_range(), 2048, [&](const IndexRange range) {
+      for (const int64_t index : range) {
+        dst_varray.set_by_copy(index, src[index]);
+      }
+    });
+  }
+  return dst_varray;
+}
+
 void FieldEval::eval()
 {
   lib_assert_msg(!is_eval_, "Cannot eval fields twice.");
 
   sel_mask_ = eval_sel(sel_field_, cxt_, mask_, scope_);
 
-  Array<GFieldRef> fields(fields_to_eval_.size());
+  /* Results are only cached when all indices are evaluated. */
+  const int64_t size = sel_mask_.min_array_size();
+  std::optional<FieldCxtCacheKey> cache_key = cxt_.cache_key();
+  if (sel_mask_.is_empty() || sel_mask_.size() != size) {
+    cache_key.reset();
+  }
+  const int64_t version = cache_key ? cache_key->sharing_info->version() : 0;
+
+  eval_varrays_.resize(fields_to_eval_.size());
+  Array<std::optional<uint64_t>> cache_hashes(fields_to_eval_.size());
+  /* Arrays the results to cache are evaluated into, shared with the cache. */
+  Array<std::shared_ptr<GArray<>>> cache_results(fields_to_eval_.size());
+  Vector<GFieldRef> fields;
+  Vector<GVMutableArray> dst_varrays;
+  Vector<int> field_indices;
+  Map<GFieldRef, std::optional<uint64_t>> hashes;
   for (const int i : fields_to_eval_.index_range()) {
-    fields[i] = fields_to_eval_[i];
+    const GField &field = fields_to_eval_[i];
+    if (cache_key && field.node().node_type() == FieldNodeType::Op &&
+        field.node().depends_on_input())
+    {
+      if (field_eval_cache_fits(field.cpp_type().size() * size)) {
+        cache_hashes[i] = field_structure_hash(field, hashes);
+      }
+    }
+    if (cache_hashes[i]) {
+      GVArray cached = field_eval_cache_lookup(field, *cache_hashes[i], *cache_key, version, size);
+      if (cached) {
+        eval_varrays_[i] = cached_result_to_dst(std::move(cached), dst_varrays_[i]);
+        continue;
+      }
+
+      /* Evaluate into an array the cache shares, even when there is a destination. */
+      const CPPType &type = field.cpp_type();
+      cache_results[i] = std::make_shared<GArray<>>(type, size);
+      /* The evaluation constructs the values in place. */
+      type.destruct_n(cache_results[i]->data(), size);
+      fields.append(field);
+      dst_varrays.append(GVMutableArray::ForSpan(cache_results[i]->as_mutable_span()));
+      field_indices.append(i);
+      continue;
+    }
+    fields.append(field);
+    dst_varrays.append(dst_varrays_[i]);
+    field_indices.append(i);
+  }
+
+  if (!fields.is_empty()) {
+    const Vector<GVArray> varrays = eval_fields(scope_, fields, sel_mask_, cxt_, dst_varrays);
+    for (const int i : field_indices.index_range()) {
+      const int field_index = field_indices[i];
+      std::shared_ptr<GArray<>> &result = cache_results[field_index];
+      if (!result) {
+        eval_varrays_[field_index] = varrays[i];
+        continue;
+      }
+      eval_varrays_[field_index] = cached_result_to_dst(
+          GVArray::For<GVArrayImpl_For_CachedFieldResult>(result), dst_varrays_[field_index]);
+      field_eval_cache_add(fields_to_eval_[field_index],
+                           *cache_hashes[field_index],
+                           *cache_key,
+                           version,
+                           std::move(result));
+    }
   }
-  eval_varrays_ = eval_fields(scope_, fields, sel_mask_, cxt_, dst_varrays_);
   lib_assert(fields_to_evaluate_.size() == evaluated_varrays_.size());
   for (const int i : fields_to_eval_.index_range()) {
     OutputPointerInfo &info = output_ptr_infos_[i];
@@ -20,6 +20,15 @@
  * exceptions). The assumption here is that most nodes are only ever touched by a single thread and
  * therefore the lock contention is reduced the more nodes there are.
  *
+ * The most common transitions of a node state don't lock the node at all, bc they only change
+ * atomic parts of the state in a way that can't conflict with a thread that holds the lock:
+ * - Counting the missing required inputs of a node.
+ * - Changing the schedule state of a node.
+ * - Marking an output as used.
+ * - Forwarding a val into an input that is used alrdy. Its usage can't change anymore and
+ *   its single origin socket is the only one that ever sets its val.
+ * All other transitions still lock the node.
+ *
  * Similar to how a LazyFn can be thought of as a state machine (see `FN_lazy_function.hh`),
  * each node can also be thought of as a state machine. The state of a node contains the evaluation
  * state of its inputs and outputs. Every time a node is executed, it has to advance its state in
@@ -35,9 +44,12 @@
  * provide new inputs to the graph which in turn leads to new nodes being scheduled and the process
  * starts again. */
 
+#include <atomic>
 #include <mutex>
 #include <sstream>
 
+#include "mem_guardedalloc.h"
+
 #include "lib_compute_cxt.hh"
 #include "lib_enumerable_thread_specific.hh"
 #include "lib_fn_ref.hh"
@@ -69,12 +81,15 @@ struct InputState {
    * computing their outputs, the computed values will be forwarded to linked input sockets. The
    * value will then live here until it is found that it is not needed anymore.
    *
-   * If was_rdy_for_ex is true, access does not require holding the node lock. */
-  void *val = nullptr;
+   * If was_rdy_for_ex is true, access does not require holding the node lock. Once the usage
+   * is #ValUsage::Used, the val is set wo holding the node lock. */
+  std::atomic<void *> val = nullptr;
   /* How the node intends to use this input. By default, all inputs may be used. Based on which
    * outputs are used, a node can decide that an input will definitely be used or is never used.
-   * This allows freeing vals early and avoids unnecessary computations.*/
-  ValUsage usage = ValUsage::Maybe;
+   * This allows freeing vals early and avoids unnecessary computations.
+   * Only changed while holding the node lock, but #ValUsage::Used never changes again, so it can
+   * be checked wo the lock. */
+  std::atomic<ValUsage> usage = ValUsage::Maybe;
   /* Set to true once val is set and will stay true afterwards. Access during execution of a
    * node, does not require holding the node lock. */
   bool was_rdy_for_ex = false;
@@ -83,8 +98,10 @@ struct InputState {
 struct OutputState {
   /* Keeps track of how the output val is used. If a connected input becomes used, this output
    * has to become used as well. The output becomes unused when it is used by no input socket
-   * anymore and it's not an output of the graph. */
-  ValUsage usage = ValUsage::Maybe;
+   * anymore and it's not an output of the graph.
+   * Changing it from #ValUsage::Maybe to #ValUsage::Used does not require holding the node lock,
+   * so other changes have to be done with a compare-and-swap. */
+  std::atomic<ValUsage> usage = ValUsage::Maybe;
   /* This is a copy of usage that is done right before node ex starts. This is done so that
    * the node gets a consistent view of what outputs are used, even when this changes while the
    * node is running (the node might be reevaluated in that case). Access during ex of a
@@ -112,8 +129,9 @@ struct NodeState {
   OutputState *outputs;
   /* Counts the num of inputs that still have to be provided to this node, until it should run
    * again. This is used as an optimization so that nodes are not scheduled unnecessarily in many
-   * cases. */
-  int missing_required_inputs = 0;
+   * cases. Only incremented while holding the node lock, but decremented wo it when a val is
+   * forwarded to a used input. */
+  std::atomic<int> missing_required_inputs = 0;
   /* Is set to true once the node is done with its work, i.e. when all outputs that may be used
    * have been computed. */
   bool node_has_finished = false;
@@ -130,10 +148,14 @@ struct NodeState {
    * methods on Params from multiple threads. */
   bool enabled_multi_threading = false;
   /* A node is always in one specific schedule state. This helps to ensure that the same node does
-   * not run twice at the same time accidentally. */
-  NodeScheduleState schedule_state = NodeScheduleState::NotScheduled;
+   * not run twice at the same time accidentally. Access does not require holding the node lock,
+   * see #Executor::schedule_node. */
+  std::atomic<NodeScheduleState> schedule_state = NodeScheduleState::NotScheduled;
   /* Custom storage of the node. */
   void *storage = nullptr;
+  /* Set to true the first time the state is changed during an eval, when node states are reused
+   * (see #GraphExReusableStates). Access does not require holding the node lock. */
+  std::atomic<bool> is_touched = false;
 };
 
 /* Util class that wraps a node whose state is locked. Having this is a separate class is useful
@@ -154,6 +176,35 @@ struct LockedNode {
   LockedNode(const Node &node, NodeState &node_state) : node(node), node_state(node_state) {}
 };
 
+/* Node states of a graph that are kept alive between evals, see
+ * #GraphExecutor::enable_state_reuse. Only the states of nodes that have been touched during an
+ * eval are reset afterwards. The states of untouched nodes still have their static val
+ * usages, so those don't have to be init again when the side effect nodes didn't change. */
+struct GraphExReusableStates {
+  /* Laid out as described by #GraphExecutor::init_buf_info_. */
+  void *buf = nullptr;
+  MutableSpan<NodeState *> node_states;
+  /* True when the static val usages of all nodes have been init for #side_effect_nodes. */
+  bool static_val_usages_initialized = false;
+  Vector<const FnNode *> side_effect_nodes;
+  /* Nodes that #side_effect_nodes and graph outputs depend on, used to init the static val
+   * usages of reset nodes again. */
+  Array<bool> reachable_node_flags;
+  /* Indices of the nodes that have been touched during the current eval. Every node is added
+   * at most once, see #NodeState::is_touched. */
+  Array<int> touched_nodes;
+  std::atomic<int> touched_nodes_num = 0;
+
+  ~GraphExReusableStates()
+  {
+    /* All nodes have been reset, so there are no vals or storages to destruct anymore. */
+    for (NodeState *node_state : node_states) {
+      std::destroy_at(node_state);
+    }
+    mem_free(buf);
+  }
+};
+
 class Executor;
 class GraphExecutorLFParams;
 
@@ -248,6 +299,8 @@ class Executor {
   LinearAllocator<> main_allocator_;
   /* Set to false when the first execution ends. */
   bool is_first_execution_ = true;
+  /* Node states taken from #GraphExecutor::reusable_states_pool_, when reusing them is enabled. */
+  GraphExReusableStates *reusable_states_ = nullptr;
 
   friend GraphExecutorLFParams;
 
@@ -272,6 +325,12 @@ class Executor {
     if (TaskPool *task_pool = task_pool_.load()) {
       lib_task_pool_free(task_pool);
     }
+    if (reusable_states_ != nullptr) {
+      this->reset_touched_node_states();
+      std::lock_guard lock{self_.reusable_states_mutex_};
+      self_.reusable_states_pool_.append(std::unique_ptr<GraphExReusableStates>(reusable_states_));
+      return;
+    }
     threading::parallel_for(node_states_.index_range(), 1024, [&](const IndexRange range) {
       for (const int node_index : range) {
         const Node &node = *self_.graph_.nodes()[node_index];
@@ -304,10 +363,16 @@ class Executor {
 
     CurrentTask current_task;
     if (is_first_execution_) {
-      /* Alloc a single large buf instead of making many smaller allocs below. */
-      char *buf = static_cast<char *>(
-          local_data.alloc->alloc(self_.init_buf_info_.total_size, alignof(void *)));
-      this->init_node_states(buf);
+      char *buf;
+      if (self_.reuse_states_) {
+        buf = this->init_reusable_node_states();
+      }
+      else {
+        /* Alloc a single large buf instead of making many smaller allocs below. */
+        buf = static_cast<char *>(
+            local_data.alloc->alloc(self_.init_buf_info_.total_size, alignof(void *)));
+        this->init_node_states(buf);
+      }
 
       loaded_inputs_ = MutableSpan{
           reinterpret_cast<std::atomic<uint8_t> *>(
@@ -323,15 +388,19 @@ class Executor {
       Vector<const FnNode *> side_effect_nodes;
       if (self_.side_effect_provider_ != nullptr) {
         side_effect_nodes = self_.side_effect_provider_->get_nodes_with_side_effects(context);
-        for (const FunctionNode *node : side_effect_nodes) {
-          lib_assert(self_.graph_.nodes().contains(node));
-          const int node_index = node->index_in_graph();
-          NodeState &node_state = *node_states_[node_index];
-          node_state.has_side_effects = true;
-        }
+      }
+      const bool static_val_usages_initialized = this->check_reusable_static_val_usages(
+          side_effect_nodes);
+      for (const FunctionNode *node : side_effect_nodes) {
+        lib_assert(self_.graph_.nodes().contains(node));
+        const int node_index = node->index_in_graph();
+        NodeState &node_state = *node_states_[node_index];
+        node_state.has_side_effects = true;
       }
 
-      this->init_static_val_usages(side_effect_nodes);
+      if (!static_val_usages_initialized) {
+        this->init_static_val_usages(side_effect_nodes);
+      }
       this->schedule_side_effect_nodes(side_effect_nodes, current_task, local_data);
     }
 
@@ -357,25 +426,115 @@ class Executor {
       for (const int i : range) {
         const Node &node = *nodes[i];
         char *mem = buf + self_.init_buffer_info_.node_states_offsets[i];
+        node_states_[i] = this->construct_node_state(node, mem);
+      }
+    });
+  }
 
-        /* Init node state. */
-        NodeState *node_state = reinterpret_cast<NodeState *>(memory);
-        memory += sizeof(NodeState);
-        new (node_state) NodeState();
+  static NodeState *construct_node_state(const Node &node, char *mem)
+  {
+    /* Init node state. */
+    NodeState *node_state = reinterpret_cast<NodeState *>(mem);
+    mem += sizeof(NodeState);
+    new (node_state) NodeState();
+
+    /* Init socket states. */
+    const int num_inputs = node.inputs().size();
+    const int num_outputs = node.outputs().size();
+    node_state->inputs = reinterpret_cast<InputState *>(mem);
+    mem += sizeof(InputState) * num_inputs;
+    node_state->outputs = reinterpret_cast<OutputState *>(mem);
+
+    default_construct_n(node_state->inputs, num_inputs);
+    default_construct_n(node_state->outputs, num_outputs);
+    return node_state;
+  }
 
-        /* Init socket states. */
-        const int num_inputs = node.inputs().size();
-        const int num_outputs = node.outputs().size();
-        node_state->inputs = reinterpret_cast<InputState *>(mem);
-        mem += sizeof(InputState) * num_inputs;
-        node_state->outputs = reinterpret_cast<OutputState *>(mem);
+  /* Takes node states from the ones kept alive by the graph executor, or creates new ones.
+   * Returns the buf that contains them. */
+  char *init_reusable_node_states()
+  {
+    {
+      std::lock_guard lock{self_.reusable_states_mutex_};
+      if (!self_.reusable_states_pool_.is_empty()) {
+        reusable_states_ = self_.reusable_states_pool_.pop_last().release();
+      }
+    }
+    if (reusable_states_ != nullptr) {
+      node_states_ = reusable_states_->node_states;
+      return static_cast<char *>(reusable_states_->buf);
+    }
+
+    const int nodes_num = self_.graph_.nodes().size();
+    reusable_states_ = new GraphExReusableStates();
+    reusable_states_->buf = mem_malloc_aligned(
+        self_.init_buf_info_.total_size, alignof(void *), __func__);
+    reusable_states_->touched_nodes.reinitialize(nodes_num);
+    this->init_node_states(static_cast<char *>(reusable_states_->buf));
+    reusable_states_->node_states = node_states_;
+    return static_cast<char *>(reusable_states_->buf);
+  }
+
+  /* Returns true when the reused node states still have the static val usages for these side
+   * effect nodes. Otherwise all node states are reset, so that they can be init again. */
+  bool check_reusable_static_val_usages(const Span<const FnNode *> side_effect_nodes)
+  {
+    if (reusable_states_ == nullptr) {
+      return false;
+    }
+    if (reusable_states_->static_val_usages_initialized) {
+      if (reusable_states_->side_effect_nodes.as_span() == side_effect_nodes) {
+        return true;
+      }
+      const Span<const Node *> nodes = self_.graph_.nodes();
+      threading::parallel_for(nodes.index_range(), 1024, [&](const IndexRange range) {
+        for (const int node_index : range) {
+          const Node &node = *nodes[node_index];
+          NodeState *node_state = node_states_[node_index];
+          std::destroy_at(node_state);
+          this->construct_node_state(node, reinterpret_cast<char *>(node_state));
+        }
+      });
+    }
+    reusable_states_->side_effect_nodes = side_effect_nodes;
+    reusable_states_->static_val_usages_initialized = true;
+    return false;
+  }
 
-        default_construct_n(node_state->inputs, num_inputs);
-        default_construct_n(node_state->outputs, num_outputs);
+  /* Only has an effect when node states are reused. */
+  void tag_node_touched(const Node &node, NodeState &node_state)
+  {
+    if (reusable_states_ == nullptr) {
+      return;
+    }
+    if (node_state.is_touched.load(std::memory_order_relaxed)) {
+      return;
+    }
+    if (node_state.is_touched.exchange(true)) {
+      return;
+    }
+    const int touched_index = reusable_states_->touched_nodes_num.fetch_add(1);
+    reusable_states_->touched_nodes[touched_index] = node.index_in_graph();
+  }
 
-        node_states_[i] = node_state;
+  /* Bring the touched nodes back into the state they had before the eval, so that the node
+   * states can be reused. */
+  void reset_touched_node_states()
+  {
+    const Span<const Node *> nodes = self_.graph_.nodes();
+    const Span<int> touched_nodes = reusable_states_->touched_nodes.as_span().take_front(
+        reusable_states_->touched_nodes_num.load());
+    threading::parallel_for(touched_nodes.index_range(), 1024, [&](const IndexRange range) {
+      for (const int node_index : touched_nodes.slice(range)) {
+        const Node &node = *nodes[node_index];
+        NodeState *node_state = node_states_[node_index];
+        this->destruct_node_state(node, *node_state);
+        this->construct_node_state(node, reinterpret_cast<char *>(node_state));
+        this->init_static_val_usages_of_node(
+            node, *node_state, reusable_states_->reachable_node_flags);
       }
     });
+    reusable_states_->touched_nodes_num.store(0);
   }
 
   void destruct_node_state(const Node &node, NodeState &node_state)
@@ -504,33 +663,45 @@ class Executor {
     for (const int node_index : reachable_node_flags.index_range()) {
       const Node &node = *all_nodes[node_index];
       NodeState &node_state = *node_states_[node_index];
-      const bool node_is_reachable = reachable_node_flags[node_index];
-      if (node_is_reachable) {
-        for (const int output_index : node.outputs().index_range()) {
-          const OutputSocket &output_socket = node.output(output_index);
-          OutputState &output_state = node_state.outputs[output_index];
-          int use_count = 0;
-          for (const InputSocket *target_socket : output_socket.targets()) {
-            const Node &target_node = target_socket->node();
-            const bool target_is_reachable = reachable_node_flags[target_node.index_in_graph()];
-            /* Only count targets that are reachable. */
-            if (target_is_reachable) {
-              use_count++;
-            }
-          }
-          output_state.potential_target_sockets = use_count;
-          if (use_count == 0) {
-            output_state.usage = ValueUsage::Unused;
+      this->init_static_val_usages_of_node(node, node_state, reachable_node_flags);
+    }
+
+    if (reusable_states_ != nullptr) {
+      /* Needed to init reset node states again. */
+      reusable_states_->reachable_node_flags = std::move(reachable_node_flags);
+    }
+  }
+
+  void init_static_val_usages_of_node(const Node &node,
+                                      NodeState &node_state,
+                                      const Span<bool> reachable_node_flags)
+  {
+    const bool node_is_reachable = reachable_node_flags[node.index_in_graph()];
+    if (node_is_reachable) {
+      for (const int output_index : node.outputs().index_range()) {
+        const OutputSocket &output_socket = node.output(output_index);
+        OutputState &output_state = node_state.outputs[output_index];
+        int use_count = 0;
+        for (const InputSocket *target_socket : output_socket.targets()) {
+          const Node &target_node = target_socket->node();
+          const bool target_is_reachable = reachable_node_flags[target_node.index_in_graph()];
+          /* Only count targets that are reachable. */
+          if (target_is_reachable) {
+            use_count++;
           }
         }
-      }
-      else {
-        /* Inputs of unreachable nodes are unused. */
-        for (const int input_index : node.inputs().index_range()) {
-          node_state.inputs[input_index].usage = ValueUsage::Unused;
+        output_state.potential_target_sockets = use_count;
+        if (use_count == 0) {
+          output_state.usage = ValueUsage::Unused;
         }
       }
     }
+    else {
+      /* Inputs of unreachable nodes are unused. */
+      for (const int input_index : node.inputs().index_range()) {
+        node_state.inputs[input_index].usage = ValueUsage::Unused;
+      }
+    }
   }
 
   void schedule_side_effect_nodes(const Span<const FunctionNode *> side_effect_nodes,
@@ -607,6 +778,17 @@ class Executor {
     }
 
     lib_assert(node.is_fn());
+    /* Most outputs are either used already or become used here, which doesn't need the lock. */
+    ValUsage old_usage = output_state.usage.load();
+    if (old_usage == ValUsage::Used) {
+      return;
+    }
+    if (old_usage == ValUsage::Maybe &&
+        output_state.usage.compare_exchange_strong(old_usage, ValUsage::Used))
+    {
+      this->schedule_node(static_cast<const FnNode &>(node), node_state, current_task, false);
+      return;
+    }
     this->with_locked_node(
         node, node_state, current_task, local_data, [&](LockedNode &locked_node) {
           if (output_state.usage == ValueUsage::Used) {
@@ -631,8 +813,9 @@ class Executor {
           output_state.potential_target_sockets -= 1;
           if (output_state.potential_target_sockets == 0) {
             lib_assert(output_state.usage != ValUsage::Unused);
-            if (output_state.usage == ValUsage::Maybe) {
-              output_state.usage = ValUsage::Unused;
+            /* The output may become used concurrently, see #notify_output_required. */
+            ValUsage old_usage = ValUsage::Maybe;
+            if (output_state.usage.compare_exchange_strong(old_usage, ValUsage::Unused)) {
               if (node.is_interface()) {
                 const int graph_input_index =
                     self_.graph_input_index_by_socket_index_[socket.index()];
@@ -651,29 +834,55 @@ class Executor {
   void schedule_node(LockedNode &locked_node, CurrentTask &current_task, const bool is_priority)
   {
     lib_assert(locked_node.node.is_function());
-    switch (locked_node.node_state.schedule_state) {
-      case NodeScheduleState::NotScheduled: {
-        locked_node.node_state.schedule_state = NodeScheduleState::Scheduled;
-        const FunctionNode &node = static_cast<const FnNode &>(locked_node.node);
-        if (this->use_multi_threading()) {
-          std::lock_guard lock{current_task.mutex};
-          current_task.scheduled_nodes.schedule(node, is_priority);
+    this->schedule_node(static_cast<const FnNode &>(locked_node.node),
+                        locked_node.node_state,
+                        current_task,
+                        is_priority);
+  }
+
+  /* The schedule state only changes with compare-and-swap, so the node does not have to be locked.
+   * Only the thread that runs the node changes it from #NodeScheduleState::Scheduled to
+   * #NodeScheduleState::Running and back to #NodeScheduleState::NotScheduled. */
+  void schedule_node(const FnNode &node,
+                     NodeState &node_state,
+                     CurrentTask &current_task,
+                     const bool is_priority)
+  {
+    this->tag_node_touched(node, node_state);
+    NodeScheduleState old_state = node_state.schedule_state.load();
+    while (true) {
+      switch (old_state) {
+        case NodeScheduleState::NotScheduled: {
+          if (!node_state.schedule_state.compare_exchange_weak(old_state,
+                                                               NodeScheduleState::Scheduled))
+          {
+            /* Try again with the changed state. */
+            break;
+          }
+          if (this->use_multi_threading()) {
+            std::lock_guard lock{current_task.mutex};
+            current_task.scheduled_nodes.schedule(node, is_priority);
+          }
+          else {
+            current_task.scheduled_nodes.schedule(node, is_priority);
+          }
+          current_task.has_scheduled_nodes.store(true, std::mem_order_relaxed);
+          return;
         }
-        else {
-          current_task.scheduled_nodes.schedule(node, is_priority);
+        case NodeScheduleState::Scheduled: {
+          return;
+        }
+        case NodeScheduleState::Running: {
+          if (!node_state.schedule_state.compare_exchange_weak(
+                  old_state, NodeScheduleState::RunningAndRescheduled))
+          {
+            break;
+          }
+          return;
+        }
+        case NodeScheduleState::RunningAndRescheduled: {
+          return;
         }
-        current_task.has_scheduled_nodes.store(true, std::mem_order_relaxed);
-        break;
-      }
-      case NodeScheduleState::Scheduled: {
-        break;
-      }
-      case NodeScheduleState::Running: {
-        locked_node.node_state.schedule_state = NodeScheduleState::RunningAndRescheduled;
-        break;
-      }
-      case NodeScheduleState::RunningAndRescheduled: {
-        break;
       }
     }
   }
@@ -685,6 +894,7 @@ class Executor {
                         const FnRef<void(LockedNode &)> f)
   {
     lib_assert(&node_state == node_states_[node.index_in_graph()]);
+    this->tag_node_touched(node, node_state);
 
     LockedNode locked_node{node, node_state};
     if (this->use_multi_threading()) {
@@ -846,9 +1056,10 @@ class Executor {
           }
 #endif
           this->finish_node_if_possible(locked_node);
-          const bool reschedule_requested = node_state.schedule_state ==
+          /* Other threads may reschedule the node concurrently wo locking it. */
+          const bool reschedule_requested = node_state.schedule_state.exchange(
+                                                NodeScheduleState::NotScheduled) ==
                                             NodeScheduleState::RunningAndRescheduled;
-          node_state.schedule_state = NodeScheduleState::NotScheduled;
           if (reschedule_requested && !node_state.node_has_finished) {
             this->schedule_node(locked_node, current_task, false);
           }
@@ -1010,8 +1221,10 @@ class Executor {
     if (input_state.usage == ValueUsage::Used) {
       return nullptr;
     }
+    /* Count the input before marking it as used, bc its val may be forwarded (and counted)
+     * wo the lock as soon as it's used, see #forward_val_to_used_input. */
+    node_state.missing_required_inputs.fetch_add(1);
     input_state.usage = ValueUsage::Used;
-    node_state.missing_required_inputs += 1;
 
     const OutputSocket *origin_socket = input_socket.origin();
     /* Unlinked inputs are always loaded in advance. */
@@ -1074,6 +1287,24 @@ class Executor {
         }
         continue;
       }
+      if (input_state.usage == ValUsage::Used) {
+        /* The usage can't change anymore, so the val is forwarded wo locking the node. */
+        void *buf;
+        if (is_last_target) {
+          buf = value_to_forward.get();
+          value_to_forward = {};
+        }
+        else {
+          buf = local_data.allocator->alloc(type.size(), type.alignment());
+          type.copy_construct(value_to_forward.get(), buf);
+        }
+        this->forward_val_to_used_input(static_cast<const FnNode &>(target_node),
+                                        node_state,
+                                        input_state,
+                                        buf,
+                                        current_task);
+        continue;
+      }
       this->with_locked_node(
           target_node, node_state, current_task, local_data, [&](LockedNode &locked_node) {
             if (input_state.usage == ValueUsage::Unused) {
@@ -1104,19 +1335,40 @@ class Executor {
   {
     NodeState &node_state = locked_node.node_state;
 
+    if (input_state.usage == ValueUsage::Used) {
+      /* Became used after the check wo the lock. */
+      this->forward_val_to_used_input(static_cast<const FnNode &>(locked_node.node),
+                                      node_state,
+                                      input_state,
+                                      value.get(),
+                                      current_task);
+      return;
+    }
+
     BLI_assert(input_state.value == nullptr);
     BLI_assert(!input_state.was_ready_for_execution);
     input_state.value = value.get();
+  }
 
-    if (input_state.usage == ValueUsage::Used) {
-      node_state.missing_required_inputs -= 1;
-      if (node_state.missing_required_inputs == 0 ||
-          (locked_node.node.is_function() && static_cast<const FunctionNode &>(locked_node.node)
-                                                 .function()
-                                                 .allow_missing_requested_inputs()))
-      {
-        this->schedule_node(locked_node, current_task, false);
-      }
+  /* Doesn't require the node to be locked. The input is used, so it has been counted in
+   * #NodeState::missing_required_inputs alrdy. */
+  void forward_val_to_used_input(const FnNode &node,
+                                 NodeState &node_state,
+                                 InputState &input_state,
+                                 void *val,
+                                 CurrentTask &current_task)
+  {
+    lib_assert(input_state.usage == ValUsage::Used);
+    lib_assert(input_state.val.load() == nullptr);
+    this->tag_node_touched(node, node_state);
+    /* Set the val before counting it, so that the thread that runs the node once all inputs
+     * are counted also finds the val. */
+    input_state.val.store(val);
+
+    const int missing_required_inputs = node_state.missing_required_inputs.fetch_sub(1) - 1;
+    lib_assert(missing_required_inputs >= 0);
+    if (missing_required_inputs == 0 || node.fn().allow_missing_requested_inputs()) {
+      this->schedule_node(node, node_state, current_task, false);
     }
   }
 
@@ -1430,6 +1682,13 @@ GraphExecutor::GraphExecutor(const Graph &graph,
   init_buffer_info_.total_size = offset;
 }
 
+GraphExecutor::~GraphExecutor() = default;
+
+void GraphExecutor::enable_state_reuse()
+{
+  reuse_states_ = true;
+}
+
 void GraphExecutor::execute_impl(Params &params, const Context &context) const
 {
   Executor &executor = *static_cast<Executor *>(context.storage);
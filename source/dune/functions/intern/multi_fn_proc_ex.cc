@@ -4,6 +4,50 @@
 
 namespace dune::fn::multi_fn {
 
+/* Max num of indices that a proc is executed for at once, when its calls are fused. Small enough
+ * that the intermediate arrays of a chain of calls stay in the CPU cache between calls. */
+static constexpr int64_t fused_chunk_size = 2048;
+
+/* Check if the proc is a single chain of calls on single vals. Every fn computes the val at an
+ * index only from the vals at the same index, so the chain can be executed in chunks of indices
+ * one after another (instead of every call for all indices), giving identical results. */
+static bool proc_calls_can_be_fused(const Proc &proc)
+{
+  for (const ConstParam &param : proc.params()) {
+    if (param.var->data_type().is_vector()) {
+      return false;
+    }
+  }
+  int calls_num = 0;
+  const Instruction *instruction = proc.entry();
+  while (instruction != nullptr) {
+    switch (instruction->type()) {
+      case InstructionType::Call: {
+        calls_num++;
+        instruction = static_cast<const CallInstruction *>(instruction)->next();
+        break;
+      }
+      case InstructionType::Destruct: {
+        instruction = static_cast<const DestructInstruction *>(instruction)->next();
+        break;
+      }
+      case InstructionType::Dummy: {
+        instruction = static_cast<const DummyInstruction *>(instruction)->next();
+        break;
+      }
+      case InstructionType::Branch: {
+        return false;
+      }
+      case InstructionType::Return: {
+        instruction = nullptr;
+        break;
+      }
+    }
+  }
+  /* A single call does not have intermediate arrays. */
+  return calls_num >= 2;
+}
+
 ProcEx::ProcEx(const Proc &proc) : proc_(proc)
 {
   SignatureBuilder builder("Proc Ex", signature_);
@@ -13,6 +57,8 @@ ProcEx::ProcEx(const Proc &proc) : proc_(proc)
   }
 
   this->set_signature(&signature_);
+
+  fuse_calls_ = proc_calls_can_be_fused(proc);
 }
 
 using IndicesSplitVectors = std::array<Vector<int64_t>, 2>;
@@ -119,6 +165,10 @@ class ValAllocator : NonCopyable, NonMovable {
   /* All bufs in the free-lists below have been alloc w this allocator. */
   LinearAllocator<> &linear_allocator_;
 
+  /* Span bufs are alloc for at least this many elems. Used when the bufs are reused for
+   * diff masks, whose min array size differs. */
+  int64_t min_span_size_;
+
   /* Use stacks so that the most recently used bufs are reused 1st. This improves cache
    * efficiency */
   std::array<Stack<VarVal *>, tot_var_val_types> var_val_free_lists_;
@@ -135,7 +185,10 @@ class ValAllocator : NonCopyable, NonMovable {
   Map<const CPPType *, Stack<void *>> single_val_free_lists_;
 
  public:
-  ValAllocator(LinearAllocator<> &linear_allocator) : linear_allocator_(linear_allocator) {}
+  ValAllocator(LinearAllocator<> &linear_allocator, const int64_t min_span_size = 0)
+      : linear_allocator_(linear_allocator), min_span_size_(min_span_size)
+  {
+  }
 
   VarVal_GVArray *obtain_GVArray(const GVArray &varray)
   {
@@ -152,9 +205,10 @@ class ValAllocator : NonCopyable, NonMovable {
     return this->obtain<VarVal_Span>(buffer, false);
   }
 
-  VarVal_Span *obtain_Span(const CPPType &type, int size)
+  VarVal_Span *obtain_Span(const CPPType &type, int64_t size)
   {
     void *buf = nullptr;
+    size = std::max(size, min_span_size_);
 
     const int64_t elem_size = type.size();
     const int64_t alignment = type.alignment();
@@ -797,17 +851,17 @@ class VarState : NonCopyable, NonMovable {
 /** Keeps track of the states of all variables during evaluation. */
 class VariableStates {
  private:
-  ValueAllocator value_allocator_;
+  ValueAllocator &value_allocator_;
   const Procedure &procedure_;
   /** The state of every variable, indexed by #Variable::index_in_procedure(). */
   Array<VariableState> variable_states_;
   const IndexMask &full_mask_;
 
  public:
-  VariableStates(LinearAllocator<> &linear_allocator,
+  VariableStates(ValueAllocator &value_allocator,
                  const Procedure &procedure,
                  const IndexMask &full_mask)
-      : value_allocator_(linear_allocator),
+      : value_allocator_(value_allocator),
         procedure_(procedure),
         variable_states_(procedure.variables().size()),
         full_mask_(full_mask)
@@ -1141,19 +1195,18 @@ class InstructionScheduler {
   }
 };
 
-void ProcedureExecutor::call(const IndexMask &full_mask, Params params, Context context) const
+static void execute_proc(const ProcEx &fn,
+                         const Proc &proc,
+                         const IndexMask &full_mask,
+                         Params params,
+                         const Cxt &context,
+                         ValAllocator &val_allocator)
 {
-  BLI_assert(procedure_.validate());
-
-  AlignedBuffer<512, 64> local_buffer;
-  LinearAllocator<> linear_allocator;
-  linear_allocator.provide_buf(local_buffer);
-
-  VariableStates variable_states{linear_allocator, proc_, full_mask};
-  variable_states.add_init_var_states(*this, proc_, params);
+  VariableStates variable_states{val_allocator, proc, full_mask};
+  variable_states.add_init_var_states(fn, proc, params);
 
   InstructionScheduler scheduler;
-  scheduler.add_referenced_indices(*procedure_.entry(), full_mask);
+  scheduler.add_referenced_indices(*proc.entry(), full_mask);
 
   /* Loop until all indices got to a return instruction. */
   while (!scheduler.is_done()) {
@@ -1202,9 +1255,9 @@ void ProcedureExecutor::call(const IndexMask &full_mask, Params params, Context
     }
   }
 
-  for (const int param_index : this->param_indices()) {
-    const ParamType param_type = this->param_type(param_index);
-    const Var *var = proc_.params()[param_index].var;
+  for (const int param_index : fn.param_indices()) {
+    const ParamType param_type = fn.param_type(param_index);
+    const Var *var = proc.params()[param_index].var;
     VarState &variable_state = var_states.get_var_state(*var);
     switch (param_type.interface_type()) {
       case ParamType::Input: {
@@ -1225,6 +1278,105 @@ void ProcedureExecutor::call(const IndexMask &full_mask, Params params, Context
   }
 }
 
+/* Like the slicing in #MultiFn::call_auto, but only for single params. */
+static void add_sliced_single_params(const ProcEx &fn,
+                                     Params &full_params,
+                                     const IndexRange slice_range,
+                                     ParamsBuilder &r_sliced_params)
+{
+  for (const int param_index : fn.param_indices()) {
+    const ParamType param_type = fn.param_type(param_index);
+    switch (param_type.category()) {
+      case ParamCategory::SingleInput: {
+        const GVArray &varray = full_params.readonly_single_input(param_index);
+        r_sliced_params.add_readonly_single_input(varray.slice(slice_range));
+        break;
+      }
+      case ParamCategory::SingleMutable: {
+        const GMutableSpan span = full_params.single_mutable(param_index);
+        r_sliced_params.add_single_mutable(span.slice(slice_range));
+        break;
+      }
+      case ParamCategory::SingleOutput: {
+        const GMutableSpan span = full_params.uninitialized_single_output(param_index);
+        r_sliced_params.add_uninitialized_single_output(span.slice(slice_range));
+        break;
+      }
+      case ParamCategory::VectorInput:
+      case ParamCategory::VectorMutable:
+      case ParamCategory::VectorOutput: {
+        lib_assert_unreachable();
+        break;
+      }
+    }
+  }
+}
+
+/* Execute the proc for chunks of #fused_chunk_size indices one after another. The indices of
+ * every chunk are offset to start at zero, so that intermediate arrays are only as large as a
+ * chunk and are reused by the next chunk while they are still in the cache.
+ * Returns false when the mask is too sparse for that to help. */
+static bool execute_proc_in_fused_chunks(const ProcEx &fn,
+                                         const Proc &proc,
+                                         const IndexMask &full_mask,
+                                         Params &params,
+                                         const Cxt &context,
+                                         LinearAllocator<> &linear_allocator)
+{
+  const int64_t chunks_num = (full_mask.size() + fused_chunk_size - 1) / fused_chunk_size;
+  const auto chunk_range = [&](const int64_t chunk_i) {
+    return full_mask.index_range().slice(chunk_i * fused_chunk_size,
+                                         std::min(fused_chunk_size,
+                                                  full_mask.size() - chunk_i * fused_chunk_size));
+  };
+  const auto chunk_input_range = [&](const IndexRange range) {
+    const int64_t start = full_mask[range.first()];
+    return IndexRange(start, full_mask[range.last()] - start + 1);
+  };
+
+  /* All chunks reuse the same intermediate arrays, which have to be large enough for all. */
+  int64_t max_array_size = 0;
+  for (const int64_t chunk_i : IndexRange(chunks_num)) {
+    max_array_size = std::max(max_array_size, chunk_input_range(chunk_range(chunk_i)).size());
+  }
+  if (max_array_size > fused_chunk_size * 4) {
+    return false;
+  }
+
+  ValAllocator val_allocator{linear_allocator, max_array_size};
+  for (const int64_t chunk_i : IndexRange(chunks_num)) {
+    const IndexRange range = chunk_range(chunk_i);
+    const IndexRange input_range = chunk_input_range(range);
+
+    IndexMaskMem mem;
+    const IndexMask offset_mask = full_mask.slice_and_offset(range, -input_range.start(), mem);
+
+    ParamsBuilder sliced_params{fn, &offset_mask};
+    add_sliced_single_params(fn, params, input_range, sliced_params);
+    execute_proc(fn, proc, offset_mask, sliced_params, context, val_allocator);
+  }
+  return true;
+}
+
+void ProcEx::call(const IndexMask &full_mask, Params params, Cxt context) const
+{
+  lib_assert(proc_.validate());
+
+  AlignedBuf<512, 64> local_buf;
+  LinearAllocator<> linear_allocator;
+  linear_allocator.provide_buf(local_buf);
+
+  if (fuse_calls_ && full_mask.size() > fused_chunk_size) {
+    if (execute_proc_in_fused_chunks(*this, proc_, full_mask, params, context, linear_allocator))
+    {
+      return;
+    }
+  }
+
+  ValAllocator val_allocator{linear_allocator};
+  execute_proc(*this, proc_, full_mask, params, context, val_allocator);
+}
+
 MultiFunction::ExecutionHints ProcedureExecutor::get_execution_hints() const
 {
   ExecutionHints hints;
@@ -1,6 +1,9 @@
 #include "testing/testing.h"
 
+#include "mem_guardedalloc.h"
+
 #include "lib_cpp_type.hh"
+#include "lib_implicit_sharing.hh"
 #include "fn_field.hh"
 #include "fn_multi_builder.hh"
 #include "fn_multi_test_common.hh"
@@ -277,4 +280,118 @@ TEST(field, IgnoredOutput)
   EXPECT_EQ(results.get(3), 5);
 }
 
+/* Counts how often its vals are retrieved. */
+class CountingIndexFieldInput final : public FieldInput {
+ public:
+  mutable int calls_num = 0;
+
+  CountingIndexFieldInput() : FieldInput(CPPType::get<int>(), "Counting Index") {}
+
+  GVArray get_varray_for_cxt(const FieldCxt & /*cxt*/,
+                             const IndexMask &mask,
+                             ResourceScope & /*scope*/) const final
+  {
+    calls_num++;
+    auto index_fn = [](int i) { return i; };
+    return VArray<int>::ForFn(mask.min_array_size(), index_fn);
+  }
+};
+
+class CachedFieldCxt : public FieldCxt {
+ public:
+  const ImplicitSharingInfo *sharing_info;
+
+  std::optional<FieldCxtCacheKey> cache_key() const override
+  {
+    return FieldCxtCacheKey{sharing_info, 0};
+  }
+};
+
+TEST(field, EvalCache)
+{
+  auto input = std::make_shared<CountingIndexFieldInput>();
+  auto add_fn = std::make_shared<mf::CustomMF_SI_SI_SO<int, int, int>>(
+      "add", [](int a, int b) { return a + b; });
+  Field<int> field{FieldOp::Create(add_fn, {GField(input), GField(input)}), 0};
+
+  CachedFieldCxt cxt;
+  cxt.sharing_info = implicit_sharing::info_for_mem_free(mem_malloc(1, __func__));
+
+  auto eval_field = [&]() {
+    Array<int> result(10);
+    FieldEval eval{cxt, 10};
+    eval.add_with_destination(field, result.as_mutable_span());
+    eval.eval();
+    EXPECT_EQ(result[0], 0);
+    EXPECT_EQ(result[9], 18);
+  };
+
+  eval_field();
+  EXPECT_EQ(input->calls_num, 1);
+  eval_field();
+  EXPECT_EQ(input->calls_num, 1);
+
+  /* Changing the data invalidates the cached result. */
+  cxt.sharing_info->tag_ensured_mutable();
+  eval_field();
+  EXPECT_EQ(input->calls_num, 2);
+  eval_field();
+  EXPECT_EQ(input->calls_num, 2);
+
+  /* Evaluating only some indices doesn't use the cache. */
+  const Array<int64_t> indices = {2, 4};
+  IndexMaskMem mem;
+  const IndexMask mask = IndexMask::from_indices<int64_t>(indices, mem);
+  VArray<int> result;
+  FieldEval eval_masked{cxt, &mask};
+  eval_masked.add(field, &result);
+  eval_masked.eval();
+  EXPECT_EQ(result.get(4), 8);
+  EXPECT_EQ(input->calls_num, 3);
+
+  clear_field_eval_cache();
+  cxt.sharing_info->remove_user_and_delete_if_last();
+}
+
+TEST(field, EvalCacheRebuiltTree)
+{
+  auto input = std::make_shared<CountingIndexFieldInput>();
+  CachedFieldCxt cxt;
+  cxt.sharing_info = implicit_sharing::info_for_mem_free(mem_malloc(1, __func__));
+
+  /* The field trees are built again for every evaluation, like the trees of node groups. */
+  auto build_sum = [&]() {
+    auto add_fn = std::make_shared<mf::CustomMF_SI_SI_SO<int, int, int>>(
+        "add", [](int a, int b) { return a + b; });
+    return Field<int>{FieldOp::Create(add_fn, {GField(input), GField(input)}), 0};
+  };
+  auto build_sum_offset = [&](const int offset) {
+    auto offset_fn = std::make_shared<mf::CustomMF_SI_SO<int, int>>(
+        "offset", [offset](int a) { return a + offset; });
+    return Field<int>{FieldOp::Create(offset_fn, {build_sum()}), 0};
+  };
+  auto eval_field = [&](const Field<int> &field, const int expected_last) {
+    Array<int> result(10);
+    FieldEval eval{cxt, 10};
+    eval.add_with_destination(field, result.as_mutable_span());
+    eval.eval();
+    EXPECT_EQ(result[0], expected_last - 18);
+    EXPECT_EQ(result[9], expected_last);
+  };
+
+  eval_field(build_sum(), 18);
+  EXPECT_EQ(input->calls_num, 1);
+  eval_field(build_sum(), 18);
+  EXPECT_EQ(input->calls_num, 1);
+
+  /* A fn with state (the captured offset) is never equal to another one. */
+  eval_field(build_sum_offset(1), 19);
+  EXPECT_EQ(input->calls_num, 2);
+  eval_field(build_sum_offset(1), 19);
+  EXPECT_EQ(input->calls_num, 3);
+
+  clear_field_eval_cache();
+  cxt.sharing_info->remove_user_and_delete_if_last();
+}
+
 }  // namespace blender::fn::tests
@@ -1,11 +1,14 @@
 #include "testing/testing.h"
 
+#include <cfloat>
+#include <cstdio>
+
 #include "fn_lazy_ex.hh"
 #include "fn_lazy_graph.hh"
 #include "fn_lazy_graph_executor.hh"
 
 #include "lib_task.h"
-#include "lib_timeit.hh"
+#include "lib_time.h"
 
 namespace dune::fn::lazy_fn::tests {
 
@@ -175,4 +178,162 @@ TEST(lazy_fn, GraphWithCycle)
   EXPECT_EQ(result, 10 * 2 * 5);
 }
 
+TEST(lazy_fn, ReuseStates)
+{
+  const AddLazyFn add_fn;
+
+  Graph graph;
+  FnNode &add_node_1 = graph.add_fn(add_fn);
+  FnNode &add_node_2 = graph.add_fn(add_fn);
+  GraphInputSocket &graph_input = graph.add_input(CPPType::get<int>());
+  GraphOutputSocket &graph_output = graph.add_output(CPPType::get<int>());
+
+  graph.add_link(graph_input, add_node_1.input(0));
+  graph.add_link(graph_input, add_node_1.input(1));
+  graph.add_link(add_node_1.output(0), add_node_2.input(0));
+  graph.add_link(graph_input, add_node_2.input(1));
+  graph.add_link(add_node_2.output(0), graph_output);
+
+  graph.update_node_indices();
+
+  GraphExecutor executor_fn{graph, {&graph_input}, {&graph_output}, nullptr, nullptr, nullptr};
+  executor_fn.enable_state_reuse();
+  /* The node states of the first eval are reset and used by the later ones. */
+  for (const int i : IndexRange(5)) {
+    int result = 0;
+    ex_lazy_fn_eagerly(
+        executor_fn, nullptr, nullptr, std::make_tuple(i), std::make_tuple(&result));
+    EXPECT_EQ(result, i * 3);
+  }
+}
+
+/* Benchmarks of the graph executor with many cheap nodes, where most time is spent in the
+ * communication between nodes. */
+
+static OutputSocket &add_node_to_graph(Graph &graph,
+                                       const LazyFn &add_fn,
+                                       OutputSocket &a,
+                                       OutputSocket *b)
+{
+  static const int zero = 0;
+  FnNode &node = graph.add_fn(add_fn);
+  graph.add_link(a, node.input(0));
+  if (b != nullptr) {
+    graph.add_link(*b, node.input(1));
+  }
+  else {
+    node.input(1).set_default_value(&zero);
+  }
+  return node.output(0);
+}
+
+/* Adds up all sockets pairwise, until one is left. */
+static OutputSocket &add_sum_to_graph(Graph &graph,
+                                      const LazyFn &add_fn,
+                                      Vector<OutputSocket *> sockets)
+{
+  while (sockets.size() > 1) {
+    Vector<OutputSocket *> sums;
+    for (int i = 0; i + 1 < sockets.size(); i += 2) {
+      sums.append(&add_node_to_graph(graph, add_fn, *sockets[i], sockets[i + 1]));
+    }
+    if (sockets.size() % 2) {
+      sums.append(sockets.last());
+    }
+    sockets = std::move(sums);
+  }
+  return *sockets.first();
+}
+
+static void benchmark_graph(const char *name,
+                            Graph &graph,
+                            GraphInputSocket &input_socket,
+                            OutputSocket &result_socket,
+                            const int expected_result)
+{
+  GraphOutputSocket &output_socket = graph.add_output(CPPType::get<int>());
+  graph.add_link(result_socket, output_socket);
+  graph.update_node_indices();
+
+  GraphExecutor executor_fn{graph, {&input_socket}, {&output_socket}, nullptr, nullptr, nullptr};
+  const int runs_num = 5;
+  double time_min = DBL_MAX;
+  double time_sum = 0.0;
+  for (int i = 0; i < runs_num; i++) {
+    int result = 0;
+    const double time_start = time_check_seconds_timer();
+    ex_lazy_fn_eagerly(
+        executor_fn, nullptr, nullptr, std::make_tuple(1), std::make_tuple(&result));
+    const double time = time_check_seconds_timer() - time_start;
+    time_min = std::min(time_min, time);
+    time_sum += time;
+    EXPECT_EQ(result, expected_result);
+  }
+  printf("%s graph: %.6f s fastest, %.6f s average of %d runs\n",
+         name,
+         time_min,
+         time_sum / runs_num,
+         runs_num);
+}
+
+TEST(lazy_fn, DISABLED_BenchmarkWideGraph)
+{
+  lib_task_scheduler_init();
+  const AddLazyFn add_fn;
+  const int width = 100000;
+
+  Graph graph;
+  GraphInputSocket &input_socket = graph.add_input(CPPType::get<int>());
+  Vector<OutputSocket *> sockets;
+  for (int i = 0; i < width; i++) {
+    sockets.append(&add_node_to_graph(graph, add_fn, input_socket, nullptr));
+  }
+  OutputSocket &sum_socket = add_sum_to_graph(graph, add_fn, std::move(sockets));
+
+  benchmark_graph("wide", graph, input_socket, sum_socket, width);
+}
+
+TEST(lazy_fn, DISABLED_BenchmarkDeepGraph)
+{
+  lib_task_scheduler_init();
+  const AddLazyFn add_fn;
+  const int depth = 100000;
+
+  Graph graph;
+  GraphInputSocket &input_socket = graph.add_input(CPPType::get<int>());
+  OutputSocket *socket = &input_socket;
+  for (int i = 0; i < depth; i++) {
+    /* Adds the graph input every time. */
+    socket = &add_node_to_graph(graph, add_fn, *socket, &input_socket);
+  }
+
+  benchmark_graph("deep", graph, input_socket, *socket, depth + 1);
+}
+
+TEST(lazy_fn, DISABLED_BenchmarkDiamondGraph)
+{
+  lib_task_scheduler_init();
+  const AddLazyFn add_fn;
+  const int width = 1000;
+  const int depth = 16;
+
+  Graph graph;
+  GraphInputSocket &input_socket = graph.add_input(CPPType::get<int>());
+  Vector<OutputSocket *> layer;
+  for (int i = 0; i < width; i++) {
+    layer.append(&add_node_to_graph(graph, add_fn, input_socket, nullptr));
+  }
+  /* Every socket is used by two nodes of the next layer, which doubles the vals. */
+  for (int depth_i = 1; depth_i < depth; depth_i++) {
+    Vector<OutputSocket *> next_layer;
+    for (int i = 0; i < width; i++) {
+      next_layer.append(&add_node_to_graph(graph, add_fn, *layer[i], layer[(i + 1) % width]));
+    }
+    layer = std::move(next_layer);
+  }
+  OutputSocket &sum_socket = add_sum_to_graph(graph, add_fn, std::move(layer));
+
+  benchmark_graph("diamond", graph, input_socket, sum_socket, width << (depth - 1));
+}
+
 }  // namespace dune::fn::lazy_fn::tests
@@ -385,6 +385,69 @@ TEST(multi_fn_proc, BufReuse)
   EXPECT_EQ(results[4], 53);
 }
 
+TEST(multi_fn_proc, FusedCalls)
+{
+  /* proc(int a, int b, int *out) {
+   *   int c = a + b;
+   *   int d = c * 2;
+   *   out = d + a; */
+
+  auto add_fn = build::SI2_SO<int, int, int>("add", [](int a, int b) { return a + b; });
+  auto double_fn = build::SI1_SO<int, int>("double", [](int a) { return a * 2; });
+
+  Proc proc;
+  ProcBuilder builder{proc};
+
+  Var *var_a = &builder.add_single_input_param<int>();
+  Var *var_b = &builder.add_single_input_param<int>();
+  auto [var_c] = builder.add_call<1>(add_fn, {var_a, var_b});
+  builder.add_destruct(*var_b);
+  auto [var_d] = builder.add_call<1>(double_fn, {var_c});
+  builder.add_destruct(*var_c);
+  auto [var_out] = builder.add_call<1>(add_fn, {var_d, var_a});
+  builder.add_destruct({var_a, var_d});
+  builder.add_return();
+  builder.add_output_param(*var_out);
+
+  EXPECT_TRUE(proc.validate());
+
+  ProcExecutor proc_fn{proc};
+
+  /* Large enough to be executed in multiple chunks, with a gap that makes one chunk larger. */
+  const int size = 10000;
+  Array<int> inputs_a(size);
+  for (const int i : IndexRange(size)) {
+    inputs_a[i] = i;
+  }
+  Vector<int> indices;
+  for (const int i : IndexRange(size)) {
+    if (i < 3000 || i >= 3500) {
+      indices.append(i);
+    }
+  }
+  IndexMaskMem mem;
+  const IndexMask mask = IndexMask::from_indices<int>(indices, mem);
+
+  Array<int> results(size, -1);
+  ParamsBuilder params{proc_fn, &mask};
+  params.add_readonly_single_input(inputs_a.as_span());
+  /* Same val for every index. */
+  params.add_readonly_single_input(VArray<int>::ForSingle(7, size));
+  params.add_uninitialized_single_output(results.as_mutable_span());
+
+  CxtBuilder cxt;
+  proc_fn.call(mask, params, cxt);
+
+  for (const int i : IndexRange(size)) {
+    if (i < 3000 || i >= 3500) {
+      EXPECT_EQ(results[i], (i + 7) * 2 + i);
+    }
+    else {
+      EXPECT_EQ(results[i], -1);
+    }
+  }
+}
+
 TEST(multi_fn_proc, OutputBufferReplaced)
 {
   Proc proc;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "BLI_math_vector_types.hh"
+#include "BLI_span.hh"
+
+namespace blender::geometry {
+
+/**
+ * Eliminate the points closer than `minimum_distance` to a kept point with a lower index, as if
+ * the points were processed in order, each point that isn't eliminated yet eliminating the points
+ * closer than the distance. Points already set in `elimination_mask` don't eliminate others.
+ *
+ * The result is the same as processing the points serially, but points are decided in parallel.
+ */
+void eliminate_close_points(Span<float3> positions,
+                            float minimum_distance,
+                            MutableSpan<bool> elimination_mask);
+
+}  // namespace blender::geometry
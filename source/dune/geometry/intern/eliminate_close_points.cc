@@ -0,0 +1,261 @@
+#include <atomic>
+
+#include "BLI_array.hh"
+#include "BLI_array_utils.hh"
+#include "BLI_bounds.hh"
+#include "BLI_offset_indices.hh"
+#include "BLI_sort.hh"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+
+#include "GEO_eliminate_close_points.hh"
+
+namespace blender::geometry {
+
+/* Elimination state of a point, see #eliminate_close_points. */
+enum class ClosePointState : int8_t {
+  Undecided,
+  Kept,
+  Eliminated,
+};
+
+/* Cell coordinates are packed in 21 bits each in a key. Cells are clamped to [0, 2^20] per axis,
+ * so the coordinates of a cell and of its neighbors (at most 2^20 + 1) fit in 21 bits. */
+static constexpr int close_points_grid_bits = 21;
+static constexpr int close_points_grid_resolution = 1 << (close_points_grid_bits - 1);
+
+static uint64_t close_points_cell_key(const int3 cell)
+{
+  return uint64_t(cell.x) | (uint64_t(cell.y) << close_points_grid_bits) |
+         (uint64_t(cell.z) << (close_points_grid_bits * 2));
+}
+
+/**
+ * A point is kept when no point with a lower index within the distance is kept.
+ *
+ * The points are sorted into a grid with cells at least as large as the minimum distance, so the
+ * close points of a point are in the surrounding 3x3x3 cells, which are found once per cell.
+ * Then the undecided points are decided in parallel rounds: a point is eliminated when a close
+ * point with a lower index is kept, and kept when all of those are eliminated. A decided state
+ * never changes, so the result doesn't depend on the order points are processed in, and is the
+ * same as processing the points serially. The point with the lowest index of the undecided ones
+ * is decided in every round at least.
+ *
+ * Only the still undecided points are carried to the next round. A point stops at the first
+ * undecided close point, and continues after it once it's decided, so the close points of a point
+ * are checked once at most.
+ */
+void eliminate_close_points(const Span<float3> positions,
+                            const float minimum_distance,
+                            MutableSpan<bool> elimination_mask)
+{
+  if (minimum_distance <= 0.0f) {
+    return;
+  }
+  const std::optional<Bounds<float3>> bounds = bounds::min_max(positions);
+  if (!bounds) {
+    return;
+  }
+  const float3 extent = bounds->max - bounds->min;
+  const float max_extent = std::max({extent.x, extent.y, extent.z});
+  const float cell_size = std::max(minimum_distance, max_extent / close_points_grid_resolution);
+  const float min_distance_sq = minimum_distance * minimum_distance;
+
+  /* Sort the points by cell, then by index. */
+  Array<uint64_t> point_keys(positions.size());
+  threading::parallel_for(positions.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      const float3 cell = (positions[i] - bounds->min) / cell_size;
+      point_keys[i] = close_points_cell_key(
+          math::min(int3(cell), int3(close_points_grid_resolution)));
+    }
+  });
+  Array<int> sorted_indices(positions.size());
+  array_utils::fill_index_range<int>(sorted_indices);
+  parallel_sort(sorted_indices.begin(), sorted_indices.end(), [&](const int a, const int b) {
+    return point_keys[a] < point_keys[b] || (point_keys[a] == point_keys[b] && a < b);
+  });
+
+  Array<float3> sorted_positions(positions.size());
+  Array<std::atomic<ClosePointState>> states(positions.size());
+  threading::parallel_for(positions.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      const int index = sorted_indices[i];
+      sorted_positions[i] = positions[index];
+      states[i].store(elimination_mask[index] ? ClosePointState::Eliminated :
+                                                ClosePointState::Undecided,
+                      std::memory_order_relaxed);
+    }
+  });
+
+  /* Each cell is a range of the sorted points. */
+  Vector<uint64_t> cell_keys;
+  Vector<int> cell_offsets;
+  Array<int> point_cells(positions.size());
+  for (const int i : sorted_indices.index_range()) {
+    const uint64_t key = point_keys[sorted_indices[i]];
+    if (cell_keys.is_empty() || cell_keys.last() != key) {
+      cell_keys.append(key);
+      cell_offsets.append(i);
+    }
+    point_cells[i] = cell_keys.size() - 1;
+  }
+  cell_offsets.append(positions.size());
+  const OffsetIndices<int> cells = cell_offsets.as_span();
+
+  /* Call `fn` with the points of every non-empty cell around the cell, the cell itself first.
+   * The cells of a row along X have consecutive keys, so they are found with a single search. */
+  auto foreach_neighbor_cell_points = [&](const int cell_i, const auto &fn) {
+    fn(cells[cell_i]);
+    const uint64_t key = cell_keys[cell_i];
+    const int3 cell(key & (close_points_grid_resolution * 2 - 1),
+                    (key >> close_points_grid_bits) & (close_points_grid_resolution * 2 - 1),
+                    key >> (close_points_grid_bits * 2));
+    for (int z = std::max(cell.z - 1, 0); z <= cell.z + 1; z++) {
+      for (int y = std::max(cell.y - 1, 0); y <= cell.y + 1; y++) {
+        const int x_min = std::max(cell.x - 1, 0);
+        const uint64_t row_key_min = close_points_cell_key(int3(x_min, y, z));
+        const uint64_t row_key_max = close_points_cell_key(int3(cell.x + 1, y, z));
+        for (const uint64_t *neighbor = std::lower_bound(
+                 cell_keys.begin(), cell_keys.end(), row_key_min);
+             neighbor != cell_keys.end() && *neighbor <= row_key_max;
+             neighbor++)
+        {
+          if (*neighbor != key) {
+            fn(cells[neighbor - cell_keys.begin()]);
+          }
+        }
+      }
+    }
+  };
+
+  Array<int> neighbor_offsets_data(cells.size() + 1);
+  threading::parallel_for(cells.index_range(), 1024, [&](const IndexRange range) {
+    for (const int cell_i : range) {
+      int count = 0;
+      foreach_neighbor_cell_points(cell_i, [&](const IndexRange /*points*/) { count++; });
+      neighbor_offsets_data[cell_i] = count;
+    }
+  });
+  const OffsetIndices<int> neighbor_offsets = offset_indices::accumulate_counts_to_offsets(
+      neighbor_offsets_data);
+  Array<IndexRange> neighbor_points(neighbor_offsets.total_size());
+  threading::parallel_for(cells.index_range(), 1024, [&](const IndexRange range) {
+    for (const int cell_i : range) {
+      int neighbor_i = neighbor_offsets[cell_i].start();
+      foreach_neighbor_cell_points(
+          cell_i, [&](const IndexRange points) { neighbor_points[neighbor_i++] = points; });
+    }
+  });
+
+  /* A kept point eliminates its close points with a higher index right away, so most points are
+   * decided without checking their own close points. A point eliminated this way can't be kept
+   * by another thread, which would need the kept point to be eliminated. */
+  auto keep_point = [&](const int i) {
+    states[i].store(ClosePointState::Kept, std::memory_order_relaxed);
+    const int index = sorted_indices[i];
+    const Span<IndexRange> neighbors = neighbor_points.as_span().slice(
+        neighbor_offsets[point_cells[i]]);
+    for (const IndexRange points : neighbors) {
+      for (const int other_i : points) {
+        if (sorted_indices[other_i] > index &&
+            math::distance_squared(sorted_positions[i], sorted_positions[other_i]) <=
+                min_distance_sq)
+        {
+          states[other_i].store(ClosePointState::Eliminated, std::memory_order_relaxed);
+        }
+      }
+    }
+  };
+
+  /* The first undecided close point with a lower index, found the last time a point was checked.
+   * The close points before it are eliminated, so they don't need to be checked again. */
+  Array<int> waiting_for(positions.size(), -1);
+
+  /* Returns true when the point is decided. */
+  auto decide_point = [&](const int i) {
+    if (states[i].load(std::memory_order_relaxed) != ClosePointState::Undecided) {
+      return true;
+    }
+    const Span<IndexRange> neighbors = neighbor_points.as_span().slice(
+        neighbor_offsets[point_cells[i]]);
+    int neighbor_i = 0;
+    int check_from = 0;
+    if (waiting_for[i] != -1) {
+      switch (states[waiting_for[i]].load(std::memory_order_relaxed)) {
+        case ClosePointState::Undecided:
+          return false;
+        case ClosePointState::Kept:
+          states[i].store(ClosePointState::Eliminated, std::memory_order_relaxed);
+          return true;
+        case ClosePointState::Eliminated:
+          while (!neighbors[neighbor_i].contains(waiting_for[i])) {
+            neighbor_i++;
+          }
+          check_from = waiting_for[i] + 1;
+          break;
+      }
+    }
+    const int index = sorted_indices[i];
+    for (; neighbor_i < neighbors.size(); neighbor_i++, check_from = 0) {
+      const IndexRange points = neighbors[neighbor_i];
+      /* The points of a cell are sorted by index. */
+      for (int other_i = std::max<int>(points.start(), check_from);
+           other_i < points.one_after_last();
+           other_i++)
+      {
+        if (sorted_indices[other_i] >= index) {
+          break;
+        }
+        if (math::distance_squared(sorted_positions[i], sorted_positions[other_i]) >
+            min_distance_sq)
+        {
+          continue;
+        }
+        switch (states[other_i].load(std::memory_order_relaxed)) {
+          case ClosePointState::Undecided:
+            waiting_for[i] = other_i;
+            return false;
+          case ClosePointState::Kept:
+            states[i].store(ClosePointState::Eliminated, std::memory_order_relaxed);
+            return true;
+          case ClosePointState::Eliminated:
+            break;
+        }
+      }
+    }
+    keep_point(i);
+    return true;
+  };
+
+  Vector<int> undecided_points;
+  for (const int i : states.index_range()) {
+    if (states[i].load(std::memory_order_relaxed) == ClosePointState::Undecided) {
+      undecided_points.append(i);
+    }
+  }
+  while (!undecided_points.is_empty()) {
+    Array<bool> point_decided(undecided_points.size());
+    threading::parallel_for(undecided_points.index_range(), 1024, [&](const IndexRange range) {
+      for (const int i : range) {
+        point_decided[i] = decide_point(undecided_points[i]);
+      }
+    });
+    Vector<int> still_undecided_points;
+    for (const int i : undecided_points.index_range()) {
+      if (!point_decided[i]) {
+        still_undecided_points.append(undecided_points[i]);
+      }
+    }
+    undecided_points = std::move(still_undecided_points);
+  }
+
+  threading::parallel_for(positions.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      elimination_mask[sorted_indices[i]] = states[i].load(std::memory_order_relaxed) ==
+                                            ClosePointState::Eliminated;
+    }
+  });
+}
+
+}  // namespace blender::geometry
@@ -0,0 +1,137 @@
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_kdtree.h"
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+
+#include "GEO_eliminate_close_points.hh"
+
+namespace blender::geometry::tests {
+
+/* The serial elimination in index order, that #eliminate_close_points has to match. */
+static void eliminate_close_points_serial(const Span<float3> positions,
+                                          const float minimum_distance,
+                                          MutableSpan<bool> elimination_mask)
+{
+  KDTree_3d *kdtree = BLI_kdtree_3d_new(positions.size());
+  for (const int i : positions.index_range()) {
+    BLI_kdtree_3d_insert(kdtree, i, positions[i]);
+  }
+  BLI_kdtree_3d_balance(kdtree);
+
+  for (const int i : positions.index_range()) {
+    if (elimination_mask[i]) {
+      continue;
+    }
+    struct CallbackData {
+      int index;
+      MutableSpan<bool> elimination_mask;
+    } callback_data = {i, elimination_mask};
+
+    BLI_kdtree_3d_range_search_cb(
+        kdtree,
+        positions[i],
+        minimum_distance,
+        [](void *user_data, int index, const float * /*co*/, float /*dist_sq*/) {
+          CallbackData &callback_data = *static_cast<CallbackData *>(user_data);
+          if (index != callback_data.index) {
+            callback_data.elimination_mask[index] = true;
+          }
+          return true;
+        },
+        &callback_data);
+  }
+
+  BLI_kdtree_3d_free(kdtree);
+}
+
+/* Random points on a plane like a surface, with a few duplicates, the first sixteenth of the
+ * points spread out, the rest in a small square, so most points have many close points. */
+static Array<float3> random_points(const int points_num, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<float3> positions(points_num);
+  for (const int i : positions.index_range()) {
+    if (i % 16 == 15) {
+      positions[i] = positions[rng.get_int32(i)];
+      continue;
+    }
+    const float scale = (i < points_num / 16) ? 10.0f : 1.0f;
+    positions[i] = float3(rng.get_float(), rng.get_float(), rng.get_float() * 0.01f) * scale;
+  }
+  return positions;
+}
+
+static void test_eliminate_close_points(const int points_num,
+                                        const float minimum_distance,
+                                        const bool use_initial_mask)
+{
+  const Array<float3> positions = random_points(points_num, points_num);
+  Array<bool> mask(points_num, false);
+  if (use_initial_mask) {
+    for (int i = 0; i < points_num; i += 7) {
+      mask[i] = true;
+    }
+  }
+  Array<bool> mask_serial = mask;
+
+  eliminate_close_points(positions, minimum_distance, mask);
+  eliminate_close_points_serial(positions, minimum_distance, mask_serial);
+
+  int eliminated_num = 0;
+  for (const int i : positions.index_range()) {
+    ASSERT_EQ(mask[i], mask_serial[i]) << "point " << i;
+    eliminated_num += mask[i];
+  }
+  EXPECT_GT(eliminated_num, 0);
+  EXPECT_LT(eliminated_num, points_num);
+}
+
+TEST(eliminate_close_points, MatchesSerial)
+{
+  test_eliminate_close_points(1000, 0.05f, false);
+  test_eliminate_close_points(50000, 0.01f, false);
+  test_eliminate_close_points(50000, 0.05f, false);
+}
+
+TEST(eliminate_close_points, MatchesSerialWithMask)
+{
+  test_eliminate_close_points(50000, 0.01f, true);
+}
+
+TEST(eliminate_close_points, Empty)
+{
+  Array<bool> mask(0);
+  eliminate_close_points({}, 0.1f, mask);
+
+  const Array<float3> positions = random_points(100, 0);
+  Array<bool> mask_zero(positions.size(), false);
+  eliminate_close_points(positions, 0.0f, mask_zero);
+  for (const bool eliminated : mask_zero) {
+    EXPECT_FALSE(eliminated);
+  }
+}
+
+/* Compares the time of the serial elimination with #eliminate_close_points. */
+TEST(eliminate_close_points, DISABLED_Benchmark)
+{
+  for (const float minimum_distance : {0.001f, 0.01f}) {
+    const Array<float3> positions = random_points(2000000, 0);
+    std::cout << "Minimum distance " << minimum_distance << ":\n";
+
+    Array<bool> mask_serial(positions.size(), false);
+    {
+      SCOPED_TIMER("  serial");
+      eliminate_close_points_serial(positions, minimum_distance, mask_serial);
+    }
+    Array<bool> mask(positions.size(), false);
+    {
+      SCOPED_TIMER("  parallel");
+      eliminate_close_points(positions, minimum_distance, mask);
+    }
+    EXPECT_EQ(mask.as_span(), mask_serial.as_span());
+  }
+}
+
+}  // namespace blender::geometry::tests
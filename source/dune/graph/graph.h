@@ -199,6 +199,17 @@ bool dgraph_is_active(const struct DGraph *dgraph);
 void dgraph_make_active(struct DGraph *dgraph);
 void dgraph_make_inactive(struct DGraph *dgraph);
 
+/**
+ * Evaluate operations on the critical path (the longest chain of dependent operations) first,
+ * instead of in the order they become ready. Weights are refined from measured operation timings
+ * on every evaluation, which helps heavy rigs where cheap leaf operations would otherwise keep
+ * the workers busy while the critical chain waits.
+ *
+ * Enabled by default, disabling it evaluates operations in the order they become ready.
+ */
+void dgraph_priority_scheduling_set(struct DGraph *dgraph, bool enable);
+bool dgraph_priority_scheduling_get(const struct DGraph *dgraph);
+
 /* -------------------------------------------------------------------- */
 /** Evaluation Debug **/
 
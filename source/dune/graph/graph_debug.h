@@ -45,6 +45,28 @@ void dgraph_debug_stats_gnuplot(const struct DGraph *graph,
                                 const char *label,
                                 const char *output_filename);
 
+/* ************************************************ */
+/* Evaluation Profiling */
+
+/**
+ * Enable recording of per-operation timings (start/end time, worker thread and owning ID) of
+ * every following evaluation. Only the last evaluation is kept.
+ */
+void dgraph_debug_profile_set(struct DGraph *dgraph, bool enable);
+bool dgraph_debug_profile_get(const struct DGraph *dgraph);
+
+/**
+ * Write timings of the last profiled evaluation as Chrome trace-event JSON,
+ * which can be opened in `chrome://tracing` or Perfetto.
+ */
+void dgraph_debug_profile_trace_write(const struct DGraph *dgraph, FILE *fp);
+
+/**
+ * Print timings of the last profiled evaluation aggregated per ID, along with the achieved
+ * parallelism (accumulated operation time relative to the wall-clock evaluation time).
+ */
+void dgraph_debug_profile_summary_print(const struct DGraph *dgraph, FILE *fp);
+
 /* ************************************************ */
 
 /** Compare two dependency graphs. */
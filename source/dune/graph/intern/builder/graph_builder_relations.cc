@@ -2,6 +2,7 @@
 
 #include "intern/builder/graph_builder_relations.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring> /* required for STREQ later on. */
@@ -3303,4 +3304,94 @@ void GraphRelationBuilder::constraint_walk(DConstraint * /*con*/,
   data->builder->build_id(id);
 }
 
+/* **** Critical path weights **** */
+
+/* Rough guess of the evaluation time (in seconds) of an operation which was never timed. Heavy
+ * operations get a bigger estimate so that chains of them are prioritized from the very first
+ * evaluation, before any measurements are available. */
+static float op_initial_cost_estimate(const OpNode *op_node)
+{
+  if (op_node->is_noop()) {
+    return 0.0f;
+  }
+  switch (op_node->opcode) {
+    case OpCode::GEOMETRY_EVAL:
+      return 1e-3f;
+    case OpCode::POSE_IK_SOLVER:
+    case OpCode::POSE_SPLINE_IK_SOLVER:
+      return 1e-4f;
+    case OpCode::TRANSFORM_CONSTRAINTS:
+    case OpCode::BONE_CONSTRAINTS:
+      return 5e-5f;
+    default:
+      return 1e-5f;
+  }
+}
+
+static bool is_critical_path_relation(const Relation *rel)
+{
+  return rel->from->type == NodeType::OPERATION && rel->to->type == NodeType::OPERATION &&
+         (rel->flag & RELATION_FLAG_CYCLIC) == 0;
+}
+
+void graph_build_critical_path_weights(Graph *graph)
+{
+  for (OpNode *op_node : graph->ops) {
+    op_node->eval_cost = op_initial_cost_estimate(op_node);
+  }
+  graph_update_critical_path_weights(graph);
+}
+
+void graph_update_critical_path_weights(Graph *graph)
+{
+  /* Reverse topological traversal (Kahn's algorithm starting from the sinks), so that weights of
+   * all children are known when a node is visited. The custom flags are used to count the number
+   * of children which are not yet visited. */
+  Vector<OpNode *> queue;
+  queue.reserve(graph->ops.size());
+  for (OpNode *op_node : graph->ops) {
+    op_node->custom_flags = 0;
+    for (Relation *rel : op_node->outlinks) {
+      if (is_critical_path_relation(rel)) {
+        op_node->custom_flags++;
+      }
+    }
+    if (op_node->custom_flags == 0) {
+      queue.append(op_node);
+    }
+  }
+
+  for (int64_t i = 0; i < queue.size(); i++) {
+    OpNode *op_node = queue[i];
+    float max_child_weight = 0.0f;
+    for (Relation *rel : op_node->outlinks) {
+      if (is_critical_path_relation(rel)) {
+        const OpNode *child = static_cast<const OpNode *>(rel->to);
+        max_child_weight = std::max(max_child_weight, child->critical_path_weight);
+      }
+    }
+    op_node->critical_path_weight = op_node->eval_cost + max_child_weight;
+    for (Relation *rel : op_node->inlinks) {
+      if (!is_critical_path_relation(rel)) {
+        continue;
+      }
+      OpNode *parent = static_cast<OpNode *>(rel->from);
+      if (--parent->custom_flags == 0) {
+        queue.append(parent);
+      }
+    }
+  }
+
+  /* Nodes which are part of an undetected cycle are never reached, fall back to their own cost
+   * so that they still get scheduled in a sane order. */
+  if (queue.size() != graph->ops.size()) {
+    for (OpNode *op_node : graph->ops) {
+      if (op_node->custom_flags != 0) {
+        op_node->critical_path_weight = op_node->eval_cost;
+        op_node->custom_flags = 0;
+      }
+    }
+  }
+}
+
 }  // namespace dune::graph
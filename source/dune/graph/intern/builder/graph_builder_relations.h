@@ -311,6 +311,14 @@ struct DNodeHandle {
   const char *default_name;
 };
 
+/* Initialize per-operation cost estimates and compute the longest remaining path weight of every
+ * operation. Must be called after cycles are detected, cyclic relations are ignored. */
+void graph_build_critical_path_weights(Graph *graph);
+
+/* Re-compute the longest remaining path weights from the current operation cost estimates,
+ * keeping the estimates themselves untouched. */
+void graph_update_critical_path_weights(Graph *graph);
+
 }  // namespace dune::dgraph
 
 #include "intern/builder/dgraph_builder_relations_impl.h"
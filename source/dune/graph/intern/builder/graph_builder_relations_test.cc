@@ -0,0 +1,157 @@
+#include "testing/testing.h"
+
+#include "types_object.h"
+#include "types_scene.h"
+
+#include "dune_collection.h"
+#include "dune_idtype.h"
+#include "dune_layer.h"
+#include "dune_main.h"
+#include "dune_object.h"
+#include "dune_scene.h"
+
+#include "graph.h"
+#include "graph_build.h"
+
+#include "intern/builder/graph_builder_relations.h"
+#include "intern/graph.h"
+#include "intern/graph_relation.h"
+#include "intern/node/graph_node_op.h"
+
+namespace dune::graph::tests {
+
+class GraphCriticalPathTest : public testing::Test {
+ public:
+  Main *dmain = nullptr;
+  Scene *scene = nullptr;
+  DGraph *dgraph = nullptr;
+  Vector<OpNode *> op_nodes;
+
+  static void SetUpTestSuite()
+  {
+    dune_idtype_init();
+    dgraph_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    dgraph_free_node_types();
+  }
+
+  void SetUp() override
+  {
+    dmain = dune_main_new();
+    scene = dune_scene_add(dmain, "Scene");
+    dgraph = dgraph_new(dmain, scene, dune_view_layer_default_view(scene), DAG_EVAL_VIEWPORT);
+  }
+
+  void TearDown() override
+  {
+    /* The operations aren't owned by an ID node, they free their incoming relations. */
+    graph()->ops.clear();
+    for (OpNode *op_node : op_nodes) {
+      delete op_node;
+    }
+    dgraph_free(dgraph);
+    dune_main_free(dmain);
+  }
+
+  Graph *graph()
+  {
+    return reinterpret_cast<Graph *>(dgraph);
+  }
+
+  OpNode *add_op(const float eval_cost)
+  {
+    OpNode *op_node = new OpNode();
+    op_node->type = NodeType::OPERATION;
+    op_node->eval_cost = eval_cost;
+    graph()->ops.append(op_node);
+    op_nodes.append(op_node);
+    return op_node;
+  }
+
+  static void add_relation(OpNode *from, OpNode *to, const int flag = 0)
+  {
+    Relation *rel = new Relation(from, to, "Test");
+    rel->flag |= flag;
+  }
+};
+
+TEST_F(GraphCriticalPathTest, chain)
+{
+  OpNode *a = add_op(1.0f);
+  OpNode *b = add_op(2.0f);
+  OpNode *c = add_op(3.0f);
+  add_relation(a, b);
+  add_relation(b, c);
+
+  graph_update_critical_path_weights(graph());
+  EXPECT_FLOAT_EQ(c->critical_path_weight, 3.0f);
+  EXPECT_FLOAT_EQ(b->critical_path_weight, 5.0f);
+  EXPECT_FLOAT_EQ(a->critical_path_weight, 6.0f);
+
+  /* Refined costs only change the weights of the operations depending on them. */
+  b->eval_cost = 10.0f;
+  graph_update_critical_path_weights(graph());
+  EXPECT_FLOAT_EQ(c->critical_path_weight, 3.0f);
+  EXPECT_FLOAT_EQ(b->critical_path_weight, 13.0f);
+  EXPECT_FLOAT_EQ(a->critical_path_weight, 14.0f);
+}
+
+TEST_F(GraphCriticalPathTest, fan)
+{
+  /* The root fans out to a cheap branch and an expensive chain, which join in the sink. */
+  OpNode *sink = add_op(1.0f);
+  OpNode *cheap = add_op(4.0f);
+  OpNode *chain_end = add_op(5.0f);
+  OpNode *chain_start = add_op(2.0f);
+  OpNode *root = add_op(1.0f);
+  add_relation(root, cheap);
+  add_relation(root, chain_start);
+  add_relation(chain_start, chain_end);
+  add_relation(cheap, sink);
+  add_relation(chain_end, sink);
+  add_relation(root, sink);
+
+  graph_update_critical_path_weights(graph());
+  EXPECT_FLOAT_EQ(sink->critical_path_weight, 1.0f);
+  EXPECT_FLOAT_EQ(cheap->critical_path_weight, 5.0f);
+  EXPECT_FLOAT_EQ(chain_end->critical_path_weight, 6.0f);
+  EXPECT_FLOAT_EQ(chain_start->critical_path_weight, 8.0f);
+  EXPECT_FLOAT_EQ(root->critical_path_weight, 9.0f);
+  /* The expensive chain is evaluated before the cheap branch. */
+  EXPECT_GT(chain_start->critical_path_weight, cheap->critical_path_weight);
+}
+
+TEST_F(GraphCriticalPathTest, cycle)
+{
+  OpNode *a = add_op(1.0f);
+  OpNode *b = add_op(2.0f);
+  OpNode *c = add_op(3.0f);
+  add_relation(a, b);
+  add_relation(b, c);
+
+  /* Relations detected as cyclic are ignored. */
+  add_relation(c, a, RELATION_FLAG_CYCLIC);
+  graph_update_critical_path_weights(graph());
+  EXPECT_FLOAT_EQ(c->critical_path_weight, 3.0f);
+  EXPECT_FLOAT_EQ(b->critical_path_weight, 5.0f);
+  EXPECT_FLOAT_EQ(a->critical_path_weight, 6.0f);
+
+  /* Operations of an undetected cycle fall back to their own cost. */
+  add_relation(c, b);
+  graph_update_critical_path_weights(graph());
+  EXPECT_FLOAT_EQ(c->critical_path_weight, 3.0f);
+  EXPECT_FLOAT_EQ(b->critical_path_weight, 2.0f);
+  EXPECT_FLOAT_EQ(a->critical_path_weight, 1.0f);
+}
+
+TEST_F(GraphCriticalPathTest, enabled_by_default)
+{
+  EXPECT_TRUE(dgraph_priority_scheduling_get(dgraph));
+  dgraph_priority_scheduling_set(dgraph, false);
+  EXPECT_FALSE(dgraph_priority_scheduling_get(dgraph));
+}
+
+}  // namespace dune::graph::tests
@@ -75,6 +75,8 @@ void AbstractBuilderPipeline::build_step_finalize()
   if (G.debug_value == 799) {
     graph_transitive_reduction(graph_);
   }
+  /* Weights used by the priority scheduler, cyclic relations are known at this point. */
+  graph_build_critical_path_weights(graph_);
   /* Store pointers to commonly used evaluated datablocks. */
   graph_->scene_cow = (Scene *)graph_->get_cow_id(&graph_->scene->id);
   /* Flush visibility layer and re-schedule nodes for update. */
@@ -4,12 +4,16 @@
 
 #include "intern/eval/graph_eval.h"
 
+#include <cmath>
+
 #include "PIL_time.h"
 
 #include "lib_compiler_attrs.h"
 #include "lib_fn_ref.hh"
 #include "lib_gsqueue.h"
+#include "lib_heap_simple.h"
 #include "lib_task.h"
+#include "lib_threads.h"
 #include "lib_utildefines.h"
 
 #include "dune_global.h"
@@ -27,6 +31,7 @@
 
 #include "atomic_ops.h"
 
+#include "intern/builder/graph_builder_relations.h"
 #include "intern/graph.h"
 #include "intern/graph_relation.h"
 #include "intern/graph_tag.h"
@@ -52,6 +57,8 @@ void schedule_children(GraphEvalState *state,
                        OpNode *node,
                        FnRef<void(OpNode *node)> schedule_fn);
 
+void schedule_node_by_priority(GraphEvalState *state, TaskPool *pool, OpNode *node);
+
 /* Denotes which part of dependency graph is being evaluated. */
 enum class EvaluationStage {
   /* Stage 1: Only  Copy-on-Write operations are to be evaluated, prior to anything else.
@@ -75,9 +82,16 @@ enum class EvaluationStage {
 struct GraphEvalState {
   Graph *graph;
   bool do_stats;
+  bool do_profile;
   EvaluationStage stage;
   bool need_update_pending_parents = true;
   bool need_single_thread_pass = false;
+
+  /* Priority scheduling: operations which are ready for evaluation are kept in a heap ordered by
+   * their critical path weight, and every worker task picks the most critical one. */
+  bool use_priority_scheduling = false;
+  HeapSimple *ready_heap = nullptr;
+  SpinLock ready_lock;
 };
 
 void evaluate_node(const GraphEvalState *state, OpNode *op_node)
@@ -87,10 +101,14 @@ void evaluate_node(const GraphEvalState *state, OpNode *op_node)
   /* Sanity checks. */
   lib_assert_msg(!op_node->is_noop(), "NOOP nodes should not actually be scheduled");
   /* Perform operation. */
-  if (state->do_stats) {
+  if (state->do_stats || state->do_profile || state->use_priority_scheduling) {
     const double start_time = PIL_check_seconds_timer();
     op_node->evaluate(graph);
-    op_node->stats.current_time += PIL_check_seconds_timer() - start_time;
+    const double end_time = PIL_check_seconds_timer();
+    op_node->stats.current_time += end_time - start_time;
+    if (state->do_profile) {
+      state->graph->profile.record(op_node, start_time, end_time);
+    }
   }
   else {
     op_node->evaluate(graph);
@@ -118,6 +136,33 @@ void dgraph_task_run_func(TaskPool *pool, void *taskdata)
   });
 }
 
+void graph_task_run_priority_fn(TaskPool *pool, void * /*taskdata*/)
+{
+  void *userdata_v = lib_task_pool_user_data(pool);
+  GraphEvalState *state = (GraphEvalState *)userdata_v;
+
+  /* There is one task pushed per ready node, but the task does not have to evaluate the node it
+   * was pushed for: take the most critical node which is ready at this moment. */
+  lib_spin_lock(&state->ready_lock);
+  OpNode *op_node = reinterpret_cast<OpNode *>(lib_heapsimple_pop_min(state->ready_heap));
+  lib_spin_unlock(&state->ready_lock);
+
+  evaluate_node(state, op_node);
+
+  schedule_children(
+      state, op_node, [&](OpNode *node) { schedule_node_by_priority(state, pool, node); });
+}
+
+void schedule_node_by_priority(GraphEvalState *state, TaskPool *pool, OpNode *node)
+{
+  /* The heap pops the smallest value first, so negate the weight. */
+  lib_spin_lock(&state->ready_lock);
+  lib_heapsimple_insert(state->ready_heap, -node->critical_path_weight, node);
+  lib_spin_unlock(&state->ready_lock);
+
+  lib_task_pool_push(pool, graph_task_run_priority_fn, nullptr, false, nullptr);
+}
+
 bool check_op_node_visible(const GraphEvalState *state, OpNode *op_node)
 {
   const ComponentNode *comp_node = op_node->owner;
@@ -184,7 +229,7 @@ void calculate_pending_parents_if_needed(GraphEvalState *state)
 void initialize_execution(GraphEvalState *state, Graph *graph)
 {
   /* Clear tags and other things which needs to be clear. */
-  if (state->do_stats) {
+  if (state->do_stats || state->use_priority_scheduling) {
     for (OpNode *node : graph->ops) {
       node->stats.reset_current();
     }
@@ -312,12 +357,49 @@ void evaluate_graph_threaded_stage(GraphEvalState *state,
 
   calculate_pending_parents_if_needed(state);
 
-  schedule_graph(state, [&](OpNode *node) {
-    lib_task_pool_push(task_pool, dgraph_task_run_func, node, false, nullptr);
-  });
+  if (state->use_priority_scheduling) {
+    schedule_graph(
+        state, [&](OpNode *node) { schedule_node_by_priority(state, task_pool, node); });
+  }
+  else {
+    schedule_graph(state, [&](OpNode *node) {
+      lib_task_pool_push(task_pool, dgraph_task_run_func, node, false, nullptr);
+    });
+  }
   lib_task_pool_work_and_wait(task_pool);
 }
 
+/* Blend the operation timings measured during this evaluation into the cost estimates, and
+ * re-compute the critical path weights when the estimates changed noticeably. */
+void update_critical_path_weights_if_needed(GraphEvalState *state)
+{
+  if (!state->use_priority_scheduling) {
+    return;
+  }
+
+  /* Exponential moving average, so that a single slow frame does not reshuffle priorities. */
+  const float blend_factor = 0.25f;
+  /* Relative change of a cost estimate after which weights are to be re-computed. */
+  const float update_threshold = 0.1f;
+
+  bool need_update = false;
+  for (OpNode *node : state->graph->ops) {
+    if (node->stats.current_time == 0.0) {
+      continue;
+    }
+    const float measured_cost = float(node->stats.current_time);
+    const float new_cost = node->eval_cost + (measured_cost - node->eval_cost) * blend_factor;
+    if (fabsf(new_cost - node->eval_cost) > node->eval_cost * update_threshold) {
+      need_update = true;
+    }
+    node->eval_cost = new_cost;
+  }
+
+  if (need_update) {
+    graph_update_critical_path_weights(state->graph);
+  }
+}
+
 /* Evaluate remaining operations of the dependency graph in a single threaded manner. */
 void evaluate_graph_single_threaded_if_needed(DGraphEvalState *state)
 {
@@ -394,6 +476,15 @@ void dgraph_evaluate_on_refresh(Graph *graph)
   GraphEvalState state;
   state.graph = graph;
   state.do_stats = graph->debug.do_time_debug();
+  state.do_profile = graph->profile.enabled;
+  if (state.do_profile) {
+    graph->profile.begin_evaluation(PIL_check_seconds_timer());
+  }
+  state.use_priority_scheduling = graph->use_priority_scheduling;
+  if (state.use_priority_scheduling) {
+    state.ready_heap = lib_heapsimple_new();
+    lib_spin_init(&state.ready_lock);
+  }
 
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
@@ -442,6 +533,12 @@ void dgraph_evaluate_on_refresh(Graph *graph)
 
   evaluate_graph_single_threaded_if_needed(&state);
 
+  if (state.use_priority_scheduling) {
+    update_critical_path_weights_if_needed(&state);
+    lib_heapsimple_free(state.ready_heap, nullptr);
+    lib_spin_end(&state.ready_lock);
+  }
+
   /* Finalize statistics gathering. This is because we only gather single
    * operation timing here, without aggregating anything to avoid any extra
    * synchronization. */
@@ -449,6 +546,10 @@ void dgraph_evaluate_on_refresh(Graph *graph)
     graph_eval_stats_aggregate(graph);
   }
 
+  if (state.do_profile) {
+    graph->profile.end_evaluation(PIL_check_seconds_timer());
+  }
+
   /* Clear any uncleared tags. */
   dgraph_clear_tags(graph);
   graph->is_evaluating = false;
@@ -0,0 +1,86 @@
+/**
+ * Per-operation timing profile of the dependency graph evaluation.
+ */
+
+#pragma once
+
+#include "lib_enumerable_thread_specific.hh"
+#include "lib_vector.hh"
+
+#include "atomic_ops.h"
+
+namespace dune::graph {
+
+struct OpNode;
+
+/* Timing of a single operation evaluation. */
+struct EvalProfileEvent {
+  const OpNode *op_node;
+  /* Seconds, in the #PIL_check_seconds_timer time base. */
+  double start_time;
+  double end_time;
+};
+
+/* Events recorded by a single worker thread. */
+struct EvalProfileThreadEvents {
+  /* Sequential index of the thread, used as a thread identifier in the exported trace. */
+  int thread_index;
+  Vector<EvalProfileEvent> events;
+};
+
+/* Profile of the last evaluation of the dependency graph.
+ *
+ * Events are stored per thread, so recording them does not require any synchronization. The
+ * storage is cleared at the beginning of every evaluation, so only the last evaluation can be
+ * inspected. */
+struct EvalProfile {
+  EvalProfile()
+      : thread_events([this]() {
+          EvalProfileThreadEvents thread_events;
+          thread_events.thread_index = int(atomic_fetch_and_add_uint32(&num_threads, 1));
+          return thread_events;
+        })
+  {
+  }
+
+  void begin_evaluation(const double time)
+  {
+    clear();
+    eval_start_time = time;
+    eval_end_time = time;
+  }
+
+  void end_evaluation(const double time)
+  {
+    eval_end_time = time;
+  }
+
+  /* Forget the recorded events, which point to the operation nodes: needed when the nodes are
+   * freed (relations are rebuilt). */
+  void clear()
+  {
+    for (EvalProfileThreadEvents &local : thread_events) {
+      local.events.clear();
+    }
+    eval_start_time = 0.0;
+    eval_end_time = 0.0;
+  }
+
+  void record(const OpNode *op_node, const double start_time, const double end_time)
+  {
+    thread_events.local().events.append({op_node, start_time, end_time});
+  }
+
+  bool enabled = false;
+
+  /* Wall-clock time span of the whole evaluation. */
+  double eval_start_time = 0.0;
+  double eval_end_time = 0.0;
+
+  uint32_t num_threads = 0;
+  /* Mutable since iterating the thread-specific storage is not a const operation, while reading
+   * the profile from the debug API should be. */
+  mutable threading::EnumerableThreadSpecific<EvalProfileThreadEvents> thread_events;
+};
+
+}  // namespace dune::graph
@@ -0,0 +1,103 @@
+#include "testing/testing.h"
+
+#include <cstdio>
+#include <string>
+
+#include "types_object.h"
+#include "types_scene.h"
+
+#include "dune_collection.h"
+#include "dune_idtype.h"
+#include "dune_layer.h"
+#include "dune_main.h"
+#include "dune_object.h"
+#include "dune_scene.h"
+
+#include "graph.h"
+#include "graph_build.h"
+#include "graph_debug.h"
+
+namespace dune::graph::tests {
+
+class GraphEvalProfileTest : public testing::Test {
+ public:
+  Main *dmain = nullptr;
+  Scene *scene = nullptr;
+  DGraph *dgraph = nullptr;
+
+  static void SetUpTestSuite()
+  {
+    dune_idtype_init();
+    dgraph_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    dgraph_free_node_types();
+  }
+
+  void SetUp() override
+  {
+    dmain = dune_main_new();
+    scene = dune_scene_add(dmain, "Scene");
+    for (const char *name : {"Empty", "Empty.001"}) {
+      Object *ob = dune_object_add_only_object(dmain, OB_EMPTY, name);
+      dune_collection_object_add(dmain, scene->master_collection, ob);
+    }
+    dgraph = dgraph_new(dmain, scene, dune_view_layer_default_view(scene), DAG_EVAL_VIEWPORT);
+    dgraph_build_from_view_layer(dgraph);
+  }
+
+  void TearDown() override
+  {
+    dgraph_free(dgraph);
+    dune_main_free(dmain);
+  }
+
+  std::string trace_write() const
+  {
+    FILE *fp = tmpfile();
+    dgraph_debug_profile_trace_write(dgraph, fp);
+    /* The summary reads the events too. */
+    dgraph_debug_profile_summary_print(dgraph, fp);
+    std::string trace(size_t(ftell(fp)), '\0');
+    rewind(fp);
+    EXPECT_EQ(fread(trace.data(), 1, trace.size(), fp), trace.size());
+    fclose(fp);
+    return trace;
+  }
+};
+
+static bool trace_has_events(const std::string &trace)
+{
+  return trace.find("\"ph\": \"X\"") != std::string::npos;
+}
+
+TEST_F(GraphEvalProfileTest, record)
+{
+  dgraph_debug_profile_set(dgraph, true);
+  dgraph_evaluate_on_refresh(dgraph);
+
+  const std::string trace = trace_write();
+  EXPECT_TRUE(trace_has_events(trace));
+  EXPECT_NE(trace.find("OBEmpty.001"), std::string::npos);
+}
+
+TEST_F(GraphEvalProfileTest, relations_rebuild)
+{
+  dgraph_debug_profile_set(dgraph, true);
+  dgraph_evaluate_on_refresh(dgraph);
+  EXPECT_TRUE(trace_has_events(trace_write()));
+
+  /* Rebuilding frees the operation nodes of the recorded events, which are dropped. */
+  dgraph_tag_relations_update(dgraph);
+  dgraph_relations_update(dgraph);
+  EXPECT_FALSE(trace_has_events(trace_write()));
+
+  /* Evaluating the rebuilt graph records the new nodes. */
+  dgraph_tag_on_visible_update(dgraph, true);
+  dgraph_evaluate_on_refresh(dgraph);
+  EXPECT_TRUE(trace_has_events(trace_write()));
+}
+
+}  // namespace dune::graph::tests
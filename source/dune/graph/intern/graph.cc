@@ -51,7 +51,8 @@ Graph::Graph(Main *dmain, Scene *scene, ViewLayer *view_layer, eEvaluationMode m
       is_active(false),
       is_evaluating(false),
       is_render_pipeline_dgraph(false),
-      use_editors_update(false)
+      use_editors_update(false),
+      use_priority_scheduling(true)
 {
   lib_spin_init(&lock);
   memset(id_type_updated, 0, sizeof(id_type_updated));
@@ -219,6 +220,8 @@ void Graph::add_entry_tag(OpNode *node)
 
 void Graph::clear_all_nodes()
 {
+  /* Recorded events point to the operation nodes which are about to be freed. */
+  profile.clear();
   clear_id_nodes();
   delete time_source;
   time_source = nullptr;
@@ -313,6 +316,18 @@ bool graph_is_active(const struct Graph *graph)
   return graph->is_active;
 }
 
+void dgraph_priority_scheduling_set(DGraph *dgraph, bool enable)
+{
+  graph::Graph *graph = reinterpret_cast<graph::Graph *>(dgraph);
+  graph->use_priority_scheduling = enable;
+}
+
+bool dgraph_priority_scheduling_get(const DGraph *dgraph)
+{
+  const graph::Graph *graph = reinterpret_cast<const graph::Graph *>(dgraph);
+  return graph->use_priority_scheduling;
+}
+
 void graph_make_active(struct Graph *graph)
 {
   graph::Graph *graph = reinterpret_cast<graph::Graph *>(graph);
@@ -20,6 +20,7 @@
 #include "graph_phys.h"
 
 #include "intern/debug/graph_debug.h"
+#include "intern/eval/graph_eval_profile.h"
 #include "intern/graph_type.h"
 
 struct Id;
@@ -139,6 +140,9 @@ struct Graph {
 
   GraphDebug debug;
 
+  /* Per-operation timings of the last evaluation, only gathered when enabled. */
+  EvalProfile profile;
+
   bool is_evaluating;
 
   /* Is set to truth for dependency graph which are used for post-processing (compositor and
@@ -150,6 +154,11 @@ struct Graph {
   /* Notify editors about changes to IDs in this depsgraph. */
   bool use_editors_update;
 
+  /* Dispatch ready operations in order of their critical path weight instead of readiness order,
+   * refining the weights from measured operation timings after every evaluation. Enabled by
+   * default. */
+  bool use_priority_scheduling;
+
   /* Cached list of colliders/effectors for collections and the scene
    * created along with relations, for fast lookup during evaluation. */
   Map<const Id *, ListBase *> *phys_relations[GRAPH_PHYS_RELATIONS_NUM];
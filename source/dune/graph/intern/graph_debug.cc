@@ -2,6 +2,8 @@
  * Implementation of tools for debugging the dgraph
  */
 
+#include <algorithm>
+
 #include "lib_utildefines.h"
 
 #include "types_scene.h"
@@ -19,6 +21,7 @@
 #include "intern/graph_type.h"
 #include "intern/node/graph_node_component.h"
 #include "intern/node/graph_node_id.h"
+#include "intern/node/graph_node_op.h"
 #include "intern/node/graph_node_time.h"
 
 namespace dune = dune::graph;
@@ -218,6 +221,140 @@ void graph_stats_simple(const Graph *graph,
   }
 }
 
+/* ------------------------------------------------ */
+
+void dgraph_debug_profile_set(DGraph *dgraph, bool enable)
+{
+  graph::Graph *graph = reinterpret_cast<graph::Graph *>(dgraph);
+  graph->profile.enabled = enable;
+}
+
+bool dgraph_debug_profile_get(const DGraph *dgraph)
+{
+  const graph::Graph *graph = reinterpret_cast<const graph::Graph *>(dgraph);
+  return graph->profile.enabled;
+}
+
+static void profile_json_string_write(FILE *fp, const char *str)
+{
+  fputc('"', fp);
+  for (const char *c = str; *c != '\0'; c++) {
+    switch (*c) {
+      case '"':
+        fputs("\\\"", fp);
+        break;
+      case '\\':
+        fputs("\\\\", fp);
+        break;
+      default:
+        if ((unsigned char)*c < 0x20) {
+          fprintf(fp, "\\u%04x", (unsigned int)(unsigned char)*c);
+        }
+        else {
+          fputc(*c, fp);
+        }
+        break;
+    }
+  }
+  fputc('"', fp);
+}
+
+void dgraph_debug_profile_trace_write(const DGraph *dgraph, FILE *fp)
+{
+  const graph::Graph *graph = reinterpret_cast<const graph::Graph *>(dgraph);
+  const graph::EvalProfile &profile = graph->profile;
+
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  bool is_first = true;
+  for (const graph::EvalProfileThreadEvents &local : profile.thread_events) {
+    for (const graph::EvalProfileEvent &event : local.events) {
+      const graph::OpNode *op_node = event.op_node;
+      const graph::ComponentNode *comp_node = op_node->owner;
+      const graph::IdNode *id_node = comp_node->owner;
+      if (!is_first) {
+        fprintf(fp, ",\n");
+      }
+      is_first = false;
+      /* Timestamps are in microseconds, relative to the beginning of the evaluation. */
+      fprintf(fp, "{\"name\": ");
+      profile_json_string_write(fp, op_node->id().c_str());
+      fprintf(fp, ", \"cat\": ");
+      profile_json_string_write(fp, graph::nodeTypeAsString(comp_node->type));
+      fprintf(fp,
+              ", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+              "\"args\": {\"id\": ",
+              local.thread_index,
+              (event.start_time - profile.eval_start_time) * 1e6,
+              (event.end_time - event.start_time) * 1e6);
+      profile_json_string_write(fp, id_node->name.c_str());
+      fprintf(fp, ", \"component\": ");
+      profile_json_string_write(fp, comp_node->name.c_str());
+      fprintf(fp, "}}");
+    }
+  }
+  fprintf(fp, "\n]}\n");
+}
+
+void dgraph_debug_profile_summary_print(const DGraph *dgraph, FILE *fp)
+{
+  const graph::Graph *graph = reinterpret_cast<const graph::Graph *>(dgraph);
+  const graph::EvalProfile &profile = graph->profile;
+
+  struct IdTiming {
+    const graph::IdNode *id_node;
+    double total_time;
+    double max_op_time;
+    int num_ops;
+  };
+  graph::Map<const graph::IdNode *, IdTiming> timing_by_id;
+
+  double total_time = 0.0;
+  int num_ops = 0;
+  int num_threads = 0;
+  for (const graph::EvalProfileThreadEvents &local : profile.thread_events) {
+    if (!local.events.is_empty()) {
+      num_threads++;
+    }
+    for (const graph::EvalProfileEvent &event : local.events) {
+      const graph::IdNode *id_node = event.op_node->owner->owner;
+      const double op_time = event.end_time - event.start_time;
+      IdTiming &timing = timing_by_id.lookup_or_add(id_node, {id_node, 0.0, 0.0, 0});
+      timing.total_time += op_time;
+      timing.max_op_time = std::max(timing.max_op_time, op_time);
+      timing.num_ops++;
+      total_time += op_time;
+      num_ops++;
+    }
+  }
+
+  graph::Vector<IdTiming> timings;
+  for (const IdTiming &timing : timing_by_id.values()) {
+    timings.append(timing);
+  }
+  std::sort(timings.begin(), timings.end(), [](const IdTiming &a, const IdTiming &b) {
+    return a.total_time > b.total_time;
+  });
+
+  const double wall_time = profile.eval_end_time - profile.eval_start_time;
+  fprintf(fp,
+          "Evaluated %d operations in %.3f ms on %d threads, accumulated time %.3f ms, "
+          "achieved parallelism %.2f\n",
+          num_ops,
+          wall_time * 1e3,
+          num_threads,
+          total_time * 1e3,
+          (wall_time > 0.0) ? total_time / wall_time : 0.0);
+  for (const IdTiming &timing : timings) {
+    fprintf(fp,
+            "  %-40s %8.3f ms (%5.1f%%) in %4d ops, slowest %.3f ms\n",
+            timing.id_node->name.c_str(),
+            timing.total_time * 1e3,
+            (total_time > 0.0) ? timing.total_time / total_time * 100.0 : 0.0,
+            timing.num_ops,
+            timing.max_op_time * 1e3);
+  }
+}
+
 static graph::string graph_name_for_logging(struct Graph *graph)
 {
   const char *name = graph_debug_name_get(dgraph);
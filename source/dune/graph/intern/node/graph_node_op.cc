@@ -189,7 +189,7 @@ const char *opCodeAsString(OpCode opcode)
   return "UNKNOWN";
 }
 
-OpNode::OpNode() : name_tag(-1), flag(0)
+OpNode::OpNode() : name_tag(-1), flag(0), eval_cost(0.0f), critical_path_weight(0.0f)
 {
 }
 
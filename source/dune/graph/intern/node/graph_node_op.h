@@ -256,6 +256,14 @@ struct OpNode : public Node {
   /* (OpFlag) extra settings affecting evaluation. */
   int flag;
 
+  /* Estimated evaluation time of this operation in seconds. Initialized with a guess when
+   * relations are built and refined from measured timings when priority scheduling is used. */
+  float eval_cost;
+  /* Sum of the estimated costs along the most expensive path from this operation to any sink of
+   * the graph, including the operation itself. Ready operations with the biggest weight are on
+   * the critical path and are evaluated first when priority scheduling is used. */
+  float critical_path_weight;
+
   GRAPH_NODE_DECLARE;
 };
 
@@ -0,0 +1,48 @@
+#pragma once
+
+/* Extensions of the color management API (see IMB_colormanagement.h).
+ *
+ * - Acquiring display buffers for the visible region of an image only: display buffers are
+ *   cached in tiles, transformed once they're visible.
+ * - Applying the baked display transform byte display buffers use, to test it. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ColorManagedDisplaySettings;
+struct ColorManagedViewSettings;
+struct ImBuf;
+struct rcti;
+
+/**
+ * Same as #IMB_display_buffer_acquire, only transforming the pixels inside `region` (in pixels
+ * of the image, max exclusive), other pixels of the buffer may be outdated. Changing view
+ * settings of a large image this way only transforms the tiles displayed.
+ * A null region transforms the whole buffer.
+ */
+unsigned char *IMB_display_buffer_acquire_region(
+    struct ImBuf *ibuf,
+    const struct ColorManagedViewSettings *view_settings,
+    const struct ColorManagedDisplaySettings *display_settings,
+    const struct rcti *region,
+    void **cache_handle);
+
+/**
+ * Apply the display transform of the settings through the LUT it's baked into for byte display
+ * buffers, like #IMB_colormanagement_processor_apply does with the processor of the settings.
+ * \return false when the transform isn't baked (curve mapping, a look, gamma or data), leaving the
+ * buffer unchanged.
+ */
+bool IMB_colormanagement_display_lut_apply(
+    float *buffer,
+    int width,
+    int height,
+    int channels,
+    bool predivide,
+    const struct ColorManagedViewSettings *view_settings,
+    const struct ColorManagedDisplaySettings *display_settings);
+
+#ifdef __cplusplus
+}
+#endif
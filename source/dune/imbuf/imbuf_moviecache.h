@@ -51,6 +51,25 @@ void imbuf_moviecache_cleanup(struct MovieCache *cache,
 void imbuf_moviecache_get_cache_segments(
     struct MovieCache *cache, int proxy, int render_flags, int *r_totseg, int **r_points);
 
+/** Counters of all movie caches, for monitoring the cache policy. */
+typedef struct MovieCacheStats {
+  /** Look-ups finding an item (possibly of an empty frame), or not. */
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t puts;
+  /** Puts refused by #imbuf_moviecache_put_if_possible, of frames used less than cached ones. */
+  uint64_t rejected;
+  /** Items removed to keep the memory in the budget. */
+  uint64_t evictions;
+  uint32_t items;
+  size_t mem_in_use;
+  /** The budget, 0 when the cache limiter is disabled. */
+  size_t mem_limit;
+} MovieCacheStats;
+
+void imbuf_moviecache_stats_get(MovieCacheStats *r_stats);
+void imbuf_moviecache_stats_reset(void);
+
 struct MovieCacheIter;
 struct MovieCacheIter *imbuf_moviecacheIter_new(struct MovieCache *cache);
 void imbuf_moviecacheIter_free(struct MovieCacheIter *iter);
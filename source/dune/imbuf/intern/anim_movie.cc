@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #ifndef _WIN32
 #  include <dirent.h>
@@ -35,10 +36,15 @@
 #include "lib_threads.h"
 #include "lib_utildefines.h"
 
+#include "types_list.h"
 #include "types_scene.h"
 
 #include "mem_guardedalloc.h"
 
+#include "MEM_CacheLimiter.h"
+
+#include "PIL_time.h"
+
 #ifdef WITH_AVI
 #  include "avi.h"
 #endif
@@ -188,6 +194,7 @@ static void free_anim_avi(struct anim *anim)
 
 #ifdef WITH_FFMPEG
 static void free_anim_ffmpeg(struct anim *anim);
+static void anim_decoder_free(struct anim *anim);
 #endif
 
 void imbuf_free_anim(struct anim *anim)
@@ -227,6 +234,10 @@ void imbuf_close_anim_proxies(struct anim *anim)
     return;
   }
 
+#ifdef WITH_FFMPEG
+  /* The decoder thread uses the indices. */
+  anim_decoder_free(anim);
+#endif
   imbuf_free_indices(anim);
 }
 
@@ -677,6 +688,7 @@ static int startffmpeg(struct anim *anim)
   anim->framesize = anim->x * anim->y * 4;
 
   anim->cur_position = 0;
+  anim->decode_position = 0;
   anim->cur_frame_final = 0;
   anim->cur_pts = -1;
   anim->cur_key_frame_pts = -1;
@@ -846,11 +858,10 @@ static AVFrame *ffmpeg_double_buffer_frame_fallback_get(struct anim *anim)
 /**
  * Postprocess the image in anim->pFrame and do color conversion and de-interlacing stuff.
  *
- * Output is `anim->cur_frame_final`.
+ * Output is `ibuf`, allocated with #ffmpeg_frame_final_alloc.
  */
-static void ffmpeg_postprocess(struct anim *anim, AVFrame *input)
+static void ffmpeg_postprocess(struct anim *anim, AVFrame *input, ImBuf *ibuf)
 {
-  ImBuf *ibuf = anim->cur_frame_final;
   int filter_y = 0;
 
   /* This means the data wasn't read properly,
@@ -1158,6 +1169,8 @@ static void ffmpeg_scan_log(struct anim *anim, int64_t pts_to_search)
          pts_to_search);
 }
 
+static void anim_decoder_gop_frame_keep(struct anim *anim);
+
 /* Decode frames one by one until its PTS matches pts_to_search. */
 static void ffmpeg_decode_video_frame_scan(struct anim *anim, int64_t pts_to_search)
 {
@@ -1176,6 +1189,10 @@ static void ffmpeg_decode_video_frame_scan(struct anim *anim, int64_t pts_to_sea
     if (anim->seek_before_decode && start_gop_frame != anim->cur_key_frame_pts) {
       av_log(anim->pFormatCtx, AV_LOG_ERROR, "SCAN: Frame belongs to an unexpected GOP!\n");
     }
+
+    if (!decode_error && anim->seek_before_decode && anim->decoder) {
+      anim_decoder_gop_frame_keep(anim);
+    }
   }
 }
 
@@ -1278,7 +1295,7 @@ static bool ffmpeg_seek_buffers_need_flushing(struct anim *anim, int position, i
 
   /* Packet after seeking is same key frame as current, and further in time. No seeking was
    * necessary, so buffers don't have to be flushed. But stream position has to be recovered. */
-  if (gop_pts == anim->cur_key_frame_pts && position > anim->cur_position) {
+  if (gop_pts == anim->cur_key_frame_pts && position > anim->decode_position) {
     ffmpeg_seek_recover_stream_position(anim);
     return false;
   }
@@ -1301,7 +1318,7 @@ static int ffmpeg_seek_to_key_frame(struct anim *anim,
   if (tc_index) {
     /* We can use timestamps generated from our indexer to seek. */
     int new_frame_index = IMB_indexer_get_frame_index(tc_index, position);
-    int old_frame_index = IMB_indexer_get_frame_index(tc_index, anim->cur_position);
+    int old_frame_index = IMB_indexer_get_frame_index(tc_index, anim->decode_position);
 
     if (imbuf_indexer_can_scan(tc_index, old_frame_index, new_frame_index)) {
       /* No need to seek, return early. */
@@ -1384,17 +1401,53 @@ static int ffmpeg_seek_to_key_frame(struct anim *anim,
 
 static bool ffmpeg_must_seek(struct anim *anim, int position)
 {
-  bool must_seek = position != anim->cur_position + 1 || ffmpeg_is_first_frame_decode(anim);
+  bool must_seek = position != anim->decode_position + 1 || ffmpeg_is_first_frame_decode(anim);
   anim->seek_before_decode = must_seek;
   return must_seek;
 }
 
-static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Type tc)
+/* Image buffer for a frame of the size of the last decoded frame. */
+static ImBuf *ffmpeg_frame_final_alloc(struct anim *anim)
 {
-  if (anim == nullptr) {
-    return nullptr;
+  /* Certain versions of FFmpeg have a bug in libswscale which ends up in crash
+   * when destination buffer is not properly aligned. For example, this happens
+   * in FFmpeg 4.3.1. It got fixed later on, but for compatibility reasons is
+   * still best to avoid crash.
+   *
+   * This is achieved by using own allocation call rather than relying on
+   * IMB_allocImBuf() to do so since the IMB_allocImBuf() is not guaranteed
+   * to perform aligned allocation.
+   *
+   * In theory this could give better performance, since SIMD operations on
+   * aligned data are usually faster.
+   *
+   * Note that even though sometimes vertical flip is required it does not
+   * affect on alignment of data passed to sws_scale because if the X dimension
+   * is not 32 byte aligned special intermediate buffer is allocated.
+   *
+   * The issue was reported to FFmpeg under ticket #8747 in the FFmpeg tracker
+   * and is fixed in the newer versions than 4.3.1. */
+
+  const AVPixFmtDescriptor *pix_fmt_descriptor = av_pix_fmt_desc_get(anim->pCodecCtx->pix_fmt);
+
+  int planes = R_IMF_PLANES_RGBA;
+  if ((pix_fmt_descriptor->flags & AV_PIX_FMT_FLAG_ALPHA) == 0) {
+    planes = R_IMF_PLANES_RGB;
   }
 
+  ImBuf *ibuf = IMB_allocImBuf(anim->x, anim->y, planes, 0);
+  ibuf->rect = static_cast<uint *>(
+      MEM_mallocN_aligned(size_t(4) * anim->x * anim->y, 32, "ffmpeg ibuf"));
+  ibuf->mall |= IB_rect;
+
+  ibuf->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
+
+  return ibuf;
+}
+
+/* Decode the frame at `position`, on the calling thread. */
+static ImBuf *ffmpeg_decode_frame(struct anim *anim, int position, IMB_Timecode_Type tc)
+{
   av_log(anim->pFormatCtx, AV_LOG_DEBUG, "FETCH: seek_pos=%d\n", position);
 
   struct anim_index *tc_index = IMB_anim_open_index(anim, tc);
@@ -1424,39 +1477,7 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
   anim->y = anim->pCodecCtx->height;
 
   IMB_freeImBuf(anim->cur_frame_final);
-
-  /* Certain versions of FFmpeg have a bug in libswscale which ends up in crash
-   * when destination buffer is not properly aligned. For example, this happens
-   * in FFmpeg 4.3.1. It got fixed later on, but for compatibility reasons is
-   * still best to avoid crash.
-   *
-   * This is achieved by using own allocation call rather than relying on
-   * IMB_allocImBuf() to do so since the IMB_allocImBuf() is not guaranteed
-   * to perform aligned allocation.
-   *
-   * In theory this could give better performance, since SIMD operations on
-   * aligned data are usually faster.
-   *
-   * Note that even though sometimes vertical flip is required it does not
-   * affect on alignment of data passed to sws_scale because if the X dimension
-   * is not 32 byte aligned special intermediate buffer is allocated.
-   *
-   * The issue was reported to FFmpeg under ticket #8747 in the FFmpeg tracker
-   * and is fixed in the newer versions than 4.3.1. */
-
-  const AVPixFmtDescriptor *pix_fmt_descriptor = av_pix_fmt_desc_get(anim->pCodecCtx->pix_fmt);
-
-  int planes = R_IMF_PLANES_RGBA;
-  if ((pix_fmt_descriptor->flags & AV_PIX_FMT_FLAG_ALPHA) == 0) {
-    planes = R_IMF_PLANES_RGB;
-  }
-
-  anim->cur_frame_final = IMB_allocImBuf(anim->x, anim->y, planes, 0);
-  anim->cur_frame_final->rect = static_cast<uint *>(
-      MEM_mallocN_aligned(size_t(4) * anim->x * anim->y, 32, "ffmpeg ibuf"));
-  anim->cur_frame_final->mall |= IB_rect;
-
-  anim->cur_frame_final->rect_colorspace = colormanage_colorspace_get_named(anim->colorspace);
+  anim->cur_frame_final = ffmpeg_frame_final_alloc(anim);
 
   AVFrame *final_frame = ffmpeg_frame_by_pts_get(anim, pts_to_search);
   if (final_frame == nullptr) {
@@ -1468,22 +1489,519 @@ static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Typ
   /* Even with the fallback from above it is possible that the current decode frame is nullptr. In
    * this case skip post-processing and return current image buffer. */
   if (final_frame != nullptr) {
-    ffmpeg_postprocess(anim, final_frame);
+    ffmpeg_postprocess(anim, final_frame, anim->cur_frame_final);
   }
 
-  anim->cur_position = position;
+  anim->decode_position = position;
 
   IMB_refImBuf(anim->cur_frame_final);
 
   return anim->cur_frame_final;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Background Decoding
+ *
+ * Once frames are fetched in sequence (playback or scrubbing), a decoder thread takes over all
+ * decoding of the movie: fetches request their frame from it, and while no frame is requested
+ * it decodes & converts the frames following the last fetched one in the direction of playback,
+ * into a ring of #ANIM_DECODE_FRAMES frames handed out by the fetches.
+ *
+ * Decoding a frame before the last decoded one seeks to the key frame of its GOP and decodes all
+ * frames up to it. When playing backwards, the frames of the GOP before the fetched one are kept
+ * in the ring on the way, instead of decoding the GOP again for each of them.
+ *
+ * The ring takes a share of the cache limiter budget. The thread stops & frees the ring when the
+ * movie isn't fetched from for #ANIM_DECODE_IDLE_MS, or when #ANIM_DECODERS_MAX other movies were
+ * fetched from since, it's started again by the next fetches in sequence.
+ * \{ */
+
+/* Frames decoded ahead of the last fetched frame, in the direction of playback. */
+#define ANIM_DECODE_AHEAD 8
+/* Decoded frames kept, more than #ANIM_DECODE_AHEAD for the frames of a GOP decoded backwards
+ * and the requested frames. */
+#define ANIM_DECODE_FRAMES 16
+/* Part of the cache limiter budget (#MEM_CacheLimiter_get_maximum) the ring may take, as a
+ * divisor. The requested frame is kept regardless. */
+#define ANIM_DECODE_MEM_DIVISOR 8
+/* Time without fetches after which the decoder thread stops. */
+#define ANIM_DECODE_IDLE_MS 2000
+/* Movies with a decoder thread, the least recently fetched ones are stopped. */
+#define ANIM_DECODERS_MAX 4
+
+struct AnimDecodedFrame {
+  int position;
+  ImBuf *ibuf;
+  size_t size;
+};
+
+struct AnimDecoder {
+  List threads;
+  ThreadMutex mutex;
+  /* Notified when a frame is requested or the playhead moves, for the decoder thread. */
+  ThreadCondition request_cond;
+  /* Notified when a frame was decoded, for the fetching threads. */
+  ThreadCondition frame_cond;
+
+  AnimDecodedFrame frames[ANIM_DECODE_FRAMES];
+  int frames_num;
+  /* Memory of the frames in the ring, and of the last decoded frame. */
+  size_t frames_size;
+  size_t frame_size_last;
+
+  IMB_Timecode_Type tc;
+  /* Frame a fetch waits for, -1 when none. */
+  int request;
+  /* Last fetched frame and direction of playback from it, 1 or -1. */
+  int playhead;
+  int direction;
+  /* Time of the last fetch, see #ANIM_DECODE_IDLE_MS. */
+  double fetch_time;
+
+  /* Frame being decoded by the thread (-1 when none), its time-code & index. */
+  int decoding;
+  IMB_Timecode_Type decoding_tc;
+  struct anim_index *tc_index;
+
+  /* Set to stop the thread, and by the thread once it stopped (the ring is freed). */
+  bool stop;
+  bool is_stopped;
+};
+
+/* Movies with a decoder, the most recently fetched first. */
+static struct anim *anim_decoders[ANIM_DECODERS_MAX];
+static int anim_decoders_num = 0;
+static ThreadMutex anim_decoders_lock = LIB_MUTEX_INITIALIZER;
+
+static size_t anim_decoder_mem_limit()
+{
+  if (MEM_CacheLimiter_is_disabled()) {
+    return SIZE_MAX;
+  }
+  return MEM_CacheLimiter_get_maximum() / ANIM_DECODE_MEM_DIVISOR;
+}
+
+static int anim_decoder_frame_find(const AnimDecoder *decoder, int position)
+{
+  for (int i = 0; i < decoder->frames_num; i++) {
+    if (decoder->frames[i].position == position) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static bool anim_decoder_frame_in_window(const struct anim *anim, int position)
+{
+  const AnimDecoder *decoder = anim->decoder;
+  const int offset = (position - decoder->playhead) * decoder->direction;
+  return offset > 0 && offset <= ANIM_DECODE_AHEAD && position >= 0 &&
+         position < anim->duration_in_frames;
+}
+
+/* Distance of the frame at `position` from the playhead, frames out of the window being further
+ * than all frames in it. */
+static int anim_decoder_frame_distance(const struct anim *anim, int position)
+{
+  const AnimDecoder *decoder = anim->decoder;
+  int distance = abs(position - decoder->playhead);
+  if (!anim_decoder_frame_in_window(anim, position)) {
+    distance += anim->duration_in_frames;
+  }
+  return distance;
+}
+
+/* Whether the frame at `position` is to be decoded ahead, with the decoder locked: in the
+ * window, not decoded yet, and the ring has room for it. */
+static bool anim_decoder_frame_wanted(const struct anim *anim, int position)
+{
+  const AnimDecoder *decoder = anim->decoder;
+  return anim_decoder_frame_in_window(anim, position) &&
+         anim_decoder_frame_find(decoder, position) == -1 &&
+         decoder->frames_size + decoder->frame_size_last <= anim_decoder_mem_limit();
+}
+
+/* Next frame to decode, with the decoder locked: the requested one, or the first frame ahead of
+ * the playhead not decoded yet. */
+static int anim_decoder_next_position(const struct anim *anim)
+{
+  const AnimDecoder *decoder = anim->decoder;
+
+  if (decoder->request != -1 && anim_decoder_frame_find(decoder, decoder->request) == -1) {
+    return decoder->request;
+  }
+  for (int i = 1; i <= ANIM_DECODE_AHEAD; i++) {
+    const int position = decoder->playhead + i * decoder->direction;
+    if (anim_decoder_frame_wanted(anim, position)) {
+      return position;
+    }
+  }
+  return -1;
+}
+
+static void anim_decoder_frame_remove(AnimDecoder *decoder, int index)
+{
+  decoder->frames_size -= decoder->frames[index].size;
+  decoder->frames[index] = decoder->frames[--decoder->frames_num];
+}
+
+static void anim_decoder_frames_clear(AnimDecoder *decoder)
+{
+  for (int i = 0; i < decoder->frames_num; i++) {
+    IMB_freeImBuf(decoder->frames[i].ibuf);
+  }
+  decoder->frames_num = 0;
+  decoder->frames_size = 0;
+}
+
+/* Add a decoded frame to the ring with the decoder locked. When the ring is full or over its
+ * budget, the frames furthest from the playhead are replaced (or `ibuf` is dropped when it's the
+ * furthest). */
+static void anim_decoder_frame_store(struct anim *anim, int position, ImBuf *ibuf)
+{
+  AnimDecoder *decoder = anim->decoder;
+
+  if (anim_decoder_frame_find(decoder, position) != -1 ||
+      (position != decoder->request && !anim_decoder_frame_in_window(anim, position)))
+  {
+    IMB_freeImBuf(ibuf);
+    return;
+  }
+
+  const size_t size = ibuf ? IMB_get_size_in_memory(ibuf) : 0;
+  const size_t mem_limit = anim_decoder_mem_limit();
+  decoder->frame_size_last = size;
+
+  while (decoder->frames_num == ANIM_DECODE_FRAMES ||
+         (decoder->frames_num > 0 && decoder->frames_size + size > mem_limit))
+  {
+    /* The requested frame isn't replaced, a fetch waits for it. */
+    int furthest = -1, furthest_distance = -1;
+    for (int i = 0; i < decoder->frames_num; i++) {
+      const int frame_position = decoder->frames[i].position;
+      const int distance = anim_decoder_frame_distance(anim, frame_position);
+      if (frame_position != decoder->request && distance > furthest_distance) {
+        furthest = i;
+        furthest_distance = distance;
+      }
+    }
+
+    if (position != decoder->request &&
+        (furthest == -1 || anim_decoder_frame_distance(anim, position) >= furthest_distance))
+    {
+      IMB_freeImBuf(ibuf);
+      return;
+    }
+    if (furthest == -1) {
+      /* Only the requested frame is left, store it over the budget. */
+      lib_assert(decoder->frames_num < ANIM_DECODE_FRAMES);
+      break;
+    }
+    IMB_freeImBuf(decoder->frames[furthest].ibuf);
+    anim_decoder_frame_remove(decoder, furthest);
+  }
+
+  decoder->frames[decoder->frames_num].position = position;
+  decoder->frames[decoder->frames_num].ibuf = ibuf;
+  decoder->frames[decoder->frames_num].size = size;
+  decoder->frames_num++;
+  decoder->frames_size += size;
+
+  lib_condition_notify_all(&decoder->frame_cond);
+}
+
+/* Position of the frame starting at `pts`, -1 when it's not the frame of a position. */
+static int ffmpeg_position_from_pts(struct anim *anim, struct anim_index *tc_index, int64_t pts)
+{
+  AVStream *v_st = anim->pFormatCtx->streams[anim->videoStream];
+  const int64_t start_pts = (v_st->start_time != AV_NOPTS_VALUE) ? v_st->start_time : 0;
+  const int64_t pts_end = pts + MAX2(anim->pFrame->pkt_duration, int64_t(1));
+  const int estimate = int(round((pts - start_pts) / ffmpeg_steps_per_frame_get(anim)));
+
+  for (int position = estimate - 1; position <= estimate + 1; position++) {
+    if (position >= 0 && position < anim->duration_in_frames &&
+        ffmpeg_pts_isect(pts, pts_end, ffmpeg_get_pts_to_search(anim, tc_index, position)))
+    {
+      return position;
+    }
+  }
+  return -1;
+}
+
+/* Keep the frame decoded while scanning the GOP of the frame being decoded by the decoder
+ * thread, when it's a frame ahead of the playhead when playing backwards. */
+static void anim_decoder_gop_frame_keep(struct anim *anim)
+{
+  AnimDecoder *decoder = anim->decoder;
+
+  if (!anim->pFrame_complete) {
+    return;
+  }
+  const int position = ffmpeg_position_from_pts(anim, decoder->tc_index, anim->cur_pts);
+  if (position == -1 || position == decoder->decoding) {
+    return;
+  }
+
+  lib_mutex_lock(&decoder->mutex);
+  const bool wanted = decoder->direction < 0 && decoder->tc == decoder->decoding_tc &&
+                      anim_decoder_frame_wanted(anim, position);
+  lib_mutex_unlock(&decoder->mutex);
+  if (!wanted) {
+    return;
+  }
+
+  ImBuf *ibuf = ffmpeg_frame_final_alloc(anim);
+  ffmpeg_postprocess(anim, anim->pFrame, ibuf);
+
+  lib_mutex_lock(&decoder->mutex);
+  if (decoder->tc == decoder->decoding_tc) {
+    anim_decoder_frame_store(anim, position, ibuf);
+  }
+  else {
+    IMB_freeImBuf(ibuf);
+  }
+  lib_mutex_unlock(&decoder->mutex);
+}
+
+static void *anim_decoder_thread(void *anim_v)
+{
+  struct anim *anim = static_cast<struct anim *>(anim_v);
+  AnimDecoder *decoder = anim->decoder;
+
+  lib_mutex_lock(&decoder->mutex);
+  while (!decoder->stop) {
+    const int position = anim_decoder_next_position(anim);
+    if (position == -1) {
+      const double idle = PIL_check_seconds_timer() - decoder->fetch_time;
+      if (idle * 1000.0 >= ANIM_DECODE_IDLE_MS) {
+        break;
+      }
+      lib_condition_wait_timeout(
+          &decoder->request_cond, &decoder->mutex, ANIM_DECODE_IDLE_MS - int(idle * 1000.0));
+      continue;
+    }
+
+    const IMB_Timecode_Type tc = decoder->tc;
+    decoder->decoding = position;
+    decoder->decoding_tc = tc;
+    lib_mutex_unlock(&decoder->mutex);
+
+    decoder->tc_index = IMB_anim_open_index(anim, tc);
+    ImBuf *ibuf = ffmpeg_decode_frame(anim, position, tc);
+
+    lib_mutex_lock(&decoder->mutex);
+    decoder->decoding = -1;
+    if (tc == decoder->tc) {
+      anim_decoder_frame_store(anim, position, ibuf);
+    }
+    else {
+      IMB_freeImBuf(ibuf);
+    }
+    if (decoder->request == position) {
+      decoder->request = -1;
+    }
+    lib_condition_notify_all(&decoder->frame_cond);
+  }
+
+  /* Fetches waiting for a frame decode it themselves, see #anim_decoder_fetch. */
+  decoder->is_stopped = true;
+  anim_decoder_frames_clear(decoder);
+  lib_condition_notify_all(&decoder->frame_cond);
+  lib_mutex_unlock(&decoder->mutex);
+
+  return nullptr;
+}
+
+/* Make `anim` the most recently fetched movie with a decoder, stopping the decoder of the least
+ * recently fetched one when there are more than #ANIM_DECODERS_MAX. */
+static void anim_decoder_activate(struct anim *anim)
+{
+  lib_mutex_lock(&anim_decoders_lock);
+
+  int index = 0;
+  while (index < anim_decoders_num && anim_decoders[index] != anim) {
+    index++;
+  }
+  if (index == anim_decoders_num) {
+    if (anim_decoders_num == ANIM_DECODERS_MAX) {
+      /* The decoder of a movie is only freed once it's removed from the list, with the list
+       * locked, so it's still there. */
+      AnimDecoder *decoder = anim_decoders[--index]->decoder;
+      lib_mutex_lock(&decoder->mutex);
+      decoder->stop = true;
+      lib_condition_notify_all(&decoder->request_cond);
+      lib_mutex_unlock(&decoder->mutex);
+    }
+    else {
+      anim_decoders_num++;
+    }
+  }
+  memmove(&anim_decoders[1], &anim_decoders[0], sizeof(*anim_decoders) * size_t(index));
+  anim_decoders[0] = anim;
+
+  lib_mutex_unlock(&anim_decoders_lock);
+}
+
+static void anim_decoder_deactivate(struct anim *anim)
+{
+  lib_mutex_lock(&anim_decoders_lock);
+  for (int i = 0; i < anim_decoders_num; i++) {
+    if (anim_decoders[i] == anim) {
+      anim_decoders_num--;
+      memmove(&anim_decoders[i],
+              &anim_decoders[i + 1],
+              sizeof(*anim_decoders) * size_t(anim_decoders_num - i));
+      break;
+    }
+  }
+  lib_mutex_unlock(&anim_decoders_lock);
+}
+
+static void anim_decoder_start(struct anim *anim, int position, IMB_Timecode_Type tc)
+{
+  AnimDecoder *decoder = static_cast<AnimDecoder *>(
+      MEM_callocN(sizeof(AnimDecoder), "AnimDecoder"));
+
+  lib_mutex_init(&decoder->mutex);
+  lib_condition_init(&decoder->request_cond);
+  lib_condition_init(&decoder->frame_cond);
+  decoder->tc = tc;
+  decoder->request = -1;
+  decoder->playhead = anim->decode_position;
+  decoder->direction = (position < anim->decode_position) ? -1 : 1;
+  decoder->fetch_time = PIL_check_seconds_timer();
+  decoder->decoding = -1;
+
+  anim->decoder = decoder;
+
+  lib_threadpool_init(&decoder->threads, anim_decoder_thread, 1);
+  lib_threadpool_insert(&decoder->threads, anim);
+}
+
+/* Stop the decoder thread, decoding on the calling thread again. */
+static void anim_decoder_free(struct anim *anim)
+{
+  AnimDecoder *decoder = anim->decoder;
+  if (decoder == nullptr) {
+    return;
+  }
+
+  anim_decoder_deactivate(anim);
+
+  lib_mutex_lock(&decoder->mutex);
+  decoder->stop = true;
+  lib_condition_notify_all(&decoder->request_cond);
+  lib_mutex_unlock(&decoder->mutex);
+
+  lib_threadpool_end(&decoder->threads);
+
+  anim_decoder_frames_clear(decoder);
+  lib_condition_end(&decoder->frame_cond);
+  lib_condition_end(&decoder->request_cond);
+  lib_mutex_end(&decoder->mutex);
+  MEM_freeN(decoder);
+
+  anim->decoder = nullptr;
+}
+
+static bool anim_decoder_is_stopped(struct anim *anim)
+{
+  AnimDecoder *decoder = anim->decoder;
+  lib_mutex_lock(&decoder->mutex);
+  const bool is_stopped = decoder->is_stopped;
+  lib_mutex_unlock(&decoder->mutex);
+  return is_stopped;
+}
+
+/* Frame at `position` from the decoder thread, waiting for it to be decoded. Null when the
+ * decoder stopped meanwhile (see #anim_decoder_is_stopped). */
+static ImBuf *anim_decoder_fetch(struct anim *anim, int position, IMB_Timecode_Type tc)
+{
+  AnimDecoder *decoder = anim->decoder;
+  ImBuf *ibuf = nullptr;
+
+  anim_decoder_activate(anim);
+
+  lib_mutex_lock(&decoder->mutex);
+  decoder->fetch_time = PIL_check_seconds_timer();
+
+  if (tc != decoder->tc) {
+    anim_decoder_frames_clear(decoder);
+    decoder->tc = tc;
+  }
+  if (position != decoder->playhead) {
+    decoder->direction = (position > decoder->playhead) ? 1 : -1;
+    decoder->playhead = position;
+  }
+
+  while (true) {
+    const int index = anim_decoder_frame_find(decoder, position);
+    if (index != -1) {
+      ibuf = decoder->frames[index].ibuf;
+      anim_decoder_frame_remove(decoder, index);
+      break;
+    }
+    if (decoder->is_stopped) {
+      break;
+    }
+    /* Another fetch may be waiting for its frame, request this one after it. The frame may be
+     * being decoded ahead already, requesting it still keeps it for this fetch. */
+    if (decoder->request == -1) {
+      decoder->request = position;
+    }
+    lib_condition_notify_one(&decoder->request_cond);
+    lib_condition_wait(&decoder->frame_cond, &decoder->mutex);
+  }
+
+  /* Continue decoding ahead of the new playhead. */
+  lib_condition_notify_one(&decoder->request_cond);
+  lib_mutex_unlock(&decoder->mutex);
+
+  return ibuf;
+}
+
+/** \} */
+
+/**
+ * Fetch the frame at `position`, decoded on the calling thread until frames are fetched in
+ * sequence, then by the decoder thread of the movie.
+ */
+static ImBuf *ffmpeg_fetchibuf(struct anim *anim, int position, IMB_Timecode_Type tc)
+{
+  if (anim == nullptr) {
+    return nullptr;
+  }
+
+  /* Open the index on this thread, the decoder thread only gets the opened index. */
+  IMB_anim_open_index(anim, tc);
+
+  /* Stopped while idle or inactive. */
+  if (anim->decoder && anim_decoder_is_stopped(anim)) {
+    anim_decoder_free(anim);
+  }
+
+  if (anim->decoder == nullptr) {
+    if (ffmpeg_is_first_frame_decode(anim) || abs(position - anim->decode_position) != 1) {
+      return ffmpeg_decode_frame(anim, position, tc);
+    }
+    anim_decoder_start(anim, position, tc);
+  }
+
+  ImBuf *ibuf = anim_decoder_fetch(anim, position, tc);
+  if (ibuf == nullptr && anim_decoder_is_stopped(anim)) {
+    anim_decoder_free(anim);
+    ibuf = ffmpeg_decode_frame(anim, position, tc);
+  }
+  return ibuf;
+}
 static void free_anim_ffmpeg(struct anim *anim)
 {
   if (anim == nullptr) {
     return;
   }
 
+  anim_decoder_free(anim);
+
   if (anim->pCodecCtx) {
     avcodec_free_context(&anim->pCodecCtx);
     avformat_close_input(&anim->pFormatCtx);
@@ -1,4 +1,5 @@
 #include "imbuf_colormanagement.h"
+#include "imbuf_colormanagement_ex.h"
 #include "imbuf_colormanagement_intern.h"
 
 #include <math.h>
@@ -40,10 +41,20 @@
 
 #include <ocio_capi.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define DISPLAY_LUT_SSE2
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define DISPLAY_LUT_NEON
+#endif
+
 /* -------------------------------------------------------------------- */
 /** Global declarations **/
 
 #define DISPLAY_BUFFER_CHANNELS 4
+/* Size of the tiles display buffers are transformed in, when they become visible. */
+#define DISPLAY_BUFFER_TILE_SIZE 256
 
 /* ** list of all supported color spaces, displays and views */
 static char global_role_data[MAX_COLORSPACE_NAME];
@@ -105,6 +116,8 @@ static struct global_color_picking_state {
   bool failed;
 } global_color_picking_state = {nullptr};
 
+static void display_lut_cache_free(void);
+
 /* -------------------------------------------------------------------- */
 /** Color Managed Cache **/
 
@@ -200,6 +213,8 @@ typedef struct ColormanageCacheData {
   float dither;                /* dither value cached buffer is calculated with */
   CurveMapping *curve_mapping; /* curve mapping used for cached buffer */
   int curve_mapping_timestamp; /* time stamp of curve mapping used for cached buffer */
+  int tiles_x, tiles_y;        /* number of #DISPLAY_BUFFER_TILE_SIZE tiles of the buffer */
+  uchar *tiles_done;           /* tiles of the buffer which were transformed already */
 } ColormanageCacheData;
 
 typedef struct ColormanageCache {
@@ -462,6 +477,12 @@ static void colormanage_cache_put(ImBuf *ibuf,
   cache_data->curve_mapping = curve_mapping;
   cache_data->curve_mapping_timestamp = curve_mapping_timestamp;
 
+  /* Tiles are transformed once needed, see #colormanage_display_buffer_tiles_update. */
+  cache_data->tiles_x = divide_ceil_u(ibuf->x, DISPLAY_BUFFER_TILE_SIZE);
+  cache_data->tiles_y = divide_ceil_u(ibuf->y, DISPLAY_BUFFER_TILE_SIZE);
+  cache_data->tiles_done = static_cast<uchar *>(MEM_callocN(
+      size_t(cache_data->tiles_x) * cache_data->tiles_y, "color manage cache tiles done"));
+
   colormanage_cachedata_set(cache_ibuf, cache_data);
 
   *cache_handle = cache_ibuf;
@@ -759,6 +780,8 @@ void colormanagement_exit(void)
   memset(&global_gpu_state, 0, sizeof(global_gpu_state));
   memset(&global_color_picking_state, 0, sizeof(global_color_picking_state));
 
+  display_lut_cache_free();
+
   colormanage_free_config();
 }
 
@@ -790,6 +813,7 @@ void colormanage_cache_free(ImBuf *ibuf)
     struct MovieCache *moviecache = colormanage_moviecache_get(ibuf);
 
     if (cache_data) {
+      MEM_SAFE_FREE(cache_data->tiles_done);
       mem_freen(cache_data);
     }
 
@@ -2016,12 +2040,462 @@ const float *IMB_colormanagement_get_xyz_to_scene_linear(void)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Baked Display Transforms
+ *
+ * Display transforms to byte buffers are baked into a 3D LUT of the view and display transforms,
+ * sampled through a log shaper so a small LUT covers the range of HDR images. Looking up the LUT
+ * costs a fraction of running the OCIO processor on every pixel and is precise enough for 8 bit
+ * output. Pixels outside of the range of the shaper still use the processor. The exposure scales
+ * scene linear values before the lookup, so changing it doesn't bake another LUT.
+ *
+ * Transforms with curve mapping, a look or gamma aren't baked: they can bend the transform between
+ * LUT points or move where display values clip off them, so the error of the LUT isn't bounded.
+ * \{ */
+
+/* Number of LUT points per axis, 4 per stop of the shaper range. The shaper is linear within
+ * each stop, points on its boundaries keep the error within half a step of 8 bit output, see the
+ * `colormanagement_test.cc` tests. With 3 per stop the sRGB curve is off by more than that. */
+#define DISPLAY_LUT_SIZE 65
+/* Range of scene linear values covered by the LUT, in stops: [0, 2^DISPLAY_LUT_LOG2_MAX]. */
+#define DISPLAY_LUT_LOG2_MIN (-8)
+#define DISPLAY_LUT_LOG2_MAX 8
+/* Number of baked transforms kept for reuse, e.g. for a few editors with different views. */
+#define DISPLAY_LUT_CACHE_SIZE 4
+
+#define DISPLAY_LUT_LEN (DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE)
+#define DISPLAY_LUT_VALUE_OFFSET (1.0f / (1 << -DISPLAY_LUT_LOG2_MIN))
+#define DISPLAY_LUT_VALUE_MAX (float(1 << DISPLAY_LUT_LOG2_MAX) - DISPLAY_LUT_VALUE_OFFSET)
+/* Shaper coefficients, see #display_lut_shaper. */
+#define DISPLAY_LUT_SHAPER_SCALE \
+  (float(DISPLAY_LUT_SIZE - 1) / \
+   (float(1 << 23) * float(DISPLAY_LUT_LOG2_MAX - DISPLAY_LUT_LOG2_MIN)))
+#define DISPLAY_LUT_SHAPER_BIAS \
+  (float(127 + DISPLAY_LUT_LOG2_MIN) * float(DISPLAY_LUT_SIZE - 1) / \
+   float(DISPLAY_LUT_LOG2_MAX - DISPLAY_LUT_LOG2_MIN))
+
+BLI_STATIC_ASSERT((DISPLAY_LUT_SIZE - 1) % (DISPLAY_LUT_LOG2_MAX - DISPLAY_LUT_LOG2_MIN) == 0,
+                  "LUT points must be on the stops of the shaper")
+
+typedef struct DisplayLUTKey {
+  char display[MAX_COLORSPACE_NAME];
+  char view[MAX_COLORSPACE_NAME];
+} DisplayLUTKey;
+
+typedef struct DisplayLUT {
+  DisplayLUTKey key;
+  /* Threads using the LUT, it's freed once unused when it's no longer in the cache. */
+  int users;
+  bool is_cached;
+  /* Display RGB of each point (4th value unused, for vector loads), blue varying fastest. */
+  float (*table)[4];
+} DisplayLUT;
+
+/* Baked transforms, most recently used first. */
+static DisplayLUT *global_display_luts[DISPLAY_LUT_CACHE_SIZE] = {nullptr};
+static pthread_mutex_t display_lut_lock = LIB_MUTEX_INITIALIZER;
+
+/**
+ * Shaper of the LUT input: log2 approximated piecewise linearly from the bits of the float,
+ * which is monotonic, exactly invertible and cheap to vectorize. Maps the range of the LUT
+ * to [0, DISPLAY_LUT_SIZE - 1].
+ */
+BLI_INLINE float display_lut_shaper(float value)
+{
+  int bits;
+  value += DISPLAY_LUT_VALUE_OFFSET;
+  memcpy(&bits, &value, sizeof(bits));
+  return float(bits) * DISPLAY_LUT_SHAPER_SCALE - DISPLAY_LUT_SHAPER_BIAS;
+}
+
+static float display_lut_shaper_inverse(float shaped)
+{
+  const int bits = int(lroundf((shaped + DISPLAY_LUT_SHAPER_BIAS) / DISPLAY_LUT_SHAPER_SCALE));
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return max_ff(value - DISPLAY_LUT_VALUE_OFFSET, 0.0f);
+}
+
+BLI_INLINE bool display_lut_in_range(const float rgb[3])
+{
+  /* Written so NaN is out of range. */
+  return (rgb[0] >= 0.0f && rgb[0] <= DISPLAY_LUT_VALUE_MAX) &&
+         (rgb[1] >= 0.0f && rgb[1] <= DISPLAY_LUT_VALUE_MAX) &&
+         (rgb[2] >= 0.0f && rgb[2] <= DISPLAY_LUT_VALUE_MAX);
+}
+
+/* Shape the RGB of a pixel in the range of the LUT. */
+BLI_INLINE void display_lut_shape_v3(const float rgb[3], float r_shaped[4])
+{
+#if defined(DISPLAY_LUT_SSE2)
+  __m128 value = _mm_add_ps(_mm_set_ps(0.0f, rgb[2], rgb[1], rgb[0]),
+                            _mm_set1_ps(DISPLAY_LUT_VALUE_OFFSET));
+  __m128 shaped = _mm_sub_ps(
+      _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(value)), _mm_set1_ps(DISPLAY_LUT_SHAPER_SCALE)),
+      _mm_set1_ps(DISPLAY_LUT_SHAPER_BIAS));
+  _mm_storeu_ps(r_shaped, shaped);
+#elif defined(DISPLAY_LUT_NEON)
+  const float rgb_v4[4] = {rgb[0], rgb[1], rgb[2], 0.0f};
+  const float32x4_t value = vaddq_f32(vld1q_f32(rgb_v4), vdupq_n_f32(DISPLAY_LUT_VALUE_OFFSET));
+  const float32x4_t shaped = vsubq_f32(
+      vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_f32(value)), DISPLAY_LUT_SHAPER_SCALE),
+      vdupq_n_f32(DISPLAY_LUT_SHAPER_BIAS));
+  vst1q_f32(r_shaped, shaped);
+#else
+  r_shaped[0] = display_lut_shaper(rgb[0]);
+  r_shaped[1] = display_lut_shaper(rgb[1]);
+  r_shaped[2] = display_lut_shaper(rgb[2]);
+  r_shaped[3] = 0.0f;
+#endif
+}
+
+/* Weighted sum of 4 LUT points. */
+BLI_INLINE void display_lut_blend_v3(const float *points[4],
+                                     const float weights[4],
+                                     float r_rgb[3])
+{
+#if defined(DISPLAY_LUT_SSE2)
+  __m128 rgb = _mm_mul_ps(_mm_loadu_ps(points[0]), _mm_set1_ps(weights[0]));
+  rgb = _mm_add_ps(rgb, _mm_mul_ps(_mm_loadu_ps(points[1]), _mm_set1_ps(weights[1])));
+  rgb = _mm_add_ps(rgb, _mm_mul_ps(_mm_loadu_ps(points[2]), _mm_set1_ps(weights[2])));
+  rgb = _mm_add_ps(rgb, _mm_mul_ps(_mm_loadu_ps(points[3]), _mm_set1_ps(weights[3])));
+  float result[4];
+  _mm_storeu_ps(result, rgb);
+  copy_v3_v3(r_rgb, result);
+#elif defined(DISPLAY_LUT_NEON)
+  float32x4_t rgb = vmulq_n_f32(vld1q_f32(points[0]), weights[0]);
+  rgb = vmlaq_n_f32(rgb, vld1q_f32(points[1]), weights[1]);
+  rgb = vmlaq_n_f32(rgb, vld1q_f32(points[2]), weights[2]);
+  rgb = vmlaq_n_f32(rgb, vld1q_f32(points[3]), weights[3]);
+  float result[4];
+  vst1q_f32(result, rgb);
+  copy_v3_v3(r_rgb, result);
+#else
+  for (int i = 0; i < 3; i++) {
+    r_rgb[i] = points[0][i] * weights[0] + points[1][i] * weights[1] +
+               points[2][i] * weights[2] + points[3][i] * weights[3];
+  }
+#endif
+}
+
+/* Tetrahedral interpolation of the LUT at a pixel in its range. */
+BLI_INLINE void display_lut_apply_v3(const DisplayLUT *lut, float rgb[3])
+{
+  const int stride_r = DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE, stride_g = DISPLAY_LUT_SIZE;
+  float shaped[4];
+  int index[3];
+  float fac[3];
+
+  display_lut_shape_v3(rgb, shaped);
+
+  for (int i = 0; i < 3; i++) {
+    index[i] = clamp_i(int(shaped[i]), 0, DISPLAY_LUT_SIZE - 2);
+    fac[i] = shaped[i] - float(index[i]);
+  }
+
+  const float(*base)[4] = lut->table + index[0] * stride_r + index[1] * stride_g + index[2];
+  const float *points[4] = {base[0], nullptr, nullptr, base[stride_r + stride_g + 1]};
+  float weights[4];
+  const float r = fac[0], g = fac[1], b = fac[2];
+
+  /* Corners of the tetrahedron of the cell the pixel is in. */
+  if (r > g) {
+    if (g > b) {
+      points[1] = base[stride_r];
+      points[2] = base[stride_r + stride_g];
+      ARRAY_SET_ITEMS(weights, 1.0f - r, r - g, g - b, b);
+    }
+    else if (r > b) {
+      points[1] = base[stride_r];
+      points[2] = base[stride_r + 1];
+      ARRAY_SET_ITEMS(weights, 1.0f - r, r - b, b - g, g);
+    }
+    else {
+      points[1] = base[1];
+      points[2] = base[stride_r + 1];
+      ARRAY_SET_ITEMS(weights, 1.0f - b, b - r, r - g, g);
+    }
+  }
+  else {
+    if (b > g) {
+      points[1] = base[1];
+      points[2] = base[stride_g + 1];
+      ARRAY_SET_ITEMS(weights, 1.0f - b, b - g, g - r, r);
+    }
+    else if (b > r) {
+      points[1] = base[stride_g];
+      points[2] = base[stride_g + 1];
+      ARRAY_SET_ITEMS(weights, 1.0f - g, g - b, b - r, r);
+    }
+    else {
+      points[1] = base[stride_g];
+      points[2] = base[stride_r + stride_g];
+      ARRAY_SET_ITEMS(weights, 1.0f - g, g - r, r - b, b);
+    }
+  }
+
+  display_lut_blend_v3(points, weights, rgb);
+}
+
+/**
+ * Apply the display transform to a buffer, the same as #IMB_colormanagement_processor_apply,
+ * using the LUT for pixels in its range once scaled by the exposure (`exposure_scale`).
+ */
+static void display_lut_apply(const DisplayLUT *lut,
+                              float exposure_scale,
+                              ColormanageProcessor *cm_processor,
+                              float *buffer,
+                              int width,
+                              int height,
+                              int channels,
+                              bool predivide)
+{
+  BLI_assert(ELEM(channels, 3, 4));
+
+  const size_t i_last = size_t(width) * height;
+  float *fp = buffer;
+
+  for (size_t i = 0; i != i_last; i++, fp += channels) {
+    const float alpha = (channels == 4) ? fp[3] : 1.0f;
+    const bool unpremultiply = predivide && !ELEM(alpha, 0.0f, 1.0f);
+    float rgb[3];
+
+    mul_v3_v3fl(rgb, fp, unpremultiply ? exposure_scale / alpha : exposure_scale);
+
+    if (display_lut_in_range(rgb)) {
+      display_lut_apply_v3(lut, rgb);
+      if (unpremultiply) {
+        mul_v3_v3fl(fp, rgb, alpha);
+      }
+      else {
+        copy_v3_v3(fp, rgb);
+      }
+    }
+    else if (channels == 4) {
+      if (predivide) {
+        IMB_colormanagement_processor_apply_v4_predivide(cm_processor, fp);
+      }
+      else {
+        IMB_colormanagement_processor_apply_v4(cm_processor, fp);
+      }
+    }
+    else {
+      IMB_colormanagement_processor_apply_v3(cm_processor, fp);
+    }
+  }
+}
+
+typedef struct DisplayLUTBakeData {
+  ColormanageProcessor *cm_processor;
+  float axis[DISPLAY_LUT_SIZE];
+  float (*table)[4];
+} DisplayLUTBakeData;
+
+static void display_lut_bake_cb(void *__restrict userdata,
+                                const int r,
+                                const TaskParallelTLS *__restrict /*tls*/)
+{
+  DisplayLUTBakeData *data = static_cast<DisplayLUTBakeData *>(userdata);
+  const int points_num = DISPLAY_LUT_SIZE * DISPLAY_LUT_SIZE;
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_mallocN(sizeof(*points) * points_num, "display LUT bake points"));
+
+  for (int g = 0, i = 0; g < DISPLAY_LUT_SIZE; g++) {
+    for (int b = 0; b < DISPLAY_LUT_SIZE; b++, i++) {
+      copy_v3_fl3(points[i], data->axis[r], data->axis[g], data->axis[b]);
+    }
+  }
+
+  IMB_colormanagement_processor_apply(
+      data->cm_processor, &points[0][0], points_num, 1, 3, false);
+
+  float(*table)[4] = data->table + size_t(r) * points_num;
+  for (int i = 0; i < points_num; i++) {
+    copy_v3_v3(table[i], points[i]);
+    table[i][3] = 0.0f;
+  }
+
+  MEM_freeN(points);
+}
+
+static DisplayLUT *display_lut_bake(ColormanageProcessor *cm_processor, const DisplayLUTKey *key)
+{
+  DisplayLUT *lut = MEM_cnew<DisplayLUT>("display LUT");
+  DisplayLUTBakeData data;
+
+  lut->key = *key;
+  lut->table = static_cast<float(*)[4]>(
+      MEM_mallocN(sizeof(*lut->table) * DISPLAY_LUT_LEN, "display LUT table"));
+
+  data.cm_processor = cm_processor;
+  data.table = lut->table;
+  for (int i = 0; i < DISPLAY_LUT_SIZE; i++) {
+    data.axis[i] = display_lut_shaper_inverse(float(i));
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_range(0, DISPLAY_LUT_SIZE, &data, display_lut_bake_cb, &settings);
+
+  return lut;
+}
+
+static void display_lut_free(DisplayLUT *lut)
+{
+  MEM_freeN(lut->table);
+  MEM_freeN(lut);
+}
+
+/* Whether the display transform of the settings can be baked, see the section comment. */
+static bool display_lut_supported(const ColorManagedViewSettings *view_settings)
+{
+  if ((view_settings->flag & COLORMANAGE_VIEW_USE_CURVES) && view_settings->curve_mapping) {
+    return false;
+  }
+  if (view_settings->gamma != 1.0f) {
+    return false;
+  }
+  return !colormanage_use_look(view_settings->look, view_settings->view_transform);
+}
+
+/* Scale of scene linear values by the exposure, the same as the processor's. */
+static float display_lut_exposure_scale(const ColorManagedViewSettings *view_settings)
+{
+  return (view_settings->exposure == 0.0f) ? 1.0f : powf(2.0f, view_settings->exposure);
+}
+
+/**
+ * Get the baked transform of the settings, from the cache or baked when `allow_bake` is set.
+ * The settings must be #display_lut_supported.
+ * \return nullptr when there is none. Release with #display_lut_release.
+ */
+static DisplayLUT *display_lut_acquire(const ColorManagedViewSettings *view_settings,
+                                       const ColorManagedDisplaySettings *display_settings,
+                                       bool allow_bake)
+{
+  DisplayLUTKey key;
+  DisplayLUT *lut = nullptr;
+  int i;
+
+  /* Padding & name bytes after the terminator are compared too. */
+  memset(&key, 0, sizeof(key));
+  STRNCPY(key.display, display_settings->display_device);
+  STRNCPY(key.view, view_settings->view_transform);
+
+  BLI_mutex_lock(&display_lut_lock);
+  for (i = 0; i < DISPLAY_LUT_CACHE_SIZE && global_display_luts[i]; i++) {
+    if (memcmp(&global_display_luts[i]->key, &key, sizeof(key)) == 0) {
+      lut = global_display_luts[i];
+      break;
+    }
+  }
+  if (lut) {
+    /* Move to the front. */
+    memmove(&global_display_luts[1], &global_display_luts[0], sizeof(*global_display_luts) * i);
+    global_display_luts[0] = lut;
+    lut->users++;
+  }
+  BLI_mutex_unlock(&display_lut_lock);
+
+  if (lut || !allow_bake) {
+    return lut;
+  }
+
+  /* Bake without locking, another thread may bake the same transform meanwhile. */
+  ColorManagedViewSettings bake_view_settings = *view_settings;
+  bake_view_settings.exposure = 0.0f;
+  ColormanageProcessor *cm_processor = IMB_colormanagement_display_processor_new(
+      &bake_view_settings, display_settings);
+  lut = display_lut_bake(cm_processor, &key);
+  IMB_colormanagement_processor_free(cm_processor);
+
+  BLI_mutex_lock(&display_lut_lock);
+  DisplayLUT *lut_last = global_display_luts[DISPLAY_LUT_CACHE_SIZE - 1];
+  if (lut_last) {
+    lut_last->is_cached = false;
+    if (lut_last->users == 0) {
+      display_lut_free(lut_last);
+    }
+  }
+  memmove(&global_display_luts[1],
+          &global_display_luts[0],
+          sizeof(*global_display_luts) * (DISPLAY_LUT_CACHE_SIZE - 1));
+  global_display_luts[0] = lut;
+  lut->is_cached = true;
+  lut->users++;
+  BLI_mutex_unlock(&display_lut_lock);
+
+  return lut;
+}
+
+static void display_lut_release(DisplayLUT *lut)
+{
+  BLI_mutex_lock(&display_lut_lock);
+  lut->users--;
+  if (lut->users == 0 && !lut->is_cached) {
+    display_lut_free(lut);
+  }
+  BLI_mutex_unlock(&display_lut_lock);
+}
+
+static void display_lut_cache_free(void)
+{
+  BLI_mutex_lock(&display_lut_lock);
+  for (int i = 0; i < DISPLAY_LUT_CACHE_SIZE; i++) {
+    DisplayLUT *lut = global_display_luts[i];
+    if (lut) {
+      lut->is_cached = false;
+      if (lut->users == 0) {
+        display_lut_free(lut);
+      }
+      global_display_luts[i] = nullptr;
+    }
+  }
+  BLI_mutex_unlock(&display_lut_lock);
+}
+
+bool IMB_colormanagement_display_lut_apply(float *buffer,
+                                           int width,
+                                           int height,
+                                           int channels,
+                                           bool predivide,
+                                           const ColorManagedViewSettings *view_settings,
+                                           const ColorManagedDisplaySettings *display_settings)
+{
+  if (!ELEM(channels, 3, 4) || !display_lut_supported(view_settings)) {
+    return false;
+  }
+
+  ColormanageProcessor *cm_processor = IMB_colormanagement_display_processor_new(view_settings,
+                                                                                 display_settings);
+  DisplayLUT *lut = nullptr;
+  if (!cm_processor->is_data_result) {
+    lut = display_lut_acquire(view_settings, display_settings, true);
+    display_lut_apply(lut,
+                      display_lut_exposure_scale(view_settings),
+                      cm_processor,
+                      buffer,
+                      width,
+                      height,
+                      channels,
+                      predivide);
+    display_lut_release(lut);
+  }
+  IMB_colormanagement_processor_free(cm_processor);
+
+  return lut != nullptr;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Threaded Display Buffer Transform Routines
  * \{ */
 
 typedef struct DisplayBufferThread {
   ColormanageProcessor *cm_processor;
+  const DisplayLUT *lut;
+  float lut_exposure_scale;
 
   const float *buffer;
   uchar *byte_buffer;
@@ -2030,6 +2504,8 @@ typedef struct DisplayBufferThread {
   uchar *display_buffer_byte;
 
   int width;
+  /* Pixels between lines of the buffers, the width of the image. */
+  int stride;
   int start_line;
   int tot_line;
 
@@ -2045,13 +2521,16 @@ typedef struct DisplayBufferThread {
 typedef struct DisplayBufferInitData {
   ImBuf *ibuf;
   ColormanageProcessor *cm_processor;
+  const DisplayLUT *lut;
+  float lut_exposure_scale;
   const float *buffer;
   uchar *byte_buffer;
 
   float *display_buffer;
   uchar *display_buffer_byte;
 
-  int width;
+  /* Region of the image to transform. */
+  rcti rect;
 
   const char *byte_colorspace;
   const char *float_colorspace;
@@ -2070,12 +2549,16 @@ static void display_buffer_init_handle(void *handle_v,
   float dither = ibuf->dither;
   bool is_data = (ibuf->colormanage_flag & IMB_COLORMANAGE_IS_DATA) != 0;
 
-  size_t offset = size_t(channels) * start_line * ibuf->x;
-  size_t display_buffer_byte_offset = size_t(DISPLAY_BUFFER_CHANNELS) * start_line * ibuf->x;
+  size_t pixel_offset = size_t(init_data->rect.ymin + start_line) * ibuf->x +
+                        init_data->rect.xmin;
+  size_t offset = size_t(channels) * pixel_offset;
+  size_t display_buffer_byte_offset = size_t(DISPLAY_BUFFER_CHANNELS) * pixel_offset;
 
   memset(handle, 0, sizeof(DisplayBufferThread));
 
   handle->cm_processor = init_data->cm_processor;
+  handle->lut = init_data->lut;
+  handle->lut_exposure_scale = init_data->lut_exposure_scale;
 
   if (init_data->buffer) {
     handle->buffer = init_data->buffer + offset;
@@ -2093,7 +2576,8 @@ static void display_buffer_init_handle(void *handle_v,
     handle->display_buffer_byte = init_data->display_buffer_byte + display_buffer_byte_offset;
   }
 
-  handle->width = ibuf->x;
+  handle->width = BLI_rcti_size_x(&init_data->rect);
+  handle->stride = ibuf->x;
 
   handle->start_line = start_line;
   handle->tot_line = tot_line;
@@ -2114,35 +2598,34 @@ static void display_buffer_apply_get_linear_buffer(DisplayBufferThread *handle,
 {
   int channels = handle->channels;
   int width = handle->width;
+  int stride = handle->stride;
 
-  size_t buffer_size = size_t(channels) * width * height;
+  size_t line_size = size_t(channels) * width;
 
   bool is_data = handle->is_data;
   bool is_data_display = handle->cm_processor->is_data_result;
   bool predivide = handle->predivide;
 
   if (!handle->buffer) {
-    uchar *byte_buffer = handle->byte_buffer;
-
     const char *from_colorspace = handle->byte_colorspace;
     const char *to_colorspace = global_role_scene_linear;
 
-    float *fp;
-    uchar *cp;
-    const size_t i_last = size_t(width) * height;
-    size_t i;
+    float *fp = linear_buffer;
 
     /* first convert byte buffer to float, keep in image space */
-    for (i = 0, fp = linear_buffer, cp = byte_buffer; i != i_last;
-         i++, fp += channels, cp += channels) {
-      if (channels == 3) {
-        rgb_uchar_to_float(fp, cp);
-      }
-      else if (channels == 4) {
-        rgba_uchar_to_float(fp, cp);
-      }
-      else {
-        BLI_assert_msg(0, "Buffers of 3 or 4 channels are only supported here");
+    for (int y = 0; y < height; y++) {
+      const uchar *cp = handle->byte_buffer + size_t(channels) * y * stride;
+
+      for (int x = 0; x < width; x++, fp += channels, cp += channels) {
+        if (channels == 3) {
+          rgb_uchar_to_float(fp, cp);
+        }
+        else if (channels == 4) {
+          rgba_uchar_to_float(fp, cp);
+        }
+        else {
+          BLI_assert_msg(0, "Buffers of 3 or 4 channels are only supported here");
+        }
       }
     }
 
@@ -2164,7 +2647,11 @@ static void display_buffer_apply_get_linear_buffer(DisplayBufferThread *handle,
     const char *from_colorspace = handle->float_colorspace;
     const char *to_colorspace = global_role_scene_linear;
 
-    memcpy(linear_buffer, handle->buffer, buffer_size * sizeof(float));
+    for (int y = 0; y < height; y++) {
+      memcpy(linear_buffer + line_size * y,
+             handle->buffer + size_t(channels) * y * stride,
+             line_size * sizeof(float));
+    }
 
     if (!is_data && !is_data_display) {
       IMB_colormanagement_transform(
@@ -2180,7 +2667,11 @@ static void display_buffer_apply_get_linear_buffer(DisplayBufferThread *handle,
      * using duplicated buffer here
      */
 
-    memcpy(linear_buffer, handle->buffer, buffer_size * sizeof(float));
+    for (int y = 0; y < height; y++) {
+      memcpy(linear_buffer + line_size * y,
+             handle->buffer + size_t(channels) * y * stride,
+             line_size * sizeof(float));
+    }
 
     *is_straight_alpha = false;
   }
@@ -2194,6 +2685,7 @@ static void *do_display_buffer_apply_thread(void *handle_v)
   uchar *display_buffer_byte = handle->display_buffer_byte;
   int channels = handle->channels;
   int width = handle->width;
+  int stride = handle->stride;
   int height = handle->tot_line;
   float dither = handle->dither;
   bool is_data = handle->is_data;
@@ -2207,8 +2699,8 @@ static void *do_display_buffer_apply_thread(void *handle_v)
                                 false,
                                 width,
                                 height,
-                                width,
-                                width);
+                                stride,
+                                stride);
     }
 
     if (display_buffer) {
@@ -2219,8 +2711,8 @@ static void *do_display_buffer_apply_thread(void *handle_v)
                                  false,
                                  width,
                                  height,
-                                 width,
-                                 width);
+                                 stride,
+                                 stride);
     }
   }
   else {
@@ -2237,16 +2729,26 @@ static void *do_display_buffer_apply_thread(void *handle_v)
        * only generate byte buffers
        */
     }
+    else if (handle->lut) {
+      display_lut_apply(handle->lut,
+                        handle->lut_exposure_scale,
+                        cm_processor,
+                        linear_buffer,
+                        width,
+                        height,
+                        channels,
+                        predivide);
+    }
     else {
       /* apply processor */
-      imbuf_colormanagement_processor_apply(
+      IMB_colormanagement_processor_apply(
           cm_processor, linear_buffer, width, height, channels, predivide);
     }
 
     /* copy result to output buffers */
     if (display_buffer_byte) {
       /* do conversion */
-      imbuf_buffer_byte_from_float(display_buffer_byte,
+      IMB_buffer_byte_from_float(display_buffer_byte,
                                  linear_buffer,
                                  channels,
                                  dither,
@@ -2255,20 +2757,24 @@ static void *do_display_buffer_apply_thread(void *handle_v)
                                  predivide,
                                  width,
                                  height,
-                                 width,
+                                 stride,
                                  width);
     }
 
     if (display_buffer) {
-      memcpy(display_buffer, linear_buffer, size_t(width) * height * channels * sizeof(float));
+      for (int y = 0; y < height; y++) {
+        float *display_line = display_buffer + size_t(channels) * y * stride;
+
+        memcpy(display_line,
+               linear_buffer + size_t(channels) * y * width,
+               size_t(width) * channels * sizeof(float));
 
-      if (is_straight_alpha && channels == 4) {
-        const size_t i_last = size_t(width) * height;
-        size_t i;
-        float *fp;
+        if (is_straight_alpha && channels == 4) {
+          float *fp = display_line;
 
-        for (i = 0, fp = display_buffer; i != i_last; i++, fp += channels) {
-          straight_to_premul_v4(fp);
+          for (int x = 0; x < width; x++, fp += channels) {
+            straight_to_premul_v4(fp);
+          }
         }
       }
     }
@@ -2284,17 +2790,29 @@ static void display_buffer_apply_threaded(ImBuf *ibuf,
                                           uchar *byte_buffer,
                                           float *display_buffer,
                                           uchar *display_buffer_byte,
-                                          ColormanageProcessor *cm_processor)
+                                          ColormanageProcessor *cm_processor,
+                                          const DisplayLUT *lut,
+                                          float lut_exposure_scale,
+                                          const rcti *rect)
 {
   DisplayBufferInitData init_data;
 
   init_data.ibuf = ibuf;
   init_data.cm_processor = cm_processor;
+  init_data.lut = lut;
+  init_data.lut_exposure_scale = lut_exposure_scale;
   init_data.buffer = buffer;
   init_data.byte_buffer = byte_buffer;
   init_data.display_buffer = display_buffer;
   init_data.display_buffer_byte = display_buffer_byte;
 
+  if (rect) {
+    init_data.rect = *rect;
+  }
+  else {
+    BLI_rcti_init(&init_data.rect, 0, ibuf->x, 0, ibuf->y);
+  }
+
   if (ibuf->rect_colorspace != nullptr) {
     init_data.byte_colorspace = ibuf->rect_colorspace->name;
   }
@@ -2313,7 +2831,7 @@ static void display_buffer_apply_threaded(ImBuf *ibuf,
     init_data.float_colorspace = nullptr;
   }
 
-  IMB_processor_apply_threaded(ibuf->y,
+  IMB_processor_apply_threaded(BLI_rcti_size_y(&init_data.rect),
                                sizeof(DisplayBufferThread),
                                &init_data,
                                display_buffer_init_handle,
@@ -2342,14 +2860,19 @@ static bool is_ibuf_rect_in_display_space(ImBuf *ibuf,
   return false;
 }
 
+/**
+ * \param rect: Region of the image to transform (max exclusive), the whole image when null.
+ */
 static void colormanage_display_buffer_process_ex(
     ImBuf *ibuf,
     float *display_buffer,
     uchar *display_buffer_byte,
     const ColorManagedViewSettings *view_settings,
-    const ColorManagedDisplaySettings *display_settings)
+    const ColorManagedDisplaySettings *display_settings,
+    const rcti *rect)
 {
   ColormanageProcessor *cm_processor = nullptr;
+  DisplayLUT *lut = nullptr;
   bool skip_transform = false;
 
   /* if we're going to transform byte buffer, check whether transformation would
@@ -2365,12 +2888,30 @@ static void colormanage_display_buffer_process_ex(
     cm_processor = IMB_colormanagement_display_processor_new(view_settings, display_settings);
   }
 
+  /* Byte output is transformed with a LUT, baked when there are more pixels than LUT points. */
+  if (cm_processor && !cm_processor->is_data_result && display_buffer == nullptr &&
+      display_buffer_byte && ELEM(ibuf->channels, 3, 4) &&
+      (ibuf->colormanage_flag & IMB_COLORMANAGE_IS_DATA) == 0 &&
+      display_lut_supported(view_settings))
+  {
+    const size_t pixels_num = rect ? size_t(BLI_rcti_size_x(rect)) * BLI_rcti_size_y(rect) :
+                                     size_t(ibuf->x) * ibuf->y;
+    lut = display_lut_acquire(view_settings, display_settings, pixels_num >= DISPLAY_LUT_LEN);
+  }
+
   display_buffer_apply_threaded(ibuf,
                                 ibuf->rect_float,
                                 (uchar *)ibuf->rect,
                                 display_buffer,
                                 display_buffer_byte,
-                                cm_processor);
+                                cm_processor,
+                                lut,
+                                lut ? display_lut_exposure_scale(view_settings) : 1.0f,
+                                rect);
+
+  if (lut) {
+    display_lut_release(lut);
+  }
 
   if (cm_processor) {
     IMB_colormanagement_processor_free(cm_processor);
@@ -2380,10 +2921,86 @@ static void colormanage_display_buffer_process_ex(
 static void colormanage_display_buffer_process(ImBuf *ibuf,
                                                uchar *display_buffer,
                                                const ColorManagedViewSettings *view_settings,
-                                               const ColorManagedDisplaySettings *display_settings)
+                                               const ColorManagedDisplaySettings *display_settings,
+                                               const rcti *rect)
 {
   colormanage_display_buffer_process_ex(
-      ibuf, nullptr, display_buffer, view_settings, display_settings);
+      ibuf, nullptr, display_buffer, view_settings, display_settings, rect);
+}
+
+/**
+ * Transform the tiles of a cached display buffer overlapping `region` (the whole image when
+ * null) that weren't transformed yet. Rows of tiles with the same range to transform are
+ * merged, so transforming the whole buffer is a single threaded pass.
+ */
+static void colormanage_display_buffer_tiles_update(
+    ImBuf *ibuf,
+    uchar *display_buffer,
+    ColormanageCacheData *cache_data,
+    const rcti *region,
+    const ColorManagedViewSettings *view_settings,
+    const ColorManagedDisplaySettings *display_settings)
+{
+  const int tile_size = DISPLAY_BUFFER_TILE_SIZE;
+  rcti tiles;
+
+  if (region) {
+    tiles.xmin = max_ii(region->xmin, 0) / tile_size;
+    tiles.ymin = max_ii(region->ymin, 0) / tile_size;
+    tiles.xmax = min_ii((region->xmax + tile_size - 1) / tile_size, cache_data->tiles_x);
+    tiles.ymax = min_ii((region->ymax + tile_size - 1) / tile_size, cache_data->tiles_y);
+  }
+  else {
+    BLI_rcti_init(&tiles, 0, cache_data->tiles_x, 0, cache_data->tiles_y);
+  }
+
+  if (tiles.xmin >= tiles.xmax || tiles.ymin >= tiles.ymax) {
+    return;
+  }
+
+  /* Tiles of the pending rectangle to transform. */
+  rcti pending;
+  BLI_rcti_init(&pending, 0, 0, 0, 0);
+
+  for (int tile_y = tiles.ymin; tile_y <= tiles.ymax; tile_y++) {
+    int xmin = 0, xmax = 0;
+
+    if (tile_y < tiles.ymax) {
+      const uchar *tiles_done = cache_data->tiles_done + size_t(tile_y) * cache_data->tiles_x;
+
+      for (xmin = tiles.xmin; xmin < tiles.xmax && tiles_done[xmin]; xmin++) {
+        /* Pass. */
+      }
+      for (xmax = tiles.xmax; xmax > xmin && tiles_done[xmax - 1]; xmax--) {
+        /* Pass. */
+      }
+    }
+
+    if (pending.ymin != pending.ymax && pending.xmin == xmin && pending.xmax == xmax) {
+      pending.ymax = tile_y + 1;
+      continue;
+    }
+
+    if (pending.xmin != pending.xmax && pending.ymin != pending.ymax) {
+      rcti rect;
+      BLI_rcti_init(&rect,
+                    pending.xmin * tile_size,
+                    min_ii(pending.xmax * tile_size, ibuf->x),
+                    pending.ymin * tile_size,
+                    min_ii(pending.ymax * tile_size, ibuf->y));
+
+      colormanage_display_buffer_process(
+          ibuf, display_buffer, view_settings, display_settings, &rect);
+
+      for (int y = pending.ymin; y < pending.ymax; y++) {
+        memset(cache_data->tiles_done + size_t(y) * cache_data->tiles_x + pending.xmin,
+               1,
+               pending.xmax - pending.xmin);
+      }
+    }
+
+    BLI_rcti_init(&pending, xmin, xmax, tile_y, tile_y + 1);
+  }
 }
 
 /* -------------------------------------------------------------------- */
@@ -3066,7 +3683,7 @@ static void colormanagement_imbuf_make_display_space(
   }
 
   colormanage_display_buffer_process_ex(
-      ibuf, ibuf->rect_float, (uchar *)ibuf->rect, view_settings, display_settings);
+      ibuf, ibuf->rect_float, (uchar *)ibuf->rect, view_settings, display_settings, nullptr);
 }
 
 void IMB_colormanagement_imbuf_make_display_space(
@@ -3257,10 +3874,11 @@ ImBuf *IMB_colormanagement_imbuf_for_write(ImBuf *ibuf,
 /** \name Public Display Buffers Interfaces
  * \{ */
 
-uchar *IMB_display_buffer_acquire(ImBuf *ibuf,
-                                  const ColorManagedViewSettings *view_settings,
-                                  const ColorManagedDisplaySettings *display_settings,
-                                  void **cache_handle)
+uchar *IMB_display_buffer_acquire_region(ImBuf *ibuf,
+                                         const ColorManagedViewSettings *view_settings,
+                                         const ColorManagedDisplaySettings *display_settings,
+                                         const rcti *region,
+                                         void **cache_handle)
 {
   uchar *display_buffer;
   size_t buffer_size;
@@ -3335,25 +3953,35 @@ uchar *IMB_display_buffer_acquire(ImBuf *ibuf,
   display_buffer = colormanage_cache_get(
       ibuf, &cache_view_settings, &cache_display_settings, cache_handle);
 
-  if (display_buffer) {
-    BLI_thread_unlock(LOCK_COLORMANAGE);
-    return display_buffer;
-  }
-
-  buffer_size = DISPLAY_BUFFER_CHANNELS * size_t(ibuf->x) * ibuf->y * sizeof(char);
-  display_buffer = static_cast<uchar *>(MEM_callocN(buffer_size, "imbuf display buffer"));
+  if (display_buffer == nullptr) {
+    buffer_size = DISPLAY_BUFFER_CHANNELS * size_t(ibuf->x) * ibuf->y * sizeof(char);
+    display_buffer = static_cast<uchar *>(MEM_callocN(buffer_size, "imbuf display buffer"));
 
-  colormanage_display_buffer_process(
-      ibuf, display_buffer, applied_view_settings, display_settings);
+    colormanage_cache_put(
+        ibuf, &cache_view_settings, &cache_display_settings, display_buffer, cache_handle);
+  }
 
-  colormanage_cache_put(
-      ibuf, &cache_view_settings, &cache_display_settings, display_buffer, cache_handle);
+  colormanage_display_buffer_tiles_update(ibuf,
+                                          display_buffer,
+                                          colormanage_cachedata_get((ImBuf *)*cache_handle),
+                                          region,
+                                          applied_view_settings,
+                                          display_settings);
 
   BLI_thread_unlock(LOCK_COLORMANAGE);
 
   return display_buffer;
 }
 
+uchar *IMB_display_buffer_acquire(ImBuf *ibuf,
+                                  const ColorManagedViewSettings *view_settings,
+                                  const ColorManagedDisplaySettings *display_settings,
+                                  void **cache_handle)
+{
+  return IMB_display_buffer_acquire_region(
+      ibuf, view_settings, display_settings, nullptr, cache_handle);
+}
+
 uchar *IMB_display_buffer_acquire_ctx(const bContext *C, ImBuf *ibuf, void **cache_handle)
 {
   ColorManagedViewSettings *view_settings;
@@ -0,0 +1,163 @@
+#include "testing/testing.h"
+
+#include "types_color.h"
+
+#include "imbuf_colormanagement.h"
+#include "imbuf_colormanagement_ex.h"
+#include "imbuf_colormanagement_intern.h"
+
+#include "mem_guardedalloc.h"
+
+#include "dune_colortools.h"
+
+#include "lib_listbase.h"
+#include "lib_math_base.h"
+#include "lib_string.h"
+
+namespace dune::imbuf::tests {
+
+/* Values per axis of the grid of colors the LUT is compared with the processor on. */
+#define GRID_SIZE 40
+/* The LUT is precise enough for 8 bit output. */
+#define DISPLAY_LUT_MAX_ERROR (0.5f / 255.0f)
+
+class ColormanagementTest : public testing::Test {
+ public:
+  void SetUp() override
+  {
+    colormanagement_init();
+  }
+
+  void TearDown() override
+  {
+    colormanagement_exit();
+  }
+};
+
+/* Values from black to beyond white, spaced by stops, on and off the points of the LUT, with a
+ * few out of its range that use the processor. */
+static float grid_value(const int i)
+{
+  if (i == 0) {
+    return 0.0f;
+  }
+  if (i == GRID_SIZE - 1) {
+    return 1000.0f;
+  }
+  if (i == GRID_SIZE - 2) {
+    return -0.1f;
+  }
+  return powf(2.0f, -10.0f + 11.0f * float(i - 1) / float(GRID_SIZE - 4));
+}
+
+static float *grid_buffer_new(const int channels, const float alpha)
+{
+  const int pixels_num = GRID_SIZE * GRID_SIZE * GRID_SIZE;
+  float *buffer = static_cast<float *>(
+      MEM_mallocN(sizeof(float) * channels * pixels_num, "display LUT test buffer"));
+  float *fp = buffer;
+  for (int r = 0; r < GRID_SIZE; r++) {
+    for (int g = 0; g < GRID_SIZE; g++) {
+      for (int b = 0; b < GRID_SIZE; b++, fp += channels) {
+        fp[0] = grid_value(r) * alpha;
+        fp[1] = grid_value(g) * alpha;
+        fp[2] = grid_value(b) * alpha;
+        if (channels == 4) {
+          fp[3] = alpha;
+        }
+      }
+    }
+  }
+  return buffer;
+}
+
+/* Compare the LUT with the processor on colors displayed in 8 bits, clamped to [0, alpha]. */
+static void test_display_lut(const ColorManagedViewSettings *view_settings,
+                             const ColorManagedDisplaySettings *display_settings,
+                             const int channels,
+                             const float alpha)
+{
+  const int width = GRID_SIZE * GRID_SIZE, height = GRID_SIZE;
+  const bool predivide = channels == 4;
+  float *buffer = grid_buffer_new(channels, alpha);
+  float *buffer_lut = grid_buffer_new(channels, alpha);
+
+  ColormanageProcessor *cm_processor = IMB_colormanagement_display_processor_new(view_settings,
+                                                                                 display_settings);
+  IMB_colormanagement_processor_apply(cm_processor, buffer, width, height, channels, predivide);
+  IMB_colormanagement_processor_free(cm_processor);
+
+  ASSERT_TRUE(IMB_colormanagement_display_lut_apply(
+      buffer_lut, width, height, channels, predivide, view_settings, display_settings));
+
+  float error_max = 0.0f;
+  int error_max_i = 0;
+  for (int i = 0; i < width * height * channels; i++) {
+    if (channels == 4 && i % 4 == 3) {
+      EXPECT_EQ(buffer_lut[i], buffer[i]);
+      continue;
+    }
+    const float error = fabsf(clamp_f(buffer_lut[i], 0.0f, alpha) -
+                              clamp_f(buffer[i], 0.0f, alpha));
+    if (error > error_max) {
+      error_max = error;
+      error_max_i = i;
+    }
+  }
+  EXPECT_LE(error_max, DISPLAY_LUT_MAX_ERROR * alpha)
+      << "view " << view_settings->view_transform << ", channel " << error_max_i % channels
+      << " of pixel " << error_max_i / channels;
+
+  MEM_freeN(buffer_lut);
+  MEM_freeN(buffer);
+}
+
+TEST_F(ColormanagementTest, DisplayLUTMatchesProcessor)
+{
+  ColorManagedDisplay *display = colormanage_display_get_default();
+  ASSERT_NE(display, nullptr);
+
+  ColorManagedDisplaySettings display_settings = {{0}};
+  STRNCPY(display_settings.display_device, display->name);
+
+  LISTBASE_FOREACH (LinkData *, link, &display->views) {
+    const ColorManagedView *view = static_cast<const ColorManagedView *>(link->data);
+    ColorManagedViewSettings view_settings = {0};
+    IMB_colormanagement_init_default_view_settings(&view_settings, &display_settings);
+    STRNCPY(view_settings.view_transform, view->name);
+
+    test_display_lut(&view_settings, &display_settings, 3, 1.0f);
+    test_display_lut(&view_settings, &display_settings, 4, 0.5f);
+
+    /* The exposure scales pixels before the lookup, the LUT is baked without it. */
+    for (const float exposure : {1.5f, -3.0f}) {
+      view_settings.exposure = exposure;
+      test_display_lut(&view_settings, &display_settings, 4, 1.0f);
+    }
+  }
+}
+
+TEST_F(ColormanagementTest, DisplayLUTNotBaked)
+{
+  ColorManagedDisplaySettings display_settings = {{0}};
+  STRNCPY(display_settings.display_device, colormanage_display_get_default_name());
+  ColorManagedViewSettings view_settings = {0};
+  IMB_colormanagement_init_default_view_settings(&view_settings, &display_settings);
+  view_settings.flag |= COLORMANAGE_VIEW_USE_CURVES;
+  view_settings.curve_mapping = dune_curvemapping_add(4, 0.0f, 0.0f, 1.0f, 1.0f);
+
+  float rgb[3] = {0.2f, 0.4f, 0.6f};
+  EXPECT_FALSE(IMB_colormanagement_display_lut_apply(
+      rgb, 1, 1, 3, false, &view_settings, &display_settings));
+  EXPECT_EQ(rgb[0], 0.2f);
+
+  dune_curvemapping_free(view_settings.curve_mapping);
+  view_settings.curve_mapping = nullptr;
+  view_settings.flag &= ~COLORMANAGE_VIEW_USE_CURVES;
+  view_settings.gamma = 0.8f;
+  EXPECT_FALSE(IMB_colormanagement_display_lut_apply(
+      rgb, 1, 1, 3, false, &view_settings, &display_settings));
+  EXPECT_EQ(rgb[0], 0.2f);
+}
+
+}  // namespace dune::imbuf::tests
@@ -59,6 +59,7 @@ extern "C" {
 
 #define MAXNUMSTREAMS 50
 
+struct AnimDecoder;
 struct IDProperty;
 struct _AviMovie;
 struct anim_index;
@@ -120,6 +121,11 @@ struct anim {
   AVPacket *cur_packet;
 
   bool seek_before_decode;
+  /* Position of the last decoded frame, in the decoder thread once there is one
+   * (the fetched position is `cur_position`). */
+  int decode_position;
+  /* Decoder thread, decoding frames around the fetched one (see #ffmpeg_fetchibuf). */
+  struct AnimDecoder *decoder;
 #endif
 
   char index_dir[768];
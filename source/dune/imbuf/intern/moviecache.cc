@@ -0,0 +1,960 @@
+/* Cache of ImBufs of movie clips, images, sequencer, color management... shared in one memory
+ * budget (#MEM_CacheLimiter_get_maximum).
+ *
+ * Items of all caches are spread over #MOVIECACHE_SHARDS shards by the hash of their key, each
+ * with its own lock, so threads putting & evicting items of different frames rarely wait on each
+ * other. Look-ups only lock the cache they look in.
+ *
+ * Eviction is CLOCK based: items accessed since the hand of their shard last passed them get
+ * another chance. Of the items the hand of a shard stops at, the one with the lowest priority
+ * (#imbuf_moviecache_set_priority_cb) or least frequently accessed recently (estimated with a
+ * TinyLFU count-min sketch per shard) is its victim. Each shard publishes the frequency of its
+ * victim, so the shard to evict from is chosen without locking the others. Optional puts
+ * (#imbuf_moviecache_put_if_possible) of frames used less often than that victim are refused,
+ * otherwise the victim is evicted for them.
+ *
+ * Items are measured again when they're looked up or are eviction candidates, as their ImBufs
+ * may gain buffers after they were put (mipmaps, float or byte buffers).
+ *
+ * Locking: a shard lock is taken before a cache lock, never the other way around. An item is in
+ * the hash of its cache and in the ring of its shard at the same time, both are changed with
+ * both locks held. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_guardedalloc.h"
+
+#include "MEM_CacheLimiter.h"
+
+#include "lib_ghash.h"
+#include "lib_math_base.h"
+#include "lib_string.h"
+#include "lib_threads.h"
+#include "lib_utildefines.h"
+
+#include "atomic_ops.h"
+
+#include "imbuf.h"
+#include "imbuf_moviecache.h"
+#include "imbuf_types.h"
+
+/* Number of shards, a power of two. */
+#define MOVIECACHE_SHARDS 16
+/* Words of 8 4-bit counters of the frequency sketch of a shard. */
+#define MOVIECACHE_SKETCH_LEN 512
+/* Number of accesses after which the counters of a sketch are halved, aging the frequencies. */
+#define MOVIECACHE_SKETCH_SAMPLE (MOVIECACHE_SKETCH_LEN * 8)
+/* Number of eviction candidates of a sweep of the CLOCK hand. */
+#define MOVIECACHE_EVICT_SAMPLE 4
+/* Victim frequency of a shard without evictable items, higher than any sketch estimate. */
+#define MOVIECACHE_NO_VICTIM 0x10
+
+struct MovieCacheItem {
+  struct MovieCache *cache;
+  ImBuf *ibuf;
+  void *priority_data;
+  /* Key of the item, allocated with it. */
+  void *userkey;
+  /* Memory counted for the item in the budget, updated atomically. */
+  size_t size;
+  /* Mixed hash of the key, selecting the shard & sketch counters. */
+  uint hash;
+  /* One for the item being in the cache, one for each pin (#moviecache_item_pin). */
+  uint32_t refs;
+  /* Accessed since the CLOCK hand last passed the item. */
+  uint8_t referenced;
+  bool in_cache;
+  MovieCacheItem *prev, *next;
+};
+
+struct MovieCache {
+  char name[64];
+
+  ThreadMutex mutex;
+  GHash *hash;
+  GHashHashFP hashfp;
+  GHashCmpFP cmpfp;
+  int keysize;
+  /* Seed of the hashes of the keys, so caches with the same keys use different shards. */
+  uint seed;
+
+  MovieCacheGetKeyDataFP getdatafp;
+
+  MovieCacheGetPriorityDataFP getprioritydatafp;
+  MovieCacheGetItemPriorityFP getitempriorityfp;
+  MovieCachePriorityDeleterFP prioritydeleterfp;
+  void *last_userkey;
+
+  /* Segments of cached frames (#imbuf_moviecache_get_cache_segments). */
+  int totseg, *points, proxy, render_flags;
+  bool points_valid;
+};
+
+struct MovieCacheSketch {
+  uint32_t words[MOVIECACHE_SKETCH_LEN];
+  uint32_t additions;
+};
+
+struct MovieCacheShard {
+  ThreadMutex mutex;
+  /* Ring of the items, the hand is the next item to look at for eviction. */
+  MovieCacheItem *hand;
+  /* Memory counted for the items of the shard, updated atomically. */
+  size_t mem_in_use;
+  /* Frequency of the victim of the shard when it was last looked for, zero once the shard
+   * changed, so it's looked at again (see #moviecache_victim_peek). Updated atomically. */
+  int32_t victim_frequency;
+  /* Not locked, updated atomically. */
+  MovieCacheSketch sketch;
+};
+
+struct MovieCacheIterItem {
+  MovieCacheItem *item;
+  ImBuf *ibuf;
+};
+
+struct MovieCacheIter {
+  MovieCacheIterItem *items;
+  int len;
+  int index;
+};
+
+static MovieCacheShard *moviecache_shards = nullptr;
+static ThreadMutex moviecache_shards_lock = LIB_MUTEX_INITIALIZER;
+static uint32_t moviecache_seed = 0;
+static uint32_t moviecache_evict_shard = 0;
+
+static size_t moviecache_mem_in_use = 0;
+static MovieCacheStats moviecache_stats;
+
+/* -------------------------------------------------------------------- */
+/** \name Hashing & Frequency Sketch
+ * \{ */
+
+static uint moviecache_hash_mix(uint h)
+{
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+static uint moviecache_key_hash(const MovieCache *cache, const void *userkey)
+{
+  return moviecache_hash_mix(cache->hashfp(userkey) ^ cache->seed);
+}
+
+static MovieCacheShard *moviecache_shard_get(uint hash)
+{
+  return &moviecache_shards[hash >> 28];
+}
+
+/* Counter of `row` of the sketch for `hash`: its word & the shift of its 4 bits in it. */
+static uint32_t *moviecache_sketch_counter(MovieCacheSketch *sketch,
+                                           uint hash,
+                                           int row,
+                                           int *r_shift)
+{
+  static const uint seeds[4] = {0x97cb3127u, 0xb492b66fu, 0x9ae16a3bu, 0xc3a5c85cu};
+  const uint h = moviecache_hash_mix(hash * seeds[row]);
+  *r_shift = int(h & 7) * 4;
+  return &sketch->words[(h >> 3) % MOVIECACHE_SKETCH_LEN];
+}
+
+static void moviecache_sketch_age(MovieCacheSketch *sketch)
+{
+  for (int i = 0; i < MOVIECACHE_SKETCH_LEN; i++) {
+    uint32_t word = sketch->words[i];
+    uint32_t prev;
+    while ((prev = atomic_cas_uint32(&sketch->words[i], word, (word >> 1) & 0x77777777u)) !=
+           word) {
+      word = prev;
+    }
+  }
+}
+
+static void moviecache_sketch_increment(MovieCacheSketch *sketch, uint hash)
+{
+  for (int row = 0; row < 4; row++) {
+    int shift;
+    uint32_t *word = moviecache_sketch_counter(sketch, hash, row, &shift);
+    uint32_t value = *word;
+    while (((value >> shift) & 0xf) != 0xf) {
+      const uint32_t prev = atomic_cas_uint32(word, value, value + (1u << shift));
+      if (prev == value) {
+        break;
+      }
+      value = prev;
+    }
+  }
+
+  if (atomic_add_and_fetch_uint32(&sketch->additions, 1) == MOVIECACHE_SKETCH_SAMPLE) {
+    moviecache_sketch_age(sketch);
+    atomic_sub_and_fetch_uint32(&sketch->additions, MOVIECACHE_SKETCH_SAMPLE / 2);
+  }
+}
+
+static int moviecache_sketch_estimate(MovieCacheSketch *sketch, uint hash)
+{
+  int frequency = 0xf;
+  for (int row = 0; row < 4; row++) {
+    int shift;
+    const uint32_t *word = moviecache_sketch_counter(sketch, hash, row, &shift);
+    frequency = min_ii(frequency, int((*word >> shift) & 0xf));
+  }
+  return frequency;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Items
+ * \{ */
+
+static void moviecache_item_pin(MovieCacheItem *item)
+{
+  atomic_add_and_fetch_uint32(&item->refs, 1);
+}
+
+static void moviecache_item_unpin(MovieCacheItem *item)
+{
+  if (atomic_sub_and_fetch_uint32(&item->refs, 1) == 0) {
+    mem_freen(item);
+  }
+}
+
+static size_t moviecache_item_size(const MovieCache *cache, ImBuf *ibuf)
+{
+  size_t size = sizeof(MovieCacheItem) + size_t(cache->keysize);
+  if (ibuf) {
+    size += imbuf_get_size_in_memory(ibuf);
+  }
+  return size;
+}
+
+static void moviecache_mem_in_use_add(MovieCacheShard *shard, const size_t size)
+{
+  atomic_add_and_fetch_z(&shard->mem_in_use, size);
+  atomic_add_and_fetch_z(&moviecache_mem_in_use, size);
+}
+
+static void moviecache_mem_in_use_sub(MovieCacheShard *shard, const size_t size)
+{
+  atomic_sub_and_fetch_z(&shard->mem_in_use, size);
+  atomic_sub_and_fetch_z(&moviecache_mem_in_use, size);
+}
+
+/* Measure `item` again, its ImBuf may have gained buffers. The item is in its cache, with the
+ * cache or the shard locked. */
+static void moviecache_item_size_update(MovieCacheItem *item)
+{
+  const size_t size = moviecache_item_size(item->cache, item->ibuf);
+  size_t size_prev = atomic_load_z(&item->size);
+  while (size != size_prev) {
+    const size_t prev = atomic_cas_z(&item->size, size_prev, size);
+    if (prev == size_prev) {
+      MovieCacheShard *shard = moviecache_shard_get(item->hash);
+      moviecache_mem_in_use_add(shard, size);
+      moviecache_mem_in_use_sub(shard, size_prev);
+      break;
+    }
+    size_prev = prev;
+  }
+}
+
+/* Add `item` to its cache & shard, both locked. */
+static void moviecache_item_link(MovieCacheShard *shard, MovieCacheItem *item)
+{
+  MovieCache *cache = item->cache;
+
+  lib_ghash_insert(cache->hash, item->userkey, item);
+  item->in_cache = true;
+  cache->points_valid = false;
+
+  /* Insert behind the hand, the item is looked at last. */
+  if (shard->hand) {
+    item->next = shard->hand;
+    item->prev = shard->hand->prev;
+    item->prev->next = item;
+    item->next->prev = item;
+  }
+  else {
+    item->prev = item->next = item;
+    shard->hand = item;
+  }
+
+  moviecache_mem_in_use_add(shard, atomic_load_z(&item->size));
+  atomic_store_int32(&shard->victim_frequency, 0);
+  atomic_add_and_fetch_uint32(&moviecache_stats.items, 1);
+}
+
+/* Remove `item` from its cache & shard, both locked. The item is released with
+ * #moviecache_item_release once the locks are released. */
+static void moviecache_item_unlink(MovieCacheShard *shard, MovieCacheItem *item)
+{
+  MovieCache *cache = item->cache;
+
+  lib_ghash_remove(cache->hash, item->userkey, nullptr, nullptr);
+  item->in_cache = false;
+  cache->points_valid = false;
+
+  if (item->next == item) {
+    shard->hand = nullptr;
+  }
+  else {
+    item->prev->next = item->next;
+    item->next->prev = item->prev;
+    if (shard->hand == item) {
+      shard->hand = item->next;
+    }
+  }
+  item->prev = item->next = nullptr;
+
+  moviecache_mem_in_use_sub(shard, atomic_load_z(&item->size));
+  atomic_store_int32(&shard->victim_frequency, 0);
+  atomic_sub_and_fetch_uint32(&moviecache_stats.items, 1);
+}
+
+static void moviecache_item_release(MovieCacheItem *item,
+                                    MovieCachePriorityDeleterFP prioritydeleterfp)
+{
+  if (item->ibuf) {
+    imbuf_freeImBuf(item->ibuf);
+    item->ibuf = nullptr;
+  }
+  if (item->priority_data && prioritydeleterfp) {
+    prioritydeleterfp(item->priority_data);
+    item->priority_data = nullptr;
+  }
+  moviecache_item_unpin(item);
+}
+
+/* Remove a pinned item from its cache if it's still in it. */
+static void moviecache_item_remove(MovieCacheItem *item)
+{
+  MovieCacheShard *shard = moviecache_shard_get(item->hash);
+  MovieCache *cache = item->cache;
+  bool removed = false;
+
+  lib_mutex_lock(&shard->mutex);
+  lib_mutex_lock(&cache->mutex);
+  if (item->in_cache) {
+    moviecache_item_unlink(shard, item);
+    removed = true;
+  }
+  lib_mutex_unlock(&cache->mutex);
+  lib_mutex_unlock(&shard->mutex);
+
+  if (removed) {
+    moviecache_item_release(item, cache->prioritydeleterfp);
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Eviction
+ * \{ */
+
+static bool moviecache_item_is_evictable(const MovieCacheItem *item)
+{
+  return !(item->ibuf && (item->ibuf->userflags & IB_PERSISTENT));
+}
+
+/* Frequency of the accesses to the key of `item`, estimated by the sketch of its shard. */
+static int moviecache_item_frequency(const MovieCacheItem *item)
+{
+  return moviecache_sketch_estimate(&moviecache_shard_get(item->hash)->sketch, item->hash);
+}
+
+/* Whether `a` is to be evicted before `b`, both of the same locked shard. */
+static bool moviecache_item_evict_before(MovieCacheItem *a, MovieCacheItem *b)
+{
+  MovieCache *cache = a->cache;
+  if (cache == b->cache && cache->getitempriorityfp && cache->last_userkey) {
+    lib_mutex_lock(&cache->mutex);
+    const int priority_a = cache->getitempriorityfp(cache->last_userkey, a->priority_data);
+    const int priority_b = cache->getitempriorityfp(cache->last_userkey, b->priority_data);
+    lib_mutex_unlock(&cache->mutex);
+    if (priority_a != priority_b) {
+      return priority_a < priority_b;
+    }
+  }
+  return moviecache_item_frequency(a) < moviecache_item_frequency(b);
+}
+
+/* Item of the locked shard to evict next, moving the hand past it: of the first items not
+ * accessed since the hand last passed them, the one with the lowest priority or frequency.
+ * With `peek`, the item is found without changing the shard: neither the hand nor the referenced
+ * bits move, so looking at the victim doesn't take the second chance of any item.
+ * The candidates are measured again, the only items the put path measures. */
+static MovieCacheItem *moviecache_shard_victim(MovieCacheShard *shard, const bool peek)
+{
+  MovieCacheItem *candidates[MOVIECACHE_EVICT_SAMPLE];
+  int candidates_num = 0;
+
+  if (shard->hand == nullptr) {
+    return nullptr;
+  }
+
+  /* Two turns at most: all referenced bits are cleared in the first one. */
+  MovieCacheItem *first = shard->hand;
+  MovieCacheItem *hand = shard->hand;
+  int turns = 0;
+  while (candidates_num < MOVIECACHE_EVICT_SAMPLE && turns < 2) {
+    MovieCacheItem *item = hand;
+    const bool is_first_turn = (turns == 0);
+    hand = item->next;
+    if (hand == first) {
+      turns++;
+    }
+
+    if (!moviecache_item_is_evictable(item)) {
+      continue;
+    }
+    if (peek ? (is_first_turn && item->referenced) :
+               atomic_fetch_and_and_uint8(&item->referenced, 0)) {
+      continue;
+    }
+    bool is_candidate = false;
+    for (int i = 0; i < candidates_num; i++) {
+      is_candidate |= candidates[i] == item;
+    }
+    if (!is_candidate) {
+      moviecache_item_size_update(item);
+      candidates[candidates_num++] = item;
+    }
+  }
+
+  if (!peek) {
+    shard->hand = hand;
+  }
+
+  MovieCacheItem *victim = nullptr;
+  for (int i = 0; i < candidates_num; i++) {
+    if (victim == nullptr || moviecache_item_evict_before(candidates[i], victim)) {
+      victim = candidates[i];
+    }
+  }
+  return victim;
+}
+
+/* Item to evict next, pinned, or null when no item can be evicted: the victim of the shard with
+ * the lowest published victim frequency, the one holding the most memory of those. Only that
+ * shard is locked. When its victim turns out to be accessed more frequently than published (it
+ * was looked up since, or the shard changed), the frequency is corrected and the shards are
+ * compared again. No shard is changed, the victim is evicted with #moviecache_evict. */
+static MovieCacheItem *moviecache_victim_peek(void)
+{
+  for (int attempt = 0; attempt < MOVIECACHE_SHARDS; attempt++) {
+    MovieCacheShard *shard = nullptr;
+    int32_t shard_frequency = MOVIECACHE_NO_VICTIM;
+    size_t shard_mem_in_use = 0;
+
+    /* Start at another shard each time, spreading evictions of equally frequent items. */
+    const uint32_t first = atomic_fetch_and_add_uint32(&moviecache_evict_shard, 1);
+    for (int i = 0; i < MOVIECACHE_SHARDS; i++) {
+      MovieCacheShard *other = &moviecache_shards[(first + uint32_t(i)) % MOVIECACHE_SHARDS];
+      const int32_t frequency = atomic_load_int32(&other->victim_frequency);
+      const size_t mem_in_use = atomic_load_z(&other->mem_in_use);
+      if (frequency < shard_frequency ||
+          (frequency == shard_frequency && mem_in_use > shard_mem_in_use))
+      {
+        shard = other;
+        shard_frequency = frequency;
+        shard_mem_in_use = mem_in_use;
+      }
+    }
+    if (shard == nullptr) {
+      return nullptr;
+    }
+
+    lib_mutex_lock(&shard->mutex);
+    MovieCacheItem *victim = moviecache_shard_victim(shard, true);
+    const int32_t frequency = victim ? moviecache_item_frequency(victim) : MOVIECACHE_NO_VICTIM;
+    atomic_store_int32(&shard->victim_frequency, frequency);
+    /* Accept the victim of the last attempt, the others may keep changing. */
+    if (victim && (frequency <= shard_frequency || attempt == MOVIECACHE_SHARDS - 1)) {
+      moviecache_item_pin(victim);
+      lib_mutex_unlock(&shard->mutex);
+      return victim;
+    }
+    lib_mutex_unlock(&shard->mutex);
+  }
+  return nullptr;
+}
+
+/* Evict & unpin the `victim` of #moviecache_victim_peek, moving the hand of its shard as if it
+ * had been found by it. Returns false when the victim was removed from its cache meanwhile. */
+static bool moviecache_evict(MovieCacheItem *victim)
+{
+  MovieCacheShard *shard = moviecache_shard_get(victim->hash);
+  MovieCachePriorityDeleterFP prioritydeleterfp = nullptr;
+  bool removed = false;
+
+  lib_mutex_lock(&shard->mutex);
+  moviecache_shard_victim(shard, false);
+  if (victim->in_cache) {
+    MovieCache *cache = victim->cache;
+    prioritydeleterfp = cache->prioritydeleterfp;
+    lib_mutex_lock(&cache->mutex);
+    moviecache_item_unlink(shard, victim);
+    lib_mutex_unlock(&cache->mutex);
+    removed = true;
+  }
+  lib_mutex_unlock(&shard->mutex);
+
+  if (removed) {
+    moviecache_item_release(victim, prioritydeleterfp);
+    atomic_add_and_fetch_uint64(&moviecache_stats.evictions, 1);
+  }
+  moviecache_item_unpin(victim);
+  return removed;
+}
+
+/* Evict items until the memory in use is in the budget, or no item can be evicted. */
+static void moviecache_enforce_budget(void)
+{
+  if (MEM_CacheLimiter_is_disabled()) {
+    return;
+  }
+
+  const size_t mem_limit = MEM_CacheLimiter_get_maximum();
+  while (atomic_load_z(&moviecache_mem_in_use) > mem_limit) {
+    MovieCacheItem *victim = moviecache_victim_peek();
+    if (victim == nullptr) {
+      break;
+    }
+    moviecache_evict(victim);
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cache API
+ * \{ */
+
+void imbuf_moviecache_init(void)
+{
+  lib_mutex_lock(&moviecache_shards_lock);
+  if (moviecache_shards == nullptr) {
+    moviecache_shards = static_cast<MovieCacheShard *>(
+        mem_callocn(sizeof(MovieCacheShard) * MOVIECACHE_SHARDS, "MovieCache shards"));
+    for (int i = 0; i < MOVIECACHE_SHARDS; i++) {
+      lib_mutex_init(&moviecache_shards[i].mutex);
+    }
+  }
+  lib_mutex_unlock(&moviecache_shards_lock);
+}
+
+void imbuf_moviecache_destruct(void)
+{
+  lib_mutex_lock(&moviecache_shards_lock);
+  if (moviecache_shards != nullptr) {
+    for (int i = 0; i < MOVIECACHE_SHARDS; i++) {
+      lib_mutex_end(&moviecache_shards[i].mutex);
+    }
+    MEM_SAFE_FREE(moviecache_shards);
+  }
+  lib_mutex_unlock(&moviecache_shards_lock);
+}
+
+MovieCache *imbuf_moviecache_create(const char *name,
+                                    int keysize,
+                                    GHashHashFP hashfp,
+                                    GHashCmpFP cmpfp)
+{
+  imbuf_moviecache_init();
+
+  MovieCache *cache = static_cast<MovieCache *>(mem_callocn(sizeof(MovieCache), "MovieCache"));
+
+  lib_strncpy(cache->name, name, sizeof(cache->name));
+  lib_mutex_init(&cache->mutex);
+  cache->hash = lib_ghash_new(hashfp, cmpfp, "MovieCache ImBuf hash");
+  cache->hashfp = hashfp;
+  cache->cmpfp = cmpfp;
+  cache->keysize = keysize;
+  cache->seed = moviecache_hash_mix(atomic_add_and_fetch_uint32(&moviecache_seed, 1));
+  cache->proxy = -1;
+
+  return cache;
+}
+
+void imbuf_moviecache_set_getdata_cb(MovieCache *cache, MovieCacheGetKeyDataFP getdatafp)
+{
+  cache->getdatafp = getdatafp;
+}
+
+void imbuf_moviecache_set_priority_cb(MovieCache *cache,
+                                      MovieCacheGetPriorityDataFP getprioritydatafp,
+                                      MovieCacheGetItemPriorityFP getitempriorityfp,
+                                      MovieCachePriorityDeleterFP prioritydeleterfp)
+{
+  cache->last_userkey = mem_mallocn(cache->keysize, "movie cache last user key");
+
+  cache->getprioritydatafp = getprioritydatafp;
+  cache->getitempriorityfp = getitempriorityfp;
+  cache->prioritydeleterfp = prioritydeleterfp;
+}
+
+void imbuf_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf)
+{
+  const size_t size = moviecache_item_size(cache, ibuf);
+  MovieCacheItem *item = static_cast<MovieCacheItem *>(
+      mem_callocn(sizeof(MovieCacheItem) + size_t(cache->keysize), "MovieCache item"));
+
+  if (ibuf) {
+    imbuf_refImBuf(ibuf);
+  }
+  item->cache = cache;
+  item->ibuf = ibuf;
+  item->userkey = item + 1;
+  memcpy(item->userkey, userkey, cache->keysize);
+  item->size = size;
+  item->hash = moviecache_key_hash(cache, userkey);
+  item->refs = 1;
+  /* Give the new item a turn of the hand before it can be evicted. */
+  item->referenced = 1;
+  if (cache->getprioritydatafp) {
+    item->priority_data = cache->getprioritydatafp(userkey);
+  }
+
+  MovieCacheShard *shard = moviecache_shard_get(item->hash);
+  lib_mutex_lock(&shard->mutex);
+  lib_mutex_lock(&cache->mutex);
+
+  MovieCacheItem *old_item = static_cast<MovieCacheItem *>(lib_ghash_lookup(cache->hash, userkey));
+  if (old_item) {
+    moviecache_item_unlink(shard, old_item);
+  }
+  moviecache_item_link(shard, item);
+  if (cache->last_userkey) {
+    memcpy(cache->last_userkey, userkey, cache->keysize);
+  }
+
+  lib_mutex_unlock(&cache->mutex);
+  lib_mutex_unlock(&shard->mutex);
+
+  if (old_item) {
+    moviecache_item_release(old_item, cache->prioritydeleterfp);
+  }
+  atomic_add_and_fetch_uint64(&moviecache_stats.puts, 1);
+
+  moviecache_enforce_budget();
+}
+
+bool imbuf_moviecache_put_if_possible(MovieCache *cache, void *userkey, ImBuf *ibuf)
+{
+  if (!MEM_CacheLimiter_is_disabled()) {
+    const size_t size = moviecache_item_size(cache, ibuf);
+    const size_t mem_limit = MEM_CacheLimiter_get_maximum();
+
+    if (atomic_load_z(&moviecache_mem_in_use) + size > mem_limit) {
+      /* Only take the place of the next victim when accessed more frequently, evicting it. */
+      MovieCacheItem *victim = (size <= mem_limit) ? moviecache_victim_peek() : nullptr;
+      const uint hash = moviecache_key_hash(cache, userkey);
+      if (victim == nullptr ||
+          moviecache_sketch_estimate(&moviecache_shard_get(hash)->sketch, hash) <=
+              moviecache_item_frequency(victim)) {
+        if (victim) {
+          moviecache_item_unpin(victim);
+        }
+        atomic_add_and_fetch_uint64(&moviecache_stats.rejected, 1);
+        return false;
+      }
+      moviecache_evict(victim);
+    }
+  }
+
+  imbuf_moviecache_put(cache, userkey, ibuf);
+  return true;
+}
+
+ImBuf *imbuf_moviecache_get(MovieCache *cache, void *userkey, bool *r_is_cached_empty)
+{
+  ImBuf *ibuf = nullptr;
+  bool found = false;
+
+  if (r_is_cached_empty) {
+    *r_is_cached_empty = false;
+  }
+
+  lib_mutex_lock(&cache->mutex);
+  MovieCacheItem *item = static_cast<MovieCacheItem *>(lib_ghash_lookup(cache->hash, userkey));
+  if (item) {
+    found = true;
+    atomic_fetch_and_or_uint8(&item->referenced, 1);
+    moviecache_item_size_update(item);
+    if (item->ibuf) {
+      ibuf = item->ibuf;
+      imbuf_refImBuf(ibuf);
+    }
+    else if (r_is_cached_empty) {
+      *r_is_cached_empty = true;
+    }
+  }
+  lib_mutex_unlock(&cache->mutex);
+
+  /* Misses are counted too, for the frequency of a frame to be known when it's put. */
+  const uint hash = moviecache_key_hash(cache, userkey);
+  moviecache_sketch_increment(&moviecache_shard_get(hash)->sketch, hash);
+  atomic_add_and_fetch_uint64(found ? &moviecache_stats.hits : &moviecache_stats.misses, 1);
+
+  return ibuf;
+}
+
+void imbuf_moviecache_remove(MovieCache *cache, void *userkey)
+{
+  MovieCacheShard *shard = moviecache_shard_get(moviecache_key_hash(cache, userkey));
+
+  lib_mutex_lock(&shard->mutex);
+  lib_mutex_lock(&cache->mutex);
+  MovieCacheItem *item = static_cast<MovieCacheItem *>(lib_ghash_lookup(cache->hash, userkey));
+  if (item) {
+    moviecache_item_unlink(shard, item);
+  }
+  lib_mutex_unlock(&cache->mutex);
+  lib_mutex_unlock(&shard->mutex);
+
+  if (item) {
+    moviecache_item_release(item, cache->prioritydeleterfp);
+  }
+}
+
+bool imbuf_moviecache_has_frame(MovieCache *cache, void *userkey)
+{
+  lib_mutex_lock(&cache->mutex);
+  const bool has_frame = lib_ghash_lookup(cache->hash, userkey) != nullptr;
+  lib_mutex_unlock(&cache->mutex);
+  return has_frame;
+}
+
+/* Pin the items of `cache` passing `check_cb` (all when null), to remove them without the cache
+ * locked (see the lock order). */
+static MovieCacheItem **moviecache_items_pin(MovieCache *cache,
+                                             bool(check_cb)(ImBuf *ibuf,
+                                                            void *userkey,
+                                                            void *userdata),
+                                             void *userdata,
+                                             int *r_len)
+{
+  GHashIterator gh_iter;
+  int len = 0;
+
+  lib_mutex_lock(&cache->mutex);
+  MovieCacheItem **items = static_cast<MovieCacheItem **>(
+      mem_mallocn(sizeof(*items) * max_ii(int(lib_ghash_len(cache->hash)), 1), __func__));
+  GHASH_ITER (gh_iter, cache->hash) {
+    MovieCacheItem *item = static_cast<MovieCacheItem *>(lib_ghashIterator_getValue(&gh_iter));
+    if (check_cb == nullptr || check_cb(item->ibuf, item->userkey, userdata)) {
+      moviecache_item_pin(item);
+      items[len++] = item;
+    }
+  }
+  lib_mutex_unlock(&cache->mutex);
+
+  *r_len = len;
+  return items;
+}
+
+static void moviecache_items_remove(MovieCacheItem **items, int len)
+{
+  for (int i = 0; i < len; i++) {
+    moviecache_item_remove(items[i]);
+    moviecache_item_unpin(items[i]);
+  }
+  mem_freen(items);
+}
+
+void imbuf_moviecache_free(MovieCache *cache)
+{
+  int len;
+  MovieCacheItem **items = moviecache_items_pin(cache, nullptr, nullptr, &len);
+  moviecache_items_remove(items, len);
+
+  lib_ghash_free(cache->hash, nullptr, nullptr);
+  lib_mutex_end(&cache->mutex);
+
+  MEM_SAFE_FREE(cache->points);
+  MEM_SAFE_FREE(cache->last_userkey);
+
+  mem_freen(cache);
+}
+
+void imbuf_moviecache_cleanup(MovieCache *cache,
+                              bool(cleanup_check_cb)(ImBuf *ibuf, void *userkey, void *userdata),
+                              void *userdata)
+{
+  int len;
+  MovieCacheItem **items = moviecache_items_pin(cache, cleanup_check_cb, userdata, &len);
+  moviecache_items_remove(items, len);
+}
+
+static int compare_int(const void *av, const void *bv)
+{
+  const int *a = static_cast<const int *>(av);
+  const int *b = static_cast<const int *>(bv);
+  return *a - *b;
+}
+
+void imbuf_moviecache_get_cache_segments(
+    MovieCache *cache, int proxy, int render_flags, int *r_totseg, int **r_points)
+{
+  *r_totseg = 0;
+  *r_points = nullptr;
+
+  if (!cache->getdatafp) {
+    return;
+  }
+
+  lib_mutex_lock(&cache->mutex);
+
+  /* The previous segments are freed here only, they stay valid until the next call. */
+  if (!cache->points_valid || cache->proxy != proxy || cache->render_flags != render_flags) {
+    MEM_SAFE_FREE(cache->points);
+    cache->totseg = 0;
+
+    const int totitem = int(lib_ghash_len(cache->hash));
+    int *frames = static_cast<int *>(
+        mem_mallocn(sizeof(int) * max_ii(totitem, 1), "movieclip cache frames"));
+    int totframe = 0;
+    GHashIterator gh_iter;
+
+    GHASH_ITER (gh_iter, cache->hash) {
+      MovieCacheItem *item = static_cast<MovieCacheItem *>(lib_ghashIterator_getValue(&gh_iter));
+      int framenr, curproxy, curflags;
+
+      if (item->ibuf) {
+        cache->getdatafp(item->userkey, &framenr, &curproxy, &curflags);
+        if (curproxy == proxy && curflags == render_flags) {
+          frames[totframe++] = framenr;
+        }
+      }
+    }
+
+    qsort(frames, totframe, sizeof(int), compare_int);
+
+    int totseg = 0;
+    for (int a = 0; a < totframe; a++) {
+      if (a == 0 || frames[a] - frames[a - 1] != 1) {
+        totseg++;
+      }
+    }
+
+    if (totseg) {
+      int *points = static_cast<int *>(
+          mem_mallocn(sizeof(int[2]) * totseg, "movieclip cache segments"));
+      int b = 0;
+      for (int a = 0; a < totframe; a++) {
+        if (a == 0 || frames[a] - frames[a - 1] != 1) {
+          if (a) {
+            points[b++] = frames[a - 1];
+          }
+          points[b++] = frames[a];
+        }
+      }
+      points[b++] = frames[totframe - 1];
+
+      cache->totseg = totseg;
+      cache->points = points;
+    }
+
+    cache->proxy = proxy;
+    cache->render_flags = render_flags;
+    cache->points_valid = true;
+
+    mem_freen(frames);
+  }
+
+  *r_totseg = cache->totseg;
+  *r_points = cache->points;
+
+  lib_mutex_unlock(&cache->mutex);
+}
+
+void imbuf_moviecache_stats_get(MovieCacheStats *r_stats)
+{
+  *r_stats = moviecache_stats;
+  r_stats->mem_in_use = moviecache_mem_in_use;
+  r_stats->mem_limit = MEM_CacheLimiter_is_disabled() ? 0 : MEM_CacheLimiter_get_maximum();
+}
+
+void imbuf_moviecache_stats_reset(void)
+{
+  moviecache_stats.hits = 0;
+  moviecache_stats.misses = 0;
+  moviecache_stats.puts = 0;
+  moviecache_stats.rejected = 0;
+  moviecache_stats.evictions = 0;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Iterator
+ *
+ * Iterates over the items in the cache when created, their ImBufs stay valid until the iterator
+ * is freed.
+ * \{ */
+
+MovieCacheIter *imbuf_moviecacheIter_new(MovieCache *cache)
+{
+  MovieCacheIter *iter = static_cast<MovieCacheIter *>(
+      mem_callocn(sizeof(MovieCacheIter), "MovieCache iterator"));
+  GHashIterator gh_iter;
+
+  lib_mutex_lock(&cache->mutex);
+  iter->items = static_cast<MovieCacheIterItem *>(mem_mallocn(
+      sizeof(MovieCacheIterItem) * max_ii(int(lib_ghash_len(cache->hash)), 1), __func__));
+  GHASH_ITER (gh_iter, cache->hash) {
+    MovieCacheItem *item = static_cast<MovieCacheItem *>(lib_ghashIterator_getValue(&gh_iter));
+    moviecache_item_pin(item);
+    if (item->ibuf) {
+      imbuf_refImBuf(item->ibuf);
+    }
+    iter->items[iter->len].item = item;
+    iter->items[iter->len].ibuf = item->ibuf;
+    iter->len++;
+  }
+  lib_mutex_unlock(&cache->mutex);
+
+  return iter;
+}
+
+void imbuf_moviecacheIter_free(MovieCacheIter *iter)
+{
+  for (int i = 0; i < iter->len; i++) {
+    if (iter->items[i].ibuf) {
+      imbuf_freeImBuf(iter->items[i].ibuf);
+    }
+    moviecache_item_unpin(iter->items[i].item);
+  }
+  mem_freen(iter->items);
+  mem_freen(iter);
+}
+
+bool imbuf_moviecacheIter_done(MovieCacheIter *iter)
+{
+  return iter->index >= iter->len;
+}
+
+void imbuf_moviecacheIter_step(MovieCacheIter *iter)
+{
+  iter->index++;
+}
+
+ImBuf *imbuf_moviecacheIter_getImBuf(MovieCacheIter *iter)
+{
+  return iter->items[iter->index].ibuf;
+}
+
+void *imbuf_moviecacheIter_getUserKey(MovieCacheIter *iter)
+{
+  return iter->items[iter->index].item->userkey;
+}
+
+/** \} */
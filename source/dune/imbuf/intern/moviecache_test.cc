@@ -0,0 +1,211 @@
+#include "testing/testing.h"
+
+#include "MEM_CacheLimiter.h"
+
+#include "imbuf.h"
+#include "imbuf_moviecache.h"
+#include "imbuf_types.h"
+
+namespace dune::imbuf::tests {
+
+/* Number of items the budget of the tests holds. */
+#define ITEMS_NUM 6
+
+struct MovieCacheTestKey {
+  int frame;
+};
+
+static uint moviecache_test_hash(const void *key)
+{
+  return uint(static_cast<const MovieCacheTestKey *>(key)->frame);
+}
+
+static bool moviecache_test_cmp(const void *a, const void *b)
+{
+  return static_cast<const MovieCacheTestKey *>(a)->frame !=
+         static_cast<const MovieCacheTestKey *>(b)->frame;
+}
+
+class MovieCacheTest : public testing::Test {
+ public:
+  MovieCache *cache;
+  size_t mem_limit_prev;
+  bool disabled_prev;
+  /* Memory counted for an item with a #frame_new ImBuf. */
+  size_t item_size;
+
+  void SetUp() override
+  {
+    mem_limit_prev = MEM_CacheLimiter_get_maximum();
+    disabled_prev = MEM_CacheLimiter_is_disabled();
+    MEM_CacheLimiter_set_disabled(false);
+    MEM_CacheLimiter_set_maximum(size_t(1) << 30);
+
+    cache = imbuf_moviecache_create(
+        "test", sizeof(MovieCacheTestKey), moviecache_test_hash, moviecache_test_cmp);
+
+    MovieCacheStats stats;
+    imbuf_moviecache_stats_get(&stats);
+    const size_t mem_in_use = stats.mem_in_use;
+    put(-1);
+    imbuf_moviecache_stats_get(&stats);
+    item_size = stats.mem_in_use - mem_in_use;
+    remove(-1);
+
+    MEM_CacheLimiter_set_maximum(mem_in_use + item_size * ITEMS_NUM);
+    imbuf_moviecache_stats_reset();
+  }
+
+  void TearDown() override
+  {
+    imbuf_moviecache_free(cache);
+    MEM_CacheLimiter_set_maximum(mem_limit_prev);
+    MEM_CacheLimiter_set_disabled(disabled_prev);
+  }
+
+  static ImBuf *frame_new()
+  {
+    return IMB_allocImBuf(64, 64, 32, IB_rect);
+  }
+
+  void put(const int frame)
+  {
+    MovieCacheTestKey key = {frame};
+    ImBuf *ibuf = frame_new();
+    imbuf_moviecache_put(cache, &key, ibuf);
+    IMB_freeImBuf(ibuf);
+  }
+
+  bool put_if_possible(const int frame)
+  {
+    MovieCacheTestKey key = {frame};
+    ImBuf *ibuf = frame_new();
+    const bool is_put = imbuf_moviecache_put_if_possible(cache, &key, ibuf);
+    IMB_freeImBuf(ibuf);
+    return is_put;
+  }
+
+  /* Look `frame` up `times`, whether it's cached or not. */
+  void get(const int frame, const int times)
+  {
+    MovieCacheTestKey key = {frame};
+    for (int i = 0; i < times; i++) {
+      ImBuf *ibuf = imbuf_moviecache_get(cache, &key, nullptr);
+      if (ibuf) {
+        IMB_freeImBuf(ibuf);
+      }
+    }
+  }
+
+  void remove(const int frame)
+  {
+    MovieCacheTestKey key = {frame};
+    imbuf_moviecache_remove(cache, &key);
+  }
+
+  bool has_frame(const int frame)
+  {
+    MovieCacheTestKey key = {frame};
+    return imbuf_moviecache_has_frame(cache, &key);
+  }
+};
+
+TEST_F(MovieCacheTest, admission)
+{
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    put(frame);
+    get(frame, 3);
+  }
+
+  /* Never looked up, less frequent than any cached frame. */
+  EXPECT_FALSE(put_if_possible(100));
+  EXPECT_FALSE(has_frame(100));
+
+  MovieCacheStats stats;
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_EQ(stats.rejected, 1);
+  EXPECT_EQ(stats.evictions, 0);
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    EXPECT_TRUE(has_frame(frame));
+  }
+
+  /* Missed more often than any cached frame was looked up: evicts exactly one of them. */
+  get(200, 5);
+  EXPECT_TRUE(put_if_possible(200));
+  EXPECT_TRUE(has_frame(200));
+
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_EQ(stats.rejected, 1);
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_LE(stats.mem_in_use, stats.mem_limit);
+  int cached_num = 0;
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    cached_num += has_frame(frame);
+  }
+  EXPECT_EQ(cached_num, ITEMS_NUM - 1);
+}
+
+TEST_F(MovieCacheTest, eviction_order)
+{
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    put(frame);
+  }
+  for (int frame = 0; frame < ITEMS_NUM / 2; frame++) {
+    get(frame, 4);
+  }
+
+  /* As frequently used as the first half, the second half is evicted for them. */
+  for (int frame = 100; frame < 100 + ITEMS_NUM / 2; frame++) {
+    get(frame, 4);
+    put(frame);
+  }
+
+  for (int frame = 0; frame < ITEMS_NUM / 2; frame++) {
+    EXPECT_TRUE(has_frame(frame));
+  }
+  for (int frame = ITEMS_NUM / 2; frame < ITEMS_NUM; frame++) {
+    EXPECT_FALSE(has_frame(frame));
+  }
+  for (int frame = 100; frame < 100 + ITEMS_NUM / 2; frame++) {
+    EXPECT_TRUE(has_frame(frame));
+  }
+
+  MovieCacheStats stats;
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_EQ(stats.evictions, ITEMS_NUM / 2);
+}
+
+TEST_F(MovieCacheTest, budget_growing_buffers)
+{
+  ImBuf *ibufs[ITEMS_NUM];
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    MovieCacheTestKey key = {frame};
+    ibufs[frame] = frame_new();
+    imbuf_moviecache_put(cache, &key, ibufs[frame]);
+  }
+
+  MovieCacheStats stats;
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_LE(stats.mem_in_use, stats.mem_limit);
+  EXPECT_EQ(stats.evictions, 0);
+
+  /* Cached buffers gaining a float buffer after they were put, measured again when they're
+   * looked up. */
+  imb_addrectfloatImBuf(ibufs[0]);
+  imb_addrectfloatImBuf(ibufs[1]);
+  get(0, 1);
+  get(1, 1);
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_GT(stats.mem_in_use, stats.mem_limit);
+  put(100);
+
+  imbuf_moviecache_stats_get(&stats);
+  EXPECT_LE(stats.mem_in_use, stats.mem_limit);
+  EXPECT_GT(stats.evictions, 1);
+
+  for (int frame = 0; frame < ITEMS_NUM; frame++) {
+    IMB_freeImBuf(ibufs[frame]);
+  }
+}
+
+}  // namespace dune::imbuf::tests
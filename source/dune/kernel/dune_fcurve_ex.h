@@ -0,0 +1,56 @@
+#pragma once
+
+/* Extensions of the F-Curve API (see BKE_fcurve.h).
+ *
+ * - Evaluating a curve at many times, reusing the keyframe segment found by the previous
+ *   evaluation and its Bezier coefficients. */
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct FCurve;
+
+/* Bezier segment between two keyframes, solved once for all times evaluated in it. */
+typedef struct FCurveEvalBezier {
+  /* Control points the coefficients were computed from, before handle correction,
+   * to detect edited keyframes. */
+  float points[4][2];
+  /* All points have the same value, which is the value of the segment. */
+  bool is_flat;
+  /* Time of the first keyframe & coefficients of the time cubic (from the 2nd degree),
+   * solved for the curve parameter of an evaluation time. */
+  float time_start;
+  double time_coeffs[3];
+  /* Coefficients of the value cubic, evaluated at the curve parameter. */
+  float value_coeffs[4];
+} FCurveEvalBezier;
+
+/* Evaluation state of one curve, kept between evaluations at (mostly) increasing times,
+ * e.g. when baking or sampling a frame range. Initialize with #BKE_fcurve_eval_cache_init.
+ * Only valid for the curve it's used with, not for use from multiple threads at once. */
+typedef struct FCurveEvalCache {
+  /* Index of the keyframe ending the last segment evaluated, where the next look-up starts. */
+  int segment;
+  /* Index of the keyframe ending the segment of `bezier`, -1 when unset. */
+  int bezier_segment;
+  FCurveEvalBezier bezier;
+} FCurveEvalCache;
+
+void BKE_fcurve_eval_cache_init(FCurveEvalCache *cache);
+
+/* Same as #evaluate_fcurve, finding the keyframe segment of `evaltime` from the segment of
+ * the previous evaluation, in constant time for sequential times. */
+float evaluate_fcurve_cached(struct FCurve *fcu, FCurveEvalCache *cache, float evaltime);
+
+/* Evaluate the curve at all `times` (best sorted), the same as #evaluate_fcurve for each. */
+void BKE_fcurve_evaluate_times(struct FCurve *fcu,
+                               const float *times,
+                               int times_num,
+                               float *r_values);
+
+#ifdef __cplusplus
+}
+#endif
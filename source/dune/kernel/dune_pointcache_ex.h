@@ -0,0 +1,26 @@
+#pragma once
+
+/* Extensions of the point cache API (see DUNE_pointcache.h).
+ *
+ * - Packed disk caches (#PTCACHE_DISK_PACKED): all frames of a cache in one memory mapped file,
+ *   instead of a file per frame. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct PTCacheID;
+
+/* Extension of the packed disk cache file, next to the #PTCACHE_EXT files of other caches. */
+#define PTCACHE_PACK_EXT ".bpack"
+
+/* Convert the disk cache of `pid` to the format of its #PTCACHE_DISK_PACKED flag,
+ * after the flag was changed. */
+void DUNE_ptcache_toggle_disk_pack(struct PTCacheID *pid);
+
+/* Close the packed disk caches kept open for reading, on exit. */
+void DUNE_ptcache_pack_exit(void);
+
+#ifdef __cplusplus
+}
+#endif
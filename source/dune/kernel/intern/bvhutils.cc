@@ -11,6 +11,7 @@
 #include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
+#include "lib_kdopbvh_ex.h"
 
 #include "BKE_bvhutils.h"
 #include "BKE_editmesh.h"
@@ -546,6 +547,11 @@ static void mesh_edges_spherecast(void *userdata,
 
 /** BVH builders **/
 
+/* Trees of meshes & point clouds are cached and serve many (often batched) queries, which the
+ * SAH build & the wide copy of the tree make faster, for a slower build. Edit-mesh trees are
+ * rebuilt after every change, they keep the default build. */
+#define BVHTREE_MESH_BUILD_FLAG (BVH_BUILD_SAH | BVH_BUILD_WIDE)
+
 /* -------------------------------------------------------------------- */
 /** Vertex Builder **/
 
@@ -599,7 +605,7 @@ static BVHTree *bvhtree_from_mesh_verts_create_tree(float epsilon,
   }
 
   if (verts_num_active) {
-    tree = LIB_bvhtree_new(verts_num_active, epsilon, tree_type, axis);
+    tree = LIB_bvhtree_new_ex(verts_num_active, epsilon, tree_type, axis, BVHTREE_MESH_BUILD_FLAG);
 
     if (tree) {
       for (int i = 0; i < verts_num; i++) {
@@ -796,7 +802,7 @@ static BVHTree *bvhtree_from_mesh_edges_create_tree(const MVert *vert,
 
   if (edges_num_active) {
     /* Create a BVH-tree of the given target */
-    tree = LIB_bvhtree_new(edges_num_active, epsilon, tree_type, axis);
+    tree = LIB_bvhtree_new_ex(edges_num_active, epsilon, tree_type, axis, BVHTREE_MESH_BUILD_FLAG);
     if (tree) {
       for (int i = 0; i < edge_num; i++) {
         if (edges_mask && !LIB_BITMAP_TEST_BOOL(edges_mask, i)) {
@@ -966,7 +972,7 @@ static BVHTree *bvhtree_from_mesh_faces_create_tree(float epsilon,
 
     /* Create a BVH-tree of the given target. */
     // printf("%s: building BVH, total=%d\n", __func__, numFaces);
-    tree = LIB_bvhtree_new(faces_num_active, epsilon, tree_type, axis);
+    tree = LIB_bvhtree_new_ex(faces_num_active, epsilon, tree_type, axis, BVHTREE_MESH_BUILD_FLAG);
     if (tree) {
       if (vert && face) {
         for (int i = 0; i < faces_num; i++) {
@@ -1135,7 +1141,8 @@ static BVHTree *bvhtree_from_mesh_looptri_create_tree(float epsilon,
   if (looptri_num_active) {
     /* Create a BVH-tree of the given target */
     // printf("%s: building BVH, total=%d\n", __func__, numFaces);
-    tree = LIB_bvhtree_new(looptri_num_active, epsilon, tree_type, axis);
+    tree = LIB_bvhtree_new_ex(
+        looptri_num_active, epsilon, tree_type, axis, BVHTREE_MESH_BUILD_FLAG);
     if (tree) {
       if (vert && looptri) {
         for (int i = 0; i < looptri_num; i++) {
@@ -1722,7 +1729,8 @@ BVHTree *KERNEL_bvhtree_from_pointcloud_get(BVHTreeFromPointCloud *data,
                                          const PointCloud *pointcloud,
                                          const int tree_type)
 {
-  BVHTree *tree = LIB_bvhtree_new(pointcloud->totpoint, 0.0f, tree_type, 6);
+  BVHTree *tree = LIB_bvhtree_new_ex(
+      pointcloud->totpoint, 0.0f, tree_type, 6, BVHTREE_MESH_BUILD_FLAG);
   if (!tree) {
     return nullptr;
   }
@@ -33,6 +33,7 @@
 #include "KERNEL_scene.h"
 #include "KERNEL_screen.h"
 #include "KERNEL_studiolight.h"
+#include "dune_pointcache_ex.h"
 
 #include "DEG_depsgraph.h"
 
@@ -67,6 +68,7 @@ void KERNEL_dune_free(void)
 
   IMB_exit();
   KERNEL_cachefiles_exit();
+  DUNE_ptcache_pack_exit();
   DEG_free_node_types();
 
   KERNEL_brush_system_exit();
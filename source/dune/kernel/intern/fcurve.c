@@ -22,6 +22,7 @@
 #include "BKE_curve.h"
 #include "BKE_fcurve.h"
 #include "BKE_fcurve_driver.h"
+#include "dune_fcurve_ex.h"
 #include "BKE_global.h"
 #include "BKE_idprop.h"
 #include "BKE_lib_query.h"
@@ -1051,9 +1052,20 @@ void fcurve_store_samples(FCurve *fcu, void *data, int start, int end, FcuSample
   fpt = new_fpt = MEM_callocN(sizeof(FPoint) * (end - start + 1), "FPoint Samples");
 
   /* Use the sampling callback at 1-frame intervals from start to end frames. */
-  for (cfra = start; cfra <= end; cfra++, fpt++) {
-    fpt->vec[0] = (float)cfra;
-    fpt->vec[1] = sample_cb(fcu, data, (float)cfra);
+  if (sample_cb == fcurve_samplingcb_evalcurve) {
+    /* Sequential evaluation of the curve itself, reuse the segment of the previous frame. */
+    FCurveEvalCache cache;
+    BKE_fcurve_eval_cache_init(&cache);
+    for (cfra = start; cfra <= end; cfra++, fpt++) {
+      fpt->vec[0] = (float)cfra;
+      fpt->vec[1] = evaluate_fcurve_cached(fcu, &cache, (float)cfra);
+    }
+  }
+  else {
+    for (cfra = start; cfra <= end; cfra++, fpt++) {
+      fpt->vec[0] = (float)cfra;
+      fpt->vec[1] = sample_cb(fcu, data, (float)cfra);
+    }
   }
 
   /* Free any existing sample/keyframe data on curve. */
@@ -1572,22 +1584,6 @@ static int findzero(float x, float q0, float q1, float q2, float q3, float *o)
   return solve_cubic(c0, c1, c2, c3, o);
 }
 
-static void berekeny(float f1, float f2, float f3, float f4, float *o, int b)
-{
-  float t, c0, c1, c2, c3;
-  int a;
-
-  c0 = f1;
-  c1 = 3.0f * (f2 - f1);
-  c2 = 3.0f * (f1 - 2.0f * f2 + f3);
-  c3 = f4 - f1 + 3.0f * (f2 - f3);
-
-  for (a = 0; a < b; a++) {
-    t = o[a];
-    o[a] = c0 + t * c1 + t * t * c2 + t * t * t * c3;
-  }
-}
-
 bool BKE_fcurve_bezt_subdivide_handles(struct BezTriple *bezt,
                                        struct BezTriple *prev,
                                        struct BezTriple *next,
@@ -1702,11 +1698,158 @@ static float fcurve_eval_keyframes_extrapolate(
   return endpoint_bezt->vec[1][1] - (fac * dx);
 }
 
-static float fcurve_eval_keyframes_interpolate(FCurve *fcu, BezTriple *bezts, float evaltime)
+/* Solve the Bezier segment between two keyframes, for any time within it. */
+static void fcurve_eval_bezier_init(FCurveEvalBezier *bezier,
+                                    const BezTriple *prevbezt,
+                                    const BezTriple *bezt)
+{
+  float v1[2], v2[2], v3[2], v4[2];
+
+  /* (v1, v2) are the first keyframe and its 2nd handle. */
+  copy_v2_v2(v1, prevbezt->vec[1]);
+  copy_v2_v2(v2, prevbezt->vec[2]);
+  /* (v3, v4) are the last keyframe's 1st handle + the last keyframe. */
+  copy_v2_v2(v3, bezt->vec[0]);
+  copy_v2_v2(v4, bezt->vec[1]);
+
+  copy_v2_v2(bezier->points[0], v1);
+  copy_v2_v2(bezier->points[1], v2);
+  copy_v2_v2(bezier->points[2], v3);
+  copy_v2_v2(bezier->points[3], v4);
+
+  /* Optimization: If all the handles are flat/at the same values,
+   * the value is simply the shared value (see T40372 -> F91346).
+   */
+  bezier->is_flat = fabsf(v1[1] - v4[1]) < FLT_EPSILON && fabsf(v2[1] - v3[1]) < FLT_EPSILON &&
+                    fabsf(v3[1] - v4[1]) < FLT_EPSILON;
+  if (bezier->is_flat) {
+    return;
+  }
+
+  /* Adjust handles so that they don't overlap (forming a loop). */
+  BKE_fcurve_correct_bezpart(v1, v2, v3, v4);
+
+  /* Same coefficients as #findzero, without the evaluation time. */
+  bezier->time_start = v1[0];
+  bezier->time_coeffs[0] = 3.0f * (v2[0] - v1[0]);
+  bezier->time_coeffs[1] = 3.0f * (v1[0] - 2.0f * v2[0] + v3[0]);
+  bezier->time_coeffs[2] = v4[0] - v1[0] + 3.0f * (v2[0] - v3[0]);
+
+  bezier->value_coeffs[0] = v1[1];
+  bezier->value_coeffs[1] = 3.0f * (v2[1] - v1[1]);
+  bezier->value_coeffs[2] = 3.0f * (v1[1] - 2.0f * v2[1] + v3[1]);
+  bezier->value_coeffs[3] = v4[1] - v1[1] + 3.0f * (v2[1] - v3[1]);
+}
+
+/* Value of a solved Bezier segment at `evaltime`, false when no curve parameter is found. */
+static bool fcurve_eval_bezier(const FCurveEvalBezier *bezier, float evaltime, float *r_value)
+{
+  if (bezier->is_flat) {
+    *r_value = bezier->points[0][1];
+    return true;
+  }
+
+  float opl[3];
+  const double *tc = bezier->time_coeffs;
+  if (!solve_cubic(bezier->time_start - evaltime, tc[0], tc[1], tc[2], opl)) {
+    return false;
+  }
+
+  const float *vc = bezier->value_coeffs;
+  const float t = opl[0];
+  *r_value = vc[0] + t * vc[1] + t * t * vc[2] + t * t * t * vc[3];
+  return true;
+}
+
+/* The solved segment ending at keyframe `segment`, reused while its keyframes are unchanged. */
+static const FCurveEvalBezier *fcurve_eval_cache_bezier_ensure(FCurveEvalCache *cache,
+                                                               const BezTriple *prevbezt,
+                                                               const BezTriple *bezt,
+                                                               const int segment)
+{
+  FCurveEvalBezier *bezier = &cache->bezier;
+  if (cache->bezier_segment != segment || !equals_v2v2(bezier->points[0], prevbezt->vec[1]) ||
+      !equals_v2v2(bezier->points[1], prevbezt->vec[2]) ||
+      !equals_v2v2(bezier->points[2], bezt->vec[0]) ||
+      !equals_v2v2(bezier->points[3], bezt->vec[1])) {
+    fcurve_eval_bezier_init(bezier, prevbezt, bezt);
+    cache->bezier_segment = segment;
+  }
+  return bezier;
+}
+
+/* Maximum number of segments to step over from the cached segment, before searching. */
+#define FCURVE_EVAL_CACHE_STEPS 4
+
+/**
+ * Find the keyframe segment of `evaltime` (between the first & last keyframe) near the segment
+ * of the previous evaluation, giving the same result as #BKE_fcurve_bezt_binarysearch_index_ex.
+ * \return false when not found nearby, or when more than one keyframe is within `threshold`
+ * (which one the binary search picks then depends on the search itself).
+ */
+static bool fcurve_eval_cache_find_segment(const FCurveEvalCache *cache,
+                                           const BezTriple *bezts,
+                                           const int totvert,
+                                           const float evaltime,
+                                           const float threshold,
+                                           int *r_index,
+                                           bool *r_exact)
+{
+  /* Step to the segment with `prev < evaltime <= next`. */
+  int a = clamp_i(cache->segment, 1, totvert - 1);
+  for (int step = 0;; step++) {
+    if (step == FCURVE_EVAL_CACHE_STEPS) {
+      return false;
+    }
+    if (evaltime <= bezts[a - 1].vec[1][0]) {
+      if (a == 1) {
+        return false;
+      }
+      a--;
+    }
+    else if (evaltime > bezts[a].vec[1][0]) {
+      if (a == totvert - 1) {
+        return false;
+      }
+      a++;
+    }
+    else {
+      break;
+    }
+  }
+
+  /* Keyframes are sorted, so the only keyframes that can be within the threshold are the ones
+   * next to `evaltime`, or the ones next to those. */
+  const bool on_prev = IS_EQT(evaltime, bezts[a - 1].vec[1][0], threshold);
+  const bool on_next = IS_EQT(evaltime, bezts[a].vec[1][0], threshold);
+  if (on_prev && on_next) {
+    return false;
+  }
+  if (on_prev) {
+    if (a >= 2 && IS_EQT(evaltime, bezts[a - 2].vec[1][0], threshold)) {
+      return false;
+    }
+    a--;
+  }
+  else if (on_next) {
+    if (a + 1 < totvert && IS_EQT(evaltime, bezts[a + 1].vec[1][0], threshold)) {
+      return false;
+    }
+  }
+
+  *r_index = a;
+  *r_exact = on_prev || on_next;
+  return true;
+}
+
+static float fcurve_eval_keyframes_interpolate(FCurve *fcu,
+                                               BezTriple *bezts,
+                                               float evaltime,
+                                               FCurveEvalCache *cache)
 {
   const float eps = 1.e-8f;
   BezTriple *bezt, *prevbezt;
-  unsigned int a;
+  int a;
 
   /* Evaltime occurs somewhere in the middle of the curve. */
   bool exact = false;
@@ -1721,7 +1864,14 @@ static float fcurve_eval_keyframes_interpolate(FCurve *fcu, BezTriple *bezts, fl
    *   Weird errors, like selecting the wrong keyframe range (see T39207), occur.
    *   This lower bound was established in b888a32eee8147b028464336ad2404d8155c64dd.
    */
-  a = BKE_fcurve_bezt_binarysearch_index_ex(bezts, evaltime, fcu->totvert, 0.0001, &exact);
+  const float threshold = 0.0001f;
+  if (!(cache && fcurve_eval_cache_find_segment(
+                     cache, bezts, fcu->totvert, evaltime, threshold, &a, &exact))) {
+    a = BKE_fcurve_bezt_binarysearch_index_ex(bezts, evaltime, fcu->totvert, threshold, &exact);
+  }
+  if (cache) {
+    cache->segment = a;
+  }
   bezt = bezts + a;
 
   if (exact) {
@@ -1771,45 +1921,31 @@ static float fcurve_eval_keyframes_interpolate(FCurve *fcu, BezTriple *bezts, fl
   switch (prevbezt->ipo) {
     /* Interpolation ...................................... */
     case BEZT_IPO_BEZ: {
-      float v1[2], v2[2], v3[2], v4[2], opl[32];
-
       /* Bezier interpolation. */
-      /* (v1, v2) are the first keyframe and its 2nd handle. */
-      v1[0] = prevbezt->vec[1][0];
-      v1[1] = prevbezt->vec[1][1];
-      v2[0] = prevbezt->vec[2][0];
-      v2[1] = prevbezt->vec[2][1];
-      /* (v3, v4) are the last keyframe's 1st handle + the last keyframe. */
-      v3[0] = bezt->vec[0][0];
-      v3[1] = bezt->vec[0][1];
-      v4[0] = bezt->vec[1][0];
-      v4[1] = bezt->vec[1][1];
-
-      if (fabsf(v1[1] - v4[1]) < FLT_EPSILON && fabsf(v2[1] - v3[1]) < FLT_EPSILON &&
-          fabsf(v3[1] - v4[1]) < FLT_EPSILON) {
-        /* Optimization: If all the handles are flat/at the same values,
-         * the value is simply the shared value (see T40372 -> F91346).
-         */
-        return v1[1];
+      FCurveEvalBezier bezier_local;
+      const FCurveEvalBezier *bezier;
+      if (cache) {
+        bezier = fcurve_eval_cache_bezier_ensure(cache, prevbezt, bezt, a);
+      }
+      else {
+        fcurve_eval_bezier_init(&bezier_local, prevbezt, bezt);
+        bezier = &bezier_local;
       }
-      /* Adjust handles so that they don't overlap (forming a loop). */
-      BKE_fcurve_correct_bezpart(v1, v2, v3, v4);
 
       /* Try to get a value for this position - if failure, try another set of points. */
-      if (!findzero(evaltime, v1[0], v2[0], v3[0], v4[0], opl)) {
+      float value;
+      if (!fcurve_eval_bezier(bezier, evaltime, &value)) {
         if (G.debug & G_DEBUG) {
           printf("    ERROR: findzero() failed at %f with %f %f %f %f\n",
                  evaltime,
-                 v1[0],
-                 v2[0],
-                 v3[0],
-                 v4[0]);
+                 bezier->points[0][0],
+                 bezier->points[1][0],
+                 bezier->points[2][0],
+                 bezier->points[3][0]);
         }
         return 0.0;
       }
-
-      berekeny(v1[1], v2[1], v3[1], v4[1], opl, 1);
-      return opl[0];
+      return value;
     }
     case BEZT_IPO_LIN:
       /* Linear - simply linearly interpolate between values of the two keyframes. */
@@ -1964,7 +2100,10 @@ static float fcurve_eval_keyframes_interpolate(FCurve *fcu, BezTriple *bezts, fl
 }
 
 /* Calculate F-Curve value for 'evaltime' using #BezTriple keyframes. */
-static float fcurve_eval_keyframes(FCurve *fcu, BezTriple *bezts, float evaltime)
+static float fcurve_eval_keyframes(FCurve *fcu,
+                                   BezTriple *bezts,
+                                   float evaltime,
+                                   FCurveEvalCache *cache)
 {
   if (evaltime <= bezts->vec[1][0]) {
     return fcurve_eval_keyframes_extrapolate(fcu, bezts, evaltime, 0, +1);
@@ -1975,7 +2114,7 @@ static float fcurve_eval_keyframes(FCurve *fcu, BezTriple *bezts, float evaltime
     return fcurve_eval_keyframes_extrapolate(fcu, bezts, evaltime, fcu->totvert - 1, -1);
   }
 
-  return fcurve_eval_keyframes_interpolate(fcu, bezts, evaltime);
+  return fcurve_eval_keyframes_interpolate(fcu, bezts, evaltime, cache);
 }
 
 /* Calculate F-Curve value for 'evaltime' using #FPoint samples. */
@@ -2021,31 +2160,30 @@ static float fcurve_eval_samples(FCurve *fcu, FPoint *fpts, float evaltime)
 /* Evaluate and return the value of the given F-Curve at the specified frame ("evaltime")
  * NOTE: this is also used for drivers.
  */
-static float evaluate_fcurve_ex(FCurve *fcu, float evaltime, float cvalue)
+static float evaluate_fcurve_with_storage(FCurve *fcu,
+                                          FModifiersStackStorage *storage,
+                                          float evaltime,
+                                          float cvalue,
+                                          FCurveEvalCache *cache)
 {
   float devaltime;
 
   /* Evaluate modifiers which modify time to evaluate the base curve at. */
-  FModifiersStackStorage storage;
-  storage.modifier_count = BLI_listbase_count(&fcu->modifiers);
-  storage.size_per_modifier = evaluate_fmodifiers_storage_size_per_modifier(&fcu->modifiers);
-  storage.buffer = alloca(storage.modifier_count * storage.size_per_modifier);
-
-  devaltime = evaluate_time_fmodifiers(&storage, &fcu->modifiers, fcu, cvalue, evaltime);
+  devaltime = evaluate_time_fmodifiers(storage, &fcu->modifiers, fcu, cvalue, evaltime);
 
   /* Evaluate curve-data
    * - 'devaltime' instead of 'evaltime', as this is the time that the last time-modifying
    *   F-Curve modifier on the stack requested the curve to be evaluated at.
    */
   if (fcu->bezt) {
-    cvalue = fcurve_eval_keyframes(fcu, fcu->bezt, devaltime);
+    cvalue = fcurve_eval_keyframes(fcu, fcu->bezt, devaltime, cache);
   }
   else if (fcu->fpt) {
     cvalue = fcurve_eval_samples(fcu, fcu->fpt, devaltime);
   }
 
   /* Evaluate modifiers. */
-  evaluate_value_fmodifiers(&storage, &fcu->modifiers, fcu, &cvalue, devaltime);
+  evaluate_value_fmodifiers(storage, &fcu->modifiers, fcu, &cvalue, devaltime);
 
   /* If curve can only have integral values, perform truncation (i.e. drop the decimal part)
    * here so that the curve can be sampled correctly.
@@ -2057,11 +2195,21 @@ static float evaluate_fcurve_ex(FCurve *fcu, float evaltime, float cvalue)
   return cvalue;
 }
 
+static float evaluate_fcurve_ex(FCurve *fcu, float evaltime, float cvalue, FCurveEvalCache *cache)
+{
+  FModifiersStackStorage storage;
+  storage.modifier_count = BLI_listbase_count(&fcu->modifiers);
+  storage.size_per_modifier = evaluate_fmodifiers_storage_size_per_modifier(&fcu->modifiers);
+  storage.buffer = alloca(storage.modifier_count * storage.size_per_modifier);
+
+  return evaluate_fcurve_with_storage(fcu, &storage, evaltime, cvalue, cache);
+}
+
 float evaluate_fcurve(FCurve *fcu, float evaltime)
 {
   BLI_assert(fcu->driver == NULL);
 
-  return evaluate_fcurve_ex(fcu, evaltime, 0.0);
+  return evaluate_fcurve_ex(fcu, evaltime, 0.0, NULL);
 }
 
 float evaluate_fcurve_only_curve(FCurve *fcu, float evaltime)
@@ -2069,7 +2217,41 @@ float evaluate_fcurve_only_curve(FCurve *fcu, float evaltime)
   /* Can be used to evaluate the (key-framed) f-curve only.
    * Also works for driver-f-curves when the driver itself is not relevant.
    * E.g. when inserting a keyframe in a driver f-curve. */
-  return evaluate_fcurve_ex(fcu, evaltime, 0.0);
+  return evaluate_fcurve_ex(fcu, evaltime, 0.0, NULL);
+}
+
+void BKE_fcurve_eval_cache_init(FCurveEvalCache *cache)
+{
+  cache->segment = 0;
+  cache->bezier_segment = -1;
+}
+
+float evaluate_fcurve_cached(FCurve *fcu, FCurveEvalCache *cache, float evaltime)
+{
+  BLI_assert(fcu->driver == NULL);
+
+  return evaluate_fcurve_ex(fcu, evaltime, 0.0, cache);
+}
+
+void BKE_fcurve_evaluate_times(FCurve *fcu,
+                               const float *times,
+                               const int times_num,
+                               float *r_values)
+{
+  BLI_assert(fcu->driver == NULL);
+
+  FCurveEvalCache cache;
+  BKE_fcurve_eval_cache_init(&cache);
+
+  /* The modifier storage only holds data of one evaluation, so it's shared by all. */
+  FModifiersStackStorage storage;
+  storage.modifier_count = BLI_listbase_count(&fcu->modifiers);
+  storage.size_per_modifier = evaluate_fmodifiers_storage_size_per_modifier(&fcu->modifiers);
+  storage.buffer = alloca(storage.modifier_count * storage.size_per_modifier);
+
+  for (int i = 0; i < times_num; i++) {
+    r_values[i] = evaluate_fcurve_with_storage(fcu, &storage, times[i], 0.0f, &cache);
+  }
 }
 
 float evaluate_fcurve_driver(PathResolvedRNA *anim_rna,
@@ -2117,7 +2299,7 @@ float evaluate_fcurve_driver(PathResolvedRNA *anim_rna,
     }
   }
 
-  return evaluate_fcurve_ex(fcu, evaltime, cvalue);
+  return evaluate_fcurve_ex(fcu, evaltime, cvalue, NULL);
 }
 
 bool BKE_fcurve_is_empty(FCurve *fcu)
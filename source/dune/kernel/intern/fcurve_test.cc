@@ -2,7 +2,10 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_utildefines.h"
+
 #include "BKE_fcurve.h"
+#include "dune_fcurve_ex.h"
 
 #include "ED_keyframing.h"
 #include "ED_types.h" /* For SELECT. */
@@ -110,6 +113,40 @@ TEST(evaluate_fcurve, InterpolationBezier)
   BKE_fcurve_free(fcu);
 }
 
+TEST(evaluate_fcurve, Cached)
+{
+  FCurve *fcu = BKE_fcurve_create();
+
+  insert_vert_fcurve(fcu, 1.0f, 7.0f, BEZT_KEYTYPE_KEYFRAME, INSERTKEY_NO_USERPREF);
+  insert_vert_fcurve(fcu, 4.0f, 13.0f, BEZT_KEYTYPE_KEYFRAME, INSERTKEY_NO_USERPREF);
+  insert_vert_fcurve(fcu, 5.0f, 2.0f, BEZT_KEYTYPE_KEYFRAME, INSERTKEY_NO_USERPREF);
+  insert_vert_fcurve(fcu, 9.0f, 2.0f, BEZT_KEYTYPE_KEYFRAME, INSERTKEY_NO_USERPREF);
+  insert_vert_fcurve(fcu, 12.0f, 19.0f, BEZT_KEYTYPE_KEYFRAME, INSERTKEY_NO_USERPREF);
+  fcu->bezt[2].ipo = BEZT_IPO_LIN;
+
+  /* Forwards, backwards & jumping, on and next to the keys. */
+  const float times[] = {0.0f,  1.0f,  1.5f, 2.0f, 3.0f,     3.99995f, 4.0f, 4.5f, 6.0f,
+                         11.5f, 12.0f, 13.0f, 8.0f, 4.00005f, 2.25f,    1.0f, 7.0f, 7.25f};
+  const int times_num = ARRAY_SIZE(times);
+  float values[ARRAY_SIZE(times)];
+
+  FCurveEvalCache cache;
+  BKE_fcurve_eval_cache_init(&cache);
+  BKE_fcurve_evaluate_times(fcu, times, times_num, values);
+  for (int i = 0; i < times_num; i++) {
+    const float expect = evaluate_fcurve(fcu, times[i]);
+    EXPECT_EQ(evaluate_fcurve_cached(fcu, &cache, times[i]), expect) << "time " << times[i];
+    EXPECT_EQ(values[i], expect) << "time " << times[i];
+  }
+
+  /* The cached segment is updated when its keys are edited. */
+  EXPECT_NEAR(evaluate_fcurve_cached(fcu, &cache, 1.5f), evaluate_fcurve(fcu, 1.5f), EPSILON);
+  fcu->bezt[1].vec[0][1] = 20.0f;
+  EXPECT_EQ(evaluate_fcurve_cached(fcu, &cache, 1.5f), evaluate_fcurve(fcu, 1.5f));
+
+  BKE_fcurve_free(fcu);
+}
+
 TEST(evaluate_fcurve, InterpolationBounce)
 {
   FCurve *fcu = BKE_fcurve_create();
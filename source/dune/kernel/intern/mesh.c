@@ -52,6 +52,8 @@
 
 #include "LOADER_read_write.h"
 
+#include "atomic_ops.h"
+
 static void mesh_clear_geometry(Mesh *mesh);
 static void mesh_tessface_clear_intern(Mesh *mesh, int free_customdata);
 
@@ -84,6 +86,11 @@ static void mesh_copy_data(Main *duneMain, ID *id_dst, const ID *id_src, const i
   const Mesh *mesh_src = (const Mesh *)id_src;
 
   DUNE_mesh_runtime_reset_on_copy(mesh_dst, flag);
+  /* The copy has the same topology, so it shares the vertex to loop map used for normals
+   * (the runtime data was copied with the ID). */
+  if (mesh_dst->runtime.vert_to_loop_map) {
+    atomic_add_and_fetch_int32(&mesh_dst->runtime.vert_to_loop_map->users, 1);
+  }
   if ((mesh_src->id.tag & LIB_TAG_NO_MAIN) == 0) {
     /* This is a direct copy of a main mesh, so for now it has the same topology. */
     mesh_dst->runtime.deformed_only = true;
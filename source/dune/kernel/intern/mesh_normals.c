@@ -80,6 +80,25 @@ static void add_v3_v3_atomic(float r[3], const float a[3])
 #undef FLT_EQ_NONAN
 }
 
+/**
+ * Release the vertex to loop map used to gather vertex normals, see #mesh_vert_to_loop_map_ensure.
+ * It's freed by its last user.
+ */
+static void mesh_vert_to_loop_map_clear(Mesh *mesh)
+{
+  MeshVertToLoopMap *map = mesh->runtime.vert_to_loop_map;
+  if (map == nullptr) {
+    return;
+  }
+  mesh->runtime.vert_to_loop_map = nullptr;
+  if (atomic_sub_and_fetch_int32(&map->users, 1) == 0) {
+    MEM_freeN(map->offsets);
+    MEM_freeN(map->indices);
+    MEM_freeN(map->loop_to_poly);
+    MEM_freeN(map);
+  }
+}
+
 /* */
 
 /* -------------------------------------------------------------------- */
@@ -144,6 +163,7 @@ void KERNEL_mesh_clear_derived_normals(Mesh *mesh)
 {
   MEM_SAFE_FREE(mesh->runtime.vert_normals);
   MEM_SAFE_FREE(mesh->runtime.poly_normals);
+  mesh_vert_to_loop_map_clear(mesh);
 
   mesh->runtime.vert_normals_dirty = true;
   mesh->runtime.poly_normals_dirty = true;
@@ -329,6 +349,159 @@ void KERNEL_mesh_calc_normals_poly_and_vertex(const MVert *mvert,
       0, mvert_len, &data, mesh_calc_normals_poly_and_vertex_finalize_fn, &settings);
 }
 
+/* -------------------------------------------------------------------- */
+/** Mesh Normal Calculation (Gathering Vertex Normals)
+ *
+ * Rather than accumulating the angle weighted polygon normals into the vertex normals (with
+ * atomic additions), each vertex normal is computed from the corners using it. Those are listed
+ * by a vertex to loop map that is cached on the mesh runtime, so it's reused while the mesh is
+ * only deformed. No locking is needed and the result doesn't depend on the order that threads
+ * process vertices in.
+ */
+
+/**
+ * Build the vertex to loop map when it doesn't exist yet. Code changing the topology of a mesh
+ * clears its derived normals (#KERNEL_mesh_clear_derived_normals, as part of clearing the runtime
+ * caches), which releases the map. The element counts are compared too, so a topology change that
+ * wasn't tagged can't make the map index out of the mesh arrays.
+ * The loops of each vertex are in loop order, so the normals are accumulated in the same order
+ * every time.
+ */
+static void mesh_vert_to_loop_map_ensure(Mesh *mesh)
+{
+  const MeshVertToLoopMap *map_prev = mesh->runtime.vert_to_loop_map;
+  if (map_prev != nullptr && map_prev->totvert == mesh->totvert &&
+      map_prev->totloop == mesh->totloop && map_prev->totpoly == mesh->totpoly)
+  {
+    return;
+  }
+  mesh_vert_to_loop_map_clear(mesh);
+
+  int *offsets = (int *)MEM_calloc_arrayN((size_t)mesh->totvert + 1, sizeof(int), __func__);
+  int *indices = (int *)MEM_malloc_arrayN((size_t)mesh->totloop, sizeof(int), __func__);
+  int *loop_to_poly = (int *)MEM_malloc_arrayN((size_t)mesh->totloop, sizeof(int), __func__);
+
+  /* Count the loops of each vertex. */
+  for (int i = 0; i < mesh->totpoly; i++) {
+    const MPoly *mp = &mesh->mpoly[i];
+    for (int j = 0; j < mp->totloop; j++) {
+      offsets[mesh->mloop[mp->loopstart + j].v + 1]++;
+      loop_to_poly[mp->loopstart + j] = i;
+    }
+  }
+  for (int i = 0; i < mesh->totvert; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+
+  /* Fill in the loops, in order. */
+  int *fill = (int *)MEM_malloc_arrayN((size_t)max_ii(mesh->totvert, 1), sizeof(int), __func__);
+  memcpy(fill, offsets, sizeof(int) * (size_t)mesh->totvert);
+  for (int i = 0; i < mesh->totpoly; i++) {
+    const MPoly *mp = &mesh->mpoly[i];
+    for (int j = mp->loopstart; j < mp->loopstart + mp->totloop; j++) {
+      indices[fill[mesh->mloop[j].v]++] = j;
+    }
+  }
+  MEM_freeN(fill);
+
+  MeshVertToLoopMap *map = (MeshVertToLoopMap *)MEM_mallocN(sizeof(MeshVertToLoopMap), __func__);
+  map->users = 1;
+  map->totvert = mesh->totvert;
+  map->totloop = mesh->totloop;
+  map->totpoly = mesh->totpoly;
+  map->offsets = offsets;
+  map->indices = indices;
+  map->loop_to_poly = loop_to_poly;
+  mesh->runtime.vert_to_loop_map = map;
+}
+
+struct MeshCalcNormalsData_VertexGather {
+  const MVert *mvert;
+  const MLoop *mloop;
+  const MPoly *mpoly;
+  const int *vert_to_loop_offsets;
+  const int *vert_to_loop_indices;
+  const int *loop_to_poly_indices;
+
+  /** Polygon normal input. */
+  const float (*pnors)[3];
+  /** Vertex normal output. */
+  float (*vnors)[3];
+};
+
+static void mesh_calc_normals_vertex_gather_fn(void *__restrict userdata,
+                                               const int vidx,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const MeshCalcNormalsData_VertexGather *data = (MeshCalcNormalsData_VertexGather *)userdata;
+  const MVert *mverts = data->mvert;
+  const MLoop *mloop = data->mloop;
+  const float *v_curr = mverts[vidx].co;
+  float *no = data->vnors[vidx];
+
+  zero_v3(no);
+  for (int i = data->vert_to_loop_offsets[vidx]; i < data->vert_to_loop_offsets[vidx + 1]; i++) {
+    const int l_curr = data->vert_to_loop_indices[i];
+    const int pidx = data->loop_to_poly_indices[l_curr];
+    const MPoly *mp = &data->mpoly[pidx];
+    const int l_end = mp->loopstart + mp->totloop - 1;
+    const int l_prev = (l_curr == mp->loopstart) ? l_end : l_curr - 1;
+    const int l_next = (l_curr == l_end) ? mp->loopstart : l_curr + 1;
+
+    /* Angle between the two poly edges incident on this vertex, like
+     * #mesh_calc_normals_poly_and_vertex_accum_fn. */
+    float edvec_prev[3], edvec_next[3];
+    sub_v3_v3v3(edvec_prev, mverts[mloop[l_prev].v].co, v_curr);
+    normalize_v3(edvec_prev);
+    sub_v3_v3v3(edvec_next, v_curr, mverts[mloop[l_next].v].co);
+    normalize_v3(edvec_next);
+    const float fac = saacos(-dot_v3v3(edvec_prev, edvec_next));
+
+    madd_v3_v3fl(no, data->pnors[pidx], fac);
+  }
+
+  if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+    /* Following Mesh convention; we use vertex coordinate itself for normal in this case. */
+    normalize_v3_v3(no, v_curr);
+  }
+}
+
+/**
+ * Compute the polygon normals, then gather them into the vertex normals using the cached vertex
+ * to loop map of the mesh.
+ */
+static void mesh_calc_normals_poly_and_vertex_gather(Mesh *mesh,
+                                                     float (*r_poly_normals)[3],
+                                                     float (*r_vert_normals)[3])
+{
+  KERNEL_mesh_calc_normals_poly(mesh->mvert,
+                                mesh->totvert,
+                                mesh->mloop,
+                                mesh->totloop,
+                                mesh->mpoly,
+                                mesh->totpoly,
+                                r_poly_normals);
+
+  mesh_vert_to_loop_map_ensure(mesh);
+
+  TaskParallelSettings settings;
+  LIB_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+
+  MeshCalcNormalsData_VertexGather data = {};
+  data.mvert = mesh->mvert;
+  data.mloop = mesh->mloop;
+  data.mpoly = mesh->mpoly;
+  data.vert_to_loop_offsets = mesh->runtime.vert_to_loop_map->offsets;
+  data.vert_to_loop_indices = mesh->runtime.vert_to_loop_map->indices;
+  data.loop_to_poly_indices = mesh->runtime.vert_to_loop_map->loop_to_poly;
+  data.pnors = r_poly_normals;
+  data.vnors = r_vert_normals;
+
+  LIB_task_parallel_range(
+      0, mesh->totvert, &data, mesh_calc_normals_vertex_gather_fn, &settings);
+}
+
 /* -------------------------------------------------------------------- */
 /** Mesh Normal Calculation
  */
@@ -362,14 +535,7 @@ const float (*KERNEL_mesh_vertex_normals_ensure(const Mesh *mesh))[3]
     vert_normals = BKE_mesh_vertex_normals_for_write(&mesh_mutable);
     poly_normals = BKE_mesh_poly_normals_for_write(&mesh_mutable);
 
-    KERNEL_mesh_calc_normals_poly_and_vertex(mesh_mutable.mvert,
-                                          mesh_mutable.totvert,
-                                          mesh_mutable.mloop,
-                                          mesh_mutable.totloop,
-                                          mesh_mutable.mpoly,
-                                          mesh_mutable.totpoly,
-                                          poly_normals,
-                                          vert_normals);
+    mesh_calc_normals_poly_and_vertex_gather(&mesh_mutable, poly_normals, vert_normals);
 
     KERNEL_mesh_vertex_normals_clear_dirty(&mesh_mutable);
     KERNEL_mesh_poly_normals_clear_dirty(&mesh_mutable);
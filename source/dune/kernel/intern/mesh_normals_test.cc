@@ -0,0 +1,165 @@
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "types_mesh.h"
+#include "types_meshdata.h"
+
+#include "dune_lib_id.h"
+#include "dune_mesh.h"
+
+namespace dune::kernel::tests {
+
+/* A grid of `size` by `size` quads, with the first quad's winding reversed when `flip_first`. */
+static Mesh *grid_mesh_new(const int size, const bool flip_first)
+{
+  const int verts_side = size + 1;
+  Mesh *mesh = DUNE_mesh_new_nomain(
+      verts_side * verts_side, 0, 0, size * size * 4, size * size);
+
+  for (int y = 0; y < verts_side; y++) {
+    for (int x = 0; x < verts_side; x++) {
+      MVert *mv = &mesh->mvert[y * verts_side + x];
+      mv->co[0] = float(x);
+      mv->co[1] = float(y);
+      mv->co[2] = float((x * y) % 3) * 0.25f;
+    }
+  }
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const int poly = y * size + x;
+      const int v = y * verts_side + x;
+      const int corners[4] = {v, v + 1, v + verts_side + 1, v + verts_side};
+      mesh->mpoly[poly].loopstart = poly * 4;
+      mesh->mpoly[poly].totloop = 4;
+      for (int i = 0; i < 4; i++) {
+        const int corner = (flip_first && poly == 0) ? 3 - i : i;
+        mesh->mloop[poly * 4 + i].v = uint(corners[corner]);
+      }
+    }
+  }
+  DUNE_mesh_normals_tag_dirty(mesh);
+  return mesh;
+}
+
+static void expect_vert_to_loop_map_eq(const Mesh *a, const Mesh *b)
+{
+  ASSERT_EQ(a->totvert, b->totvert);
+  ASSERT_EQ(a->totloop, b->totloop);
+  const MeshVertToLoopMap *map_a = a->runtime.vert_to_loop_map;
+  const MeshVertToLoopMap *map_b = b->runtime.vert_to_loop_map;
+  ASSERT_NE(map_a, nullptr);
+  ASSERT_NE(map_b, nullptr);
+  for (int i = 0; i <= a->totvert; i++) {
+    EXPECT_EQ(map_a->offsets[i], map_b->offsets[i]);
+  }
+  for (int i = 0; i < a->totloop; i++) {
+    EXPECT_EQ(map_a->indices[i], map_b->indices[i]);
+    EXPECT_EQ(map_a->loop_to_poly[i], map_b->loop_to_poly[i]);
+  }
+}
+
+TEST(mesh_normals, vert_to_loop_map_copy)
+{
+  Mesh *mesh = grid_mesh_new(8, false);
+  KERNEL_mesh_vertex_normals_ensure(mesh);
+  const MeshVertToLoopMap *map = mesh->runtime.vert_to_loop_map;
+  ASSERT_NE(map, nullptr);
+  EXPECT_EQ(map->users, 1);
+
+  /* The copies share the map of their source. */
+  Mesh *mesh_copy = DUNE_mesh_copy_for_eval(mesh, false);
+  Mesh *mesh_copy_copy = DUNE_mesh_copy_for_eval(mesh_copy, false);
+  EXPECT_EQ(mesh_copy->runtime.vert_to_loop_map, map);
+  EXPECT_EQ(mesh_copy_copy->runtime.vert_to_loop_map, map);
+  EXPECT_EQ(map->users, 3);
+
+  /* Deforming a copy keeps the map. */
+  mesh_copy->mvert[0].co[2] += 1.0f;
+  DUNE_mesh_normals_tag_dirty(mesh_copy);
+  KERNEL_mesh_vertex_normals_ensure(mesh_copy);
+  EXPECT_EQ(mesh_copy->runtime.vert_to_loop_map, map);
+
+  /* The map outlives its source, and is freed by its last user. */
+  dune_id_free(nullptr, mesh);
+  EXPECT_EQ(map->users, 2);
+  Mesh *mesh_fresh = grid_mesh_new(8, false);
+  KERNEL_mesh_vertex_normals_ensure(mesh_fresh);
+  expect_vert_to_loop_map_eq(mesh_copy, mesh_fresh);
+
+  KERNEL_mesh_clear_derived_normals(mesh_copy_copy);
+  EXPECT_EQ(mesh_copy_copy->runtime.vert_to_loop_map, nullptr);
+  EXPECT_EQ(map->users, 1);
+
+  dune_id_free(nullptr, mesh_copy);
+  dune_id_free(nullptr, mesh_copy_copy);
+  dune_id_free(nullptr, mesh_fresh);
+}
+
+TEST(mesh_normals, vert_to_loop_map_topology_change)
+{
+  Mesh *mesh = grid_mesh_new(8, false);
+  KERNEL_mesh_vertex_normals_ensure(mesh);
+  const MeshVertToLoopMap *map = mesh->runtime.vert_to_loop_map;
+
+  /* Only moving vertices keeps the map. */
+  mesh->mvert[0].co[2] += 1.0f;
+  DUNE_mesh_normals_tag_dirty(mesh);
+  KERNEL_mesh_vertex_normals_ensure(mesh);
+  EXPECT_EQ(mesh->runtime.vert_to_loop_map, map);
+
+  /* Changing the loops clears the derived normals, which rebuilds it. */
+  Mesh *mesh_flip = grid_mesh_new(8, true);
+  for (int i = 0; i < 4; i++) {
+    mesh->mloop[i] = mesh_flip->mloop[i];
+  }
+  KERNEL_mesh_clear_derived_normals(mesh);
+  EXPECT_EQ(mesh->runtime.vert_to_loop_map, nullptr);
+  KERNEL_mesh_vertex_normals_ensure(mesh);
+  KERNEL_mesh_vertex_normals_ensure(mesh_flip);
+  expect_vert_to_loop_map_eq(mesh, mesh_flip);
+
+  dune_id_free(nullptr, mesh);
+  dune_id_free(nullptr, mesh_flip);
+}
+
+/* The normals gathered through the vertex to loop map match the ones accumulated per polygon,
+ * up to the order of the additions. */
+TEST(mesh_normals, gather_matches_accumulate)
+{
+  for (const bool flip_first : {false, true}) {
+    Mesh *mesh = grid_mesh_new(16, flip_first);
+    const float(*vert_normals)[3] = KERNEL_mesh_vertex_normals_ensure(mesh);
+    const float(*poly_normals)[3] = KERNEL_mesh_poly_normals_ensure(mesh);
+
+    float(*vert_normals_accum)[3] = static_cast<float(*)[3]>(
+        MEM_malloc_arrayN(mesh->totvert, sizeof(float[3]), __func__));
+    float(*poly_normals_accum)[3] = static_cast<float(*)[3]>(
+        MEM_malloc_arrayN(mesh->totpoly, sizeof(float[3]), __func__));
+    KERNEL_mesh_calc_normals_poly_and_vertex(mesh->mvert,
+                                             mesh->totvert,
+                                             mesh->mloop,
+                                             mesh->totloop,
+                                             mesh->mpoly,
+                                             mesh->totpoly,
+                                             poly_normals_accum,
+                                             vert_normals_accum);
+
+    for (int i = 0; i < mesh->totpoly; i++) {
+      for (int j = 0; j < 3; j++) {
+        EXPECT_NEAR(poly_normals[i][j], poly_normals_accum[i][j], 1e-6f) << "poly " << i;
+      }
+    }
+    for (int i = 0; i < mesh->totvert; i++) {
+      for (int j = 0; j < 3; j++) {
+        EXPECT_NEAR(vert_normals[i][j], vert_normals_accum[i][j], 1e-5f) << "vertex " << i;
+      }
+    }
+
+    MEM_freeN(vert_normals_accum);
+    MEM_freeN(poly_normals_accum);
+    dune_id_free(nullptr, mesh);
+  }
+}
+
+}  // namespace dune::kernel::tests
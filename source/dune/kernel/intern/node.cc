@@ -59,6 +59,8 @@
 #include "aoi_define.h"
 #include "api_prototypes.h"
 
+#include "fn_field.hh"
+
 #include "node_common.h"
 #include "node_composite.h"
 #include "node_fn.h"
@@ -5101,6 +5103,9 @@ void BKE_node_system_exit()
     BLI_ghash_free(nodetreetypes_hash, nullptr, ntree_free_type);
     nodetreetypes_hash = nullptr;
   }
+
+  /* Results of fields evaluated by the node trees, with the multi-functions they hold. */
+  dune::fn::clear_field_eval_cache();
 }
 
 /* -------------------------------------------------------------------- */
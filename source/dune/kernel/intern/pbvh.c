@@ -12,6 +12,7 @@
 #include "TYPES_meshdata.h"
 
 #include "DUNE_ccg.h"
+#include "DUNE_global.h"
 #include "DUNE_mesh.h"
 #include "DUNE_paint.h"
 #include "DUNE_pbvh.h"
@@ -28,6 +29,7 @@
 #include "pbvh_intern.h"
 
 #include <limits.h>
+#include <stdio.h>
 
 #define LEAF_LIMIT 10000
 
@@ -227,17 +229,21 @@ void pbvh_grow_nodes(PBVH *pbvh, int totnode)
 }
 
 /* Add a vertex to the map, with a positive value for unique vertices and
- * a negative value for additional vertices */
-static int map_insert_vert(
-    PBVH *pbvh, GHash *map, unsigned int *face_verts, unsigned int *uniq_verts, int vertex)
+ * a negative value for additional vertices.
+ * A vertex is unique in the first leaf using it, see #pbvh_build_vert_leaf_owners. */
+static int map_insert_vert(GHash *map,
+                           unsigned int *face_verts,
+                           unsigned int *uniq_verts,
+                           const int *vert_leaf_owners,
+                           const int leaf_order,
+                           int vertex)
 {
   void *key, **value_p;
 
   key = POINTER_FROM_INT(vertex);
   if (!BLI_ghash_ensure_p(map, key, &value_p)) {
     int value_i;
-    if (BLI_BITMAP_TEST(pbvh->vert_bitmap, vertex) == 0) {
-      BLI_BITMAP_ENABLE(pbvh->vert_bitmap, vertex);
+    if (vert_leaf_owners[vertex] == leaf_order) {
       value_i = *uniq_verts;
       (*uniq_verts)++;
     }
@@ -253,7 +259,10 @@ static int map_insert_vert(
 }
 
 /* Find vertices used by the faces in this node and update the draw buffers */
-static void build_mesh_leaf_node(PBVH *pbvh, PBVHNode *node)
+static void build_mesh_leaf_node(PBVH *pbvh,
+                                 PBVHNode *node,
+                                 const int *vert_leaf_owners,
+                                 const int leaf_order)
 {
   bool has_visible = false;
 
@@ -274,8 +283,12 @@ static void build_mesh_leaf_node(PBVH *pbvh, PBVHNode *node)
   for (int i = 0; i < totface; i++) {
     const MLoopTri *lt = &pbvh->looptri[node->prim_indices[i]];
     for (int j = 0; j < 3; j++) {
-      face_vert_indices[i][j] = map_insert_vert(
-          pbvh, map, &node->face_verts, &node->uniq_verts, pbvh->mloop[lt->tri[j]].v);
+      face_vert_indices[i][j] = map_insert_vert(map,
+                                                &node->face_verts,
+                                                &node->uniq_verts,
+                                                vert_leaf_owners,
+                                                leaf_order,
+                                                pbvh->mloop[lt->tri[j]].v);
     }
 
     if (has_visible == false) {
@@ -388,7 +401,13 @@ static void build_grid_leaf_node(PBVH *pbvh, PBVHNode *node)
   BKE_pbvh_node_mark_rebuild_draw(node);
 }
 
-static void build_leaf(PBVH *pbvh, int node_index, BBC *prim_bbc, int offset, int count)
+static void build_leaf(PBVH *pbvh,
+                       int node_index,
+                       BBC *prim_bbc,
+                       int offset,
+                       int count,
+                       const int *vert_leaf_owners,
+                       int leaf_order)
 {
   pbvh->nodes[node_index].flag |= PBVH_Leaf;
 
@@ -399,7 +418,7 @@ static void build_leaf(PBVH *pbvh, int node_index, BBC *prim_bbc, int offset, in
   update_vb(pbvh, &pbvh->nodes[node_index], prim_bbc, offset, count);
 
   if (pbvh->looptri) {
-    build_mesh_leaf_node(pbvh, pbvh->nodes + node_index);
+    build_mesh_leaf_node(pbvh, pbvh->nodes + node_index, vert_leaf_owners, leaf_order);
   }
   else {
     build_grid_leaf_node(pbvh, pbvh->nodes + node_index);
@@ -440,73 +459,402 @@ static bool leaf_needs_material_split(PBVH *pbvh, int offset, int count)
   return false;
 }
 
-/* Recursively build a node in the tree
- *
- * vb is the voxel box around all of the primitives contained in
- * this node.
+/* -------------------------------------------------------------------- */
+/** \name Tree Build
  *
- * cb is the bounding box around all the centroids of the primitives
- * contained in this node
+ * The tree is built top-down, nodes above the leaf limit are split where the binned surface area
+ * heuristic (SAH) is lowest, nodes below it are only split when their primitives use different
+ * materials. Large subtrees are built in parallel on a task pool, into temporary nodes, which are
+ * then stored in the PBVH in the same order as when built recursively on a single thread.
+ * Finally the leaves are built in parallel.
+ * \{ */
+
+/* Number of bins the centroids are sorted into along the split axis, to evaluate the SAH. */
+#define BUILD_SAH_BINS 16
+/* Subtrees with more primitives are built in a separate task. */
+#define BUILD_TASK_MIN_PRIMS 8192
+/* Bounds & bins of nodes with more primitives are computed in parallel. */
+#define BUILD_PARALLEL_MIN_PRIMS 65536
+
+typedef struct PBVHBuildNode {
+  /* Both children or none for leaves, allocated together. */
+  struct PBVHBuildNode *children;
+  int offset, count;
+} PBVHBuildNode;
+
+typedef struct PBVHBuildData {
+  PBVH *pbvh;
+  BBC *prim_bbc;
+} PBVHBuildData;
+
+typedef struct PBVHBuildBin {
+  BB bb;
+  int count;
+} PBVHBuildBin;
+
+typedef struct PBVHBuildRangeData {
+  const PBVHBuildData *build_data;
+  int offset;
+  int axis;
+  float bin_min;
+  float bin_scale;
+} PBVHBuildRangeData;
+
+typedef struct PBVHBuildBins {
+  PBVHBuildBin bins[BUILD_SAH_BINS];
+} PBVHBuildBins;
+
+static float bb_half_area(const BB *bb)
+{
+  float size[3];
+  sub_v3_v3v3(size, bb->bmax, bb->bmin);
+  if (size[0] < 0.0f) {
+    return 0.0f;
+  }
+  return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+static int build_bin_index(const PBVHBuildRangeData *data, const float centroid)
+{
+  const int bin = (int)((centroid - data->bin_min) * data->bin_scale);
+  return clamp_i(bin, 0, BUILD_SAH_BINS - 1);
+}
+
+static void build_centroid_bounds_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict tls)
+{
+  const PBVHBuildRangeData *data = userdata;
+  const PBVHBuildData *build_data = data->build_data;
+  BB *cb = tls->userdata_chunk;
+  BB_expand(cb, build_data->prim_bbc[build_data->pbvh->prim_indices[data->offset + i]].bcentroid);
+}
+
+static void build_centroid_bounds_reduce(const void *__restrict UNUSED(userdata),
+                                         void *__restrict chunk_join,
+                                         void *__restrict chunk)
+{
+  BB_expand_with_bb(chunk_join, chunk);
+}
+
+static void build_bins_cb(void *__restrict userdata,
+                          const int i,
+                          const TaskParallelTLS *__restrict tls)
+{
+  const PBVHBuildRangeData *data = userdata;
+  const PBVHBuildData *build_data = data->build_data;
+  PBVHBuildBins *bins = tls->userdata_chunk;
+  BBC *bbc = &build_data->prim_bbc[build_data->pbvh->prim_indices[data->offset + i]];
+  PBVHBuildBin *bin = &bins->bins[build_bin_index(data, bbc->bcentroid[data->axis])];
+  BB_expand_with_bb(&bin->bb, (BB *)bbc);
+  bin->count++;
+}
+
+static void build_bins_reduce(const void *__restrict UNUSED(userdata),
+                              void *__restrict chunk_join,
+                              void *__restrict chunk)
+{
+  PBVHBuildBins *bins_join = chunk_join;
+  const PBVHBuildBins *bins = chunk;
+  for (int i = 0; i < BUILD_SAH_BINS; i++) {
+    BB_expand_with_bb(&bins_join->bins[i].bb, (BB *)&bins->bins[i].bb);
+    bins_join->bins[i].count += bins->bins[i].count;
+  }
+}
+
+/* Returns the index of the first element on the right of the partition */
+static int partition_indices_bins(
+    const PBVHBuildRangeData *data, int *prim_indices, int lo, int hi, int split_bin)
+{
+  const BBC *prim_bbc = data->build_data->prim_bbc;
+  int i = lo, j = hi;
+  for (;;) {
+    while (i <= j &&
+           build_bin_index(data, prim_bbc[prim_indices[i]].bcentroid[data->axis]) <= split_bin) {
+      i++;
+    }
+    while (i <= j &&
+           build_bin_index(data, prim_bbc[prim_indices[j]].bcentroid[data->axis]) > split_bin) {
+      j--;
+    }
+    if (!(i < j)) {
+      return i;
+    }
+    SWAP(int, prim_indices[i], prim_indices[j]);
+    i++;
+    j--;
+  }
+}
+
+/**
+ * Split the primitives of a node above the leaf limit where the binned SAH is lowest, along the
+ * widest axis of the centroids. Falls back to a split at the middle of the centroids when they
+ * are all at the same position.
  *
- * offset and start indicate a range in the array of primitive indices
+ * \return The index of the first primitive of the second child.
  */
+static int build_partition_sah(const PBVHBuildData *build_data, const int offset, const int count)
+{
+  PBVH *pbvh = build_data->pbvh;
+  const bool use_threading = count >= BUILD_PARALLEL_MIN_PRIMS;
 
-static void build_sub(PBVH *pbvh, int node_index, BB *cb, BBC *prim_bbc, int offset, int count)
+  PBVHBuildRangeData data = {
+      .build_data = build_data,
+      .offset = offset,
+  };
+
+  BB cb;
+  BB_reset(&cb);
+  {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = use_threading;
+    settings.min_iter_per_thread = BUILD_TASK_MIN_PRIMS;
+    settings.userdata_chunk = &cb;
+    settings.userdata_chunk_size = sizeof(cb);
+    settings.func_reduce = build_centroid_bounds_reduce;
+    BLI_task_parallel_range(0, count, &data, build_centroid_bounds_cb, &settings);
+  }
+
+  const int axis = BB_widest_axis(&cb);
+  const float extent = cb.bmax[axis] - cb.bmin[axis];
+  if (!(extent > 0.0f)) {
+    return partition_indices(pbvh->prim_indices,
+                             offset,
+                             offset + count - 1,
+                             axis,
+                             (cb.bmax[axis] + cb.bmin[axis]) * 0.5f,
+                             build_data->prim_bbc);
+  }
+  data.axis = axis;
+  data.bin_min = cb.bmin[axis];
+  data.bin_scale = (float)BUILD_SAH_BINS / extent;
+
+  PBVHBuildBins bins;
+  for (int i = 0; i < BUILD_SAH_BINS; i++) {
+    BB_reset(&bins.bins[i].bb);
+    bins.bins[i].count = 0;
+  }
+  {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = use_threading;
+    settings.min_iter_per_thread = BUILD_TASK_MIN_PRIMS;
+    settings.userdata_chunk = &bins;
+    settings.userdata_chunk_size = sizeof(bins);
+    settings.func_reduce = build_bins_reduce;
+    BLI_task_parallel_range(0, count, &data, build_bins_cb, &settings);
+  }
+
+  /* Cost of the primitives right of each bin boundary. */
+  float right_costs[BUILD_SAH_BINS];
+  BB right_bb;
+  BB_reset(&right_bb);
+  int right_count = 0;
+  for (int i = BUILD_SAH_BINS - 1; i > 0; i--) {
+    BB_expand_with_bb(&right_bb, &bins.bins[i].bb);
+    right_count += bins.bins[i].count;
+    right_costs[i] = bb_half_area(&right_bb) * (float)right_count;
+  }
+
+  int split_bin = -1;
+  float split_cost = FLT_MAX;
+  BB left_bb;
+  BB_reset(&left_bb);
+  int left_count = 0;
+  for (int i = 0; i < BUILD_SAH_BINS - 1; i++) {
+    BB_expand_with_bb(&left_bb, &bins.bins[i].bb);
+    left_count += bins.bins[i].count;
+    if (left_count == 0 || left_count == count) {
+      continue;
+    }
+    const float cost = bb_half_area(&left_bb) * (float)left_count + right_costs[i + 1];
+    if (cost < split_cost) {
+      split_cost = cost;
+      split_bin = i;
+    }
+  }
+  if (split_bin == -1) {
+    /* Not expected, the first & last bin contain the centroids at the bounds. */
+    BLI_assert_unreachable();
+    return partition_indices(pbvh->prim_indices,
+                             offset,
+                             offset + count - 1,
+                             axis,
+                             (cb.bmax[axis] + cb.bmin[axis]) * 0.5f,
+                             build_data->prim_bbc);
+  }
+
+  return partition_indices_bins(
+      &data, pbvh->prim_indices, offset, offset + count - 1, split_bin);
+}
+
+static void build_node(TaskPool *pool, PBVHBuildData *data, PBVHBuildNode *node);
+
+static void build_node_task(TaskPool *__restrict pool, void *taskdata)
 {
-  int end;
-  BB cb_backing;
+  build_node(pool, BLI_task_pool_user_data(pool), taskdata);
+}
+
+/* Split the node (recursively), leaves are built later by #build_leaves. */
+static void build_node(TaskPool *pool, PBVHBuildData *data, PBVHBuildNode *node)
+{
+  PBVH *pbvh = data->pbvh;
+  const int offset = node->offset;
+  const int count = node->count;
 
   /* Decide whether this is a leaf or not */
   const bool below_leaf_limit = count <= pbvh->leaf_limit;
   if (below_leaf_limit) {
     if (!leaf_needs_material_split(pbvh, offset, count)) {
-      build_leaf(pbvh, node_index, prim_bbc, offset, count);
       return;
     }
   }
 
-  /* Add two child nodes */
-  pbvh->nodes[node_index].children_offset = pbvh->totnode;
-  pbvh_grow_nodes(pbvh, pbvh->totnode + 2);
-
-  /* Update parent node bounding box */
-  update_vb(pbvh, &pbvh->nodes[node_index], prim_bbc, offset, count);
-
+  int end;
   if (!below_leaf_limit) {
-    /* Find axis with widest range of primitive centroids */
-    if (!cb) {
-      cb = &cb_backing;
-      BB_reset(cb);
-      for (int i = offset + count - 1; i >= offset; i--) {
-        BB_expand(cb, prim_bbc[pbvh->prim_indices[i]].bcentroid);
-      }
-    }
-    const int axis = BB_widest_axis(cb);
-
-    /* Partition primitives along that axis */
-    end = partition_indices(pbvh->prim_indices,
-                            offset,
-                            offset + count - 1,
-                            axis,
-                            (cb->bmax[axis] + cb->bmin[axis]) * 0.5f,
-                            prim_bbc);
+    end = build_partition_sah(data, offset, count);
   }
   else {
     /* Partition primitives by material */
     end = partition_indices_material(pbvh, offset, offset + count - 1);
   }
 
+  node->children = MEM_callocN(sizeof(PBVHBuildNode) * 2, __func__);
+  node->children[0].offset = offset;
+  node->children[0].count = end - offset;
+  node->children[1].offset = end;
+  node->children[1].count = offset + count - end;
+
   /* Build children */
-  build_sub(pbvh, pbvh->nodes[node_index].children_offset, NULL, prim_bbc, offset, end - offset);
-  build_sub(pbvh,
-            pbvh->nodes[node_index].children_offset + 1,
-            NULL,
-            prim_bbc,
-            end,
-            offset + count - end);
+  for (int i = 0; i < 2; i++) {
+    if (node->children[i].count >= BUILD_TASK_MIN_PRIMS) {
+      BLI_task_pool_push(pool, build_node_task, &node->children[i], false, NULL);
+    }
+    else {
+      build_node(pool, data, &node->children[i]);
+    }
+  }
 }
 
-static void pbvh_build(PBVH *pbvh, BB *cb, BBC *prim_bbc, int totprim)
+/**
+ * Store the temporary nodes in the PBVH, in the order they would be added by splitting them
+ * recursively. Leaves are added to \a r_leaves in that order as well.
+ */
+static void build_store_nodes(PBVH *pbvh,
+                              const PBVHBuildNode *build_node,
+                              int node_index,
+                              int *r_leaves,
+                              int *r_totleaf)
+{
+  PBVHNode *node = &pbvh->nodes[node_index];
+  if (build_node->children == NULL) {
+    node->prim_indices = pbvh->prim_indices + build_node->offset;
+    node->totprim = build_node->count;
+    r_leaves[(*r_totleaf)++] = node_index;
+    return;
+  }
+  node->children_offset = pbvh->totnode;
+  pbvh->totnode += 2;
+  build_store_nodes(pbvh, &build_node->children[0], node->children_offset, r_leaves, r_totleaf);
+  build_store_nodes(
+      pbvh, &build_node->children[1], node->children_offset + 1, r_leaves, r_totleaf);
+}
+
+static int build_count_nodes(const PBVHBuildNode *build_node)
+{
+  if (build_node->children == NULL) {
+    return 1;
+  }
+  return 1 + build_count_nodes(&build_node->children[0]) +
+         build_count_nodes(&build_node->children[1]);
+}
+
+static void build_free_nodes(PBVHBuildNode *build_node)
+{
+  if (build_node->children) {
+    build_free_nodes(&build_node->children[0]);
+    build_free_nodes(&build_node->children[1]);
+    MEM_freeN(build_node->children);
+  }
+}
+
+typedef struct PBVHBuildLeavesData {
+  PBVH *pbvh;
+  BBC *prim_bbc;
+  const int *leaves;
+  /* The first leaf using each vertex, see #map_insert_vert. */
+  int *vert_leaf_owners;
+} PBVHBuildLeavesData;
+
+static void build_vert_leaf_owners_cb(void *__restrict userdata,
+                                      const int leaf_order,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PBVHBuildLeavesData *data = userdata;
+  PBVH *pbvh = data->pbvh;
+  const PBVHNode *node = &pbvh->nodes[data->leaves[leaf_order]];
+  for (int i = 0; i < node->totprim; i++) {
+    const MLoopTri *lt = &pbvh->looptri[node->prim_indices[i]];
+    for (int j = 0; j < 3; j++) {
+      int *owner = &data->vert_leaf_owners[pbvh->mloop[lt->tri[j]].v];
+      int old_owner = *owner;
+      while (leaf_order < old_owner) {
+        const int prev_owner = atomic_cas_int32(owner, old_owner, leaf_order);
+        if (prev_owner == old_owner) {
+          break;
+        }
+        old_owner = prev_owner;
+      }
+    }
+  }
+}
+
+static void build_leaves_cb(void *__restrict userdata,
+                            const int leaf_order,
+                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PBVHBuildLeavesData *data = userdata;
+  PBVH *pbvh = data->pbvh;
+  const int node_index = data->leaves[leaf_order];
+  PBVHNode *node = &pbvh->nodes[node_index];
+  build_leaf(pbvh,
+             node_index,
+             data->prim_bbc,
+             (int)(node->prim_indices - pbvh->prim_indices),
+             node->totprim,
+             data->vert_leaf_owners,
+             leaf_order);
+}
+
+/**
+ * Build the leaves in parallel. The vertices of a mesh are unique in the first leaf using them,
+ * like when the leaves are built one after another.
+ */
+static void build_leaves(PBVH *pbvh, BBC *prim_bbc, const int *leaves, const int totleaf)
+{
+  PBVHBuildLeavesData data = {
+      .pbvh = pbvh,
+      .prim_bbc = prim_bbc,
+      .leaves = leaves,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+
+  if (pbvh->looptri) {
+    data.vert_leaf_owners = MEM_malloc_arrayN(pbvh->totvert, sizeof(int), __func__);
+    copy_vn_i(data.vert_leaf_owners, pbvh->totvert, INT_MAX);
+    BLI_task_parallel_range(0, totleaf, &data, build_vert_leaf_owners_cb, &settings);
+  }
+
+  BLI_task_parallel_range(0, totleaf, &data, build_leaves_cb, &settings);
+
+  MEM_SAFE_FREE(data.vert_leaf_owners);
+}
+
+static void pbvh_build(PBVH *pbvh, BBC *prim_bbc, int totprim)
 {
   if (totprim != pbvh->totprim) {
     pbvh->totprim = totprim;
@@ -527,8 +875,115 @@ static void pbvh_build(PBVH *pbvh, BB *cb, BBC *prim_bbc, int totprim)
     }
   }
 
+  PBVHBuildData data = {
+      .pbvh = pbvh,
+      .prim_bbc = prim_bbc,
+  };
+
+  PBVHBuildNode root = {
+      .children = NULL,
+      .offset = 0,
+      .count = totprim,
+  };
+  TaskPool *pool = BLI_task_pool_create(&data, TASK_PRIORITY_HIGH);
+  build_node(pool, &data, &root);
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+
+  const int totnode = build_count_nodes(&root);
+  pbvh_grow_nodes(pbvh, totnode);
+  int *leaves = MEM_malloc_arrayN(totnode, sizeof(int), __func__);
+  int totleaf = 0;
   pbvh->totnode = 1;
-  build_sub(pbvh, 0, cb, prim_bbc, 0, totprim);
+  build_store_nodes(pbvh, &root, 0, leaves, &totleaf);
+  BLI_assert(pbvh->totnode == totnode);
+  build_free_nodes(&root);
+
+  build_leaves(pbvh, prim_bbc, leaves, totleaf);
+  MEM_freeN(leaves);
+
+  /* The bounds of a node contain those of its children, which have a higher index. */
+  for (int i = pbvh->totnode - 1; i >= 0; i--) {
+    PBVHNode *node = &pbvh->nodes[i];
+    if (!(node->flag & PBVH_Leaf)) {
+      BB_reset(&node->vb);
+      BB_expand_with_bb(&node->vb, &pbvh->nodes[node->children_offset].vb);
+      BB_expand_with_bb(&node->vb, &pbvh->nodes[node->children_offset + 1].vb);
+      node->orig_vb = node->vb;
+    }
+  }
+}
+
+/** \} */
+
+typedef struct PBVHPrimBoundsData {
+  const PBVH *pbvh;
+  const CCGKey *key;
+  BBC *prim_bbc;
+} PBVHPrimBoundsData;
+
+static void pbvh_mesh_prim_bounds_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const PBVHPrimBoundsData *data = userdata;
+  const PBVH *pbvh = data->pbvh;
+  const MLoopTri *lt = &pbvh->looptri[i];
+  BBC *bbc = data->prim_bbc + i;
+
+  BB_reset((BB *)bbc);
+  for (int j = 0; j < 3; j++) {
+    BB_expand((BB *)bbc, pbvh->verts[pbvh->mloop[lt->tri[j]].v].co);
+  }
+  BBC_update_centroid(bbc);
+}
+
+static void pbvh_grid_prim_bounds_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const PBVHPrimBoundsData *data = userdata;
+  const CCGKey *key = data->key;
+  CCGElem *grid = data->pbvh->grids[i];
+  BBC *bbc = data->prim_bbc + i;
+
+  BB_reset((BB *)bbc);
+  for (int j = 0; j < key->grid_area; j++) {
+    BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
+  }
+  BBC_update_centroid(bbc);
+}
+
+/* For each primitive, store the AABB and the AABB centroid. */
+static BBC *pbvh_prim_bounds_calc(const PBVH *pbvh, const CCGKey *key, const int totprim)
+{
+  BBC *prim_bbc = MEM_malloc_arrayN(totprim, sizeof(BBC), "prim_bbc");
+  PBVHPrimBoundsData data = {
+      .pbvh = pbvh,
+      .key = key,
+      .prim_bbc = prim_bbc,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0,
+                          totprim,
+                          &data,
+                          pbvh->looptri ? pbvh_mesh_prim_bounds_cb : pbvh_grid_prim_bounds_cb,
+                          &settings);
+  return prim_bbc;
+}
+
+/* Report the time spent building the tree, e.g. when entering sculpt mode. */
+static void pbvh_build_time_report(const PBVH *pbvh, const double start_time)
+{
+  if (G.debug & G_DEBUG) {
+    printf("PBVH build: %d primitives, %d nodes in %.3f seconds\n",
+           pbvh->totprim,
+           pbvh->totnode,
+           PIL_check_seconds_timer() - start_time);
+  }
 }
 
 void BKE_pbvh_build_mesh(PBVH *pbvh,
@@ -543,8 +998,7 @@ void BKE_pbvh_build_mesh(PBVH *pbvh,
                          const MLoopTri *looptri,
                          int looptri_num)
 {
-  BBC *prim_bbc = NULL;
-  BB cb;
+  const double start_time = PIL_check_seconds_timer();
 
   pbvh->mesh = mesh;
   pbvh->type = PBVH_FACES;
@@ -564,33 +1018,13 @@ void BKE_pbvh_build_mesh(PBVH *pbvh,
   pbvh->face_sets_color_seed = mesh->face_sets_color_seed;
   pbvh->face_sets_color_default = mesh->face_sets_color_default;
 
-  BB_reset(&cb);
-
-  /* For each face, store the AABB and the AABB centroid */
-  prim_bbc = MEM_mallocN(sizeof(BBC) * looptri_num, "prim_bbc");
-
-  for (int i = 0; i < looptri_num; i++) {
-    const MLoopTri *lt = &looptri[i];
-    const int sides = 3;
-    BBC *bbc = prim_bbc + i;
-
-    BB_reset((BB *)bbc);
-
-    for (int j = 0; j < sides; j++) {
-      BB_expand((BB *)bbc, verts[pbvh->mloop[lt->tri[j]].v].co);
-    }
-
-    BBC_update_centroid(bbc);
-
-    BB_expand(&cb, bbc->bcentroid);
-  }
-
   if (looptri_num) {
-    pbvh_build(pbvh, &cb, prim_bbc, looptri_num);
+    BBC *prim_bbc = pbvh_prim_bounds_calc(pbvh, NULL, looptri_num);
+    pbvh_build(pbvh, prim_bbc, looptri_num);
+    MEM_freeN(prim_bbc);
+    pbvh_build_time_report(pbvh, start_time);
   }
 
-  MEM_freeN(prim_bbc);
-
   /* Clear the bitmap so it can be used as an update tag later on. */
   BLI_bitmap_set_all(pbvh->vert_bitmap, false, totvert);
 }
@@ -604,6 +1038,7 @@ void BKE_pbvh_build_grids(PBVH *pbvh,
                           BLI_bitmap **grid_hidden)
 {
   const int gridsize = key->grid_size;
+  const double start_time = PIL_check_seconds_timer();
 
   pbvh->type = PBVH_GRIDS;
   pbvh->grids = grids;
@@ -614,32 +1049,12 @@ void BKE_pbvh_build_grids(PBVH *pbvh,
   pbvh->grid_hidden = grid_hidden;
   pbvh->leaf_limit = max_ii(LEAF_LIMIT / (gridsize * gridsize), 1);
 
-  BB cb;
-  BB_reset(&cb);
-
-  /* For each grid, store the AABB and the AABB centroid */
-  BBC *prim_bbc = MEM_mallocN(sizeof(BBC) * totgrid, "prim_bbc");
-
-  for (int i = 0; i < totgrid; i++) {
-    CCGElem *grid = grids[i];
-    BBC *bbc = prim_bbc + i;
-
-    BB_reset((BB *)bbc);
-
-    for (int j = 0; j < gridsize * gridsize; j++) {
-      BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
-    }
-
-    BBC_update_centroid(bbc);
-
-    BB_expand(&cb, bbc->bcentroid);
-  }
-
   if (totgrid) {
-    pbvh_build(pbvh, &cb, prim_bbc, totgrid);
+    BBC *prim_bbc = pbvh_prim_bounds_calc(pbvh, key, totgrid);
+    pbvh_build(pbvh, prim_bbc, totgrid);
+    MEM_freeN(prim_bbc);
+    pbvh_build_time_report(pbvh, start_time);
   }
-
-  MEM_freeN(prim_bbc);
 }
 
 PBVH *BKE_pbvh_new(void)
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,11 +45,14 @@
 #include "DUNE_pointcache.h"
 #include "DUNE_scene.h"
 #include "DUNE_softbody.h"
+#include "dune_pointcache_ex.h"
 
 #include "LOADER_read_write.h"
 
 #include "BIK_api.h"
 
+#include "pointcache_pack.h"
+
 #ifdef WITH_BULLET
 #  include "RBI_api.h"
 #endif
@@ -69,6 +73,8 @@
 #  include "LzmaLib.h"
 #endif
 
+#include <zstd.h>
+
 /* needed for directory lookup */
 #ifndef WIN32
 #  include <dirent.h>
@@ -93,6 +99,10 @@
 /* could be made into a pointcache option */
 #define DURIAN_POINTCACHE_LIB_OK 1
 
+/* PTCacheMem.flag of frames read from a packed disk cache: the data of this type points into
+ * the memory mapped file, which is released after the frame is freed. */
+#define PTCACHE_MEM_DATA_MAPPED(data_type) (1u << (data_type))
+
 static CLG_LogRef LOG = {"bke.pointcache"};
 
 static int ptcache_data_size[] = {
@@ -1517,6 +1527,10 @@ static int ptcache_file_compressed_read(PTCacheFile *pf, unsigned char *result,
         r = LzmaUncompress(result, &leno, in, &leni, props, sizeOfIt);
       }
 #endif
+      if (compressed == PTCACHE_COMPRESS_ZSTD) {
+        const size_t zstd_len = ZSTD_decompress(result, len, in, in_len);
+        r = (ZSTD_isError(zstd_len) || zstd_len != len);
+      }
       MEM_freeN(in);
     }
   }
@@ -1578,6 +1592,16 @@ static int ptcache_file_compressed_write(
     }
   }
 #endif
+  if (mode == PTCACHE_COMPRESS_ZSTD) {
+    /* `out` is allocated for LZO (see #LZO_OUT_LEN), larger than the zstd bound. */
+    out_len = ZSTD_compress(out, ZSTD_compressBound(in_len), in, in_len, ZSTD_CLEVEL_DEFAULT);
+    if (ZSTD_isError(out_len) || (out_len >= in_len)) {
+      compressed = 0;
+    }
+    else {
+      compressed = PTCACHE_COMPRESS_ZSTD;
+    }
+  }
 
   ptcache_file_write(pf, &compressed, 1, sizeof(unsigned char));
   if (compressed) {
@@ -1793,7 +1817,7 @@ static void ptcache_data_free(PTCacheMem *pm)
   int i;
 
   for (i = 0; i < BPHYS_TOT_DATA; i++) {
-    if (data[i]) {
+    if (data[i] && (pm->flag & PTCACHE_MEM_DATA_MAPPED(i)) == 0) {
       MEM_freeN(data[i]);
     }
   }
@@ -1904,12 +1928,311 @@ static void ptcache_find_frames_around(PTCacheID *pid, unsigned int frame, int *
   }
 }
 
+/* Packed disk cache (#PTCACHE_DISK_PACKED), see pointcache_pack.h. */
+
+/* External caches & caches of streamed data (read & written by their owner) keep a file per
+ * frame. */
+static bool ptcache_pack_used(const PTCacheID *pid)
+{
+  return (pid->cache->flag & (PTCACHE_DISK_PACKED | PTCACHE_EXTERNAL)) == PTCACHE_DISK_PACKED &&
+         pid->write_stream == NULL;
+}
+
+static int ptcache_pack_filepath(PTCacheID *pid, char *filepath)
+{
+  int len = ptcache_filename(pid, filepath, 0, 1, 0);
+  if (len == 0) {
+    return 0;
+  }
+
+  /* Same name as the files of the frames, without frame number. */
+  len = ptcache_filename_ext_append(pid, filepath, (size_t)len, false, 0);
+  len -= strlen(ptcache_file_extension(pid));
+  LIB_strncpy(filepath + len, PTCACHE_PACK_EXT, MAX_PTCACHE_FILE - len);
+
+  return len + strlen(PTCACHE_PACK_EXT);
+}
+
+/**
+ * Read a frame of the packed disk cache.
+ *
+ * \param r_pack: When set, uncompressed data isn't copied but used from the memory mapped file
+ * (see #PTCACHE_MEM_DATA_MAPPED): release the pack after freeing the frame.
+ */
+static PTCacheMem *ptcache_pack_frame_to_mem(PTCacheID *pid, int cfra, PTCachePack **r_pack)
+{
+  char filepath[MAX_PTCACHE_FILE];
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    return NULL;
+  }
+
+  PTCachePack *pack = ptcache_pack_acquire(filepath, pid->type);
+  const PTCachePackFrame *frame = pack ? ptcache_pack_frame_find(pack, cfra) : NULL;
+
+  if (frame == NULL) {
+    if (pack) {
+      ptcache_pack_release(pack);
+    }
+    return NULL;
+  }
+
+  const PTCachePackBlock *blocks = ptcache_pack_frame_blocks(pack, frame);
+  PTCacheMem *pm = MEM_callocN(sizeof(PTCacheMem), "Pointcache mem");
+  unsigned int i, error = 0;
+
+  pm->frame = frame->frame;
+  pm->totpoint = frame->totpoint;
+  pm->data_types = frame->data_types;
+
+  for (i = 0; i < frame->block_num && !error; i++) {
+    const PTCachePackBlock *block = &blocks[i];
+    const unsigned int type = block->type & ~PTCACHE_PACK_BLOCK_EXTRA;
+    const bool is_extra = (block->type & PTCACHE_PACK_BLOCK_EXTRA) != 0;
+
+    /* The block must match the data it's read into. */
+    if (is_extra) {
+      error = (type == 0 || type >= ARRAY_SIZE(ptcache_extra_datasize) ||
+               block->elem_size != ptcache_extra_datasize[type]);
+    }
+    else {
+      error = (type >= BPHYS_TOT_DATA || (pm->data_types & (1 << type)) == 0 || pm->data[type] ||
+               block->elem_size != ptcache_data_size[type] || block->totdata != pm->totpoint);
+    }
+    if (error) {
+      break;
+    }
+
+    bool owned;
+    void *data = ptcache_pack_block_data(pack, frame, i, &owned);
+    if (data == NULL) {
+      error = 1;
+      break;
+    }
+    if (!owned && (is_extra || r_pack == NULL)) {
+      const size_t data_len = (size_t)block->totdata * block->elem_size;
+      data = memcpy(MEM_mallocN(data_len, "PTCache Data"), data, data_len);
+      owned = true;
+    }
+
+    if (is_extra) {
+      PTCacheExtra *extra = MEM_callocN(sizeof(PTCacheExtra), "Pointcache extradata");
+      extra->type = type;
+      extra->totdata = block->totdata;
+      extra->data = data;
+      LIB_addtail(&pm->extradata, extra);
+    }
+    else {
+      pm->data[type] = data;
+      if (!owned) {
+        pm->flag |= PTCACHE_MEM_DATA_MAPPED(type);
+      }
+    }
+  }
+
+  for (i = 0; i < BPHYS_TOT_DATA && !error; i++) {
+    error = (pm->data_types & (1 << i)) && pm->data[i] == NULL;
+  }
+
+  if (error) {
+    ptcache_mem_clear(pm);
+    MEM_freeN(pm);
+    pm = NULL;
+
+    if (G.debug & G_DEBUG) {
+      printf("Error reading from disk cache\n");
+    }
+  }
+
+  if (pm && r_pack) {
+    *r_pack = pack;
+  }
+  else {
+    ptcache_pack_release(pack);
+  }
+
+  return pm;
+}
+
+static int ptcache_pack_mem_to_disk(PTCacheID *pid, PTCacheMem *pm)
+{
+  char filepath[MAX_PTCACHE_FILE];
+  PTCachePackBlock blocks[BPHYS_TOT_DATA + 8];
+  const void *blocks_data[ARRAY_SIZE(blocks)];
+  PTCachePackFrame frame = {0};
+  unsigned int i;
+  int ok;
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    if (G.debug & G_DEBUG) {
+      printf("Error opening disk cache file for writing\n");
+    }
+    return 0;
+  }
+
+  frame.frame = (int)pm->frame;
+  frame.totpoint = pm->totpoint;
+
+  PTCachePackBlock *blocks_all = blocks;
+  const void **blocks_data_all = blocks_data;
+  unsigned int blocks_num = BPHYS_TOT_DATA + LIB_listbase_count(&pm->extradata);
+  if (blocks_num > ARRAY_SIZE(blocks)) {
+    blocks_all = MEM_mallocN(sizeof(*blocks_all) * blocks_num, __func__);
+    blocks_data_all = MEM_mallocN(sizeof(*blocks_data_all) * blocks_num, __func__);
+  }
+
+  /* A block per data type, followed by the extra data. */
+  for (i = 0; i < BPHYS_TOT_DATA; i++) {
+    if (pm->data[i]) {
+      PTCachePackBlock *block = &blocks_all[frame.block_num];
+      memset(block, 0, sizeof(*block));
+      block->type = i;
+      block->totdata = pm->totpoint;
+      block->elem_size = ptcache_data_size[i];
+      blocks_data_all[frame.block_num++] = pm->data[i];
+      frame.data_types |= (1 << i);
+    }
+  }
+  LISTBASE_FOREACH (PTCacheExtra *, extra, &pm->extradata) {
+    if (extra->data == NULL || extra->totdata == 0) {
+      continue;
+    }
+    PTCachePackBlock *block = &blocks_all[frame.block_num];
+    memset(block, 0, sizeof(*block));
+    block->type = PTCACHE_PACK_BLOCK_EXTRA | extra->type;
+    block->totdata = extra->totdata;
+    block->elem_size = ptcache_extra_datasize[extra->type];
+    blocks_data_all[frame.block_num++] = extra->data;
+  }
+
+  ok = ptcache_pack_frame_write(
+      filepath, pid->type, &frame, blocks_all, blocks_data_all, pid->cache->compression);
+
+  if (blocks_all != blocks) {
+    MEM_freeN(blocks_all);
+    MEM_freeN((void *)blocks_data_all);
+  }
+
+  if (!ok && G.debug & G_DEBUG) {
+    printf("Error writing to disk cache\n");
+  }
+
+  return ok;
+}
+
+static bool ptcache_pack_frame_exists(PTCacheID *pid, int cfra)
+{
+  char filepath[MAX_PTCACHE_FILE];
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    return false;
+  }
+
+  PTCachePack *pack = ptcache_pack_acquire(filepath, pid->type);
+  if (pack == NULL) {
+    return false;
+  }
+
+  const bool exists = ptcache_pack_frame_find(pack, cfra) != NULL;
+  ptcache_pack_release(pack);
+
+  return exists;
+}
+
+/* Flag the frames of the packed disk cache from `sta` to `end` in `cached_frames`. */
+static void ptcache_pack_cached_frames_fill(PTCacheID *pid, char *cached_frames, int sta, int end)
+{
+  char filepath[MAX_PTCACHE_FILE];
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    return;
+  }
+
+  PTCachePack *pack = ptcache_pack_acquire(filepath, pid->type);
+  if (pack == NULL) {
+    return;
+  }
+
+  uint frames_num;
+  const PTCachePackFrame *frames = ptcache_pack_frames_get(pack, &frames_num);
+  for (uint i = 0; i < frames_num; i++) {
+    if (frames[i].frame >= sta && frames[i].frame <= end) {
+      cached_frames[frames[i].frame - sta] = 1;
+    }
+  }
+  ptcache_pack_release(pack);
+}
+
+/* Decompress the frames following `cfra` on a background thread, during playback. */
+static void ptcache_pack_prefetch_frames(PTCacheID *pid, int cfra)
+{
+  char filepath[MAX_PTCACHE_FILE];
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    return;
+  }
+
+  PTCachePack *pack = ptcache_pack_acquire(filepath, pid->type);
+  if (pack) {
+    ptcache_pack_prefetch(pack, cfra);
+    ptcache_pack_release(pack);
+  }
+}
+
+/* Same as the #BKE_ptcache_id_clear modes for the packed disk cache. */
+static void ptcache_pack_clear(PTCacheID *pid, int mode, int cfra)
+{
+  PointCache *cache = pid->cache;
+  const int sta = cache->startframe, end = cache->endframe;
+  int frame_min = INT_MIN, frame_max = INT_MAX;
+  char filepath[MAX_PTCACHE_FILE];
+
+  if (ptcache_pack_filepath(pid, filepath) == 0) {
+    return;
+  }
+
+  switch (mode) {
+    case PTCACHE_CLEAR_ALL:
+      if (BLI_exists(filepath)) {
+        cache->last_exact = MIN2(cache->startframe, 0);
+        ptcache_pack_close(filepath);
+        BLI_delete(filepath, false, false);
+      }
+      if (cache->cached_frames) {
+        memset(cache->cached_frames, 0, MEM_allocN_len(cache->cached_frames));
+      }
+      return;
+    case PTCACHE_CLEAR_BEFORE:
+      frame_max = cfra - 1;
+      break;
+    case PTCACHE_CLEAR_AFTER:
+      frame_min = cfra + 1;
+      break;
+    case PTCACHE_CLEAR_FRAME:
+      frame_min = frame_max = cfra;
+      break;
+  }
+
+  ptcache_pack_frames_remove(filepath, pid->type, frame_min, frame_max);
+
+  if (cache->cached_frames) {
+    for (int frame = MAX2(frame_min, sta); frame <= MIN2(frame_max, end); frame++) {
+      cache->cached_frames[frame - sta] = 0;
+    }
+  }
+}
+
 static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 {
-  PTCacheFile *pf = ptcache_file_open(pid, PTCACHE_FILE_READ, cfra);
+  PTCacheFile *pf;
   PTCacheMem *pm = NULL;
   unsigned int i, error = 0;
 
+  if (ptcache_pack_used(pid)) {
+    return ptcache_pack_frame_to_mem(pid, cfra, NULL);
+  }
+
+  pf = ptcache_file_open(pid, PTCACHE_FILE_READ, cfra);
   if (pf == NULL) {
     return NULL;
   }
@@ -2000,6 +2323,11 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
   PTCacheFile *pf = NULL;
   unsigned int i, error = 0;
 
+  if (ptcache_pack_used(pid)) {
+    /* Replaces the frame in the pack. */
+    return ptcache_pack_mem_to_disk(pid, pm);
+  }
+
   DUNE_ptcache_id_clear(pid, PTCACHE_CLEAR_FRAME, pm->frame);
 
   pf = ptcache_file_open(pid, PTCACHE_FILE_WRITE, pm->frame);
@@ -2142,12 +2470,19 @@ static int ptcache_read_stream(PTCacheID *pid, int cfra)
 static int ptcache_read(PTCacheID *pid, int cfra)
 {
   PTCacheMem *pm = NULL;
+  PTCachePack *pack = NULL;
   int i;
   int *index = &i;
 
   /* get a memory cache to read from */
   if (pid->cache->flag & PTCACHE_DISK_CACHE) {
-    pm = ptcache_disk_frame_to_mem(pid, cfra);
+    if (ptcache_pack_used(pid)) {
+      /* Read the data in place, from the memory mapped file. */
+      pm = ptcache_pack_frame_to_mem(pid, cfra, &pack);
+    }
+    else {
+      pm = ptcache_disk_frame_to_mem(pid, cfra);
+    }
   }
   else {
     pm = pid->cache->mem_cache.first;
@@ -2194,17 +2529,27 @@ static int ptcache_read(PTCacheID *pid, int cfra)
     }
   }
 
+  if (pack) {
+    ptcache_pack_release(pack);
+  }
+
   return 1;
 }
 static int ptcache_interpolate(PTCacheID *pid, float cfra, int cfra1, int cfra2)
 {
   PTCacheMem *pm = NULL;
+  PTCachePack *pack = NULL;
   int i;
   int *index = &i;
 
   /* get a memory cache to read from */
   if (pid->cache->flag & PTCACHE_DISK_CACHE) {
-    pm = ptcache_disk_frame_to_mem(pid, cfra2);
+    if (ptcache_pack_used(pid)) {
+      pm = ptcache_pack_frame_to_mem(pid, cfra2, &pack);
+    }
+    else {
+      pm = ptcache_disk_frame_to_mem(pid, cfra2);
+    }
   }
   else {
     pm = pid->cache->mem_cache.first;
@@ -2250,6 +2595,10 @@ static int ptcache_interpolate(PTCacheID *pid, float cfra, int cfra1, int cfra2)
     }
   }
 
+  if (pack) {
+    ptcache_pack_release(pack);
+  }
+
   return 1;
 }
 /* reads cache from disk or memory */
@@ -2333,6 +2682,10 @@ int DUNE_ptcache_read(PTCacheID *pid, float cfra, bool no_extrapolate_old)
     pid->cache->simframe = cfra2;
   }
 
+  if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_pack_used(pid)) {
+    ptcache_pack_prefetch_frames(pid, cfra2 ? cfra2 : cfra1);
+  }
+
   cfrai = (int)cfra;
   /* clear invalid cache frames so that better stuff can be simulated */
   if (pid->cache->flag & PTCACHE_OUTDATED) {
@@ -2601,7 +2954,10 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
     case PTCACHE_CLEAR_ALL:
     case PTCACHE_CLEAR_BEFORE:
     case PTCACHE_CLEAR_AFTER:
-      if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+      if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_pack_used(pid)) {
+        ptcache_pack_clear(pid, mode, cfra);
+      }
+      else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
         ptcache_path(pid, path);
 
         dir = opendir(path);
@@ -2691,8 +3047,13 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
     case PTCACHE_CLEAR_FRAME:
       if (pid->cache->flag & PTCACHE_DISK_CACHE) {
         if (BKE_ptcache_id_exist(pid, cfra)) {
-          ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
-          BLI_delete(filename, false, false);
+          if (ptcache_pack_used(pid)) {
+            ptcache_pack_clear(pid, mode, cfra);
+          }
+          else {
+            ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
+            BLI_delete(filename, false, false);
+          }
         }
       }
       else {
@@ -2732,6 +3093,10 @@ bool BKE_ptcache_id_exist(PTCacheID *pid, int cfra)
   if (pid->cache->flag & PTCACHE_DISK_CACHE) {
     char filename[MAX_PTCACHE_FILE];
 
+    if (ptcache_pack_used(pid)) {
+      return ptcache_pack_frame_exists(pid, cfra);
+    }
+
     ptcache_filename(pid, filename, cfra, 1, 1);
 
     return BLI_exists(filename);
@@ -2797,7 +3162,11 @@ void BKE_ptcache_id_time(
     cache->cached_frames = MEM_callocN(sizeof(char) * cache->cached_frames_len,
                                        "cached frames array");
 
-    if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+    if ((pid->cache->flag & PTCACHE_DISK_CACHE) && ptcache_pack_used(pid)) {
+      /* All frames are in one file, listed by its index. */
+      ptcache_pack_cached_frames_fill(pid, cache->cached_frames, (int)sta, (int)end);
+    }
+    else if (pid->cache->flag & PTCACHE_DISK_CACHE) {
       /* mode is same as fopen's modes */
       DIR *dir;
       struct dirent *de;
@@ -3455,6 +3824,51 @@ void BKE_ptcache_toggle_disk_cache(PTCacheID *pid)
   }
 }
 
+void DUNE_ptcache_toggle_disk_pack(PTCacheID *pid)
+{
+  PointCache *cache = pid->cache;
+  int last_exact = cache->last_exact;
+  int baked = cache->flag & PTCACHE_BAKED;
+
+  /* Memory & external caches have nothing to convert, streamed caches aren't packed. */
+  if ((cache->flag & PTCACHE_DISK_CACHE) == 0 || (cache->flag & PTCACHE_EXTERNAL) ||
+      pid->write_stream) {
+    return;
+  }
+
+  if (cache->cached_frames) {
+    MEM_freeN(cache->cached_frames);
+    cache->cached_frames = NULL;
+    cache->cached_frames_len = 0;
+  }
+
+  /* Read the frames in the previous format & remove its files. */
+  cache->flag ^= PTCACHE_DISK_PACKED;
+  cache->flag &= ~PTCACHE_DISK_CACHE;
+  BKE_ptcache_disk_to_mem(pid);
+  cache->flag |= PTCACHE_DISK_CACHE;
+
+  cache->flag &= ~PTCACHE_BAKED;
+  BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_ALL, 0);
+  cache->flag |= baked;
+
+  /* Write them in the new format, clears the disk cache flag on failure. */
+  cache->flag ^= PTCACHE_DISK_PACKED;
+  BKE_ptcache_mem_to_disk(pid);
+
+  if (cache->flag & PTCACHE_DISK_CACHE) {
+    cache->flag &= ~(PTCACHE_DISK_CACHE | PTCACHE_BAKED);
+    BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_ALL, 0);
+    cache->flag |= PTCACHE_DISK_CACHE | baked;
+  }
+
+  cache->last_exact = last_exact;
+
+  BKE_ptcache_id_time(pid, NULL, 0.0f, NULL, NULL, NULL);
+
+  cache->flag |= PTCACHE_FLAG_INFO_DIRTY;
+}
+
 void DUNE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const char *name_dst)
 {
   char old_name[80];
@@ -3481,6 +3895,20 @@ void DUNE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const
 
   len = ptcache_filename(pid, old_filename, 0, 0, 0); /* no path */
 
+  if (ptcache_pack_used(pid)) {
+    /* All frames are in one file. */
+    if (ptcache_pack_filepath(pid, old_path_full) && BLI_exists(old_path_full)) {
+      BLI_strncpy(pid->cache->name, name_dst, sizeof(pid->cache->name));
+      if (ptcache_pack_filepath(pid, new_path_full)) {
+        ptcache_pack_close(old_path_full);
+        ptcache_pack_close(new_path_full);
+        LIB_rename(old_path_full, new_path_full);
+      }
+    }
+    BLI_strncpy(pid->cache->name, old_name, sizeof(pid->cache->name));
+    return;
+  }
+
   ptcache_path(pid, path);
   dir = opendir(path);
   if (dir == NULL) {
@@ -0,0 +1,992 @@
+/* Packed disk cache of point caches, see pointcache_pack.h. */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+#  include <unistd.h>
+#else
+#  include <io.h>
+#endif
+
+#include <zstd.h>
+
+#include "CLG_log.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "TYPES_pointcache.h"
+
+#include "LIB_fileops.h"
+#include "LIB_listbase.h"
+#include "LIB_mmap.h"
+#include "LIB_path_util.h"
+#include "LIB_string.h"
+#include "LIB_task.h"
+#include "LIB_threads.h"
+#include "LIB_utildefines.h"
+
+#include "dune_pointcache_ex.h"
+
+#include "pointcache_pack.h"
+
+#define PTCACHE_PACK_ID "BPHYSPAK"
+#define PTCACHE_PACK_INDEX_ID "BPHYSIDX"
+#define PTCACHE_PACK_VERSION 1
+/* Byte order of the file, which is only read on machines of the same byte order. */
+#define PTCACHE_PACK_ENDIAN 0x01020304
+
+/* Packs kept open without readers, the least recently used ones are closed. */
+#define PTCACHE_PACK_OPEN_MAX 16
+/* Frames prepared ahead of playback, with twice as many slots to keep the frames read last. */
+#define PTCACHE_PACK_PREFETCH_FRAMES 4
+#define PTCACHE_PACK_PREFETCH_SLOTS (PTCACHE_PACK_PREFETCH_FRAMES * 2)
+/* Compact the file when its unused bytes exceed the used ones, and this size. */
+#define PTCACHE_PACK_COMPACT_MIN (1 << 20)
+
+#define PTCACHE_PACK_ALIGN_SIZE(size) \
+  (((size) + (PTCACHE_PACK_ALIGN - 1)) & ~(uint64_t)(PTCACHE_PACK_ALIGN - 1))
+
+static CLG_LogRef LOG = {"bke.pointcache"};
+
+typedef struct PTCachePackHeader {
+  char id[8];
+  uint32_t version;
+  uint32_t endian;
+  int32_t type;
+  uint32_t _pad[3];
+} PTCachePackHeader;
+
+typedef struct PTCachePackTrailer {
+  uint64_t index_offset;
+  uint32_t frames_num;
+  uint32_t blocks_num;
+  char id[8];
+} PTCachePackTrailer;
+
+typedef struct PTCachePackIndex {
+  PTCachePackFrame *frames;
+  PTCachePackBlock *blocks;
+  uint frames_num;
+  uint blocks_num;
+  /* Location of the index in the file, where the blocks of the next frame are written. */
+  uint64_t offset;
+} PTCachePackIndex;
+
+typedef struct PTCachePackPrefetch {
+  /* Frame prepared (or being prepared) in this slot, INT_MIN when unused. */
+  int frame;
+  bool done;
+  /* Decompressed data of each block of the frame, once done. NULL for uncompressed blocks &
+   * blocks taken by #ptcache_pack_block_data. */
+  void **blocks_data;
+  uint blocks_num;
+} PTCachePackPrefetch;
+
+struct PTCachePack {
+  struct PTCachePack *next, *prev;
+
+  char *filepath;
+  int type;
+  /* Readers & the list of open packs. */
+  int users;
+  /* Removed from the open packs (the file changed or is about to), still mapped for its readers,
+   * in #ptcache_packs_closed. */
+  bool is_closed;
+
+  /* State of the file when it was mapped, to detect changes. */
+  int64_t file_size;
+  int64_t file_mtime;
+
+  LIB_mmap_file *mmap;
+  const char *mem;
+  PTCachePackIndex index;
+
+  /* Decompression of the frames ahead of playback. */
+  TaskPool *prefetch_pool;
+  ThreadMutex prefetch_mutex;
+  PTCachePackPrefetch prefetch[PTCACHE_PACK_PREFETCH_SLOTS];
+  int prefetch_last_frame;
+};
+
+/* Open packs, the most recently used first. */
+static ListBase ptcache_packs = {NULL, NULL};
+/* Packs no longer open, which are still mapped until their readers release them. */
+static ListBase ptcache_packs_closed = {NULL, NULL};
+static ThreadMutex ptcache_packs_mutex = LIB_MUTEX_INITIALIZER;
+
+/* -------------------------------------------------------------------- */
+/* Index */
+
+typedef bool (*PTCachePackReadFn)(void *handle, void *dest, uint64_t offset, uint64_t len);
+
+static bool ptcache_pack_read_mmap(void *handle, void *dest, uint64_t offset, uint64_t len)
+{
+  return LIB_mmap_read((LIB_mmap_file *)handle, dest, (size_t)offset, (size_t)len);
+}
+
+static bool ptcache_pack_read_file(void *handle, void *dest, uint64_t offset, uint64_t len)
+{
+  FILE *fp = (FILE *)handle;
+  return (LIB_fseek(fp, (int64_t)offset, SEEK_SET) == 0) && (fread(dest, 1, len, fp) == len);
+}
+
+static bool ptcache_pack_write_file(FILE *fp, const void *data, uint64_t offset, uint64_t len)
+{
+  return (LIB_fseek(fp, (int64_t)offset, SEEK_SET) == 0) && (fwrite(data, 1, len, fp) == len);
+}
+
+static void ptcache_pack_index_free(PTCachePackIndex *index)
+{
+  MEM_SAFE_FREE(index->frames);
+  MEM_SAFE_FREE(index->blocks);
+  index->frames_num = 0;
+  index->blocks_num = 0;
+}
+
+static bool ptcache_pack_index_is_valid(const PTCachePackIndex *index)
+{
+  for (uint i = 0; i < index->blocks_num; i++) {
+    const PTCachePackBlock *block = &index->blocks[i];
+    const uint64_t raw_size = (uint64_t)block->totdata * block->elem_size;
+
+    if (block->offset < sizeof(PTCachePackHeader) || block->offset > index->offset ||
+        block->size > index->offset - block->offset || (block->offset % PTCACHE_PACK_ALIGN)) {
+      return false;
+    }
+    if (block->compression == PTCACHE_COMPRESS_NO) {
+      if (block->size != raw_size) {
+        return false;
+      }
+    }
+    else if (block->compression != PTCACHE_COMPRESS_ZSTD) {
+      return false;
+    }
+  }
+
+  for (uint i = 0; i < index->frames_num; i++) {
+    const PTCachePackFrame *frame = &index->frames[i];
+
+    if ((i > 0 && frame->frame <= index->frames[i - 1].frame) ||
+        frame->block_first > index->blocks_num ||
+        frame->block_num > index->blocks_num - frame->block_first) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Read & validate the header & index of a pack of `file_len` bytes. */
+static bool ptcache_pack_index_read(PTCachePackReadFn read_fn,
+                                    void *handle,
+                                    uint64_t file_len,
+                                    int type,
+                                    PTCachePackIndex *r_index)
+{
+  PTCachePackHeader header;
+  PTCachePackTrailer trailer;
+
+  memset(r_index, 0, sizeof(*r_index));
+
+  if (file_len < sizeof(header) + sizeof(trailer) ||
+      !read_fn(handle, &header, 0, sizeof(header)) ||
+      !read_fn(handle, &trailer, file_len - sizeof(trailer), sizeof(trailer))) {
+    return false;
+  }
+
+  if (memcmp(header.id, PTCACHE_PACK_ID, sizeof(header.id)) != 0 ||
+      header.version != PTCACHE_PACK_VERSION || header.endian != PTCACHE_PACK_ENDIAN ||
+      header.type != type || memcmp(trailer.id, PTCACHE_PACK_INDEX_ID, sizeof(trailer.id)) != 0) {
+    return false;
+  }
+
+  const uint64_t index_end = file_len - sizeof(trailer);
+  const uint64_t frames_size = sizeof(PTCachePackFrame) * (uint64_t)trailer.frames_num;
+  const uint64_t blocks_size = sizeof(PTCachePackBlock) * (uint64_t)trailer.blocks_num;
+
+  if (trailer.index_offset < sizeof(header) || trailer.index_offset > index_end ||
+      frames_size + blocks_size > index_end - trailer.index_offset) {
+    return false;
+  }
+
+  r_index->offset = trailer.index_offset;
+  r_index->frames_num = trailer.frames_num;
+  r_index->blocks_num = trailer.blocks_num;
+  if (trailer.frames_num) {
+    r_index->frames = MEM_mallocN((size_t)frames_size, "PTCachePackIndex frames");
+  }
+  if (trailer.blocks_num) {
+    r_index->blocks = MEM_mallocN((size_t)blocks_size, "PTCachePackIndex blocks");
+  }
+
+  if ((r_index->frames &&
+       !read_fn(handle, r_index->frames, trailer.index_offset, frames_size)) ||
+      (r_index->blocks &&
+       !read_fn(handle, r_index->blocks, trailer.index_offset + frames_size, blocks_size)) ||
+      !ptcache_pack_index_is_valid(r_index)) {
+    ptcache_pack_index_free(r_index);
+    return false;
+  }
+
+  return true;
+}
+
+/* Write `index` at `offset`, followed by the trailer ending the file beyond `file_len`
+ * (the previous end), so the file always grows. */
+static bool ptcache_pack_index_write(FILE *fp,
+                                     PTCachePackIndex *index,
+                                     uint64_t offset,
+                                     uint64_t file_len)
+{
+  const uint64_t frames_size = sizeof(PTCachePackFrame) * (uint64_t)index->frames_num;
+  const uint64_t blocks_size = sizeof(PTCachePackBlock) * (uint64_t)index->blocks_num;
+  uint64_t trailer_offset = offset + frames_size + blocks_size;
+
+  if (trailer_offset + sizeof(PTCachePackTrailer) <= file_len) {
+    trailer_offset = file_len;
+  }
+
+  PTCachePackTrailer trailer = {0};
+  trailer.index_offset = offset;
+  trailer.frames_num = index->frames_num;
+  trailer.blocks_num = index->blocks_num;
+  memcpy(trailer.id, PTCACHE_PACK_INDEX_ID, sizeof(trailer.id));
+
+  index->offset = offset;
+
+  return ptcache_pack_write_file(fp, index->frames, offset, frames_size) &&
+         ptcache_pack_write_file(fp, index->blocks, offset + frames_size, blocks_size) &&
+         ptcache_pack_write_file(fp, &trailer, trailer_offset, sizeof(trailer));
+}
+
+static bool ptcache_pack_header_write(FILE *fp, int type)
+{
+  PTCachePackHeader header = {{0}};
+  memcpy(header.id, PTCACHE_PACK_ID, sizeof(header.id));
+  header.version = PTCACHE_PACK_VERSION;
+  header.endian = PTCACHE_PACK_ENDIAN;
+  header.type = type;
+
+  return ptcache_pack_write_file(fp, &header, 0, sizeof(header));
+}
+
+/* Bytes of the file the blocks of the index don't use: blocks of removed & replaced frames,
+ * indices these frames were written over. */
+static uint64_t ptcache_pack_index_unused_size(const PTCachePackIndex *index, uint64_t *r_used)
+{
+  uint64_t used = 0;
+  for (uint i = 0; i < index->blocks_num; i++) {
+    used += PTCACHE_PACK_ALIGN_SIZE(index->blocks[i].size);
+  }
+  *r_used = used;
+
+  const uint64_t data_size = index->offset - sizeof(PTCachePackHeader);
+  return (data_size > used) ? data_size - used : 0;
+}
+
+static int ptcache_pack_frame_index_find(const PTCachePackIndex *index, int frame)
+{
+  /* First frame not before `frame`. */
+  int low = 0, high = (int)index->frames_num;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    if (index->frames[mid].frame < frame) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/* Append `frame` to `index` (allocated large enough), with its blocks from `blocks`, indexed
+ * by the #PTCachePackFrame.block_first of the frame. */
+static void ptcache_pack_index_append(PTCachePackIndex *index,
+                                      const PTCachePackFrame *frame,
+                                      const PTCachePackBlock *blocks)
+{
+  PTCachePackFrame *frame_dst = &index->frames[index->frames_num++];
+  *frame_dst = *frame;
+  frame_dst->block_first = index->blocks_num;
+  memcpy(&index->blocks[index->blocks_num],
+         &blocks[frame->block_first],
+         sizeof(PTCachePackBlock) * frame->block_num);
+  index->blocks_num += frame->block_num;
+}
+
+/* -------------------------------------------------------------------- */
+/* Reading */
+
+static void ptcache_pack_prefetch_slot_clear(PTCachePackPrefetch *prefetch)
+{
+  if (prefetch->blocks_data) {
+    for (uint i = 0; i < prefetch->blocks_num; i++) {
+      MEM_SAFE_FREE(prefetch->blocks_data[i]);
+    }
+    MEM_freeN(prefetch->blocks_data);
+  }
+  prefetch->frame = INT_MIN;
+  prefetch->done = false;
+  prefetch->blocks_data = NULL;
+  prefetch->blocks_num = 0;
+}
+
+static PTCachePack *ptcache_pack_open(const char *filepath, int type)
+{
+  const int file = LIB_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return NULL;
+  }
+
+  LIB_stat_t st;
+  LIB_mmap_file *mmap = NULL;
+  if (LIB_fstat(file, &st) == 0 && st.st_size > 0) {
+    mmap = LIB_mmap_open(file);
+  }
+  /* The mapping stays valid without the file descriptor. */
+  close(file);
+
+  if (mmap == NULL) {
+    return NULL;
+  }
+
+  PTCachePack *pack = MEM_callocN(sizeof(PTCachePack), "PTCachePack");
+  if (!ptcache_pack_index_read(
+          ptcache_pack_read_mmap, mmap, LIB_mmap_get_length(mmap), type, &pack->index)) {
+    CLOG_WARN(&LOG, "Invalid point cache file '%s'", filepath);
+    LIB_mmap_free(mmap);
+    MEM_freeN(pack);
+    return NULL;
+  }
+
+  pack->filepath = LIB_strdup(filepath);
+  pack->type = type;
+  pack->file_size = (int64_t)st.st_size;
+  pack->file_mtime = (int64_t)st.st_mtime;
+  pack->mmap = mmap;
+  pack->mem = LIB_mmap_get_ptr(mmap);
+
+  LIB_mutex_init(&pack->prefetch_mutex);
+  for (int i = 0; i < PTCACHE_PACK_PREFETCH_SLOTS; i++) {
+    pack->prefetch[i].frame = INT_MIN;
+  }
+  pack->prefetch_last_frame = INT_MIN;
+
+  return pack;
+}
+
+static void ptcache_pack_prefetch_cancel(PTCachePack *pack)
+{
+  /* Waits for the task being run, without the lock it takes. */
+  if (pack->prefetch_pool) {
+    LIB_task_pool_cancel(pack->prefetch_pool);
+  }
+}
+
+static void ptcache_pack_free(PTCachePack *pack)
+{
+  if (pack->prefetch_pool) {
+    LIB_task_pool_cancel(pack->prefetch_pool);
+    LIB_task_pool_free(pack->prefetch_pool);
+  }
+  for (int i = 0; i < PTCACHE_PACK_PREFETCH_SLOTS; i++) {
+    ptcache_pack_prefetch_slot_clear(&pack->prefetch[i]);
+  }
+  LIB_mutex_end(&pack->prefetch_mutex);
+
+  LIB_mmap_free(pack->mmap);
+  ptcache_pack_index_free(&pack->index);
+  MEM_freeN(pack->filepath);
+  MEM_freeN(pack);
+}
+
+/* Remove the pack from the open packs, it's freed once its readers release it.
+ * Call with #ptcache_packs_mutex locked. */
+static void ptcache_pack_unlink(PTCachePack *pack)
+{
+  LIB_remlink(&ptcache_packs, pack);
+  if (--pack->users == 0) {
+    ptcache_pack_free(pack);
+  }
+  else {
+    /* Prefetching is of no use when the file is about to change. */
+    ptcache_pack_prefetch_cancel(pack);
+    pack->is_closed = true;
+    LIB_addtail(&ptcache_packs_closed, pack);
+  }
+}
+
+static PTCachePack *ptcache_pack_find(const char *filepath)
+{
+  LISTBASE_FOREACH (PTCachePack *, pack, &ptcache_packs) {
+    if (STREQ(pack->filepath, filepath)) {
+      return pack;
+    }
+  }
+  return NULL;
+}
+
+PTCachePack *ptcache_pack_acquire(const char *filepath, int type)
+{
+  LIB_stat_t st;
+  const bool exists = (LIB_stat(filepath, &st) == 0);
+
+  LIB_mutex_lock(&ptcache_packs_mutex);
+
+  PTCachePack *pack = ptcache_pack_find(filepath);
+  if (pack && (!exists || pack->type != type || pack->file_size != (int64_t)st.st_size ||
+               pack->file_mtime != (int64_t)st.st_mtime)) {
+    ptcache_pack_unlink(pack);
+    pack = NULL;
+  }
+
+  if (pack) {
+    /* Most recently used first. */
+    LIB_remlink(&ptcache_packs, pack);
+    LIB_addhead(&ptcache_packs, pack);
+  }
+  else if (exists && (pack = ptcache_pack_open(filepath, type))) {
+    pack->users = 1;
+    LIB_addhead(&ptcache_packs, pack);
+
+    /* Close the least recently used packs without readers. */
+    int open_num = 0;
+    PTCachePack *pack_iter = ptcache_packs.first;
+    while (pack_iter) {
+      PTCachePack *pack_next = pack_iter->next;
+      if (++open_num > PTCACHE_PACK_OPEN_MAX && pack_iter->users == 1) {
+        ptcache_pack_unlink(pack_iter);
+      }
+      pack_iter = pack_next;
+    }
+  }
+
+  if (pack) {
+    pack->users++;
+  }
+
+  LIB_mutex_unlock(&ptcache_packs_mutex);
+
+  return pack;
+}
+
+void ptcache_pack_release(PTCachePack *pack)
+{
+  LIB_mutex_lock(&ptcache_packs_mutex);
+  if (--pack->users == 0) {
+    if (pack->is_closed) {
+      LIB_remlink(&ptcache_packs_closed, pack);
+    }
+    ptcache_pack_free(pack);
+  }
+  LIB_mutex_unlock(&ptcache_packs_mutex);
+}
+
+bool ptcache_pack_close(const char *filepath)
+{
+  LIB_mutex_lock(&ptcache_packs_mutex);
+  PTCachePack *pack = ptcache_pack_find(filepath);
+  if (pack) {
+    ptcache_pack_unlink(pack);
+  }
+  bool is_mapped = false;
+  LISTBASE_FOREACH (PTCachePack *, pack_closed, &ptcache_packs_closed) {
+    if (STREQ(pack_closed->filepath, filepath)) {
+      is_mapped = true;
+      break;
+    }
+  }
+  LIB_mutex_unlock(&ptcache_packs_mutex);
+
+  return !is_mapped;
+}
+
+void DUNE_ptcache_pack_exit(void)
+{
+  LIB_mutex_lock(&ptcache_packs_mutex);
+  while (ptcache_packs.first) {
+    ptcache_pack_unlink(ptcache_packs.first);
+  }
+  LIB_mutex_unlock(&ptcache_packs_mutex);
+}
+
+const PTCachePackFrame *ptcache_pack_frames_get(const PTCachePack *pack, uint *r_frames_num)
+{
+  *r_frames_num = pack->index.frames_num;
+  return pack->index.frames;
+}
+
+const PTCachePackFrame *ptcache_pack_frame_find(const PTCachePack *pack, int frame)
+{
+  const int index = ptcache_pack_frame_index_find(&pack->index, frame);
+  if (index < (int)pack->index.frames_num && pack->index.frames[index].frame == frame) {
+    return &pack->index.frames[index];
+  }
+  return NULL;
+}
+
+const PTCachePackBlock *ptcache_pack_frame_blocks(const PTCachePack *pack,
+                                                  const PTCachePackFrame *frame)
+{
+  return &pack->index.blocks[frame->block_first];
+}
+
+/* The mapping was read without I/O errors (after which it reads as zeros). */
+static bool ptcache_pack_mmap_is_valid(PTCachePack *pack)
+{
+  char id;
+  return LIB_mmap_read(pack->mmap, &id, 0, sizeof(id));
+}
+
+static void *ptcache_pack_block_decompress(PTCachePack *pack, const PTCachePackBlock *block)
+{
+  const size_t raw_size = (size_t)block->totdata * block->elem_size;
+  void *data = MEM_mallocN(raw_size, "PTCache Data");
+
+  const size_t size = ZSTD_decompress(data, raw_size, pack->mem + block->offset, block->size);
+  if (ZSTD_isError(size) || size != raw_size || !ptcache_pack_mmap_is_valid(pack)) {
+    MEM_freeN(data);
+    return NULL;
+  }
+  return data;
+}
+
+void *ptcache_pack_block_data(PTCachePack *pack,
+                              const PTCachePackFrame *frame,
+                              uint block_index,
+                              bool *r_owned)
+{
+  const PTCachePackBlock *block = &pack->index.blocks[frame->block_first + block_index];
+
+  if (block->compression == PTCACHE_COMPRESS_NO) {
+    *r_owned = false;
+    return ptcache_pack_mmap_is_valid(pack) ? (void *)(pack->mem + block->offset) : NULL;
+  }
+
+  *r_owned = true;
+
+  /* Take the data decompressed ahead. */
+  void *data = NULL;
+  LIB_mutex_lock(&pack->prefetch_mutex);
+  for (int i = 0; i < PTCACHE_PACK_PREFETCH_SLOTS; i++) {
+    PTCachePackPrefetch *prefetch = &pack->prefetch[i];
+    if (prefetch->done && prefetch->frame == frame->frame && block_index < prefetch->blocks_num) {
+      data = prefetch->blocks_data[block_index];
+      prefetch->blocks_data[block_index] = NULL;
+      break;
+    }
+  }
+  LIB_mutex_unlock(&pack->prefetch_mutex);
+
+  if (data == NULL) {
+    data = ptcache_pack_block_decompress(pack, block);
+  }
+  return data;
+}
+
+/* -------------------------------------------------------------------- */
+/* Prefetching */
+
+static void ptcache_pack_prefetch_task(TaskPool *__restrict pool, void *taskdata)
+{
+  PTCachePack *pack = LIB_task_pool_user_data(pool);
+  PTCachePackPrefetch *prefetch = &pack->prefetch[POINTER_AS_INT(taskdata)];
+
+  /* The frame of the slot doesn't change until it's done. */
+  const PTCachePackFrame *frame = ptcache_pack_frame_find(pack, prefetch->frame);
+  const PTCachePackBlock *blocks = ptcache_pack_frame_blocks(pack, frame);
+  void **blocks_data = MEM_callocN(sizeof(void *) * MAX2(frame->block_num, 1), __func__);
+
+  for (uint i = 0; i < frame->block_num; i++) {
+    if (LIB_task_pool_current_canceled(pool)) {
+      break;
+    }
+
+    const PTCachePackBlock *block = &blocks[i];
+    if (block->compression == PTCACHE_COMPRESS_NO) {
+      /* Read the pages in, for the data to be used from the mapping. */
+      const volatile char *data = pack->mem + block->offset;
+      for (uint64_t offset = 0; offset < block->size; offset += 4096) {
+        (void)data[offset];
+      }
+    }
+    else {
+      blocks_data[i] = ptcache_pack_block_decompress(pack, block);
+    }
+  }
+
+  LIB_mutex_lock(&pack->prefetch_mutex);
+  prefetch->blocks_data = blocks_data;
+  prefetch->blocks_num = frame->block_num;
+  prefetch->done = true;
+  LIB_mutex_unlock(&pack->prefetch_mutex);
+}
+
+void ptcache_pack_prefetch(PTCachePack *pack, int frame)
+{
+  const PTCachePackIndex *index = &pack->index;
+
+  LIB_mutex_lock(&pack->prefetch_mutex);
+
+  const bool forward = (frame >= pack->prefetch_last_frame);
+  pack->prefetch_last_frame = frame;
+
+  /* The frames following `frame` in the direction of playback. */
+  int frame_first = ptcache_pack_frame_index_find(index, frame);
+  if (forward) {
+    if (frame_first < (int)index->frames_num && index->frames[frame_first].frame == frame) {
+      frame_first++;
+    }
+  }
+  else {
+    frame_first--;
+  }
+  const int direction = forward ? 1 : -1;
+  const int frame_last = forward ? MIN2(frame_first + PTCACHE_PACK_PREFETCH_FRAMES,
+                                        (int)index->frames_num) - 1 :
+                                   MAX2(frame_first - PTCACHE_PACK_PREFETCH_FRAMES, -1) + 1;
+
+  for (int i = frame_first; (forward ? i <= frame_last : i >= frame_last); i += direction) {
+    const int prefetch_frame = index->frames[i].frame;
+
+    /* Reuse a slot done with a frame out of the range, or unused. */
+    PTCachePackPrefetch *slot = NULL;
+    bool is_prepared = false;
+    for (int j = 0; j < PTCACHE_PACK_PREFETCH_SLOTS; j++) {
+      PTCachePackPrefetch *prefetch = &pack->prefetch[j];
+      if (prefetch->frame == prefetch_frame) {
+        is_prepared = true;
+        break;
+      }
+      const bool in_range = forward ? (prefetch->frame > frame &&
+                                       prefetch->frame <= index->frames[frame_last].frame) :
+                                      (prefetch->frame < frame &&
+                                       prefetch->frame >= index->frames[frame_last].frame);
+      if ((prefetch->frame == INT_MIN || prefetch->done) && !in_range &&
+          (slot == NULL || slot->frame != INT_MIN)) {
+        slot = prefetch;
+      }
+    }
+    if (is_prepared) {
+      continue;
+    }
+    if (slot == NULL) {
+      break;
+    }
+
+    ptcache_pack_prefetch_slot_clear(slot);
+    slot->frame = prefetch_frame;
+
+    if (pack->prefetch_pool == NULL) {
+      pack->prefetch_pool = LIB_task_pool_create_background(pack, TASK_PRIORITY_LOW);
+    }
+    LIB_task_pool_push(pack->prefetch_pool,
+                       ptcache_pack_prefetch_task,
+                       POINTER_FROM_INT((int)(slot - pack->prefetch)),
+                       false,
+                       NULL);
+  }
+
+  LIB_mutex_unlock(&pack->prefetch_mutex);
+}
+
+/* -------------------------------------------------------------------- */
+/* Writing */
+
+static int ptcache_pack_zstd_level(int compression)
+{
+  switch (compression) {
+    case PTCACHE_COMPRESS_LZO:
+      return 1;
+    case PTCACHE_COMPRESS_LZMA:
+      return 19;
+    default:
+      return ZSTD_CLEVEL_DEFAULT;
+  }
+}
+
+typedef struct PTCachePackCompressData {
+  PTCachePackBlock *blocks;
+  const void **blocks_data;
+  /* Compressed data of the blocks, NULL for blocks stored as is. */
+  void **blocks_compressed;
+  int level;
+} PTCachePackCompressData;
+
+static void ptcache_pack_compress_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PTCachePackCompressData *data = userdata;
+  PTCachePackBlock *block = &data->blocks[i];
+  const size_t raw_size = block->size;
+
+  if (raw_size == 0) {
+    return;
+  }
+
+  const size_t bound = ZSTD_compressBound(raw_size);
+  void *out = MEM_mallocN(bound, __func__);
+  const size_t size = ZSTD_compress(out, bound, data->blocks_data[i], raw_size, data->level);
+
+  /* Keep data which doesn't compress as is, to be used from the mapping. */
+  if (ZSTD_isError(size) || size >= raw_size) {
+    MEM_freeN(out);
+    return;
+  }
+
+  block->compression = PTCACHE_COMPRESS_ZSTD;
+  block->size = size;
+  data->blocks_compressed[i] = out;
+}
+
+/* Open a pack for writing, creating it when it doesn't exist or is invalid. */
+static FILE *ptcache_pack_write_open(const char *filepath,
+                                     int type,
+                                     PTCachePackIndex *r_index,
+                                     uint64_t *r_file_len)
+{
+  FILE *fp = LIB_fopen(filepath, "rb+");
+
+  memset(r_index, 0, sizeof(*r_index));
+  if (fp && LIB_fseek(fp, 0, SEEK_END) == 0) {
+    const int64_t file_len = LIB_ftell(fp);
+    if (file_len > 0 &&
+        ptcache_pack_index_read(ptcache_pack_read_file, fp, (uint64_t)file_len, type, r_index)) {
+      *r_file_len = (uint64_t)file_len;
+      return fp;
+    }
+  }
+  if (fp) {
+    fclose(fp);
+  }
+
+  /* Will create the dir if needs be, same as "//textures" is created. */
+  LIB_make_existing_file(filepath);
+  fp = LIB_fopen(filepath, "wb+");
+  if (fp == NULL) {
+    return NULL;
+  }
+  if (!ptcache_pack_header_write(fp, type)) {
+    fclose(fp);
+    return NULL;
+  }
+
+  r_index->offset = sizeof(PTCachePackHeader);
+  *r_file_len = sizeof(PTCachePackHeader);
+  return fp;
+}
+
+/* Rewrite the pack without its unused bytes, when they're more than the used ones. */
+static void ptcache_pack_compact(const char *filepath, int type, const PTCachePackIndex *index)
+{
+  uint64_t used;
+  const uint64_t unused = ptcache_pack_index_unused_size(index, &used);
+  if (unused <= used || unused < PTCACHE_PACK_COMPACT_MIN) {
+    return;
+  }
+
+  char filepath_tmp[FILE_MAX + 4];
+  LIB_snprintf(filepath_tmp, sizeof(filepath_tmp), "%s.tmp", filepath);
+
+  FILE *fp_src = LIB_fopen(filepath, "rb");
+  FILE *fp_dst = fp_src ? LIB_fopen(filepath_tmp, "wb") : NULL;
+  bool ok = fp_dst && ptcache_pack_header_write(fp_dst, type);
+
+  PTCachePackIndex index_dst = *index;
+  index_dst.blocks = MEM_dupallocN(index->blocks);
+
+  uint64_t offset = sizeof(PTCachePackHeader);
+  void *buffer = NULL;
+  for (uint i = 0; ok && i < index_dst.blocks_num; i++) {
+    PTCachePackBlock *block = &index_dst.blocks[i];
+    buffer = MEM_reallocN(buffer, MAX2(block->size, 1));
+    ok = ptcache_pack_read_file(fp_src, buffer, block->offset, block->size) &&
+         ptcache_pack_write_file(fp_dst, buffer, offset, block->size);
+    block->offset = offset;
+    offset = PTCACHE_PACK_ALIGN_SIZE(offset + block->size);
+  }
+  MEM_SAFE_FREE(buffer);
+
+  ok = ok && ptcache_pack_index_write(fp_dst, &index_dst, offset, 0);
+  MEM_SAFE_FREE(index_dst.blocks);
+
+  if (fp_src) {
+    fclose(fp_src);
+  }
+  if (fp_dst) {
+    ok = (fclose(fp_dst) == 0) && ok;
+  }
+
+  /* A file that is memory mapped can't be replaced on all platforms: when readers still use it,
+   * compacting is left to a following write. */
+  if (ok && !ptcache_pack_close(filepath)) {
+    LIB_delete(filepath_tmp, false, false);
+    return;
+  }
+  if (ok) {
+    ok = (LIB_rename_overwrite(filepath_tmp, filepath) == 0);
+  }
+  if (!ok) {
+    CLOG_WARN(&LOG, "Failed to compact point cache file '%s'", filepath);
+    LIB_delete(filepath_tmp, false, false);
+  }
+}
+
+bool ptcache_pack_frame_write(const char *filepath,
+                              int type,
+                              const PTCachePackFrame *frame,
+                              PTCachePackBlock *blocks,
+                              const void **blocks_data,
+                              int compression)
+{
+  const uint blocks_num = frame->block_num;
+
+  /* Readers are done with the previous state of the file. */
+  ptcache_pack_close(filepath);
+
+  for (uint i = 0; i < blocks_num; i++) {
+    blocks[i].compression = PTCACHE_COMPRESS_NO;
+    blocks[i].size = (uint64_t)blocks[i].totdata * blocks[i].elem_size;
+  }
+
+  PTCachePackCompressData data = {
+      .blocks = blocks,
+      .blocks_data = blocks_data,
+      .blocks_compressed = MEM_callocN(sizeof(void *) * MAX2(blocks_num, 1), __func__),
+      .level = ptcache_pack_zstd_level(compression),
+  };
+  if (compression != PTCACHE_COMPRESS_NO) {
+    TaskParallelSettings settings;
+    LIB_parallel_range_settings_defaults(&settings);
+    LIB_task_parallel_range(0, (int)blocks_num, &data, ptcache_pack_compress_cb, &settings);
+  }
+
+  PTCachePackIndex index;
+  uint64_t file_len = 0;
+  FILE *fp = ptcache_pack_write_open(filepath, type, &index, &file_len);
+  bool ok = (fp != NULL);
+
+  /* The blocks are written over the previous index. */
+  uint64_t offset = index.offset;
+  for (uint i = 0; ok && i < blocks_num; i++) {
+    const void *block_data = data.blocks_compressed[i] ? data.blocks_compressed[i] :
+                                                         blocks_data[i];
+    blocks[i].offset = offset;
+    ok = ptcache_pack_write_file(fp, block_data, offset, blocks[i].size);
+    offset = PTCACHE_PACK_ALIGN_SIZE(offset + blocks[i].size);
+  }
+
+  for (uint i = 0; i < blocks_num; i++) {
+    MEM_SAFE_FREE(data.blocks_compressed[i]);
+  }
+  MEM_freeN(data.blocks_compressed);
+
+  if (ok) {
+    /* The new index, with the frame (replaced) in order. */
+    const uint frame_index = (uint)ptcache_pack_frame_index_find(&index, frame->frame);
+    const bool is_replaced = frame_index < index.frames_num &&
+                             index.frames[frame_index].frame == frame->frame;
+    PTCachePackFrame frame_new = *frame;
+    frame_new.block_first = 0;
+
+    PTCachePackIndex index_new = {NULL};
+    index_new.frames = MEM_mallocN(sizeof(PTCachePackFrame) * (index.frames_num + 1), __func__);
+    index_new.blocks = MEM_mallocN(
+        sizeof(PTCachePackBlock) * MAX2(index.blocks_num + blocks_num, 1), __func__);
+
+    for (uint i = 0; i < index.frames_num; i++) {
+      if (i == frame_index) {
+        ptcache_pack_index_append(&index_new, &frame_new, blocks);
+      }
+      if (i != frame_index || !is_replaced) {
+        ptcache_pack_index_append(&index_new, &index.frames[i], &index.blocks[0]);
+      }
+    }
+    if (frame_index == index.frames_num) {
+      ptcache_pack_index_append(&index_new, &frame_new, blocks);
+    }
+
+    ok = ptcache_pack_index_write(fp, &index_new, offset, file_len);
+    ptcache_pack_index_free(&index);
+    index = index_new;
+  }
+
+  if (fp) {
+    ok = (fclose(fp) == 0) && ok;
+  }
+
+  if (ok) {
+    ptcache_pack_compact(filepath, type, &index);
+  }
+  else {
+    CLOG_ERROR(&LOG, "Failed to write point cache file '%s'", filepath);
+  }
+
+  ptcache_pack_index_free(&index);
+
+  return ok;
+}
+
+void ptcache_pack_frames_remove(const char *filepath, int type, int frame_min, int frame_max)
+{
+  /* Readers are done with the previous state of the file. */
+  ptcache_pack_close(filepath);
+
+  FILE *fp = LIB_fopen(filepath, "rb+");
+  if (fp == NULL) {
+    return;
+  }
+
+  PTCachePackIndex index;
+  int64_t file_len = -1;
+  if (LIB_fseek(fp, 0, SEEK_END) == 0) {
+    file_len = LIB_ftell(fp);
+  }
+  if (file_len <= 0 ||
+      !ptcache_pack_index_read(ptcache_pack_read_file, fp, (uint64_t)file_len, type, &index)) {
+    fclose(fp);
+    return;
+  }
+
+  /* Remove the frames from the index, the blocks of the remaining frames stay in place. */
+  PTCachePackIndex index_new = index;
+  index_new.frames_num = 0;
+  index_new.blocks_num = 0;
+  index_new.frames = MEM_mallocN(sizeof(PTCachePackFrame) * MAX2(index.frames_num, 1), __func__);
+  index_new.blocks = MEM_mallocN(sizeof(PTCachePackBlock) * MAX2(index.blocks_num, 1), __func__);
+
+  for (uint i = 0; i < index.frames_num; i++) {
+    const PTCachePackFrame *frame = &index.frames[i];
+    if (frame->frame < frame_min || frame->frame > frame_max) {
+      ptcache_pack_index_append(&index_new, frame, &index.blocks[0]);
+    }
+  }
+
+  const bool is_changed = (index_new.frames_num != index.frames_num);
+  bool ok = true;
+  if (is_changed && index_new.frames_num) {
+    /* Written after the previous index, which may still be read. */
+    ok = ptcache_pack_index_write(
+        fp, &index_new, PTCACHE_PACK_ALIGN_SIZE((uint64_t)file_len), (uint64_t)file_len);
+  }
+  ok = (fclose(fp) == 0) && ok;
+
+  if (is_changed && index_new.frames_num == 0) {
+    LIB_delete(filepath, false, false);
+  }
+  else if (!ok) {
+    CLOG_ERROR(&LOG, "Failed to write point cache file '%s'", filepath);
+  }
+  else if (is_changed) {
+    ptcache_pack_compact(filepath, type, &index_new);
+  }
+
+  ptcache_pack_index_free(&index);
+  ptcache_pack_index_free(&index_new);
+}
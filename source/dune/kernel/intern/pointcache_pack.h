@@ -0,0 +1,114 @@
+#pragma once
+
+/* Packed disk cache of a point cache (see #PTCACHE_DISK_PACKED): all frames of a cache in one
+ * indexed file, memory mapped for reading.
+ *
+ * Frames are stored as one block per data type (#BPHYS_DATA_INDEX, ...) and one per extra data,
+ * so a column can be used from the mapping as is, or decompressed (zstd) on its own.
+ *
+ * File layout:
+ * - #PTCachePackHeader.
+ * - Blocks, aligned to #PTCACHE_PACK_ALIGN bytes.
+ * - The index: #PTCachePackFrame array sorted by frame, then the #PTCachePackBlock array.
+ * - #PTCachePackTrailer, at the end of the file, locating the index.
+ *
+ * Writing a frame writes its blocks over the previous index and a new index after them, so the
+ * file only grows (readers compare its size & time to reload it) until it's compacted. */
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PTCACHE_PACK_ALIGN 16
+/* Type of the blocks of extra data, or'ed with the #PTCacheExtra.type. */
+#define PTCACHE_PACK_BLOCK_EXTRA (1u << 16)
+
+typedef struct PTCachePackBlock {
+  /* #BPHYS_DATA_INDEX, ... or #PTCACHE_PACK_BLOCK_EXTRA | extra type. */
+  uint32_t type;
+  /* #PTCACHE_COMPRESS_NO or #PTCACHE_COMPRESS_ZSTD. */
+  uint32_t compression;
+  /* Number of elements & their size, when decompressed. */
+  uint32_t totdata;
+  uint32_t elem_size;
+  /* Location of the (compressed) data in the file. */
+  uint64_t offset;
+  uint64_t size;
+} PTCachePackBlock;
+
+typedef struct PTCachePackFrame {
+  int32_t frame;
+  uint32_t totpoint;
+  uint32_t data_types;
+  /* Range of the blocks of the frame in the index, data blocks first, in #BPHYS_DATA_INDEX
+   * order, then extra data blocks. */
+  uint32_t block_first;
+  uint32_t block_num;
+  uint32_t _pad;
+} PTCachePackFrame;
+
+/* A packed cache file open for reading, shared by its readers (see #ptcache_pack_acquire). */
+typedef struct PTCachePack PTCachePack;
+
+/**
+ * Get the pack of `filepath`, (re)opening it when it's not open yet or has changed on disk.
+ * \return NULL when there is no valid pack file of this point cache `type`.
+ * Release with #ptcache_pack_release.
+ */
+PTCachePack *ptcache_pack_acquire(const char *filepath, int type);
+void ptcache_pack_release(PTCachePack *pack);
+
+/* The frames of the pack, sorted by frame. */
+const PTCachePackFrame *ptcache_pack_frames_get(const PTCachePack *pack, uint *r_frames_num);
+const PTCachePackFrame *ptcache_pack_frame_find(const PTCachePack *pack, int frame);
+const PTCachePackBlock *ptcache_pack_frame_blocks(const PTCachePack *pack,
+                                                  const PTCachePackFrame *frame);
+
+/**
+ * Data of a block of `frame`, decompressed as needed.
+ * \param r_owned: Set when the data was allocated for the caller to free, otherwise it points
+ * into the mapping of the pack, valid until the pack is released.
+ * \return NULL on read error.
+ */
+void *ptcache_pack_block_data(PTCachePack *pack,
+                              const PTCachePackFrame *frame,
+                              uint block_index,
+                              bool *r_owned);
+
+/**
+ * Prepare the frames of the pack following `frame`, in the direction of playback (from the
+ * `frame` of the previous call), on a background task pool: compressed blocks are decompressed
+ * ahead of #ptcache_pack_block_data, pages of uncompressed ones are read in.
+ */
+void ptcache_pack_prefetch(PTCachePack *pack, int frame);
+
+/**
+ * Write a frame to the pack of `filepath`, replacing the frame if it exists.
+ * \param blocks_data: Data of each of `blocks` (of which `offset` & `size` are set here).
+ * \param compression: #PointCache.compression, blocks are compressed with zstd (in parallel)
+ * unless it's #PTCACHE_COMPRESS_NO, at a level matching the legacy LZO & LZMA settings.
+ */
+bool ptcache_pack_frame_write(const char *filepath,
+                              int type,
+                              const PTCachePackFrame *frame,
+                              PTCachePackBlock *blocks,
+                              const void **blocks_data,
+                              int compression);
+
+/**
+ * Remove the frames from `frame_min` to `frame_max` (inclusive) from the pack of `filepath`,
+ * deleting the file when no frame is left.
+ */
+void ptcache_pack_frames_remove(const char *filepath, int type, int frame_min, int frame_max);
+
+/**
+ * Unmap the pack of `filepath` (once its readers release it), before deleting or renaming it.
+ * \return false when readers still have the file mapped.
+ */
+bool ptcache_pack_close(const char *filepath);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,195 @@
+#include "testing/testing.h"
+
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "TYPES_pointcache.h"
+
+#include "LIB_fileops.h"
+
+#include "DUNE_pointcache.h"
+#include "dune_pointcache_ex.h"
+
+#include "pointcache_pack.h"
+
+namespace dune::kernel::tests {
+
+/* Large enough for replaced & removed frames to exceed #PTCACHE_PACK_COMPACT_MIN. */
+#define POINTS_NUM (1 << 17)
+
+class PointCachePackTest : public testing::Test {
+ public:
+  std::string filepath;
+
+  void SetUp() override
+  {
+    filepath = std::string(testing::TempDir()) + "pointcache_pack_test" PTCACHE_PACK_EXT;
+    LIB_delete(filepath.c_str(), false, false);
+  }
+
+  void TearDown() override
+  {
+    DUNE_ptcache_pack_exit();
+    LIB_delete(filepath.c_str(), false, false);
+  }
+
+  /* Write `frame` with an index & a location block, of values derived from `seed`. */
+  bool frame_write(const int frame, const int seed, const int compression)
+  {
+    int *index = (int *)MEM_mallocN(sizeof(int) * POINTS_NUM, __func__);
+    float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * POINTS_NUM, __func__);
+    for (int i = 0; i < POINTS_NUM; i++) {
+      index[i] = i + seed;
+      co[i][0] = co[i][1] = co[i][2] = float(i % 1000 + seed);
+    }
+
+    PTCachePackFrame pack_frame = {};
+    pack_frame.frame = frame;
+    pack_frame.totpoint = POINTS_NUM;
+    pack_frame.data_types = (1 << BPHYS_DATA_INDEX) | (1 << BPHYS_DATA_LOCATION);
+    pack_frame.block_num = 2;
+
+    PTCachePackBlock blocks[2] = {};
+    blocks[0].type = BPHYS_DATA_INDEX;
+    blocks[0].totdata = POINTS_NUM;
+    blocks[0].elem_size = sizeof(int);
+    blocks[1].type = BPHYS_DATA_LOCATION;
+    blocks[1].totdata = POINTS_NUM;
+    blocks[1].elem_size = sizeof(float[3]);
+    const void *blocks_data[2] = {index, co};
+
+    const bool ok = ptcache_pack_frame_write(
+        filepath.c_str(), PTCACHE_TYPE_PARTICLES, &pack_frame, blocks, blocks_data, compression);
+    MEM_freeN(index);
+    MEM_freeN(co);
+    return ok;
+  }
+
+  /* Check the frames of the pack are `frames`, written with `seeds`. */
+  void expect_frames(const std::initializer_list<int> frames,
+                     const std::initializer_list<int> seeds)
+  {
+    PTCachePack *pack = ptcache_pack_acquire(filepath.c_str(), PTCACHE_TYPE_PARTICLES);
+    ASSERT_NE(pack, nullptr);
+
+    uint frames_num;
+    const PTCachePackFrame *pack_frames = ptcache_pack_frames_get(pack, &frames_num);
+    ASSERT_EQ(frames_num, frames.size());
+
+    for (int i = 0; i < int(frames.size()); i++) {
+      const int frame = frames.begin()[i];
+      const int seed = seeds.begin()[i];
+      EXPECT_EQ(pack_frames[i].frame, frame);
+
+      const PTCachePackFrame *pack_frame = ptcache_pack_frame_find(pack, frame);
+      ASSERT_EQ(pack_frame, &pack_frames[i]);
+      EXPECT_EQ(pack_frame->totpoint, POINTS_NUM);
+      ASSERT_EQ(pack_frame->block_num, 2);
+
+      bool index_owned, co_owned;
+      const int *index = (const int *)ptcache_pack_block_data(pack, pack_frame, 0, &index_owned);
+      const float(*co)[3] = (const float(*)[3])ptcache_pack_block_data(
+          pack, pack_frame, 1, &co_owned);
+      ASSERT_NE(index, nullptr);
+      ASSERT_NE(co, nullptr);
+      for (int j = 0; j < POINTS_NUM; j += 97) {
+        EXPECT_EQ(index[j], j + seed);
+        EXPECT_EQ(co[j][2], float(j % 1000 + seed));
+      }
+      if (index_owned) {
+        MEM_freeN((void *)index);
+      }
+      if (co_owned) {
+        MEM_freeN((void *)co);
+      }
+    }
+    EXPECT_EQ(ptcache_pack_frame_find(pack, -1), nullptr);
+
+    ptcache_pack_release(pack);
+  }
+
+  int64_t file_size() const
+  {
+    LIB_stat_t st;
+    return (LIB_stat(filepath.c_str(), &st) == 0) ? int64_t(st.st_size) : -1;
+  }
+};
+
+TEST_F(PointCachePackTest, round_trip)
+{
+  for (const int compression : {PTCACHE_COMPRESS_NO, PTCACHE_COMPRESS_ZSTD}) {
+    LIB_delete(filepath.c_str(), false, false);
+
+    /* Written out of order, read back sorted. */
+    EXPECT_TRUE(frame_write(3, 30, compression));
+    EXPECT_TRUE(frame_write(1, 10, compression));
+    EXPECT_TRUE(frame_write(2, 20, compression));
+    expect_frames({1, 2, 3}, {10, 20, 30});
+
+    /* Overwrite. */
+    EXPECT_TRUE(frame_write(2, 21, compression));
+    expect_frames({1, 2, 3}, {10, 21, 30});
+
+    /* Remove. */
+    ptcache_pack_frames_remove(filepath.c_str(), PTCACHE_TYPE_PARTICLES, 3, 3);
+    expect_frames({1, 2}, {10, 21});
+
+    /* Reopen, after closing the mapping of the pack. */
+    EXPECT_TRUE(ptcache_pack_close(filepath.c_str()));
+    expect_frames({1, 2}, {10, 21});
+
+    /* Removing all frames deletes the file. */
+    ptcache_pack_frames_remove(filepath.c_str(), PTCACHE_TYPE_PARTICLES, 0, 10);
+    EXPECT_FALSE(LIB_exists(filepath.c_str()));
+    EXPECT_EQ(ptcache_pack_acquire(filepath.c_str(), PTCACHE_TYPE_PARTICLES), nullptr);
+  }
+}
+
+TEST_F(PointCachePackTest, compact)
+{
+  for (int frame = 1; frame <= 4; frame++) {
+    EXPECT_TRUE(frame_write(frame, frame, PTCACHE_COMPRESS_NO));
+  }
+  const int64_t size_full = file_size();
+
+  /* The replaced blocks stay in the file, until they exceed the used ones. */
+  EXPECT_TRUE(frame_write(2, 5, PTCACHE_COMPRESS_NO));
+  EXPECT_GT(file_size(), size_full);
+  ptcache_pack_frames_remove(filepath.c_str(), PTCACHE_TYPE_PARTICLES, 3, 4);
+  EXPECT_LT(file_size(), size_full);
+  expect_frames({1, 2}, {1, 5});
+}
+
+TEST_F(PointCachePackTest, compact_mapped)
+{
+  for (int frame = 1; frame <= 4; frame++) {
+    EXPECT_TRUE(frame_write(frame, frame, PTCACHE_COMPRESS_NO));
+  }
+  const int64_t size_full = file_size();
+
+  /* A reader keeps the file mapped: it's not replaced by a compacted file. */
+  PTCachePack *pack = ptcache_pack_acquire(filepath.c_str(), PTCACHE_TYPE_PARTICLES);
+  ASSERT_NE(pack, nullptr);
+  ptcache_pack_frames_remove(filepath.c_str(), PTCACHE_TYPE_PARTICLES, 2, 4);
+  EXPECT_GE(file_size(), size_full);
+  EXPECT_FALSE(ptcache_pack_close(filepath.c_str()));
+
+  /* The reader still reads the previous state of the file. */
+  const PTCachePackFrame *pack_frame = ptcache_pack_frame_find(pack, 3);
+  ASSERT_NE(pack_frame, nullptr);
+  bool owned;
+  const int *index = (const int *)ptcache_pack_block_data(pack, pack_frame, 0, &owned);
+  ASSERT_NE(index, nullptr);
+  EXPECT_FALSE(owned);
+  EXPECT_EQ(index[1], 4);
+  ptcache_pack_release(pack);
+
+  /* Compacted on the next write. */
+  EXPECT_TRUE(ptcache_pack_close(filepath.c_str()));
+  EXPECT_TRUE(frame_write(5, 5, PTCACHE_COMPRESS_NO));
+  EXPECT_LT(file_size(), size_full);
+  expect_frames({1, 5}, {1, 5});
+}
+
+}  // namespace dune::kernel::tests
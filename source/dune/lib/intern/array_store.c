@@ -88,6 +88,8 @@
 #include "lib_strict_flags.h"
 
 #include "lib_array_store.h" /* Own include. */
+#include "lib_array_store_ex.h"
+#include "lib_task.h"
 
 /* Only for lib_array_store_is_valid. */
 #include "lib_ghash.h"
@@ -182,6 +184,30 @@
 #  define BCHUNK_SIZE_MAX_MUL 2
 #endif /* USE_MERGE_CHUNKS */
 
+/* Content defined chunks (#ARRAY_STORE_CONTENT_DEFINED_CHUNKS):
+ * place chunk boundaries where a rolling hash of the last few bytes matches a pattern,
+ * instead of every #ArrayInfo.chunk_byte_size bytes.
+ * Inserting or removing elements then only changes the chunks around the edit,
+ * as the boundaries of all following chunks move along with their contents.
+ *
+ * Chunks store the hash of all their data in #Chunk.key, so this depends on the key cache. */
+#ifdef USE_HASH_TABLE_KEY_CACHE
+#  define USE_CONTENT_DEFINED_CHUNKS
+#endif
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+/* Number of bytes the rolling hash depends on (the number of bits in the hash). */
+#  define CDC_WINDOW_BYTES 64
+/* Min/max chunk sizes, relative to the regular chunk size.
+ * The first bytes (up to the min size) of each chunk are skipped when searching for a boundary,
+ * larger values are faster but boundaries take longer to line up again after an edit. */
+#  define CDC_SIZE_MIN_DIV 8
+#  define CDC_SIZE_MAX_MUL 2
+#endif
+
+/* Adding the states of a batch is threaded when there is at least this much data. */
+#define ARRAY_STORE_BATCH_THREAD_MIN_BYTES (1 << 16)
+
 /* Slow (keep disabled), but handy for debugging. */
 // #define USE_VALIDATE_LIST_SIZE
 
@@ -208,6 +234,14 @@ typedef struct ArrayInfo {
   size_t accum_steps;
   size_t accum_read_ahead_len;
 #endif
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+  bool use_content_defined_chunks;
+  /* A chunk may end after an element when none of these bits of the rolling hash are set. */
+  uint64_t cdc_mask;
+  /* #CDC_WINDOW_BYTES rounded up to the stride. */
+  size_t cdc_window_bytes;
+#endif
 } ArrayInfo;
 
 typedef struct ArrayMem {
@@ -263,6 +297,7 @@ typedef struct Chunk {
   int users;
 
 #ifdef USE_HASH_TABLE_KEY_CACHE
+  /* With content defined chunks, this is the hash of all data (see hash_data_chunk). */
   hash_key key;
 #endif
 } Chunk;
@@ -284,6 +319,22 @@ typedef struct TableRef {
   const ChunkRef *cref;
 } TableRef;
 
+/* Content defined chunks of an array, calculated before adding it to the store
+ * (which allows calculating them for many arrays in parallel). */
+typedef struct CDCChunks {
+  /* Number of chunks at the start & end of the ref which match the array. */
+  uint ref_match_first_len;
+  uint ref_match_last_len;
+  /* The range of the array between the matching chunks, split into new chunks. */
+  size_t data_start;
+  size_t data_end;
+  /* End offset of each chunk in bytes, the last is `data_end`. */
+  size_t *ends;
+  /* Hash of each chunk, see hash_data_chunk. */
+  hash_key *keys;
+  uint len;
+} CDCChunks;
+
 static size_t bchunk_list_size(const ChunkList *chunk_list);
 
 /* Internal Chunk API */
@@ -1348,6 +1399,405 @@ static ChunkList *chunk_list_from_data_merge(const ArrayInfo *info,
 
   return chunk_list;
 }
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+
+/* Content Defined Chunks */
+
+/* Random values for each byte, the rolling hash is the sum of the values of the last
+ * #CDC_WINDOW_BYTES bytes, each shifted by its distance from the end ("gear" hash). */
+static const uint64_t cdc_gear_table[256] = {
+    0xc0e16b163a85a4dcull, 0x890acd8dd443c47cull, 0xb3889d8a6dc47761ull,
+    0x6a0398e528f0ae6aull, 0x048344ece48a855eull, 0xf175cfea21871330ull,
+    0x391ceef02702c2fdull, 0x4baf8cac4784cb12ull, 0x3547744583a3f88eull,
+    0xd9cf2b15c6b6c90eull, 0x961facc76d5fe21cull, 0x0094ab49d50f11f9ull,
+    0xe3211e37bdbeb6dcull, 0x62fe6c274ff3511aull, 0x5ac30b329fdf0574ull,
+    0x1450582c6b65b406ull, 0x7a30fcc7888eb791ull, 0x5540f5ba6a15576eull,
+    0x16cef0559096d3e9ull, 0x2cf8f14b06874899ull, 0xc9c9263b6e2ce103ull,
+    0xd6ff920b0a9faa6dull, 0x53192697db998dc1ull, 0x73ea9b9bc7cd18d7ull,
+    0x102713f872c33fceull, 0xf4183a0e5d2a033eull, 0x71b63e307eebb517ull,
+    0xda61f5713d036000ull, 0x46eb7409ae691b21ull, 0xb23ad691d6707698ull,
+    0x67c8fe11d22fc4b9ull, 0x7eb4661419481338ull, 0x98077547fb070efcull,
+    0x1ee63336c2e3a9a8ull, 0xbc353656348c36f6ull, 0xce3898cbf1bb1bd8ull,
+    0x265b1c23c82915cbull, 0xfd1948c91687e355ull, 0xd976893961980ffaull,
+    0x336e77a6288e4c34ull, 0x16f8956d7b76d269ull, 0xda7cd844690d4669ull,
+    0x1e8cf85f253a581eull, 0x3ea68129e923e53aull, 0xa080a077c9e9fd79ull,
+    0x4469a19c673c14cfull, 0xbd5b9351b2d0963cull, 0xb46a749cad9df6b7ull,
+    0x07da714e59c7d362ull, 0x393a84bb5af17618ull, 0xb3ae08f3c86dfc0cull,
+    0x642a350ed7c82c93ull, 0x547bdec029cd3fa3ull, 0x778debb21b67fc3dull,
+    0xb1e26d886eaed22bull, 0x49fb5996898a7303ull, 0x5e245bcec3e007b3ull,
+    0x1f6818e4a739f61bull, 0xad694562d6313affull, 0xded7c324e96e3a09ull,
+    0x0e181ef86a661cf8ull, 0x675448d833ac146bull, 0xf047e1b493d6b255ull,
+    0xe3d9f8b33d92678cull, 0x62648db4d3b1b3acull, 0x5e772e6b32ded778ull,
+    0x6bc2ea32285bad33ull, 0x298b58c7b2262c2dull, 0x89a142e7a847c68full,
+    0x07b170d776f29a64ull, 0x754b9d28182fd07full, 0x934990332438604cull,
+    0xa1ab48a85cc22bbbull, 0xff5aa2d675545595ull, 0x32a5a207c5c3eed3ull,
+    0xd9970e23aebb3d51ull, 0xd9d01979fc161649ull, 0x437a2ed7a4fca264ull,
+    0x30fa485d263c4dd1ull, 0xaab6790590cb5b06ull, 0x65091913e11e2cfaull,
+    0x51b90f06b259b46bull, 0x8289d10138b1d6b4ull, 0x88ae7e8730e361fbull,
+    0x0833a622304c447bull, 0xe2e55431bf4b1b54ull, 0xdde9371fc120d32full,
+    0x5751a8d978ce73ddull, 0xbf1f19e0e1fbd33dull, 0x75374f1247e3cdaaull,
+    0x9f1ca64eb4d3ce97ull, 0x38136f3a3d5ace59ull, 0xd47963dbf7f8dc43ull,
+    0xd87428ff43dd9d86ull, 0x2607e8bece834053ull, 0x3c7a84fa12044c87ull,
+    0x8c7f4bfac5f7e4bbull, 0xed4a244966996f87ull, 0x36c97138af16e719ull,
+    0x08d81534dedb7662ull, 0xac7c55978241afc4ull, 0xdf1b8863c9332ce7ull,
+    0x620ee7f218ea0997ull, 0x38d1df383ce89b65ull, 0xe719097929758713ull,
+    0x9ec6cd248c58ad3cull, 0xf54bd98a78d9f340ull, 0x6498bc6124519df3ull,
+    0x198e656271e64fa2ull, 0xa43fd5dd0d813097ull, 0x35ad65fea929819aull,
+    0x2f00139d2a8cd90cull, 0x155f41d97478845cull, 0x3f2b6a8cfea779b9ull,
+    0x4b7264199d7c962aull, 0xa26165f55b57273full, 0xb7a6f3f0ecf5b89full,
+    0x8e0692470e1ee509ull, 0x23234da5964b213aull, 0x6461d9c18fb4c2b9ull,
+    0x9c44cac712b73113ull, 0x93de0e8d937a2da0ull, 0x88c84529e3843d70ull,
+    0x70daad40227330ceull, 0x7ab855c449ec8acaull, 0xc8de7a81906c8be8ull,
+    0x5f5627df47641ddaull, 0xdd60bf81e2586cbcull, 0x3cfc1ba44eaf2468ull,
+    0x405a9309613ad882ull, 0x4de7eb21b0277f28ull, 0x86e512678e4dd45aull,
+    0x0f1286efd6bdd066ull, 0x1c8aca34c2fa6773ull, 0x1da8e48b2342e347ull,
+    0x1890dcd0a94893e7ull, 0x2b1aaf97ef6b4dffull, 0xb32b16249647a7ecull,
+    0x9fb5f0bced31ea58ull, 0x3d78f7907627c61full, 0x1841958c7d191f94ull,
+    0xa18a85a96a78b19eull, 0x631e9abbb0213210ull, 0x3dab614952cc05a9ull,
+    0x017020b874beabd6ull, 0xfa59da85e751094cull, 0x29cd811450b5412eull,
+    0x8d15c850af2489a8ull, 0x950b3bdd58d563a0ull, 0x836cb8f306d51f7eull,
+    0x4065efde02b744e8ull, 0xb9baecb669369d99ull, 0x7b378c9248d47dc4ull,
+    0x4ddd25d48cdc6168ull, 0xa732d6380105f470ull, 0x75c8d0927bb9c613ull,
+    0x6785a012497a2d75ull, 0xffca85e4ac7617e9ull, 0xc6f2129203f39492ull,
+    0x3ed2bc376029332eull, 0xd0dc8d146f7e2680ull, 0x513f8ed97341b4a1ull,
+    0x4324394cfa366d32ull, 0x7cbea6ee7da29a4aull, 0x69707125ac82ecfaull,
+    0xdd4ba7a8ed6c0ef7ull, 0x100210a42564a9efull, 0xaf1101e77e76c1c2ull,
+    0x140a33b32394451bull, 0xce3748ebe86fd0f9ull, 0x763b94236a3c95dcull,
+    0x0e82087dbe388ce4ull, 0x8a3f991981c24d6eull, 0x31b399f558c60586ull,
+    0xf50ea2c64afdfe9bull, 0x6c02449c992ff889ull, 0x7914a6531aeeb744ull,
+    0xb75f86f73f2f4ec2ull, 0x1bdb24c7bd571df8ull, 0x06e4e518ae8f033eull,
+    0xffe622dab44f3689ull, 0xf2792f1385db0e95ull, 0x2aad6ff4838907b8ull,
+    0x0d649d2b9341accaull, 0x2aef8ac693c156cdull, 0xb86c9e57fa18942eull,
+    0xe85e3cf930ed3877ull, 0xb3fb466dd31f94a2ull, 0xac8d03c007f25604ull,
+    0xa9eec498626ff508ull, 0xf47be033dda3f9b0ull, 0xa4f748b538e6f27dull,
+    0xc01bb10959d5e985ull, 0x89079de7dda37d8full, 0xd7007ba815cc0658ull,
+    0xc4da1bb45a7b871aull, 0x98185ba52f9d9cd4ull, 0x4242c91a500844e5ull,
+    0x07965f1aa6863c5dull, 0x0359ccaad9aea599ull, 0xe7a54bf05004eddbull,
+    0x333aa1cd725ff5e8ull, 0x94c18d8184570964ull, 0xee0303af7e757a57ull,
+    0xbbc38705003c82ecull, 0xc57a6bbdbb7edfbdull, 0xbaea4e697c235ee2ull,
+    0x9f1ed9c9b4707ea2ull, 0x3845a969b77941f0ull, 0x1f02624c80d73ce6ull,
+    0x4820b4e1649d1ddcull, 0x77d1259b2f0be5fbull, 0xa495f4fdba5cccddull,
+    0x5ce421e295346c68ull, 0x0dfd63adc1c5bc74ull, 0x570045b98cbc93e3ull,
+    0x5b7317cd17a15f04ull, 0x6defb13e4a48fa9cull, 0x9d2540358539f109ull,
+    0xdff1d3db7af0541bull, 0xa786c0d906df090eull, 0x9c8aa8553f5db609ull,
+    0x2d5d59b48454ab11ull, 0x73fbfbfd57360323ull, 0xe045969a1fe274d6ull,
+    0xb374b31ccc1c9668ull, 0xee53c1d82d9ced9cull, 0x02ee16f7445f3d27ull,
+    0x43d17009acf06ed8ull, 0xd17f5baf03dd6e26ull, 0xbddf2289ed7719ffull,
+    0xf9b980d54f117273ull, 0xcdd05dc90b2c3b5bull, 0xae6df7dd9d557455ull,
+    0xa6a0e6779f5dfb3full, 0xd85269b48de6f619ull, 0x43b0855155163e1cull,
+    0x716aa342eaa75e67ull, 0xf601d8d15e1709aeull, 0x9ce1c4f19d6c405bull,
+    0x8e5d480bf2121c70ull, 0x5cd643cb24cbaa78ull, 0x44ecfa2a75ca3a34ull,
+    0x390f2eddea3099a2ull, 0xdfea67149da0609full, 0xb734297101779a59ull,
+    0xc3f3700cbb0afe9full, 0x403cae0119d1bb35ull, 0x23853b00d0e1076bull,
+    0x63dc284ae4cf5983ull, 0x252721131cfe91aeull, 0xdbe6d98b3113e9d6ull,
+    0xf3f923744c247687ull, 0x01ef9061730e4ab6ull, 0x7f2a753307b3391cull,
+    0xfd4cbb1b3007d376ull,
+};
+
+/* Hash all data of a chunk, reading 8 bytes at a time. */
+static hash_key hash_data_chunk(const uchar *data, const size_t data_len)
+{
+  uint64_t h = (uint64_t)data_len * 0x9E3779B97F4A7C15ull;
+  uint64_t v;
+  size_t i = 0;
+  for (; i + sizeof(v) <= data_len; i += sizeof(v)) {
+    memcpy(&v, &data[i], sizeof(v));
+    h = (h ^ v) * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+  }
+  if (i != data_len) {
+    v = 0;
+    memcpy(&v, &data[i], data_len - i);
+    h = (h ^ v) * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+  }
+
+  hash_key key = (hash_key)h;
+  if (UNLIKELY(key == HASH_TABLE_KEY_UNSET)) {
+    key = HASH_TABLE_KEY_FALLBACK;
+  }
+  return key;
+}
+
+/* return The length of the chunk at the start of data.
+ * Apart from the last, all chunks are larger than ArrayInfo.chunk_byte_size_min,
+ * the last is only smaller when the whole array is. */
+static size_t cdc_chunk_len_calc(const ArrayInfo *info, const uchar *data, const size_t data_len)
+{
+  const size_t stride = info->chunk_stride;
+  const size_t size_min = info->chunk_byte_size_min;
+  if (data_len <= size_min * 2) {
+    return data_len;
+  }
+  /* Leave enough data for the next chunk. */
+  const size_t size_limit = MIN2(info->chunk_byte_size_max, data_len - size_min);
+  const uint64_t mask = info->cdc_mask;
+
+  /* Only the bytes in the window before a boundary define it,
+   * so the start of the chunk doesn't need to be hashed. */
+  size_t i = (size_min > info->cdc_window_bytes) ? size_min - info->cdc_window_bytes : 0;
+  uint64_t h = 0;
+  for (; i < size_min; i++) {
+    h = (h << 1) + cdc_gear_table[data[i]];
+  }
+
+  /* Boundaries are only placed between elements. */
+  while (i < size_limit) {
+    for (const size_t i_end = i + stride; i < i_end; i++) {
+      h = (h << 1) + cdc_gear_table[data[i]];
+    }
+    if ((h & mask) == 0) {
+      return i;
+    }
+  }
+
+  /* No boundary found, use all data that fits. */
+  return (data_len <= info->chunk_byte_size_max) ? data_len : size_limit;
+}
+
+/* Split data into chunks, reusing matching chunks at the start & end of chunk_list_ref.
+ * Only reads from the ref, so this is safe to run in parallel with other arrays. */
+static void cdc_chunks_calc(const ArrayInfo *info,
+                            const uchar *data,
+                            const size_t data_len,
+                            const ChunkList *chunk_list_ref,
+                            CDCChunks *r_chunks)
+{
+  uint match_first_len = 0;
+  uint match_last_len = 0;
+  size_t data_start = 0;
+  size_t data_end = data_len;
+
+  if (chunk_list_ref != NULL) {
+    /* Fast-Path for leading & trailing chunks, as with USE_FASTPATH_CHUNKS_FIRST & LAST.
+     * Since the ref chunk boundaries are content defined,
+     * the chunks of the data between them line up with the ref again after an edit. */
+    const ChunkRef *cref_first = NULL;
+    const ChunkRef *cref = chunk_list_ref->chunk_refs.first;
+    while (cref && chunk_data_compare(cref->link, data, data_len, data_start)) {
+      data_start += cref->link->data_len;
+      match_first_len += 1;
+      cref_first = cref;
+      cref = cref->next;
+    }
+
+    const ChunkRef *cref_last = NULL;
+    cref = chunk_list_ref->chunk_refs.last;
+    while ((match_first_len + match_last_len < chunk_list_ref->chunk_refs_len) &&
+           (cref->link->data_len <= data_end - data_start) &&
+           chunk_data_compare(cref->link, data, data_len, data_end - cref->link->data_len))
+    {
+      data_end -= cref->link->data_len;
+      match_last_len += 1;
+      cref_last = cref;
+      cref = cref->prev;
+    }
+
+    /* Don't leave too little data for a chunk between the matches,
+     * un-match chunks until there is enough. */
+    while ((data_start != data_end) && (data_end - data_start < info->chunk_byte_size_min)) {
+      if (match_last_len != 0) {
+        data_end += cref_last->link->data_len;
+        match_last_len -= 1;
+        cref_last = cref_last->next;
+      }
+      else if (match_first_len != 0) {
+        data_start -= cref_first->link->data_len;
+        match_first_len -= 1;
+        cref_first = cref_first->prev;
+      }
+      else {
+        break;
+      }
+    }
+  }
+
+  r_chunks->ref_match_first_len = match_first_len;
+  r_chunks->ref_match_last_len = match_last_len;
+  r_chunks->data_start = data_start;
+  r_chunks->data_end = data_end;
+
+  const size_t chunks_len_max = ((data_end - data_start) / info->chunk_byte_size_min) + 1;
+  r_chunks->ends = mem_malloc((sizeof(*r_chunks->ends) + sizeof(*r_chunks->keys)) *
+                                  chunks_len_max,
+                              __func__);
+  r_chunks->keys = (hash_key *)&r_chunks->ends[chunks_len_max];
+  r_chunks->len = 0;
+
+  size_t i_prev = data_start;
+  while (i_prev != data_end) {
+    const size_t chunk_len = cdc_chunk_len_calc(info, &data[i_prev], data_end - i_prev);
+    lib_assert(r_chunks->len < chunks_len_max);
+    r_chunks->ends[r_chunks->len] = i_prev + chunk_len;
+    r_chunks->keys[r_chunks->len] = hash_data_chunk(&data[i_prev], chunk_len);
+    r_chunks->len += 1;
+    i_prev += chunk_len;
+  }
+}
+
+static void cdc_chunks_free(CDCChunks *chunks)
+{
+  MEM_SAFE_FREE(chunks->ends);
+  chunks->keys = NULL;
+  chunks->len = 0;
+}
+
+LIB_INLINE size_t cdc_chunk_offset(const CDCChunks *chunks, const uint i)
+{
+  return i ? chunks->ends[i - 1] : chunks->data_start;
+}
+
+static bool cdc_chunk_compare(const Chunk *chunk,
+                              const uchar *data,
+                              const CDCChunks *chunks,
+                              const uint i)
+{
+  lib_assert(chunk->key != HASH_TABLE_KEY_UNSET);
+  const size_t offset = cdc_chunk_offset(chunks, i);
+  return (chunk->key == chunks->keys[i]) && (chunk->data_len == chunks->ends[i] - offset) &&
+         (memcmp(&data[offset], chunk->data, chunk->data_len) == 0);
+}
+
+static void cdc_table_insert(TableRef **table,
+                             const size_t table_len,
+                             TableRef *table_ref_stack,
+                             uint *table_ref_stack_n,
+                             const ChunkRef *cref)
+{
+  const uint key_index = (uint)(cref->link->key % (hash_key)table_len);
+  TableRef *tref = &table_ref_stack[(*table_ref_stack_n)++];
+  tref->cref = cref;
+  tref->next = table[key_index];
+  table[key_index] = tref;
+}
+
+static const ChunkRef *cdc_table_lookup(TableRef **table,
+                                        const size_t table_len,
+                                        const uchar *data,
+                                        const CDCChunks *chunks,
+                                        const uint i)
+{
+  const uint key_index = (uint)(chunks->keys[i] % (hash_key)table_len);
+  for (const TableRef *tref = table[key_index]; tref; tref = tref->next) {
+    if (cdc_chunk_compare(tref->cref->link, data, chunks, i)) {
+      return tref->cref;
+    }
+  }
+  return NULL;
+}
+
+/* Content defined version of chunk_list_from_data_merge & chunk_list_fill_from_array.
+ *
+ * Since the boundaries only depend on the data, de-duplication is a lookup of each chunk,
+ * there is no need to search for matches at every element.
+ *
+ * param chunk_list_ref: Reuse chunks from this list (may be NULL),
+ * chunks repeating within data are also only stored once.
+ * param chunks: Calculated from data & chunk_list_ref.
+ * Caller is responsible for adding the user. */
+static ChunkList *chunk_list_from_data_cdc(const ArrayInfo *info,
+                                           ArrayMem *bs_mem,
+                                           const uchar *data,
+                                           const size_t data_len,
+                                           const ChunkList *chunk_list_ref,
+                                           const CDCChunks *chunks)
+{
+  lib_assert(info->use_content_defined_chunks);
+  lib_assert(chunks->len == 0 || chunks->ends[chunks->len - 1] == chunks->data_end);
+  UNUSED_VARS_NDEBUG(info);
+
+  /* Exact match. */
+  if (chunk_list_ref && (chunks->ref_match_first_len == chunk_list_ref->chunk_refs_len) &&
+      (chunks->data_start == data_len))
+  {
+    return (ChunkList *)chunk_list_ref;
+  }
+
+  ChunkList *chunk_list = chunk_list_new(bs_mem, data_len);
+
+  /* Matching chunks at the start, the ref chunks from `cref_ref_first` up to `cref_ref_end`
+   * are the ones between the matches at the start & end. */
+  const ChunkRef *cref_ref_first = NULL;
+  const ChunkRef *cref_ref_end = NULL;
+  uint ref_remaining_len = 0;
+  if (chunk_list_ref) {
+    cref_ref_first = chunk_list_ref->chunk_refs.first;
+    for (uint i = 0; i < chunks->ref_match_first_len; i++) {
+      chunk_list_append_only(bs_mem, chunk_list, cref_ref_first->link);
+      cref_ref_first = cref_ref_first->next;
+    }
+    ref_remaining_len = chunk_list_ref->chunk_refs_len -
+                        (chunks->ref_match_first_len + chunks->ref_match_last_len);
+    cref_ref_end = cref_ref_first;
+    for (uint i = 0; i < ref_remaining_len; i++) {
+      cref_ref_end = cref_ref_end->next;
+    }
+  }
+
+  if (chunks->len != 0) {
+    /* Remaining chunks of the ref and all new chunks are added to the table. */
+    const uint table_ref_stack_len = ref_remaining_len + chunks->len;
+    TableRef *table_ref_stack = mem_malloc(table_ref_stack_len * sizeof(TableRef), __func__);
+    uint table_ref_stack_n = 0;
+
+    const size_t table_len = table_ref_stack_len * BCHUNK_HASH_TABLE_MUL;
+    TableRef **table = mem_calloc(table_len * sizeof(*table), __func__);
+
+    for (const ChunkRef *cref = cref_ref_first; cref != cref_ref_end; cref = cref->next) {
+      cdc_table_insert(table, table_len, table_ref_stack, &table_ref_stack_n, cref);
+    }
+
+    /* The chunk most likely to match is the one after the previous chunk's match,
+     * or after the ref chunk it replaces when it's new. */
+    const ChunkRef *cref_hint = (cref_ref_first != cref_ref_end) ? cref_ref_first : NULL;
+    for (uint i = 0; i < chunks->len; i++) {
+      const ChunkRef *cref_found = NULL;
+      if (cref_hint && cdc_chunk_compare(cref_hint->link, data, chunks, i)) {
+        cref_found = cref_hint;
+      }
+      else {
+        cref_found = cdc_table_lookup(table, table_len, data, chunks, i);
+      }
+
+      if (cref_found != NULL) {
+        chunk_list_append_only(bs_mem, chunk_list, cref_found->link);
+        cref_hint = cref_found->next;
+      }
+      else {
+        const size_t offset = cdc_chunk_offset(chunks, i);
+        Chunk *chunk = chunk_new_copydata(bs_mem, &data[offset], chunks->ends[i] - offset);
+        chunk->key = chunks->keys[i];
+        chunk_list_append_only(bs_mem, chunk_list, chunk);
+        cdc_table_insert(
+            table, table_len, table_ref_stack, &table_ref_stack_n, chunk_list->chunk_refs.last);
+        cref_hint = cref_hint ? cref_hint->next : NULL;
+      }
+      if (cref_hint == cref_ref_end) {
+        cref_hint = NULL;
+      }
+    }
+
+    lib_assert(table_ref_stack_n <= table_ref_stack_len);
+
+    mem_free(table);
+    mem_free(table_ref_stack);
+  }
+
+  for (const ChunkRef *cref = cref_ref_end; cref; cref = cref->next) {
+    chunk_list_append_only(bs_mem, chunk_list, cref->link);
+  }
+
+  ASSERT_CHUNKLIST_SIZE(chunk_list, data_len);
+  ASSERT_CHUNKLIST_DATA(chunk_list, data);
+
+  return chunk_list;
+}
+
+/* End Content Defined Chunks */
+
+#endif /* USE_CONTENT_DEFINED_CHUNKS */
+
 /* End private API. */
 /* Main Array Storage API */
 ArrayStore *lib_array_store_create(uint stride, uint chunk_count)
@@ -1405,6 +1855,34 @@ ArrayStore *lib_array_store_create(uint stride, uint chunk_count)
   return bs;
 }
 
+ArrayStore *lib_array_store_create_ex(uint stride, uint chunk_count, const int flag)
+{
+  ArrayStore *bs = lib_array_store_create(stride, chunk_count);
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+  if (flag & ARRAY_STORE_CONTENT_DEFINED_CHUNKS) {
+    ArrayInfo *info = &bs->info;
+    const uint chunk_count_min = MAX2(1u, chunk_count / CDC_SIZE_MIN_DIV);
+    info->use_content_defined_chunks = true;
+    info->chunk_byte_size_min = chunk_count_min * stride;
+    info->chunk_byte_size_max = (chunk_count * CDC_SIZE_MAX_MUL) * stride;
+    info->cdc_window_bytes = ((CDC_WINDOW_BYTES + stride - 1) / stride) * stride;
+
+    /* Boundaries are tested after every element once a chunk reaches the min size,
+     * choose the number of bits to test so the average size is close to the regular size. */
+    uint cdc_bits = 0;
+    while ((2u << cdc_bits) <= chunk_count - chunk_count_min) {
+      cdc_bits += 1;
+    }
+    info->cdc_mask = cdc_bits ? (~(uint64_t)0 << (64 - cdc_bits)) : 0;
+  }
+#else
+  UNUSED_VARS(flag);
+#endif
+
+  return bs;
+}
+
 static void array_store_free_data(ArrayStore *bs)
 {
   /* Free chunk data. */
@@ -1471,10 +1949,13 @@ size_t lib_array_store_calc_size_compacted_get(const ArrayStore *bs)
 }
 
 /* ArrayState Access */
-ArrayState *lib_array_store_state_add(ArrayStore *bs,
-                                       const void *data,
-                                       const size_t data_len,
-                                       const ArrayState *state_ref)
+
+/* param chunks: Precalculated content defined chunks of data (may be NULL). */
+static ArrayState *array_store_state_add_ex(ArrayStore *bs,
+                                            const void *data,
+                                            const size_t data_len,
+                                            const ArrayState *state_ref,
+                                            const CDCChunks *chunks)
 {
   /* Ensure we're aligned to the stride. */
   lib_assert((data_len % bs->info.chunk_stride) == 0);
@@ -1486,7 +1967,31 @@ ArrayState *lib_array_store_state_add(ArrayStore *bs,
 #endif
 
   ChunkList *chunk_list;
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+  if (bs->info.use_content_defined_chunks) {
+    CDCChunks chunks_local;
+    if (chunks == NULL) {
+      cdc_chunks_calc(&bs->info,
+                      (const uchar *)data,
+                      data_len,
+                      state_ref ? state_ref->chunk_list : NULL,
+                      &chunks_local);
+    }
+    chunk_list = chunk_list_from_data_cdc(&bs->info,
+                                          &bs->mem,
+                                          (const uchar *)data,
+                                          data_len,
+                                          state_ref ? state_ref->chunk_list : NULL,
+                                          chunks ? chunks : &chunks_local);
+    if (chunks == NULL) {
+      cdc_chunks_free(&chunks_local);
+    }
+  }
+  else if (state_ref) {
+#else
+  UNUSED_VARS(chunks);
   if (state_ref) {
+#endif
     chunk_list = chunk_list_from_data_merge(&bs->info,
                                              &bs->mem,
                                              (const uchar *)data,
@@ -1519,6 +2024,120 @@ ArrayState *lib_array_store_state_add(ArrayStore *bs,
   return state;
 }
 
+ArrayState *lib_array_store_state_add(ArrayStore *bs,
+                                       const void *data,
+                                       const size_t data_len,
+                                       const ArrayState *state_ref)
+{
+  return array_store_state_add_ex(bs, data, data_len, state_ref, NULL);
+}
+
+/* Batch State Adding
+ *
+ * Content defined chunks only depend on the data (and read the reference state),
+ * so these are calculated for all arrays in parallel. Stores aren't thread-safe,
+ * so the states of each store are then added by a single task,
+ * while different stores are handled in parallel. */
+
+typedef struct StateAddBatchData {
+  ArrayStoreStateAdd *items;
+  /* Chunks of each item, only calculated for stores using content defined chunks. */
+  CDCChunks *items_chunks;
+  /* Items of each store, as linked lists of item indices (-1 terminated). */
+  int *store_item_first;
+  int *item_next;
+} StateAddBatchData;
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+static void state_add_batch_chunks_calc_fn(void *__restrict userdata,
+                                           const int item_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  StateAddBatchData *batch = userdata;
+  const ArrayStoreStateAdd *item = &batch->items[item_index];
+  if (item->bs->info.use_content_defined_chunks) {
+    cdc_chunks_calc(&item->bs->info,
+                    (const uchar *)item->data,
+                    item->data_len,
+                    item->state_ref ? item->state_ref->chunk_list : NULL,
+                    &batch->items_chunks[item_index]);
+  }
+}
+#endif
+
+static void state_add_batch_store_fn(void *__restrict userdata,
+                                     const int store_index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  StateAddBatchData *batch = userdata;
+  for (int i = batch->store_item_first[store_index]; i != -1; i = batch->item_next[i]) {
+    ArrayStoreStateAdd *item = &batch->items[i];
+    CDCChunks *chunks = NULL;
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+    if (item->bs->info.use_content_defined_chunks) {
+      chunks = &batch->items_chunks[i];
+    }
+#endif
+    item->state = array_store_state_add_ex(
+        item->bs, item->data, item->data_len, item->state_ref, chunks);
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+    if (chunks) {
+      cdc_chunks_free(chunks);
+    }
+#endif
+  }
+}
+
+void lib_array_store_state_add_batch(ArrayStoreStateAdd *items, const int items_len)
+{
+  if (items_len == 0) {
+    return;
+  }
+
+  StateAddBatchData batch = {.items = items};
+  batch.store_item_first = mem_malloc(sizeof(int) * (size_t)items_len, __func__);
+  batch.item_next = mem_malloc(sizeof(int) * (size_t)items_len, __func__);
+  int *store_item_last = mem_malloc(sizeof(int) * (size_t)items_len, __func__);
+
+  /* Group items by store, keeping their order (batches are small, a linear search is fine). */
+  int stores_len = 0;
+  size_t data_len_total = 0;
+  for (int i = 0; i < items_len; i++) {
+    int store_index = 0;
+    while ((store_index < stores_len) &&
+           (items[batch.store_item_first[store_index]].bs != items[i].bs)) {
+      store_index++;
+    }
+    if (store_index == stores_len) {
+      batch.store_item_first[store_index] = i;
+      stores_len += 1;
+    }
+    else {
+      batch.item_next[store_item_last[store_index]] = i;
+    }
+    store_item_last[store_index] = i;
+    batch.item_next[i] = -1;
+    data_len_total += items[i].data_len;
+  }
+  mem_free(store_item_last);
+
+  TaskParallelSettings settings;
+  lib_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (data_len_total >= ARRAY_STORE_BATCH_THREAD_MIN_BYTES);
+  settings.min_iter_per_thread = 1;
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+  batch.items_chunks = mem_calloc(sizeof(*batch.items_chunks) * (size_t)items_len, __func__);
+  lib_task_parallel_range(0, items_len, &batch, state_add_batch_chunks_calc_fn, &settings);
+#endif
+
+  lib_task_parallel_range(0, stores_len, &batch, state_add_batch_store_fn, &settings);
+
+  MEM_SAFE_FREE(batch.items_chunks);
+  mem_free(batch.store_item_first);
+  mem_free(batch.item_next);
+}
+
 void lib_array_store_state_remove(ArrayStore *bs, ArrayState *state)
 {
 #ifdef USE_PARANOID_CHECKS
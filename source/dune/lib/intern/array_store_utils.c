@@ -4,13 +4,15 @@
 #include "lib_utildefines.h"
 
 #include "lib_array_store.h"
+#include "lib_array_store_ex.h"
 #include "lib_array_store_utils.h" /* own include */
 
 #include "lib_math_base.h"
 
-ArrayStore *lib_array_store_at_size_ensure(struct ArrayStoreAtSize *bs_stride,
-                                            const int stride,
-                                            const int chunk_size)
+ArrayStore *lib_array_store_at_size_ensure_ex(struct ArrayStoreAtSize *bs_stride,
+                                               const int stride,
+                                               const int chunk_size,
+                                               const int flag)
 {
   if (bs_stride->stride_table_len < stride) {
     bs_stride->stride_table_len = stride;
@@ -29,11 +31,18 @@ ArrayStore *lib_array_store_at_size_ensure(struct ArrayStoreAtSize *bs_stride,
       chunk_count = size / stride;
     }
 
-    (*bs_p) = lib_array_store_create(stride, chunk_count);
+    (*bs_p) = lib_array_store_create_ex(stride, chunk_count, flag);
   }
   return *bs_p;
 }
 
+ArrayStore *lib_array_store_at_size_ensure(struct ArrayStoreAtSize *bs_stride,
+                                            const int stride,
+                                            const int chunk_size)
+{
+  return lib_array_store_at_size_ensure_ex(bs_stride, stride, chunk_size, 0);
+}
+
 ArrayStore *lib_array_store_at_size_get(struct ArrayStoreAtSize *bs_stride, const int stride)
 {
   lib_assert(stride > 0 && stride <= bs_stride->stride_table_len);
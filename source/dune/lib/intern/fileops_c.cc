@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdlib.h> /* malloc */
 #include <string.h>
 
@@ -33,11 +34,14 @@
 
 #include "mem_guardedalloc.h"
 
+#include "lib_endian_switch.h"
 #include "lib_fileops.h"
+#include "lib_fileops_ex.h"
 #include "lib_path_util.h"
 #include "lib_string.h"
 #include "lib_string_utils.hh"
 #include "lib_sys_types.h" /* for intptr_t support */
+#include "lib_task.h"
 #include "lib_utildefines.h"
 
 /* Sizes above this must be alloc. */
@@ -245,6 +249,151 @@ size_t lib_file_unzstd_to_mem_at_pos(void *buf, size_t len, FILE *file, size_t f
   return ZSTD_isError(ret) ? 0 : output.pos;
 }
 
+/* Seekable zstd files: independently compressed frames followed by a seek table frame holding
+ * the size of every frame, in the format of the zstd seekable contrib. Frames are compressed in
+ * parallel, a group of frames at a time to bound the memory used: at most
+ * #ZSTD_SEEKABLE_GROUP_FRAMES frames, whose compressed buffers take at most
+ * #ZSTD_SEEKABLE_GROUP_BYTES (or a single frame when larger). */
+#define ZSTD_SEEKABLE_GROUP_FRAMES 32
+#define ZSTD_SEEKABLE_GROUP_BYTES (64 << 20)
+
+struct ZstdSeekableFrame {
+  char *compressed;
+  size_t compressed_size;
+  size_t uncompressed_size;
+};
+
+struct ZstdSeekableWriteData {
+  const char *buf;
+  size_t len;
+  size_t frame_size;
+  size_t frame_size_bound;
+  int compression_level;
+  size_t frame_start;
+  ZstdSeekableFrame frames[ZSTD_SEEKABLE_GROUP_FRAMES];
+};
+
+static void zstd_seekable_compress_frame_fn(void *__restrict userdata,
+                                            const int i,
+                                            const TaskParallelTLS *__restrict /*tls*/)
+{
+  ZstdSeekableWriteData *data = static_cast<ZstdSeekableWriteData *>(userdata);
+  ZstdSeekableFrame *frame = &data->frames[i];
+  const size_t frame_offset = (data->frame_start + size_t(i)) * data->frame_size;
+
+  frame->uncompressed_size = std::min(data->frame_size, data->len - frame_offset);
+
+  ZSTD_CCxt *cxt = ZSTD_createCCxt();
+  frame->compressed_size = ZSTD_compressCCxt(cxt,
+                                             frame->compressed,
+                                             data->frame_size_bound,
+                                             data->buf + frame_offset,
+                                             frame->uncompressed_size,
+                                             data->compression_level);
+  ZSTD_freeCCxt(cxt);
+}
+
+static bool zstd_seekable_write_u32(FILE *file, uint32_t val)
+{
+#ifdef __BIG_ENDIAN__
+  lib_endian_switch_uint32(&val);
+#endif
+  return fwrite(&val, sizeof(val), 1, file) == 1;
+}
+
+size_t lib_file_zstd_seekable_from_mem_at_pos(void *buf,
+                                              size_t len,
+                                              FILE *file,
+                                              size_t file_offset,
+                                              int compression_level,
+                                              size_t frame_size)
+{
+  /* Sizes in the seek table are 32 bit, leave room for incompressible data. */
+  lib_assert(frame_size > 0 && frame_size <= (1u << 31));
+
+  fseek(file, file_offset, SEEK_SET);
+
+  const size_t frames_num = (len + frame_size - 1) / frame_size;
+  if (frames_num > UINT32_MAX) {
+    return 0;
+  }
+  uint32_t(*seek_table)[2] = static_cast<uint32_t(*)[2]>(
+      mem_malloc(sizeof(*seek_table) * std::max(frames_num, size_t(1)), __func__));
+
+  ZstdSeekableWriteData *data = static_cast<ZstdSeekableWriteData *>(
+      mem_calloc(sizeof(ZstdSeekableWriteData), __func__));
+  data->buf = static_cast<const char *>(buf);
+  data->len = len;
+  data->frame_size = frame_size;
+  data->frame_size_bound = ZSTD_compressBound(frame_size);
+  data->compression_level = compression_level;
+
+  const size_t group_frames_max = std::clamp(size_t(ZSTD_SEEKABLE_GROUP_BYTES) /
+                                                 data->frame_size_bound,
+                                             size_t(1),
+                                             size_t(ZSTD_SEEKABLE_GROUP_FRAMES));
+
+  size_t total_written = 0;
+  bool is_error = false;
+
+  for (size_t frame_start = 0; frame_start < frames_num && !is_error;
+       frame_start += group_frames_max)
+  {
+    const int group_frames_num = int(std::min(frames_num - frame_start, group_frames_max));
+    data->frame_start = frame_start;
+    for (int i = 0; i < group_frames_num; i++) {
+      if (data->frames[i].compressed == nullptr) {
+        data->frames[i].compressed = static_cast<char *>(
+            mem_malloc(data->frame_size_bound, __func__));
+      }
+    }
+
+    TaskParallelSettings settings;
+    lib_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    lib_task_parallel_range(0, group_frames_num, data, zstd_seekable_compress_frame_fn, &settings);
+
+    /* Write the frames in order. */
+    for (int i = 0; i < group_frames_num; i++) {
+      const ZstdSeekableFrame *frame = &data->frames[i];
+      if (ZSTD_isError(frame->compressed_size) ||
+          fwrite(frame->compressed, 1, frame->compressed_size, file) != frame->compressed_size)
+      {
+        is_error = true;
+        break;
+      }
+      seek_table[frame_start + size_t(i)][0] = uint32_t(frame->compressed_size);
+      seek_table[frame_start + size_t(i)][1] = uint32_t(frame->uncompressed_size);
+      total_written += frame->compressed_size;
+    }
+  }
+
+  for (int i = 0; i < ZSTD_SEEKABLE_GROUP_FRAMES; i++) {
+    MEM_SAFE_FREE(data->frames[i].compressed);
+  }
+  mem_free(data);
+
+  /* The seek table is a skippable frame: magic, length, then an entry per frame followed by
+   * the number of frames, flags (no check-sums) and the seek table magic. */
+  if (!is_error) {
+    const uint32_t seek_table_len = uint32_t(frames_num * 8 + 9);
+    const uint8_t flags = 0;
+    is_error = !zstd_seekable_write_u32(file, 0x184D2A5E) ||
+               !zstd_seekable_write_u32(file, seek_table_len);
+    for (size_t i = 0; i < frames_num && !is_error; i++) {
+      is_error = !zstd_seekable_write_u32(file, seek_table[i][0]) ||
+                 !zstd_seekable_write_u32(file, seek_table[i][1]);
+    }
+    is_error = is_error || !zstd_seekable_write_u32(file, uint32_t(frames_num)) ||
+               fwrite(&flags, 1, 1, file) != 1 || !zstd_seekable_write_u32(file, 0x8F92EAB1);
+    total_written += 8 + seek_table_len;
+  }
+
+  mem_free(seek_table);
+
+  return is_error ? 0 : total_written;
+}
+
 bool lib_file_magic_is_gzip(const char header[4])
 {
   /* GZIP itself starts with the magic bytes 0x1f 0x8b.
@@ -4,10 +4,35 @@
 #include "lib_dunelib.h"
 #include "lib_endian_switch.h"
 #include "lib_filereader.h"
+#include "lib_filereader_ex.h"
 #include "lib_math_base.h"
+#include "lib_task.h"
 
 #include "mem_guardedalloc.h"
 
+/* A frame decompressed ahead of reading it. */
+typedef struct ZstdFrameBuf {
+  ZSTD_DCxt *cxt;
+  int frame;
+  bool is_valid;
+
+  char *compressed;
+  size_t compressed_size;
+  size_t compressed_alloc;
+  char *content;
+  size_t content_size;
+  size_t content_alloc;
+} ZstdFrameBuf;
+
+/* Consecutive frames decompressed by the tasks of a pool. */
+typedef struct ZstdReadAheadBatch {
+  ZstdFrameBuf *bufs;
+  int frame_start;
+  int frames_num;
+  /* Set while the frames are being decompressed. */
+  TaskPool *pool;
+} ZstdReadAheadBatch;
+
 typedef struct {
   FileReader reader;
 
@@ -25,6 +50,14 @@ typedef struct {
     char *cached_content;
     int cached_frame;
   } seek;
+
+  /* The ring of frame buffers is split in two batches: frames are read from one batch
+   * while the following frames are decompressed into the other. */
+  struct {
+    ZstdReadAheadBatch batches[2];
+    /* Frames per batch, zero when reading ahead isn't used. */
+    int batch_frames_num;
+  } read_ahead;
 } ZstdReader;
 
 static bool zstd_read_u32(FileReader *base, uint32_t *val)
@@ -185,6 +218,110 @@ static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
   return uncompressed_data;
 }
 
+static void zstd_read_ahead_frame_task(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  ZstdFrameBuf *frame_buf = taskdata;
+
+  size_t res = ZSTD_decompressDCxt(frame_buf->cxt,
+                                   frame_buf->content,
+                                   frame_buf->content_size,
+                                   frame_buf->compressed,
+                                   frame_buf->compressed_size);
+  frame_buf->is_valid = !ZSTD_isError(res) && res == frame_buf->content_size;
+}
+
+static void zstd_read_ahead_batch_wait(ZstdReadAheadBatch *batch)
+{
+  if (batch->pool) {
+    lib_task_pool_work_and_wait(batch->pool);
+    lib_task_pool_free(batch->pool);
+    batch->pool = NULL;
+  }
+}
+
+/* Read the compressed data of the frames from `frame_start` on, and decompress them in tasks.
+ * The base reader isn't thread safe, so reading is done here. */
+static void zstd_read_ahead_batch_start(ZstdReader *zstd,
+                                        ZstdReadAheadBatch *batch,
+                                        const int frame_start)
+{
+  zstd_read_ahead_batch_wait(batch);
+
+  batch->frame_start = frame_start;
+  batch->frames_num = min_ii(zstd->read_ahead.batch_frames_num,
+                             zstd->seek.frames_num - frame_start);
+  batch->pool = lib_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+
+  for (int i = 0; i < batch->frames_num; i++) {
+    ZstdFrameBuf *frame_buf = &batch->bufs[i];
+    const int frame = frame_start + i;
+    const size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] -
+                                   zstd->seek.compressed_ofs[frame];
+    const size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                                     zstd->seek.uncompressed_ofs[frame];
+
+    /* Buffers are only grown, to reuse them for the following frames. */
+    if (compressed_size > frame_buf->compressed_alloc) {
+      MEM_SAFE_FREE(frame_buf->compressed);
+      frame_buf->compressed = mem_malloc(compressed_size, __func__);
+      frame_buf->compressed_alloc = compressed_size;
+    }
+    if (uncompressed_size > frame_buf->content_alloc) {
+      MEM_SAFE_FREE(frame_buf->content);
+      frame_buf->content = mem_malloc(uncompressed_size, __func__);
+      frame_buf->content_alloc = uncompressed_size;
+    }
+    frame_buf->compressed_size = compressed_size;
+    frame_buf->content_size = uncompressed_size;
+    frame_buf->frame = frame;
+    frame_buf->is_valid = false;
+
+    if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
+        zstd->base->read(zstd->base, frame_buf->compressed, compressed_size) < compressed_size)
+    {
+      /* The following frames are invalid too, reading them will fail. */
+      batch->frames_num = i + 1;
+      break;
+    }
+
+    lib_task_pool_push(batch->pool, zstd_read_ahead_frame_task, frame_buf, false, NULL);
+  }
+}
+
+/* Like #zstd_ensure_cache, using the frames decompressed ahead, which starts decompressing
+ * the frames following the requested one. */
+static const char *zstd_read_ahead_ensure(ZstdReader *zstd, int frame)
+{
+  ZstdReadAheadBatch *batch = NULL;
+  for (int i = 0; i < 2; i++) {
+    ZstdReadAheadBatch *batch_test = &zstd->read_ahead.batches[i];
+    if (frame >= batch_test->frame_start &&
+        frame < batch_test->frame_start + batch_test->frames_num) {
+      batch = batch_test;
+    }
+  }
+
+  if (batch == NULL) {
+    /* The first read, or after seeking elsewhere. */
+    batch = &zstd->read_ahead.batches[0];
+    zstd_read_ahead_batch_start(zstd, batch, frame);
+  }
+  zstd_read_ahead_batch_wait(batch);
+
+  /* Decompress the following frames while the frames of this batch are read. */
+  ZstdReadAheadBatch *batch_next = (batch == &zstd->read_ahead.batches[0]) ?
+                                       &zstd->read_ahead.batches[1] :
+                                       &zstd->read_ahead.batches[0];
+  const int frame_next = batch->frame_start + batch->frames_num;
+  if (batch_next->frame_start != frame_next && frame_next < zstd->seek.frames_num) {
+    zstd_read_ahead_batch_start(zstd, batch_next, frame_next);
+  }
+
+  const ZstdFrameBuf *frame_buf = &batch->bufs[frame - batch->frame_start];
+  lib_assert(frame_buf->frame == frame);
+  return frame_buf->is_valid ? frame_buf->content : NULL;
+}
+
 static int64_t zstd_read_seekable(FileReader *reader, void *buf, size_t size)
 {
   ZstdReader *zstd = (ZstdReader *)reader;
@@ -197,7 +334,9 @@ static int64_t zstd_read_seekable(FileReader *reader, void *buf, size_t size)
       break;
     }
 
-    const char *framedata = zstd_ensure_cache(zstd, frame);
+    const char *framedata = zstd->read_ahead.batch_frames_num ?
+                                zstd_read_ahead_ensure(zstd, frame) :
+                                zstd_ensure_cache(zstd, frame);
     if (framedata == NULL) {
       /* Error while reading the frame, so return as much as we can. */
       break;
@@ -207,7 +346,7 @@ static int64_t zstd_read_seekable(FileReader *reader, void *buf, size_t size)
     size_t frame_read_len = frame_end_offset - zstd->reader.offset;
 
     size_t offset_in_frame = zstd->reader.offset - zstd->seek.uncompressed_ofs[frame];
-    memcpy((char *)buffer + read_len, framedata + offset_in_frame, frame_read_len);
+    memcpy((char *)buf + read_len, framedata + offset_in_frame, frame_read_len);
     read_len += frame_read_len;
     zstd->reader.offset = frame_end_offset;
   }
@@ -258,7 +397,7 @@ static int64_t zstd_read(FileReader *reader, void *buf, size_t size)
       }
     }
 
-    if (ZSTD_isError(ZSTD_decompressStream(zstd->ctx, &output, &zstd->in_buf))) {
+    if (ZSTD_isError(ZSTD_decompressStream(zstd->cxt, &output, &zstd->in_buf))) {
       break;
     }
   }
@@ -279,6 +418,16 @@ static void zstd_close(FileReader *reader)
     if (zstd->seek.cached_content) {
       mem_free(zstd->seek.cached_content);
     }
+    for (int i = 0; i < 2 && zstd->read_ahead.batch_frames_num; i++) {
+      ZstdReadAheadBatch *batch = &zstd->read_ahead.batches[i];
+      zstd_read_ahead_batch_wait(batch);
+      for (int j = 0; j < zstd->read_ahead.batch_frames_num; j++) {
+        ZSTD_freeDCxt(batch->bufs[j].cxt);
+        MEM_SAFE_FREE(batch->bufs[j].compressed);
+        MEM_SAFE_FREE(batch->bufs[j].content);
+      }
+      mem_free(batch->bufs);
+    }
   }
   else {
     mem_free((void *)zstd->in_buf.src);
@@ -288,16 +437,29 @@ static void zstd_close(FileReader *reader)
   mem_free(zstd);
 }
 
-FileReader *lib_filereader_new_zstd(FileReader *base)
+FileReader *lib_filereader_new_zstd_ex(FileReader *base, int read_ahead_frames)
 {
   ZstdReader *zstd = mem_calloc(sizeof(ZstdReader), __func__);
 
-  zstd->ctx = ZSTD_createDCxt();
+  zstd->cxt = ZSTD_createDCxt();
   zstd->base = base;
 
   if (zstd_read_seek_table(zstd)) {
     zstd->reader.read = zstd_read_seekable;
     zstd->reader.seek = zstd_seek;
+
+    /* Not worth it for files of a single batch. */
+    const int batch_frames_num = read_ahead_frames / 2;
+    if (batch_frames_num > 1 && zstd->seek.frames_num > batch_frames_num) {
+      zstd->read_ahead.batch_frames_num = batch_frames_num;
+      for (int i = 0; i < 2; i++) {
+        ZstdReadAheadBatch *batch = &zstd->read_ahead.batches[i];
+        batch->bufs = mem_calloc(sizeof(*batch->bufs) * (size_t)batch_frames_num, __func__);
+        for (int j = 0; j < batch_frames_num; j++) {
+          batch->bufs[j].cxt = ZSTD_createDCxt();
+        }
+      }
+    }
   }
   else {
     zstd->reader.read = zstd_read;
@@ -317,3 +479,8 @@ FileReader *lib_filereader_new_zstd(FileReader *base)
 
   return (FileReader *)zstd;
 }
+
+FileReader *lib_filereader_new_zstd(FileReader *base)
+{
+  return lib_filereader_new_zstd_ex(base, 0);
+}
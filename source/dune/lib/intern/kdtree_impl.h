@@ -1,7 +1,9 @@
 #include "mem_guardedalloc.h"
 
+#include "lib_kdtree_ex.h"
 #include "lib_kdtree_impl.h"
 #include "lib_math_base.h"
+#include "lib_task.h"
 #include "lib_strict_flags.h"
 #include "lib_utildefines.h"
 
@@ -39,6 +41,11 @@ struct KDTree {
 #define KD_NEAR_ALLOC_INC 100 /* alloc increment for collecting nearest */
 #define KD_FOUND_ALLOC_INC 50 /* alloc increment for collecting nearest */
 
+/* Balance sub-trees of more nodes than this in a task of their own. */
+#define KD_BALANCE_TASK_NODES_MIN 16384
+/* Search the nearest of batches of more queries than this with multiple threads. */
+#define KD_BATCH_THREAD_QUERIES_MIN 1024
+
 #define KD_NODE_UNSET ((uint)-1)
 
 /* When set we know all vas are unbalanced,
@@ -118,7 +125,28 @@ void lib_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+typedef struct KDBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+  /* The sub-tree root is stored here. */
+  uint *r_root;
+} KDBalanceTask;
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata)
+{
+  KDBalanceTask *task = taskdata;
+  *task->r_root = kdtree_balance(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/* Sorts nodes around the median, then balances both halves. When `pool` is set, large sub-trees
+ * are balanced by tasks, every sub-tree being a separate range of `nodes`. */
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
   float co;
@@ -167,14 +195,27 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
-  node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+  if (pool && (nodes_len - (median + 1)) > KD_BALANCE_TASK_NODES_MIN) {
+    KDBalanceTask *task = mem_malloc(sizeof(*task), __func__);
+    task->nodes = nodes + median + 1;
+    task->nodes_len = nodes_len - (median + 1);
+    task->axis = axis;
+    task->ofs = (median + 1) + ofs;
+    task->r_root = &node->right;
+    lib_task_pool_push(pool, kdtree_balance_task, task, true, NULL);
+  }
+  else {
+    node->right = kdtree_balance(
+        pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+  }
+  node->left = kdtree_balance(pool, nodes, median, axis, ofs);
 
   return median + ofs;
 }
 
-void lib_kdtree_nd_(balance)(KDTree *tree)
+/* Balancing large trees with multiple threads only with use_threading,
+ * the tree is the same either way. */
+void lib_kdtree_nd_(balance_ex)(KDTree *tree, const bool use_threading)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
     for (uint i = 0; i < tree->nodes_len; i++) {
@@ -183,13 +224,26 @@ void lib_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (use_threading && tree->nodes_len > KD_BALANCE_TASK_NODES_MIN * 2) {
+    TaskPool *pool = lib_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance(pool, tree->nodes, tree->nodes_len, 0, 0);
+    lib_task_pool_work_and_wait(pool);
+    lib_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(NULL, tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifndef NDEBUG
   tree->is_balanced = true;
 #endif
 }
 
+void lib_kdtree_nd_(balance)(KDTree *tree)
+{
+  lib_kdtree_nd_(balance_ex)(tree, true);
+}
+
 static uint *realloc_nodes(uint *stack, uint *stack_len_capacity, const bool is_alloc)
 {
   uint *stack_new = mem_malloc((*stack_len_capacity + KD_NEAR_ALLOC_INC) * sizeof(uint),
@@ -565,6 +619,155 @@ int lib_kdtree_nd_(find_nearest_n)(const KDTree *tree,
       tree, co, r_nearest, nearest_len_capacity, NULL, NULL);
 }
 
+/* lib_kdtree_3d_find_nearest_n_batch */
+typedef struct KDNearestBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  KDTreeNearest *r_nearest;
+  uint nearest_len_capacity;
+  int *r_nearest_len;
+} KDNearestBatchData;
+
+/* find_nearest_n without a distance callback, the stack never grows:
+ * a balanced tree is at most 33 levels deep, which keeps at most one node per level stacked.
+ * Nodes are visited in the same order, for the same nearest (of equal distances too). */
+static uint kdtree_find_nearest_n_fixed_stack(const KDTree *tree,
+                                              const float co[KD_DIMS],
+                                              KDTreeNearest r_nearest[],
+                                              const uint nearest_len_capacity)
+{
+  const KDTreeNode *nodes = tree->nodes;
+  const KDTreeNode *root = &nodes[tree->root];
+  uint stack[KD_STACK_INIT];
+  float cur_dist;
+  uint cur = 0;
+  uint i, nearest_len = 0;
+
+  cur_dist = len_squared_vnvn(co, root->co);
+  nearest_ordered_insert(
+      r_nearest, &nearest_len, nearest_len_capacity, root->index, cur_dist, root->co);
+
+  if (co[root->d] < root->co[root->d]) {
+    if (root->right != KD_NODE_UNSET) {
+      stack[cur++] = root->right;
+    }
+    if (root->left != KD_NODE_UNSET) {
+      stack[cur++] = root->left;
+    }
+  }
+  else {
+    if (root->left != KD_NODE_UNSET) {
+      stack[cur++] = root->left;
+    }
+    if (root->right != KD_NODE_UNSET) {
+      stack[cur++] = root->right;
+    }
+  }
+
+  while (cur--) {
+    const KDTreeNode *node = &nodes[stack[cur]];
+
+    cur_dist = node->co[node->d] - co[node->d];
+
+    if (cur_dist < 0.0f) {
+      cur_dist = -cur_dist * cur_dist;
+
+      if (nearest_len < nearest_len_capacity || -cur_dist < r_nearest[nearest_len - 1].dist) {
+        cur_dist = len_squared_vnvn(co, node->co);
+
+        if (nearest_len < nearest_len_capacity || cur_dist < r_nearest[nearest_len - 1].dist) {
+          nearest_ordered_insert(
+              r_nearest, &nearest_len, nearest_len_capacity, node->index, cur_dist, node->co);
+        }
+
+        if (node->left != KD_NODE_UNSET) {
+          stack[cur++] = node->left;
+        }
+      }
+      if (node->right != KD_NODE_UNSET) {
+        stack[cur++] = node->right;
+      }
+    }
+    else {
+      cur_dist = cur_dist * cur_dist;
+
+      if (nearest_len < nearest_len_capacity || cur_dist < r_nearest[nearest_len - 1].dist) {
+        cur_dist = len_squared_vnvn(co, node->co);
+        if (nearest_len < nearest_len_capacity || cur_dist < r_nearest[nearest_len - 1].dist) {
+          nearest_ordered_insert(
+              r_nearest, &nearest_len, nearest_len_capacity, node->index, cur_dist, node->co);
+        }
+
+        if (node->right != KD_NODE_UNSET) {
+          stack[cur++] = node->right;
+        }
+      }
+      if (node->left != KD_NODE_UNSET) {
+        stack[cur++] = node->left;
+      }
+    }
+    lib_assert(cur + KD_DIMS <= ARRAY_SIZE(stack));
+  }
+
+  for (i = 0; i < nearest_len; i++) {
+    r_nearest[i].dist = sqrtf(r_nearest[i].dist);
+  }
+
+  return nearest_len;
+}
+
+static void kdtree_find_nearest_n_batch_cb(void *__restrict userdata,
+                                           const int i,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDNearestBatchData *data = userdata;
+  const uint nearest_len = kdtree_find_nearest_n_fixed_stack(
+      data->tree,
+      data->co[i],
+      &data->r_nearest[(size_t)i * data->nearest_len_capacity],
+      data->nearest_len_capacity);
+  if (data->r_nearest_len) {
+    data->r_nearest_len[i] = (int)nearest_len;
+  }
+}
+
+/* Find the nearest_len_capacity nearest points to each of co, in parallel.
+ * param r_nearest: Flat array of queries_num * nearest_len_capacity nearest,
+ * those of query i start at i * nearest_len_capacity, ordered by distance.
+ * param r_nearest_len: The num of points found for each query (optional). */
+void lib_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint queries_num,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+#ifndef NDEBUG
+  lib_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY((tree->root == KD_NODE_UNSET) || nearest_len_capacity == 0)) {
+    if (r_nearest_len) {
+      memset(r_nearest_len, 0, sizeof(*r_nearest_len) * queries_num);
+    }
+    return;
+  }
+
+  KDNearestBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+      .nearest_len_capacity = nearest_len_capacity,
+      .r_nearest_len = r_nearest_len,
+  };
+
+  TaskParallelSettings settings;
+  lib_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (queries_num > KD_BATCH_THREAD_QUERIES_MIN);
+  settings.min_iter_per_thread = KD_BATCH_THREAD_QUERIES_MIN / 4;
+  lib_task_parallel_range(0, (int)queries_num, &data, kdtree_find_nearest_n_batch_cb, &settings);
+}
+
 static int nearest_cmp_dist(const void *a, const void *b)
 {
   const KDTreeNearest *kda = a;
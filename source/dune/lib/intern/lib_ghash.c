@@ -1,5 +1,8 @@
 /* A general (ptr -> ptr) chaining hash table
- * for 'Abstract Data Types' (known as an ADT Hash Table). */
+ * for 'Abstract Data Types' (known as an ADT Hash Table).
+ *
+ * With #GHASH_FLAG_OPEN_ADDRESSING the bucket chains are replaced by an open addressing index
+ * (see "Open Addressing Index" below), entries are still allocated from the same pool. */
 #include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -8,6 +11,7 @@
 #include "mem_guardedalloc.h"
 
 #include "lib_math_base.h"
+#include "lib_math_bits.h"
 #include "lib_mempool.h"
 #include "lib_sys_types.h" /* for intptr_t support */
 #include "lib_utildefines.h"
@@ -15,6 +19,15 @@
 #define GHASH_INTERNAL_API
 #include "lib_ghash.h" /* own include */
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define GHASH_GROUP_SSE2
+#elif defined(__ARM_NEON) && defined(__BYTE_ORDER__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#  include <arm_neon.h>
+#  define GHASH_GROUP_NEON
+#endif
+
 /* keep last */
 #include "lib_strict_flags.h"
 
@@ -45,6 +58,11 @@ LIB_STATIC_ASSERT(ARRAY_SIZE(hashsizes) == GHASH_MAX_SIZE, "Invalid 'hashsizes'
 #define GHASH_LIMIT_GROW(_nbkt) (((_nbkt)*3) / 4)
 #define GHASH_LIMIT_SHRINK(_nbkt) (((_nbkt)*3) / 16)
 
+/* The open addressing index can be filled a lot more than the chained buckets,
+ * since probing a group of control bytes is about as cheap as testing a single bucket. */
+#define GHASH_OPEN_LIMIT_GROW(_nslots) ((_nslots) - ((_nslots) / 8))
+#define GHASH_OPEN_LIMIT_SHRINK(_nslots) (((_nslots)*3) / 16)
+
 /* WARNING! Keep in sync with ugly _gh_Entry in header!!! */
 typedef struct Entry {
   struct Entry *next;
@@ -62,6 +80,20 @@ typedef Entry GSetEntry;
 
 #define GHASH_ENTRY_SIZE(_is_gset) ((_is_gset) ? sizeof(GSetEntry) : sizeof(GHashEntry))
 
+/* Number of slots probed at once by the open addressing index. */
+#ifdef GHASH_GROUP_SSE2
+#  define GHASH_GROUP_WIDTH 16
+#else
+#  define GHASH_GROUP_WIDTH 8
+#endif
+
+/* Control bytes are stored next to their slots, so probing a group and reading the matching
+ * slot usually touches a single cache line. */
+typedef struct GHashGroup {
+  uint8_t ctrl[GHASH_GROUP_WIDTH];
+  Entry *slots[GHASH_GROUP_WIDTH];
+} GHashGroup;
+
 struct GHash {
   GHashHashFP hashfp;
   GHashCmpFP cmpfp;
@@ -76,6 +108,13 @@ struct GHash {
   uint bucket_mask, bucket_bit, bucket_bit_min;
 #endif
 
+  /* Open addressing index, used instead of `buckets` with #GHASH_FLAG_OPEN_ADDRESSING.
+   * `nbuckets` is then the number of slots. */
+  GHashGroup *groups;
+  uint group_mask, slot_bit, slot_bit_min;
+  /* Number of empty slots that can still be filled before a rehash is needed. */
+  uint growth_left;
+
   uint nentries;
   uint flag;
 };
@@ -113,9 +152,339 @@ LIB_INLINE uint ghash_entryhash(const GHash *gh, const Entry *e)
   return gh->hashfp(e->key);
 }
 
-/* Get the bucket-index for an already-computed full hash. */
+/* Open Addressing Index
+ *
+ * Swiss-table style index: every slot has a control byte, which is either EMPTY, DELETED
+ * (a tombstone left by a removal) or 7 bits of the hash of the entry stored in the slot.
+ * Lookups compare all control bytes of a group against the hash at once (SSE2, NEON,
+ * or 8 bytes packed in an integer), entries are only accessed for likely matches.
+ *
+ * Entries are still allocated from `entrypool`, so pointers to keys and values remain valid
+ * when the index is rebuilt, and the iterator only has to walk the slots instead of buckets. */
+
+#define GHASH_CTRL_EMPTY ((uint8_t)0x80)
+#define GHASH_CTRL_DELETED ((uint8_t)0xFE)
+/* Full slots store 7 bits of the hash, EMPTY and DELETED both have the high bit set. */
+#define GHASH_CTRL_IS_FULL(_ctrl) ((_ctrl) < GHASH_CTRL_EMPTY)
+
+#define GHASH_SLOT_CTRL(_gh, _slot) \
+  ((_gh)->groups[(_slot) / GHASH_GROUP_WIDTH].ctrl[(_slot) % GHASH_GROUP_WIDTH])
+#define GHASH_SLOT_ENTRY(_gh, _slot) \
+  ((_gh)->groups[(_slot) / GHASH_GROUP_WIDTH].slots[(_slot) % GHASH_GROUP_WIDTH])
+
+/* The index always holds at least one group. */
+#ifdef GHASH_GROUP_SSE2
+#  define GHASH_OPEN_SLOT_BIT_MIN 4
+#else
+#  define GHASH_OPEN_SLOT_BIT_MIN 3
+#endif
+#define GHASH_OPEN_SLOT_BIT_MAX 30
+
+/* One bit set for every slot of a group matching the query,
+ * the bits of slot `i` start at `i << GHASH_GROUP_MASK_SHIFT`. */
+typedef uint64_t GHashGroupMask;
+
+#if defined(GHASH_GROUP_SSE2)
+#  define GHASH_GROUP_MASK_SHIFT 0
+
+LIB_INLINE GHashGroupMask ghash_group_match(const GHashGroup *group, const uint8_t h2)
+{
+  const __m128i ctrl = _mm_loadu_si128((const __m128i *)group->ctrl);
+  return (GHashGroupMask)(uint)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2)));
+}
+
+LIB_INLINE GHashGroupMask ghash_group_match_empty(const GHashGroup *group)
+{
+  return ghash_group_match(group, GHASH_CTRL_EMPTY);
+}
+
+LIB_INLINE GHashGroupMask ghash_group_match_empty_or_deleted(const GHashGroup *group)
+{
+  return (GHashGroupMask)(uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group->ctrl));
+}
+#elif defined(GHASH_GROUP_NEON)
+#  define GHASH_GROUP_MASK_SHIFT 3
+
+LIB_INLINE GHashGroupMask ghash_group_match(const GHashGroup *group, const uint8_t h2)
+{
+  const uint8x8_t eq = vceq_u8(vld1_u8(group->ctrl), vdup_n_u8(h2));
+  return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ull;
+}
+
+LIB_INLINE GHashGroupMask ghash_group_match_empty(const GHashGroup *group)
+{
+  return ghash_group_match(group, GHASH_CTRL_EMPTY);
+}
+
+LIB_INLINE GHashGroupMask ghash_group_match_empty_or_deleted(const GHashGroup *group)
+{
+  return vget_lane_u64(vreinterpret_u64_u8(vld1_u8(group->ctrl)), 0) & 0x8080808080808080ull;
+}
+#else
+#  define GHASH_GROUP_MASK_SHIFT 3
+
+/* Portable fallback, the control bytes packed in an integer (first slot lowest). */
+LIB_INLINE uint64_t ghash_group_load(const GHashGroup *group)
+{
+  uint64_t ctrl;
+  memcpy(&ctrl, group->ctrl, sizeof(ctrl));
+#  if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  ctrl = __builtin_bswap64(ctrl);
+#  endif
+  return ctrl;
+}
+
+/* May report false positives for full slots following a match,
+ * those are rejected by the key comparison anyway. */
+LIB_INLINE GHashGroupMask ghash_group_match(const GHashGroup *group, const uint8_t h2)
+{
+  const uint64_t lsbs = 0x0101010101010101ull;
+  const uint64_t x = ghash_group_load(group) ^ (lsbs * h2);
+  return (x - lsbs) & ~x & 0x8080808080808080ull;
+}
+
+/* EMPTY is the only control byte with the high bit set and the second lowest bit cleared. */
+LIB_INLINE GHashGroupMask ghash_group_match_empty(const GHashGroup *group)
+{
+  const uint64_t ctrl = ghash_group_load(group);
+  return ctrl & ~(ctrl << 6) & 0x8080808080808080ull;
+}
+
+LIB_INLINE GHashGroupMask ghash_group_match_empty_or_deleted(const GHashGroup *group)
+{
+  return ghash_group_load(group) & 0x8080808080808080ull;
+}
+#endif
+
+/* Return the first matching slot of the group, and clear it from the mask. */
+LIB_INLINE uint ghash_group_mask_next(GHashGroupMask *mask)
+{
+  const uint offset = bitscan_forward_uint64(*mask) >> GHASH_GROUP_MASK_SHIFT;
+  *mask &= *mask - 1;
+  return offset;
+}
+
+/* Many hash functions (pointers, integers...) only vary in some of their bits, mix them.
+ * The high half selects the first group to probe, the 7 bits below it go in the control byte. */
+LIB_INLINE uint64_t ghash_open_hash_mix(const uint hash)
+{
+  return (uint64_t)hash * 0xBF58476D1CE4E5B9ull;
+}
+#define GHASH_OPEN_H1(_mix) ((uint)((_mix) >> 32))
+#define GHASH_OPEN_H2(_mix) ((uint8_t)(((_mix) >> 25) & 0x7F))
+
+/* Triangular probing, visits every group once since the number of groups is a power of two. */
+#define GHASH_OPEN_PROBE_NEXT(_gh, _group_index, _stride) \
+  { \
+    (_stride)++; \
+    (_group_index) = ((_group_index) + (_stride)) & (_gh)->group_mask; \
+  } \
+  ((void)0)
+
+/* Find the slot of the entry matching key, or UINT_MAX if there is none. */
+LIB_INLINE uint ghash_open_lookup_slot(const GHash *gh, const void *key, const uint hash)
+{
+  const uint64_t mix = ghash_open_hash_mix(hash);
+  const uint8_t h2 = GHASH_OPEN_H2(mix);
+  uint group_index = GHASH_OPEN_H1(mix) & gh->group_mask;
+  uint stride = 0;
+
+  while (true) {
+    const GHashGroup *group = &gh->groups[group_index];
+    GHashGroupMask match = ghash_group_match(group, h2);
+    while (match) {
+      const uint offset = ghash_group_mask_next(&match);
+      if (LIKELY(gh->cmpfp(key, group->slots[offset]->key) == false)) {
+        return group_index * GHASH_GROUP_WIDTH + offset;
+      }
+    }
+    /* Key would have been stored in this group. */
+    if (LIKELY(ghash_group_match_empty(group))) {
+      return UINT_MAX;
+    }
+    GHASH_OPEN_PROBE_NEXT(gh, group_index, stride);
+  }
+}
+
+/* Find the first empty or deleted slot in the probe sequence of the hash. */
+LIB_INLINE uint ghash_open_find_insert_slot(const GHash *gh, const uint64_t mix)
+{
+  uint group_index = GHASH_OPEN_H1(mix) & gh->group_mask;
+  uint stride = 0;
+
+  while (true) {
+    GHashGroupMask match = ghash_group_match_empty_or_deleted(&gh->groups[group_index]);
+    if (match) {
+      return group_index * GHASH_GROUP_WIDTH + ghash_group_mask_next(&match);
+    }
+    GHASH_OPEN_PROBE_NEXT(gh, group_index, stride);
+  }
+}
+
+/* Store the entry in the index, there must be room for it. */
+LIB_INLINE void ghash_open_place(GHash *gh, Entry *e, const uint hash)
+{
+  const uint64_t mix = ghash_open_hash_mix(hash);
+  const uint slot = ghash_open_find_insert_slot(gh, mix);
+
+  if (GHASH_SLOT_CTRL(gh, slot) == GHASH_CTRL_EMPTY) {
+    lib_assert(gh->growth_left != 0);
+    gh->growth_left--;
+  }
+  GHASH_SLOT_CTRL(gh, slot) = GHASH_OPEN_H2(mix);
+  GHASH_SLOT_ENTRY(gh, slot) = e;
+}
+
+/* Rebuild the index with `2^slot_bit` slots, this also clears all tombstones. */
+static void ghash_open_resize(GHash *gh, const uint slot_bit)
+{
+  GHashGroup *groups_old = gh->groups;
+  const uint nslots_old = groups_old ? gh->nbuckets : 0;
+  const uint nslots = 1u << slot_bit;
+  const uint ngroups = nslots / GHASH_GROUP_WIDTH;
+
+  gh->nbuckets = nslots;
+  gh->group_mask = ngroups - 1;
+  gh->slot_bit = slot_bit;
+  gh->limit_grow = GHASH_OPEN_LIMIT_GROW(nslots);
+  gh->limit_shrink = GHASH_OPEN_LIMIT_SHRINK(nslots);
+  lib_assert(gh->nentries <= gh->limit_grow);
+
+  gh->groups = (GHashGroup *)mem_malloc(sizeof(*gh->groups) * ngroups, __func__);
+  for (uint i = 0; i < ngroups; i++) {
+    memset(gh->groups[i].ctrl, GHASH_CTRL_EMPTY, sizeof(gh->groups[i].ctrl));
+  }
+  gh->growth_left = gh->limit_grow;
+
+  if (groups_old) {
+    for (uint i = 0; i < nslots_old; i++) {
+      const GHashGroup *group = &groups_old[i / GHASH_GROUP_WIDTH];
+      if (GHASH_CTRL_IS_FULL(group->ctrl[i % GHASH_GROUP_WIDTH])) {
+        Entry *e = group->slots[i % GHASH_GROUP_WIDTH];
+        ghash_open_place(gh, e, ghash_entryhash(gh, e));
+      }
+    }
+    mem_free(groups_old);
+  }
+}
+
+/* Smallest slot_bit (not below the given one) with room for nentries. */
+LIB_INLINE uint ghash_open_slot_bit_for(const uint nentries, uint slot_bit)
+{
+  while ((nentries > GHASH_OPEN_LIMIT_GROW(1u << slot_bit)) &&
+         (slot_bit < GHASH_OPEN_SLOT_BIT_MAX)) {
+    slot_bit++;
+  }
+  return slot_bit;
+}
+
+static void ghash_open_expand(GHash *gh, const uint nentries, const bool user_defined)
+{
+  const uint slot_bit = ghash_open_slot_bit_for(nentries, gh->slot_bit);
+
+  if (user_defined) {
+    gh->slot_bit_min = slot_bit;
+  }
+
+  if ((slot_bit != gh->slot_bit) || !gh->groups) {
+    ghash_open_resize(gh, slot_bit);
+  }
+}
+
+static void ghash_open_contract(GHash *gh,
+                                const uint nentries,
+                                const bool user_defined,
+                                const bool force_shrink)
+{
+  uint slot_bit = gh->slot_bit;
+
+  if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
+    return;
+  }
+
+  if (LIKELY(gh->groups && (nentries > gh->limit_shrink))) {
+    return;
+  }
+
+  while ((nentries < GHASH_OPEN_LIMIT_SHRINK(1u << slot_bit)) && (slot_bit > gh->slot_bit_min)) {
+    slot_bit--;
+  }
+
+  if (user_defined) {
+    gh->slot_bit_min = slot_bit;
+  }
+
+  if ((slot_bit != gh->slot_bit) || !gh->groups) {
+    ghash_open_resize(gh, slot_bit);
+  }
+}
+
+/* Clear the index and reserve slots for given num of entries. */
+LIB_INLINE void ghash_open_reset(GHash *gh, const uint nentries)
+{
+  MEM_SAFE_FREE(gh->groups);
+
+  gh->slot_bit = GHASH_OPEN_SLOT_BIT_MIN;
+  gh->slot_bit_min = GHASH_OPEN_SLOT_BIT_MIN;
+  gh->nentries = 0;
+
+  ghash_open_expand(gh, nentries, (nentries != 0));
+}
+
+static void ghash_open_insert(GHash *gh, Entry *e, const uint hash)
+{
+  if (UNLIKELY(gh->growth_left == 0)) {
+    /* When tombstones take most of the used slots, a rebuild at the same size is enough. */
+    ghash_open_resize(gh,
+                      (gh->nentries < gh->limit_grow / 2) ?
+                          gh->slot_bit :
+                          ghash_open_slot_bit_for(gh->nentries + 1, gh->slot_bit + 1));
+  }
+  ghash_open_place(gh, e, hash);
+  gh->nentries++;
+}
+
+static void ghash_open_remove_slot(GHash *gh, const uint slot)
+{
+  /* A tombstone keeps the probe sequences going through this slot intact,
+   * the slot only becomes empty again when the index is rebuilt. */
+  GHASH_SLOT_CTRL(gh, slot) = GHASH_CTRL_DELETED;
+  ghash_open_contract(gh, --gh->nentries, false, false);
+}
+
+/* Find index of next full slot, starting from slot (UINT_MAX when there is none). */
+LIB_INLINE uint ghash_open_find_next_slot(const GHash *gh, uint slot)
+{
+  for (; slot < gh->nbuckets; slot++) {
+    if (GHASH_CTRL_IS_FULL(GHASH_SLOT_CTRL(gh, slot))) {
+      return slot;
+    }
+  }
+  return UINT_MAX;
+}
+
+/* Number of groups probed to find the entry stored in slot. */
+static uint ghash_open_probe_len(const GHash *gh, const uint slot)
+{
+  const uint64_t mix = ghash_open_hash_mix(ghash_entryhash(gh, GHASH_SLOT_ENTRY(gh, slot)));
+  uint group_index = GHASH_OPEN_H1(mix) & gh->group_mask;
+  uint stride = 0;
+  uint len = 1;
+
+  while (group_index != slot / GHASH_GROUP_WIDTH) {
+    GHASH_OPEN_PROBE_NEXT(gh, group_index, stride);
+    len++;
+  }
+  return len;
+}
+
+/* Get the bucket-index for an already-computed full hash.
+ * The open addressing index has no fixed bucket, the full hash is used to start probing. */
 LIB_INLINE uint ghash_bucket_index(const GHash *gh, const uint hash)
 {
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    return hash;
+  }
 #ifdef GHASH_USE_MODULO_BUCKETS
   return hash % gh->nbuckets;
 #else
@@ -218,6 +587,11 @@ static void ghash_buckets_expand(GHash *gh, const uint nentries, const bool user
 {
   uint new_nbuckets;
 
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    ghash_open_expand(gh, nentries, user_defined);
+    return;
+  }
+
   if (LIKELY(gh->buckets && (nentries < gh->limit_grow))) {
     return;
   }
@@ -260,6 +634,11 @@ static void ghash_buckets_contract(GHash *gh,
 {
   uint new_nbuckets;
 
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    ghash_open_contract(gh, nentries, user_defined, force_shrink);
+    return;
+  }
+
   if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
     return;
   }
@@ -302,6 +681,11 @@ static void ghash_buckets_contract(GHash *gh,
 /* Clear+reset gh buckets reserve again buckets for given num of entries. */
 LIB_INLINE void ghash_buckets_reset(GHash *gh, const uint nentries)
 {
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    ghash_open_reset(gh, nentries);
+    return;
+  }
+
   MEM_SAFE_FREE(gh->buckets);
 
 #ifdef GHASH_USE_MODULO_BUCKETS
@@ -329,6 +713,12 @@ LIB_INLINE void ghash_buckets_reset(GHash *gh, const uint nentries)
 LIB_INLINE Entry *ghash_lookup_entry_ex(const GHash *gh, const void *key, const uint bucket_index)
 {
   Entry *e;
+
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    const uint slot = ghash_open_lookup_slot(gh, key, bucket_index);
+    return (slot != UINT_MAX) ? GHASH_SLOT_ENTRY(gh, slot) : NULL;
+  }
+
   /* If dont store GHash not worth computing it for each entry here!
    * Typically cmp fn will be quicker, bc it's needed in the end anyway... */
   for (e = gh->buckets[bucket_index]; e; e = e->next) {
@@ -382,6 +772,7 @@ static GHash *ghash_new(GHashHashFP hashfp,
   gh->cmpfp = cmpfp;
 
   gh->buckets = NULL;
+  gh->groups = NULL;
   gh->flag = flag;
 
   ghash_buckets_reset(gh, nentries_reserve);
@@ -391,6 +782,20 @@ static GHash *ghash_new(GHashHashFP hashfp,
   return gh;
 }
 
+/* Add an allocated entry to the buckets (or open addressing index). */
+LIB_INLINE void ghash_entry_link(GHash *gh, Entry *e, const uint bucket_index)
+{
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    ghash_open_insert(gh, e, bucket_index);
+    return;
+  }
+
+  e->next = gh->buckets[bucket_index];
+  gh->buckets[bucket_index] = e;
+
+  ghash_buckets_expand(gh, ++gh->nentries, false);
+}
+
 /* Internal insert fn.
  * Takes hash and bucket_index args to avoid calling ghash_keyhash and ghash_bucket_index
  * mult times. */
@@ -401,12 +806,9 @@ LIB_INLINE void ghash_insert_ex(GHash *gh, void *key, void *val, const uint buck
   lib_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (lib_ghash_haskey(gh, key) == 0));
   lib_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
-  e->e.next = gh->buckets[bucket_index];
   e->e.key = key;
   e->val = val;
-  gh->buckets[bucket_index] = (Entry *)e;
-
-  ghash_buckets_expand(gh, ++gh->nentries, false);
+  ghash_entry_link(gh, (Entry *)e, bucket_index);
 }
 
 /* Insert fn that takes a pre-alloc entry. */
@@ -417,11 +819,8 @@ LIB_INLINE void ghash_insert_ex_keyonly_entry(GHash *gh,
 {
   lib_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (lib_ghash_haskey(gh, key) == 0));
 
-  e->next = gh->buckets[bucket_index];
   e->key = key;
-  gh->buckets[bucket_index] = e;
-
-  ghash_buckets_expand(gh, ++gh->nentries, false);
+  ghash_entry_link(gh, e, bucket_index);
 }
 
 /* Insert fn that doesn't set the val (use for GSet) */
@@ -432,11 +831,8 @@ LIB_INLINE void ghash_insert_ex_keyonly(GHash *gh, void *key, const uint bucket_
   lib_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (lib_ghash_haskey(gh, key) == 0));
   lib_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
 
-  e->next = gh->buckets[bucket_index];
   e->key = key;
-  gh->buckets[bucket_index] = e;
-
-  ghash_buckets_expand(gh, ++gh->nentries, false);
+  ghash_entry_link(gh, e, bucket_index);
 }
 
 LIB_INLINE void ghash_insert(GHash *gh, void *key, void *val)
@@ -508,8 +904,17 @@ static Entry *ghash_remove_ex(GHash *gh,
                               GHashValFreeFP valfreefp,
                               const uint bucket_index)
 {
-  Entry *e_prev;
-  Entry *e = ghash_lookup_entry_prev_ex(gh, key, &e_prev, bucket_index);
+  Entry *e_prev = NULL;
+  Entry *e;
+  uint slot = UINT_MAX;
+
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    slot = ghash_open_lookup_slot(gh, key, bucket_index);
+    e = (slot != UINT_MAX) ? GHASH_SLOT_ENTRY(gh, slot) : NULL;
+  }
+  else {
+    e = ghash_lookup_entry_prev_ex(gh, key, &e_prev, bucket_index);
+  }
 
   lib_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
@@ -521,14 +926,19 @@ static Entry *ghash_remove_ex(GHash *gh,
       valfreefp(((GHashEntry *)e)->val);
     }
 
-    if (e_prev) {
-      e_prev->next = e->next;
+    if (slot != UINT_MAX) {
+      ghash_open_remove_slot(gh, slot);
     }
     else {
-      gh->buckets[bucket_index] = e->next;
-    }
+      if (e_prev) {
+        e_prev->next = e->next;
+      }
+      else {
+        gh->buckets[bucket_index] = e->next;
+      }
 
-    ghash_buckets_contract(gh, --gh->nentries, false, false);
+      ghash_buckets_contract(gh, --gh->nentries, false, false);
+    }
   }
 
   return e;
@@ -542,6 +952,20 @@ static Entry *ghash_pop(GHash *gh, GHashIterState *state)
     return NULL;
   }
 
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    uint slot = ghash_open_find_next_slot(gh, (curr_bucket < gh->nbuckets) ? curr_bucket : 0);
+    if (slot == UINT_MAX) {
+      slot = ghash_open_find_next_slot(gh, 0);
+    }
+    lib_assert(slot != UINT_MAX);
+
+    Entry *e = GHASH_SLOT_ENTRY(gh, slot);
+    ghash_open_remove_slot(gh, slot);
+
+    state->curr_bucket = slot;
+    return e;
+  }
+
   /* Using first_bucket_index here allows us to avoid potential
    * huge num of loops over buckets,
    * in case we are popping from a large ghash with few items in it... */
@@ -564,6 +988,21 @@ static void ghash_free_cb(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP va
   lib_assert(keyfreefp || valfreefp);
   lib_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    for (i = 0; i < gh->nbuckets; i++) {
+      if (GHASH_CTRL_IS_FULL(GHASH_SLOT_CTRL(gh, i))) {
+        Entry *e = GHASH_SLOT_ENTRY(gh, i);
+        if (keyfreefp) {
+          keyfreefp(e->key);
+        }
+        if (valfreefp) {
+          valfreefp(((GHashEntry *)e)->val);
+        }
+      }
+    }
+    return;
+  }
+
   for (i = 0; i < gh->nbuckets; i++) {
     Entry *e;
 
@@ -589,6 +1028,26 @@ static GHash *ghash_copy(const GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopy
   lib_assert(!valcopyfp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
   gh_new = ghash_new(gh->hashfp, gh->cmpfp, __func__, 0, gh->flag);
+
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    /* Same number of slots as the source, so the control bytes can be copied as is. */
+    ghash_open_resize(gh_new, gh->slot_bit);
+    memcpy(gh_new->groups, gh->groups, sizeof(*gh->groups) * (gh->group_mask + 1));
+
+    for (i = 0; i < gh->nbuckets; i++) {
+      if (GHASH_CTRL_IS_FULL(GHASH_SLOT_CTRL(gh, i))) {
+        Entry *e_new = lib_mempool_alloc(gh_new->entrypool);
+        ghash_entry_copy(gh_new, e_new, gh, GHASH_SLOT_ENTRY(gh, i), keycopyfp, valcopyfp);
+        GHASH_SLOT_ENTRY(gh_new, i) = e_new;
+      }
+    }
+    gh_new->slot_bit_min = gh->slot_bit_min;
+    gh_new->growth_left = gh->growth_left;
+    gh_new->nentries = gh->nentries;
+
+    return gh_new;
+  }
+
   ghash_buckets_expand(gh_new, reserve_nentries_new, false);
 
   lib_assert(gh_new->nbuckets == gh->nbuckets);
@@ -804,19 +1263,59 @@ void lib_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreef
     ghash_free_cb(gh, keyfreefp, valfreefp);
   }
 
-  mem_free(gh->buckets);
+  MEM_SAFE_FREE(gh->buckets);
+  MEM_SAFE_FREE(gh->groups);
   lib_mempool_destroy(gh->entrypool);
   mem_free(gh);
 }
 
+/* Set the flags, rebuilding the index when #GHASH_FLAG_OPEN_ADDRESSING changes. */
+static void ghash_flag_update(GHash *gh, const uint flag)
+{
+  const uint nentries = gh->nentries;
+  Entry **entries;
+  uint i, entries_len = 0;
+
+  if (((gh->flag ^ flag) & GHASH_FLAG_OPEN_ADDRESSING) == 0) {
+    gh->flag = flag;
+    return;
+  }
+
+  entries = (Entry **)mem_malloc(sizeof(*entries) * MAX2(nentries, 1), __func__);
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    for (i = 0; i < gh->nbuckets; i++) {
+      if (GHASH_CTRL_IS_FULL(GHASH_SLOT_CTRL(gh, i))) {
+        entries[entries_len++] = GHASH_SLOT_ENTRY(gh, i);
+      }
+    }
+    MEM_SAFE_FREE(gh->groups);
+  }
+  else {
+    for (i = 0; i < gh->nbuckets; i++) {
+      for (Entry *e = gh->buckets[i]; e; e = e->next) {
+        entries[entries_len++] = e;
+      }
+    }
+    MEM_SAFE_FREE(gh->buckets);
+  }
+  lib_assert(entries_len == nentries);
+
+  gh->flag = flag;
+  ghash_buckets_reset(gh, nentries);
+  for (i = 0; i < entries_len; i++) {
+    ghash_entry_link(gh, entries[i], ghash_bucket_index(gh, ghash_entryhash(gh, entries[i])));
+  }
+  mem_free(entries);
+}
+
 void lib_ghash_flag_set(GHash *gh, uint flag)
 {
-  gh->flag |= flag;
+  ghash_flag_update(gh, gh->flag | flag);
 }
 
 void lib_ghash_flag_clear(GHash *gh, uint flag)
 {
-  gh->flag &= ~flag;
+  ghash_flag_update(gh, gh->flag & ~flag);
 }
 
 /* GHash Iter API */
@@ -832,6 +1331,13 @@ void lib_ghashIter_init(GHashIterator *ghi, GHash *gh)
   ghi->gh = gh;
   ghi->curEntry = NULL;
   ghi->curBucket = UINT_MAX; /* wraps to zero */
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    ghi->curBucket = ghash_open_find_next_slot(gh, 0);
+    if (ghi->curBucket != UINT_MAX) {
+      ghi->curEntry = GHASH_SLOT_ENTRY(gh, ghi->curBucket);
+    }
+    return;
+  }
   if (gh->nentries) {
     do {
       ghi->curBucket++;
@@ -845,7 +1351,12 @@ void lib_ghashIter_init(GHashIterator *ghi, GHash *gh)
 
 void lib_ghashIter_step(GHashIterator *ghi)
 {
-  if (ghi->curEntry) {
+  if (ghi->curEntry && (ghi->gh->flag & GHASH_FLAG_OPEN_ADDRESSING)) {
+    ghi->curBucket = ghash_open_find_next_slot(ghi->gh, ghi->curBucket + 1);
+    ghi->curEntry = (ghi->curBucket != UINT_MAX) ? GHASH_SLOT_ENTRY(ghi->gh, ghi->curBucket) :
+                                                      NULL;
+  }
+  else if (ghi->curEntry) {
     ghi->curEntry = ghi->curEntry->next;
     while (!ghi->curEntry) {
       ghi->curBucket++;
@@ -968,12 +1479,12 @@ void lib_gset_free(GSet *gs, GSetKeyFreeFP keyfreefp)
 
 void lib_gset_flag_set(GSet *gs, uint flag)
 {
-  ((GHash *)gs)->flag |= flag;
+  lib_ghash_flag_set((GHash *)gs, flag);
 }
 
 void lib_gset_flag_clear(GSet *gs, uint flag)
 {
-  ((GHash *)gs)->flag &= ~flag;
+  lib_ghash_flag_clear((GHash *)gs, flag);
 }
 
 /* GSet Combined Key/Val Usage
@@ -1009,6 +1520,50 @@ int lib_gset_buckets_len(const GSet *gs)
   return lib_ghash_buckets_len((const GHash *)gs);
 }
 
+/* For the open addressing index the "bucket" of an entry is the group it's found in:
+ * returns the mean number of groups probed for a successful lookup (1.0 is ideal),
+ * entries outside of their first group count as overloaded. */
+static double ghash_open_calc_quality_ex(GHash *gh,
+                                         double *r_load,
+                                         double *r_variance,
+                                         double *r_prop_empty_buckets,
+                                         double *r_prop_overloaded_buckets,
+                                         int *r_biggest_bucket)
+{
+  uint64_t sum = 0, sum_sq = 0, sum_overloaded = 0, sum_empty = 0;
+  uint biggest = 0;
+
+  for (uint i = 0; i < gh->nbuckets; i++) {
+    if (!GHASH_CTRL_IS_FULL(GHASH_SLOT_CTRL(gh, i))) {
+      sum_empty += (GHASH_SLOT_CTRL(gh, i) == GHASH_CTRL_EMPTY);
+      continue;
+    }
+    const uint len = ghash_open_probe_len(gh, i);
+    sum += len;
+    sum_sq += (uint64_t)len * len;
+    sum_overloaded += (len > 1);
+    biggest = max_uu(biggest, len);
+  }
+
+  const double mean = (double)sum / (double)gh->nentries;
+  if (r_load) {
+    *r_load = (double)gh->nentries / (double)gh->nbuckets;
+  }
+  if (r_variance) {
+    *r_variance = (double)sum_sq / (double)gh->nentries - mean * mean;
+  }
+  if (r_prop_empty_buckets) {
+    *r_prop_empty_buckets = (double)sum_empty / (double)gh->nbuckets;
+  }
+  if (r_prop_overloaded_buckets) {
+    *r_prop_overloaded_buckets = (double)sum_overloaded / (double)gh->nentries;
+  }
+  if (r_biggest_bucket) {
+    *r_biggest_bucket = (int)biggest;
+  }
+  return mean;
+}
+
 double lib_ghash_calc_quality_ex(GHash *gh,
                                  double *r_load,
                                  double *r_variance,
@@ -1039,6 +1594,11 @@ double lib_ghash_calc_quality_ex(GHash *gh,
     return 0.0;
   }
 
+  if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+    return ghash_open_calc_quality_ex(
+        gh, r_load, r_variance, r_prop_empty_buckets, r_prop_overloaded_buckets, r_biggest_bucket);
+  }
+
   mean = (double)gh->nentries / (double)gh->nbuckets;
   if (r_load) {
     *r_load = mean;
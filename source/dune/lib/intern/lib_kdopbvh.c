@@ -16,12 +16,15 @@
 #include "lib_alloca.h"
 #include "lib_heap_simple.h"
 #include "lib_kdopbvh.h"
+#include "lib_kdopbvh_ex.h"
 #include "lib_math_geom.h"
 #include "lib_stack.h"
 #include "lib_task.h"
 #include "lib_utildefines.h"
 #include "lib_strict_flags.h"
 
+#include "atomic_ops.h"
+
 /* used for iter_raycast */
 // #define USE_SKIP_LINKS
 
@@ -31,8 +34,32 @@
 /* Check tree is valid. */
 // #define USE_VERIFY_TREE
 
+/* Support a copy of the tree with up to 4 children per node (#BVHWideNode, #BVH_BUILD_WIDE),
+ * used by ray-casts & nearest queries to test the bounds of all children at once. */
+#define USE_WIDE_NODES
+
 #define MAX_TREETYPE 32
 
+#ifdef USE_WIDE_NODES
+#  define BVH_WIDE 4
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define BVH_WIDE_SSE2
+#  elif defined(__ARM_NEON)
+#    include <arm_neon.h>
+#    define BVH_WIDE_NEON
+#  endif
+/* Leafs are stored in #BVHWideNode.children as `-1 - index` (the macro is its own inverse). */
+#  define BVH_WIDE_LEAF(index) (-1 - (index))
+#endif
+
+/* Number of bins per axis used to evaluate the SAH of splits (#BVH_BUILD_SAH). */
+#define BVH_SAH_BINS 16
+/* Ranges with less leafs than `leaf_num / BVH_SAH_TASK_DIV` are built as separate tasks. */
+#define BVH_SAH_TASK_DIV 64
+/* Deeper nodes are split at the median, so degenerate input can't recurse too deep. */
+#define BVH_SAH_DEPTH_MAX 64
+
 /* Setting zero so we can catch bugs in BLI_task/KDOPBVH.
  * TODO: Dedup limits w PBVH from dune core/kernel. */
 #ifndef NDEBUG
@@ -56,23 +83,43 @@ typedef struct BVHNode {
   char main_axis; /* Axis used to split this node */
 } BVHNode;
 
-/* keep under 26 bytes for speed purposes */
+#ifdef USE_WIDE_NODES
+/* Node of the wide tree, the bounds of the children are stored per axis
+ * so they can be tested at once (SIMD). */
+typedef struct BVHWideNode {
+  /* Min & max of the X, Y & Z axes (same order as #BVHNode.bv), for each child. */
+  float bounds[6][BVH_WIDE];
+  /* Index of the child in #BVHTree.wide_nodes,
+   * or #BVH_WIDE_LEAF of the index of the leaf in #BVHTree.nodearray. */
+  int children[BVH_WIDE];
+  /* Index of the branch this node was created from in #BVHTree.nodearray. */
+  int node;
+  int node_num;
+} BVHWideNode;
+#endif
+
+/* Keep within one cache-line (64 bytes, 48 on 32 bit systems) for speed purposes. */
 struct BVHTree {
   BVHNode **nodes;
   BVHNode *nodearray;  /* pre-alloc branch nodes */
   BVHNode **nodechild; /* pre-alloc children for nodes */
   float *nodebv;       /* pre-alloc bounding-volumes for nodes */
+#ifdef USE_WIDE_NODES
+  BVHWideNode *wide_nodes; /* wide copy of the tree, root first (NULL when unsupported) */
+  int wide_num;
+#endif
   float epsilon;       /* Epsilon is used for inflation of the K-DOP. */
   int leaf_num;        /* leafs */
   int branch_num;
   axis_t start_axis, stop_axis; /* bvhtree_kdop_axes array indices according to axis */
   axis_t axis;                  /* KDOP type (6 => OBB, 7 => AABB, ...) */
   char tree_type;               /* type of tree (4 => quad-tree). */
+  char flag;                    /* BVH_BUILD_* */
 };
 
-/* optimization, ensure we stay small */
-LIB_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+/* optimization, ensure we stay small (one cache-line with the wide copy's pointer & length) */
+LIB_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 64) ||
+                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 48),
                   "over sized")
 
 /* avoid dup vars in BVHOverlapDataThread */
@@ -117,6 +164,11 @@ typedef struct BVHRayCastData {
   float ray_dot_axis[13];
   float idot_axis[13];
   int index[6];
+#ifdef USE_WIDE_NODES
+  /* Ray origin offset by the radius towards the near (even) & far (odd) planes of each axis,
+   * indexed like #BVHRayCastData.index. */
+  float wide_origin[6];
+#endif
   BVHTreeRayHit hit;
 } BVHRayCastData;
 
@@ -185,6 +237,22 @@ MINLINE axis_t max_axis(axis_t a, axis_t b)
 }
 #endif
 
+/* Half the surface area of the X, Y & Z axes of a bounding volume. */
+MINLINE float bv_half_area(const float bv[6])
+{
+  const float x = bv[1] - bv[0], y = bv[3] - bv[2], z = bv[5] - bv[4];
+  return (x * y) + (y * z) + (z * x);
+}
+
+#ifdef BVH_WIDE_NEON
+MINLINE int wide_neon_movemask(const uint32x4_t mask)
+{
+  uint32_t lanes[4];
+  vst1q_u32(lanes, mask);
+  return (int)((lanes[0] & 1u) | (lanes[1] & 2u) | (lanes[2] & 4u) | (lanes[3] & 8u));
+}
+#endif
+
 /* Intro-sort w permission deriving
  * from following Java code:
  * http://ralphunden.net/content/tutorials/a-guide-to-introsort/
@@ -787,8 +855,441 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
   }
 }
 
+/* Binned SAH build (#BVH_BUILD_SAH)
+ *
+ * Nodes are built top-down: the leafs of a node are split in 2 where the surface area heuristic
+ * is lowest, then the part with the largest surface area is split again, until the node has
+ * `tree_type` children (or only leafs as children).
+ *
+ * The SAH is only evaluated between bins: the leafs are sorted into #BVH_SAH_BINS bins along each
+ * axis (by the center of their bounds), which takes linear time.
+ *
+ * Branches are allocated as they are created, so children always have an index greater than
+ * their parent (as #lib_bvhtree_update_tree expects). Small ranges of leafs are built in parallel,
+ * allocating from a shared counter. */
+
+typedef struct BVHSAHBin {
+  float bv[6];
+  int count;
+} BVHSAHBin;
+
+typedef struct BVHSAHRange {
+  int begin, end;
+  float bv[6];
+} BVHSAHRange;
+
+typedef struct BVHSAHTask {
+  BVHNode *node;
+  int begin, end;
+  int depth;
+} BVHSAHTask;
+
+typedef struct BVHSAHBuildData {
+  const BVHTree *tree;
+  BVHNode *branches_array;
+  BVHNode **leafs_array;
+  /* Number of allocated branches (atomic). */
+  int branch_num;
+
+  /* Ranges deferred to be built in parallel (NULL when building on a single thread). */
+  BVHSAHTask *tasks;
+  int tasks_num;
+  int tasks_alloc;
+  /* Ranges with at most this number of leafs are deferred, zero once they are being built. */
+  int task_leafs_max;
+} BVHSAHBuildData;
+
+static void sah_bv_init(float bv[6])
+{
+  bv[0] = bv[2] = bv[4] = FLT_MAX;
+  bv[1] = bv[3] = bv[5] = -FLT_MAX;
+}
+
+static void sah_bv_union(float bv[6], const float bv_other[6])
+{
+  for (int i = 0; i < 6; i += 2) {
+    bv[i] = min_ff(bv[i], bv_other[i]);
+    bv[i + 1] = max_ff(bv[i + 1], bv_other[i + 1]);
+  }
+}
+
+MINLINE float sah_centroid(const BVHNode *node, const int axis)
+{
+  return (node->bv[2 * axis] + node->bv[2 * axis + 1]) * 0.5f;
+}
+
+MINLINE int sah_bin_index(const BVHNode *node, const int axis, const float min, const float scale)
+{
+  const int bin = (int)((sah_centroid(node, axis) - min) * scale);
+  return min_ii(max_ii(bin, 0), BVH_SAH_BINS - 1);
+}
+
+static void sah_range_init(BVHSAHBuildData *data,
+                           BVHSAHRange *range,
+                           const int begin,
+                           const int end)
+{
+  range->begin = begin;
+  range->end = end;
+  sah_bv_init(range->bv);
+  for (int i = begin; i < end; i++) {
+    sah_bv_union(range->bv, data->leafs_array[i]->bv);
+  }
+}
+
+/* Split `range` (of at least 2 leafs) in 2 where the SAH is lowest,
+ * or at the median of its largest axis when `use_median` is set.
+ * Returns the axis of the split. */
+static int sah_range_split(BVHSAHBuildData *data,
+                           const BVHSAHRange *range,
+                           const bool use_median,
+                           BVHSAHRange *r_left,
+                           BVHSAHRange *r_right)
+{
+  BVHNode **leafs = data->leafs_array;
+  const int begin = range->begin, end = range->end;
+  float center_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float center_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  int best_axis = -1, best_bin = 0;
+  float best_cost = FLT_MAX, best_scale = 0.0f;
+  int axis, mid;
+
+  for (int i = begin; i < end; i++) {
+    for (axis = 0; axis < 3; axis++) {
+      const float center = sah_centroid(leafs[i], axis);
+      center_min[axis] = min_ff(center_min[axis], center);
+      center_max[axis] = max_ff(center_max[axis], center);
+    }
+  }
+
+  for (axis = 0; axis < 3 && !use_median; axis++) {
+    const float extent = center_max[axis] - center_min[axis];
+    BVHSAHBin bins[BVH_SAH_BINS];
+    float right_area[BVH_SAH_BINS];
+    int right_count[BVH_SAH_BINS];
+    float bv[6];
+    int count, bin;
+
+    if (!(extent > 0.0f)) {
+      continue;
+    }
+    /* Slightly less than the number of bins, so the largest center falls in the last bin. */
+    const float scale = ((float)BVH_SAH_BINS * 0.9999f) / extent;
+
+    for (bin = 0; bin < BVH_SAH_BINS; bin++) {
+      sah_bv_init(bins[bin].bv);
+      bins[bin].count = 0;
+    }
+    for (int i = begin; i < end; i++) {
+      BVHSAHBin *b = &bins[sah_bin_index(leafs[i], axis, center_min[axis], scale)];
+      sah_bv_union(b->bv, leafs[i]->bv);
+      b->count++;
+    }
+
+    /* Sweep from the right, for the leafs right of a split after each bin. */
+    sah_bv_init(bv);
+    count = 0;
+    for (bin = BVH_SAH_BINS - 1; bin > 0; bin--) {
+      if (bins[bin].count) {
+        sah_bv_union(bv, bins[bin].bv);
+        count += bins[bin].count;
+      }
+      right_area[bin - 1] = count ? bv_half_area(bv) : 0.0f;
+      right_count[bin - 1] = count;
+    }
+
+    /* Sweep from the left, evaluating the cost of each split. */
+    sah_bv_init(bv);
+    count = 0;
+    for (bin = 0; bin < BVH_SAH_BINS - 1; bin++) {
+      if (bins[bin].count) {
+        sah_bv_union(bv, bins[bin].bv);
+        count += bins[bin].count;
+      }
+      if (count == 0 || right_count[bin] == 0) {
+        continue;
+      }
+      const float cost = bv_half_area(bv) * (float)count +
+                         right_area[bin] * (float)right_count[bin];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = bin;
+        best_scale = scale;
+      }
+    }
+  }
+
+  if (best_axis != -1) {
+    int i = begin, j = end - 1;
+    while (i <= j) {
+      if (sah_bin_index(leafs[i], best_axis, center_min[best_axis], best_scale) <= best_bin) {
+        i++;
+      }
+      else {
+        SWAP(BVHNode *, leafs[i], leafs[j]);
+        j--;
+      }
+    }
+    mid = i;
+    axis = best_axis;
+  }
+  else {
+    /* All centers are at the same position or the tree is too deep. */
+    const char split_axis = get_largest_axis(range->bv);
+    mid = (begin + end) / 2;
+    partition_nth_element(leafs, begin, end, mid, split_axis);
+    axis = split_axis / 2;
+  }
+
+  sah_range_init(data, r_left, begin, mid);
+  sah_range_init(data, r_right, mid, end);
+  return axis;
+}
+
+static void sah_build_node(BVHSAHBuildData *data,
+                           BVHNode *node,
+                           const int begin,
+                           const int end,
+                           const int depth)
+{
+  const BVHTree *tree = data->tree;
+  BVHSAHRange ranges[MAX_TREETYPE];
+  int ranges_num = 1;
+  int i;
+
+  refit_kdop_hull(tree, node, begin, end);
+  node->main_axis = (char)(get_largest_axis(node->bv) / 2);
+
+  ranges[0].begin = begin;
+  ranges[0].end = end;
+  memcpy(ranges[0].bv, node->bv, sizeof(ranges[0].bv));
+
+  while (ranges_num < tree->tree_type) {
+    /* Split the range with the largest surface area. */
+    int split = -1;
+    float split_area = -1.0f;
+    for (i = 0; i < ranges_num; i++) {
+      if (ranges[i].end - ranges[i].begin > 1) {
+        const float area = bv_half_area(ranges[i].bv);
+        if (area > split_area) {
+          split = i;
+          split_area = area;
+        }
+      }
+    }
+    if (split == -1) {
+      break;
+    }
+
+    const BVHSAHRange range = ranges[split];
+    memmove(&ranges[split + 2],
+            &ranges[split + 1],
+            sizeof(*ranges) * (size_t)(ranges_num - split - 1));
+    const int axis = sah_range_split(
+        data, &range, depth >= BVH_SAH_DEPTH_MAX, &ranges[split], &ranges[split + 1]);
+    if (ranges_num == 1) {
+      /* Save split axis (used to order the traversal of children). */
+      node->main_axis = (char)axis;
+    }
+    ranges_num++;
+  }
+
+  for (i = 0; i < ranges_num; i++) {
+    const int leafs_num = ranges[i].end - ranges[i].begin;
+    BVHNode *child;
+
+    if (leafs_num == 1) {
+      child = data->leafs_array[ranges[i].begin];
+    }
+    else {
+      child = &data->branches_array[atomic_fetch_and_add_int32(&data->branch_num, 1)];
+
+      if (data->tasks && leafs_num <= data->task_leafs_max) {
+        if (data->tasks_num == data->tasks_alloc) {
+          data->tasks_alloc *= 2;
+          data->tasks = mem_realloc(data->tasks, sizeof(*data->tasks) * (size_t)data->tasks_alloc);
+        }
+        BVHSAHTask *task = &data->tasks[data->tasks_num++];
+        task->node = child;
+        task->begin = ranges[i].begin;
+        task->end = ranges[i].end;
+        task->depth = depth + 1;
+      }
+      else {
+        sah_build_node(data, child, ranges[i].begin, ranges[i].end, depth + 1);
+      }
+    }
+
+    node->children[i] = child;
+    child->parent = node;
+  }
+  node->node_num = (char)ranges_num;
+}
+
+static void sah_build_task_cb(void *__restrict userdata,
+                              const int i,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHSAHBuildData *data = userdata;
+  const BVHSAHTask *task = &data->tasks[i];
+  sah_build_node(data, task->node, task->begin, task->end, task->depth);
+}
+
+/* Build the tree on `branches_array` (root first), returns the number of branches. */
+static int sah_bvh_div_nodes(const BVHTree *tree,
+                             BVHNode *branches_array,
+                             BVHNode **leafs_array,
+                             int leafs_num)
+{
+  BVHNode *root = &branches_array[0];
+  root->parent = NULL;
+
+  /* Most of bvhtree code relies on 1-leaf trees having at least one branch. */
+  if (leafs_num <= 1) {
+    refit_kdop_hull(tree, root, 0, leafs_num);
+    root->main_axis = (char)(get_largest_axis(root->bv) / 2);
+    root->node_num = (char)leafs_num;
+    if (leafs_num == 1) {
+      root->children[0] = leafs_array[0];
+      root->children[0]->parent = root;
+    }
+    return 1;
+  }
+
+  BVHSAHBuildData data = {
+      .tree = tree,
+      .branches_array = branches_array,
+      .leafs_array = leafs_array,
+      .branch_num = 1,
+  };
+
+  if (leafs_num > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    data.tasks_alloc = tree->tree_type * BVH_SAH_TASK_DIV;
+    data.tasks = mem_malloc(sizeof(*data.tasks) * (size_t)data.tasks_alloc, __func__);
+    data.task_leafs_max = max_ii(leafs_num / BVH_SAH_TASK_DIV, 2);
+  }
+
+  sah_build_node(&data, root, 0, leafs_num, 0);
+
+  if (data.tasks) {
+    data.task_leafs_max = 0;
+
+    TaskParallelSettings settings;
+    lib_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    lib_task_parallel_range(0, data.tasks_num, &data, sah_build_task_cb, &settings);
+    MEM_SAFE_FREE(data.tasks);
+  }
+
+  return data.branch_num;
+}
+
+#ifdef USE_WIDE_NODES
+
+/* Wide tree
+ *
+ * Built from the tree after balancing: each branch is collapsed with its children into a node of
+ * up to #BVH_WIDE children, expanding the child with the largest surface area first.
+ * Only the X, Y & Z axes are stored, which is all ray-casts & nearest queries use,
+ * so it's only built for k-DOP's that contain them and trees of up to #BVH_WIDE children. */
+
+/* Copy the bounds of the children from the tree. */
+static void wide_node_refit(const BVHTree *tree, BVHWideNode *wnode)
+{
+  for (int j = 0; j < BVH_WIDE; j++) {
+    if (j < wnode->node_num) {
+      const int child = wnode->children[j];
+      const BVHNode *node = &tree->nodearray[(child >= 0) ? tree->wide_nodes[child].node :
+                                                            BVH_WIDE_LEAF(child)];
+      for (int i = 0; i < 6; i++) {
+        wnode->bounds[i][j] = node->bv[i];
+      }
+    }
+    else {
+      /* Unused, inverted bounds are never hit. */
+      for (int i = 0; i < 6; i += 2) {
+        wnode->bounds[i][j] = FLT_MAX;
+        wnode->bounds[i + 1][j] = -FLT_MAX;
+      }
+    }
+  }
+}
+
+static int wide_node_build(BVHTree *tree, const BVHNode *node)
+{
+  const int index = tree->wide_num++;
+  BVHWideNode *wnode = &tree->wide_nodes[index];
+  BVHNode *children[BVH_WIDE];
+  int children_num = node->node_num;
+
+  memcpy(children, node->children, sizeof(*children) * (size_t)children_num);
+
+  /* Replace branches by their children while they fit. */
+  while (true) {
+    int expand = -1;
+    float expand_area = -1.0f;
+    for (int j = 0; j < children_num; j++) {
+      const BVHNode *child = children[j];
+      if (child->node_num != 0 && children_num - 1 + child->node_num <= BVH_WIDE) {
+        const float area = bv_half_area(child->bv);
+        if (area > expand_area) {
+          expand = j;
+          expand_area = area;
+        }
+      }
+    }
+    if (expand == -1) {
+      break;
+    }
+
+    const BVHNode *child = children[expand];
+    memmove(&children[expand + child->node_num],
+            &children[expand + 1],
+            sizeof(*children) * (size_t)(children_num - expand - 1));
+    memcpy(&children[expand], child->children, sizeof(*children) * (size_t)child->node_num);
+    children_num += child->node_num - 1;
+  }
+
+  wnode->node = (int)(node - tree->nodearray);
+  wnode->node_num = children_num;
+  for (int j = 0; j < children_num; j++) {
+    wnode->children[j] = (children[j]->node_num == 0) ?
+                             BVH_WIDE_LEAF((int)(children[j] - tree->nodearray)) :
+                             wide_node_build(tree, children[j]);
+  }
+  wide_node_refit(tree, wnode);
+
+  return index;
+}
+
+static void bvhtree_wide_build(BVHTree *tree)
+{
+  MEM_SAFE_FREE(tree->wide_nodes);
+  tree->wide_num = 0;
+
+  if ((tree->flag & BVH_BUILD_WIDE) == 0 || tree->tree_type > BVH_WIDE ||
+      tree->start_axis != 0 || tree->leaf_num == 0)
+  {
+    return;
+  }
+
+  /* Every wide node is created from a different branch. */
+  tree->wide_nodes = mem_malloc(sizeof(*tree->wide_nodes) * (size_t)tree->branch_num, __func__);
+  wide_node_build(tree, tree->nodes[tree->leaf_num]);
+}
+
+static void bvhtree_wide_refit(BVHTree *tree)
+{
+  for (int i = 0; i < tree->wide_num; i++) {
+    wide_node_refit(tree, &tree->wide_nodes[i]);
+  }
+}
+
+#endif /* USE_WIDE_NODES */
+
 /* lib_bvhtree API */
-BVHTree *lib_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+BVHTree *lib_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag)
 {
   BVHTree *tree;
   int numnodes, i;
@@ -807,6 +1308,7 @@ BVHTree *lib_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
     tree->epsilon = epsilon;
     tree->tree_type = tree_type;
     tree->axis = axis;
+    tree->flag = (char)flag;
 
     if (axis == 26) {
       tree->start_axis = 0;
@@ -837,6 +1339,10 @@ BVHTree *lib_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 
     /* Alloc arrays */
     numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
+    if (flag & BVH_BUILD_SAH) {
+      /* Nodes may have less than `tree_type` children, every branch has at least 2. */
+      numnodes = max_ii(numnodes, maxsize + maxsize + tree_type);
+    }
 
     tree->nodes = mem_calloc(sizeof(BVHNode *) * (size_t)numnodes, "BVHNodes");
     tree->nodebv = mem_calloc(sizeof(float) * (size_t)(axis * numnodes), "BVHNodeBV");
@@ -860,9 +1366,17 @@ fail:
   return NULL;
 }
 
+BVHTree *lib_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+{
+  return lib_bvhtree_new_ex(maxsize, epsilon, tree_type, axis, 0);
+}
+
 void lib_bvhtree_free(BVHTree *tree)
 {
   if (tree) {
+#ifdef USE_WIDE_NODES
+    MEM_SAFE_FREE(tree->wide_nodes);
+#endif
     MEM_SAFE_FREE(tree->nodes);
     MEM_SAFE_FREE(tree->nodearray);
     MEM_SAFE_FREE(tree->nodebv);
@@ -879,13 +1393,19 @@ void lib_bvhtree_balance(BVHTree *tree)
    * (some big bug goes here if its being called more than once per tree) */
   lib_assert(tree->branch_num == 0);
 
-  /* Build the implicit tree */
-  non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+  if ((tree->flag & BVH_BUILD_SAH) && (tree->start_axis == 0)) {
+    tree->branch_num = sah_bvh_div_nodes(
+        tree, tree->nodearray + tree->leaf_num, leafs_array, tree->leaf_num);
+  }
+  else {
+    /* Build the implicit tree */
+    non_recursive_bvh_div_nodes(
+        tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+    tree->branch_num = implicit_needed_branches(tree->tree_type, tree->leaf_num);
+  }
 
   /* current code expects the branches to be linked to the nodes array
    * we perform that linkage here */
-  tree->branch_num = implicit_needed_branches(tree->tree_type, tree->leaf_num);
   for (int i = 0; i < tree->branch_num; i++) {
     tree->nodes[tree->leaf_num + i] = &tree->nodearray[tree->leaf_num + i];
   }
@@ -894,6 +1414,10 @@ void lib_bvhtree_balance(BVHTree *tree)
   build_skip_links(tree, tree->nodes[tree->leaf_num], NULL, NULL);
 #endif
 
+#ifdef USE_WIDE_NODES
+  bvhtree_wide_build(tree);
+#endif
+
 #ifdef USE_VERIFY_TREE
   bvhtree_verify(tree);
 #endif
@@ -967,6 +1491,10 @@ void lib_bvhtree_update_tree(BVHTree *tree)
   for (; index >= root; index--) {
     node_join(tree, *index);
   }
+
+#ifdef USE_WIDE_NODES
+  bvhtree_wide_refit(tree);
+#endif
 }
 int lib_bvhtree_get_len(const BVHTree *tree)
 {
@@ -1558,6 +2086,141 @@ static void heap_find_nearest_begin(BVHNearestData *data, BVHNode *root)
   }
 }
 
+#ifdef USE_WIDE_NODES
+/* Wide tree methods */
+
+/* Order the children set in `mask` by distance, nearest first. Returns their number. */
+static int wide_hit_order(const float dist[BVH_WIDE], int mask, int r_order[BVH_WIDE])
+{
+  int num = 0;
+  for (int j = 0; mask; j++, mask >>= 1) {
+    if (mask & 1) {
+      int k = num++;
+      while (k > 0 && dist[r_order[k - 1]] > dist[j]) {
+        r_order[k] = r_order[k - 1];
+        k--;
+      }
+      r_order[k] = j;
+    }
+  }
+  return num;
+}
+
+/* Squared distance to the bounds of each child,
+ * returns a bit-mask of the children nearer than the nearest found so far. */
+static int wide_nearest_hit(const BVHNearestData *data,
+                            const BVHWideNode *wnode,
+                            float r_dist_sq[BVH_WIDE])
+{
+#  if defined(BVH_WIDE_SSE2)
+  __m128 dist_sq = _mm_setzero_ps();
+  for (int i = 0; i < 3; i++) {
+    const __m128 proj = _mm_set1_ps(data->proj[i]);
+    const __m128 nearest = _mm_min_ps(_mm_max_ps(proj, _mm_loadu_ps(wnode->bounds[2 * i])),
+                                      _mm_loadu_ps(wnode->bounds[2 * i + 1]));
+    const __m128 delta = _mm_sub_ps(proj, nearest);
+    dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(delta, delta));
+  }
+  _mm_storeu_ps(r_dist_sq, dist_sq);
+  const int mask = _mm_movemask_ps(_mm_cmplt_ps(dist_sq, _mm_set1_ps(data->nearest.dist_sq)));
+#  elif defined(BVH_WIDE_NEON)
+  float32x4_t dist_sq = vdupq_n_f32(0.0f);
+  for (int i = 0; i < 3; i++) {
+    const float32x4_t proj = vdupq_n_f32(data->proj[i]);
+    const float32x4_t nearest = vminq_f32(vmaxq_f32(proj, vld1q_f32(wnode->bounds[2 * i])),
+                                          vld1q_f32(wnode->bounds[2 * i + 1]));
+    const float32x4_t delta = vsubq_f32(proj, nearest);
+    dist_sq = vmlaq_f32(dist_sq, delta, delta);
+  }
+  vst1q_f32(r_dist_sq, dist_sq);
+  const int mask = wide_neon_movemask(vcltq_f32(dist_sq, vdupq_n_f32(data->nearest.dist_sq)));
+#  else
+  int mask = 0;
+  for (int j = 0; j < BVH_WIDE; j++) {
+    float dist_sq = 0.0f;
+    for (int i = 0; i < 3; i++) {
+      const float delta = data->proj[i] -
+                          min_ff(max_ff(data->proj[i], wnode->bounds[2 * i][j]),
+                                 wnode->bounds[2 * i + 1][j]);
+      dist_sq += delta * delta;
+    }
+    r_dist_sq[j] = dist_sq;
+    if (dist_sq < data->nearest.dist_sq) {
+      mask |= 1 << j;
+    }
+  }
+#  endif
+  return mask & ((1 << wnode->node_num) - 1);
+}
+
+static void wide_find_nearest_leaf(BVHNearestData *data, BVHNode *node)
+{
+  if (data->cb) {
+    data->cb(data->userdata, node->index, data->co, &data->nearest);
+  }
+  else {
+    data->nearest.index = node->index;
+    data->nearest.dist_sq = calc_nearest_point_squared(data->proj, node, data->nearest.co);
+  }
+}
+
+static void dfs_find_nearest_wide(BVHNearestData *data, const BVHWideNode *wnode)
+{
+  float dist_sq[BVH_WIDE];
+  int order[BVH_WIDE];
+  const int hit_num = wide_hit_order(dist_sq, wide_nearest_hit(data, wnode, dist_sq), order);
+
+  for (int k = 0; k < hit_num; k++) {
+    const int j = order[k];
+    /* The nearest may have changed, remaining children are further away. */
+    if (dist_sq[j] >= data->nearest.dist_sq) {
+      break;
+    }
+
+    const int child = wnode->children[j];
+    if (child >= 0) {
+      dfs_find_nearest_wide(data, &data->tree->wide_nodes[child]);
+    }
+    else {
+      wide_find_nearest_leaf(data, &data->tree->nodearray[BVH_WIDE_LEAF(child)]);
+    }
+  }
+}
+
+static void heap_find_nearest_wide_inner(BVHNearestData *data,
+                                         HeapSimple *heap,
+                                         const BVHWideNode *wnode)
+{
+  float dist_sq[BVH_WIDE];
+  int mask = wide_nearest_hit(data, wnode, dist_sq);
+
+  for (int j = 0; mask; j++, mask >>= 1) {
+    if (mask & 1) {
+      lib_heapsimple_insert(heap, dist_sq[j], POINTER_FROM_INT(wnode->children[j]));
+    }
+  }
+}
+
+static void heap_find_nearest_wide_begin(BVHNearestData *data, const BVHWideNode *root)
+{
+  HeapSimple *heap = lib_heapsimple_new_ex(32);
+
+  heap_find_nearest_wide_inner(data, heap, root);
+
+  while (!lib_heapsimple_is_empty(heap) && lib_heapsimple_top_val(heap) < data->nearest.dist_sq) {
+    const int child = POINTER_AS_INT(lib_heapsimple_pop_min(heap));
+    if (child >= 0) {
+      heap_find_nearest_wide_inner(data, heap, &data->tree->wide_nodes[child]);
+    }
+    else {
+      wide_find_nearest_leaf(data, &data->tree->nodearray[BVH_WIDE_LEAF(child)]);
+    }
+  }
+
+  lib_heapsimple_free(heap, NULL);
+}
+#endif /* USE_WIDE_NODES */
+
 int lib_bvhtree_find_nearest_ex(const BVHTree *tree,
                                 const float co[3],
                                 BVHTreeNearest *nearest,
@@ -1590,7 +2253,19 @@ int lib_bvhtree_find_nearest_ex(const BVHTree *tree,
   }
 
   /* dfs search */
-  if (root) {
+#ifdef USE_WIDE_NODES
+  if (tree->wide_nodes) {
+    if (flag & BVH_NEAREST_OPTIMAL_ORDER) {
+      heap_find_nearest_wide_begin(&data, tree->wide_nodes);
+    }
+    else {
+      dfs_find_nearest_wide(&data, tree->wide_nodes);
+    }
+  }
+  else
+#endif
+      if (root)
+  {
     if (flag & BVH_NEAREST_OPTIMAL_ORDER) {
       heap_find_nearest_begin(&data, root);
     }
@@ -1805,6 +2480,110 @@ static void dfs_raycast(BVHRayCastData *data, BVHNode *node)
   }
 }
 
+#ifdef USE_WIDE_NODES
+/* Distance the ray must travel to hit the bounds of each child (taking the radius into account),
+ * returns a bit-mask of the children hit nearer than the nearest hit so far. */
+static int wide_ray_nearest_hit(const BVHRayCastData *data,
+                                const BVHWideNode *wnode,
+                                float r_dist[BVH_WIDE])
+{
+  /* Match #fast_ray_nearest_hit & #ray_nearest_hit, only the latter clamps to the ray origin. */
+  const float dist_min = (data->ray.radius == 0.0f) ? -FLT_MAX : 0.0f;
+#  if defined(BVH_WIDE_SSE2)
+  __m128 dist_near = _mm_set1_ps(dist_min);
+  __m128 dist_far = _mm_set1_ps(FLT_MAX);
+  for (int i = 0; i < 3; i++) {
+    const __m128 idot = _mm_set1_ps(data->idot_axis[i]);
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(wnode->bounds[data->index[2 * i]]),
+                                            _mm_set1_ps(data->wide_origin[2 * i])),
+                                 idot);
+    const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(wnode->bounds[data->index[2 * i + 1]]),
+                                            _mm_set1_ps(data->wide_origin[2 * i + 1])),
+                                 idot);
+    dist_near = _mm_max_ps(dist_near, t1);
+    dist_far = _mm_min_ps(dist_far, t2);
+  }
+  _mm_storeu_ps(r_dist, dist_near);
+  const __m128 hit = _mm_and_ps(
+      _mm_and_ps(_mm_cmple_ps(dist_near, dist_far), _mm_cmpge_ps(dist_far, _mm_setzero_ps())),
+      _mm_cmplt_ps(dist_near, _mm_set1_ps(data->hit.dist)));
+  const int mask = _mm_movemask_ps(hit);
+#  elif defined(BVH_WIDE_NEON)
+  float32x4_t dist_near = vdupq_n_f32(dist_min);
+  float32x4_t dist_far = vdupq_n_f32(FLT_MAX);
+  for (int i = 0; i < 3; i++) {
+    const float32x4_t idot = vdupq_n_f32(data->idot_axis[i]);
+    const float32x4_t t1 = vmulq_f32(vsubq_f32(vld1q_f32(wnode->bounds[data->index[2 * i]]),
+                                               vdupq_n_f32(data->wide_origin[2 * i])),
+                                     idot);
+    const float32x4_t t2 = vmulq_f32(vsubq_f32(vld1q_f32(wnode->bounds[data->index[2 * i + 1]]),
+                                               vdupq_n_f32(data->wide_origin[2 * i + 1])),
+                                     idot);
+    dist_near = vmaxq_f32(dist_near, t1);
+    dist_far = vminq_f32(dist_far, t2);
+  }
+  vst1q_f32(r_dist, dist_near);
+  const uint32x4_t hit = vandq_u32(
+      vandq_u32(vcleq_f32(dist_near, dist_far), vcgeq_f32(dist_far, vdupq_n_f32(0.0f))),
+      vcltq_f32(dist_near, vdupq_n_f32(data->hit.dist)));
+  const int mask = wide_neon_movemask(hit);
+#  else
+  int mask = 0;
+  for (int j = 0; j < BVH_WIDE; j++) {
+    float dist_near = dist_min, dist_far = FLT_MAX;
+    for (int i = 0; i < 3; i++) {
+      const float t1 = (wnode->bounds[data->index[2 * i]][j] - data->wide_origin[2 * i]) *
+                       data->idot_axis[i];
+      const float t2 = (wnode->bounds[data->index[2 * i + 1]][j] - data->wide_origin[2 * i + 1]) *
+                       data->idot_axis[i];
+      dist_near = max_ff(dist_near, t1);
+      dist_far = min_ff(dist_far, t2);
+    }
+    r_dist[j] = dist_near;
+    if (dist_near <= dist_far && dist_far >= 0.0f && dist_near < data->hit.dist) {
+      mask |= 1 << j;
+    }
+  }
+#  endif
+  return mask & ((1 << wnode->node_num) - 1);
+}
+
+static void wide_raycast_leaf(BVHRayCastData *data, const BVHNode *node, const float dist)
+{
+  if (data->cb) {
+    data->cb(data->userdata, node->index, &data->ray, &data->hit);
+  }
+  else {
+    data->hit.index = node->index;
+    data->hit.dist = dist;
+    madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist);
+  }
+}
+
+static void dfs_raycast_wide(BVHRayCastData *data, const BVHWideNode *wnode)
+{
+  float dist[BVH_WIDE];
+  int order[BVH_WIDE];
+  const int hit_num = wide_hit_order(dist, wide_ray_nearest_hit(data, wnode, dist), order);
+
+  for (int k = 0; k < hit_num; k++) {
+    const int j = order[k];
+    /* The hit may have changed, remaining children are further away. */
+    if (dist[j] >= data->hit.dist) {
+      break;
+    }
+
+    const int child = wnode->children[j];
+    if (child >= 0) {
+      dfs_raycast_wide(data, &data->tree->wide_nodes[child]);
+    }
+    else {
+      wide_raycast_leaf(data, &data->tree->nodearray[BVH_WIDE_LEAF(child)], dist[j]);
+    }
+  }
+}
+#endif /* USE_WIDE_NODES */
+
 /* version of dfs_raycast w minor changes to reset the index & dist each ray cast. */
 static void dfs_raycast_all(BVHRayCastData *data, BVHNode *node)
 {
@@ -1861,6 +2640,15 @@ static void bvhtree_ray_cast_data_precalc(BVHRayCastData *data, int flag)
     data->index[2 * i + 1] = 1 - data->index[2 * i];
     data->index[2 * i] += 2 * i;
     data->index[2 * i + 1] += 2 * i;
+
+#ifdef USE_WIDE_NODES
+    {
+      /* Moving the origin instead of the planes, the near plane is the min of positive axes. */
+      const float radius = data->idot_axis[i] < 0.0f ? -data->ray.radius : data->ray.radius;
+      data->wide_origin[2 * i] = data->ray.origin[i] + radius;
+      data->wide_origin[2 * i + 1] = data->ray.origin[i] - radius;
+    }
+#endif
   }
 
 #ifdef USE_KDOPBVH_WATERTIGHT
@@ -1909,7 +2697,14 @@ int lib_bvhtree_ray_cast_ex(const BVHTree *tree,
     data.hit.dist = BVH_RAYCAST_DIST_MAX;
   }
 
-  if (root) {
+#ifdef USE_WIDE_NODES
+  if (tree->wide_nodes) {
+    dfs_raycast_wide(&data, tree->wide_nodes);
+  }
+  else
+#endif
+      if (root)
+  {
     dfs_raycast(&data, root);
     //      iter_raycast(&data, root);
   }
@@ -2006,6 +2801,428 @@ void lib_bvhtree_ray_cast_all(const BVHTree *tree,
       tree, co, dir, radius, hit_dist, callback, userdata, BVH_RAYCAST_DEFAULT);
 }
 
+/* lib_bvhtree_ray_cast_batch & lib_bvhtree_find_nearest_batch
+ *
+ * Queries are sorted along a Z-order curve of their origin (ray-casts by direction octant first),
+ * so consecutive queries mostly visit the same nodes, then processed in parallel in groups of
+ * #BVH_PACKET_SIZE consecutive queries (packets).
+ * Rays of a packet traverse the tree together (its wide copy when there is one): the bounds of
+ * each node are tested for all rays of the packet that may still hit it, visiting the node only
+ * once.
+ * Points of a packet are searched one at a time, the nearest found first prunes more of the tree
+ * for a single point than a shared traversal of the packet would. */
+
+#define BVH_PACKET_SIZE 8
+/* Bits of the sort key per axis of the origin, the direction octant uses 3 more. */
+#define BVH_BATCH_KEY_AXIS_BITS 9
+#define BVH_BATCH_KEY_AXIS_MAX ((1 << BVH_BATCH_KEY_AXIS_BITS) - 1)
+/* The key is sorted by this many bits at once. */
+#define BVH_BATCH_RADIX_BITS 10
+/* Use threads for batches of more queries. */
+#define BVH_BATCH_THREAD_THRESHOLD 256
+
+typedef struct BVHBatchQuery {
+  uint key;
+  int index;
+} BVHBatchQuery;
+
+typedef struct BVHBatchData {
+  const BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTreeNearest *nearest;
+  BVHTree_RayCastCallback ray_cb;
+  BVHTree_NearestPointCallback nearest_cb;
+  void *userdata;
+  int flag;
+
+  const int *mask;
+  BVHBatchQuery *queries;
+  int queries_num;
+  /* Bounds of the query origins, to quantize them for sorting. */
+  float co_min[3];
+  float co_scale[3];
+} BVHBatchData;
+
+/* Spread the lower 9 bits of `x` to every third bit. */
+static uint batch_morton_spread(uint x)
+{
+  x &= BVH_BATCH_KEY_AXIS_MAX;
+  x = (x | (x << 16)) & 0x30000ff;
+  x = (x | (x << 8)) & 0x300f00f;
+  x = (x | (x << 4)) & 0x30c30c3;
+  x = (x | (x << 2)) & 0x9249249;
+  return x;
+}
+
+static void batch_query_key_task_cb(void *__restrict userdata,
+                                    const int i,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHBatchData *data = userdata;
+  BVHBatchQuery *query = &data->queries[i];
+  const int index = data->mask ? data->mask[i] : i;
+  uint key = 0;
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float co_quantized = clamp_f((data->co[index][axis] - data->co_min[axis]) *
+                                           data->co_scale[axis],
+                                       0.0f,
+                                       (float)BVH_BATCH_KEY_AXIS_MAX);
+    key |= batch_morton_spread((uint)co_quantized) << axis;
+  }
+  if (data->dir) {
+    const uint octant = (uint)((data->dir[index][0] < 0.0f) | ((data->dir[index][1] < 0.0f) << 1) |
+                               ((data->dir[index][2] < 0.0f) << 2));
+    key |= octant << (BVH_BATCH_KEY_AXIS_BITS * 3);
+  }
+
+  query->key = key;
+  query->index = index;
+}
+
+/* Stable radix sort of the queries by their key, using `buffer` of the same size. */
+static void batch_queries_radix_sort(BVHBatchQuery *queries,
+                                     BVHBatchQuery *buffer,
+                                     const int queries_num)
+{
+  const int passes_num = ((BVH_BATCH_KEY_AXIS_BITS * 3) + 3 + BVH_BATCH_RADIX_BITS - 1) /
+                         BVH_BATCH_RADIX_BITS;
+  const uint digit_mask = (1u << BVH_BATCH_RADIX_BITS) - 1;
+  int *offsets = mem_malloc(sizeof(*offsets) << BVH_BATCH_RADIX_BITS, __func__);
+  BVHBatchQuery *src = queries, *dst = buffer;
+
+  for (int pass = 0; pass < passes_num; pass++) {
+    const int shift = pass * BVH_BATCH_RADIX_BITS;
+    memset(offsets, 0, sizeof(*offsets) << BVH_BATCH_RADIX_BITS);
+    for (int i = 0; i < queries_num; i++) {
+      offsets[(src[i].key >> shift) & digit_mask]++;
+    }
+    for (int digit = 0, offset = 0; digit <= (int)digit_mask; digit++) {
+      const int digit_num = offsets[digit];
+      offsets[digit] = offset;
+      offset += digit_num;
+    }
+    for (int i = 0; i < queries_num; i++) {
+      dst[offsets[(src[i].key >> shift) & digit_mask]++] = src[i];
+    }
+    SWAP(BVHBatchQuery *, src, dst);
+  }
+
+  if (src != queries) {
+    memcpy(queries, src, sizeof(*queries) * (size_t)queries_num);
+  }
+  mem_free(offsets);
+}
+
+/* Fill and sort `data->queries`. */
+static void batch_queries_sort(BVHBatchData *data, const TaskParallelSettings *settings)
+{
+  float co_max[3];
+
+  INIT_MINMAX(data->co_min, co_max);
+  for (int i = 0; i < data->queries_num; i++) {
+    minmax_v3v3_v3(data->co_min, co_max, data->co[data->mask ? data->mask[i] : i]);
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = co_max[axis] - data->co_min[axis];
+    data->co_scale[axis] = (extent > 0.0f) ? (float)BVH_BATCH_KEY_AXIS_MAX / extent : 0.0f;
+  }
+
+  const size_t queries_size = sizeof(*data->queries) * (size_t)data->queries_num;
+  data->queries = mem_malloc(queries_size, __func__);
+  lib_task_parallel_range(0, data->queries_num, data, batch_query_key_task_cb, settings);
+
+  BVHBatchQuery *buffer = mem_malloc(queries_size, __func__);
+  batch_queries_radix_sort(data->queries, buffer, data->queries_num);
+  mem_free(buffer);
+}
+
+/* Index of the first query in the packet `mask`. */
+static int batch_packet_first(const uint mask)
+{
+  int i = 0;
+  while (!(mask & (1u << i))) {
+    i++;
+  }
+  return i;
+}
+
+/* Like #dfs_raycast for the rays of a packet, for trees without a wide copy: the bounds of the
+ * node are tested for all rays of `rays_mask`, which traverse its children together. */
+static void dfs_raycast_packet(BVHRayCastData *packet, BVHNode *node, const uint rays_mask)
+{
+  float dist[BVH_PACKET_SIZE];
+  uint rays = 0;
+  int r, i;
+
+  for (r = 0; r < BVH_PACKET_SIZE; r++) {
+    if (rays_mask & (1u << r)) {
+      BVHRayCastData *data = &packet[r];
+      dist[r] = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) :
+                                             ray_nearest_hit(data, node->bv);
+      if (dist[r] < data->hit.dist) {
+        rays |= 1u << r;
+      }
+    }
+  }
+  if (rays == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    for (r = 0; r < BVH_PACKET_SIZE; r++) {
+      if (rays & (1u << r)) {
+        BVHRayCastData *data = &packet[r];
+        if (data->cb) {
+          data->cb(data->userdata, node->index, &data->ray, &data->hit);
+        }
+        else {
+          data->hit.index = node->index;
+          data->hit.dist = dist[r];
+          madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[r]);
+        }
+      }
+    }
+    return;
+  }
+
+  if (!(rays & (rays - 1))) {
+    /* A single ray is faster to traverse alone. */
+    BVHRayCastData *data = &packet[batch_packet_first(rays)];
+    if (data->ray_dot_axis[node->main_axis] > 0.0f) {
+      for (i = 0; i != node->node_num; i++) {
+        dfs_raycast(data, node->children[i]);
+      }
+    }
+    else {
+      for (i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast(data, node->children[i]);
+      }
+    }
+    return;
+  }
+
+  /* Rays are sorted by direction octant, so the first ray's direction suits most of the packet. */
+  if (packet[batch_packet_first(rays)].ray_dot_axis[node->main_axis] > 0.0f) {
+    for (i = 0; i != node->node_num; i++) {
+      dfs_raycast_packet(packet, node->children[i], rays);
+    }
+  }
+  else {
+    for (i = node->node_num - 1; i >= 0; i--) {
+      dfs_raycast_packet(packet, node->children[i], rays);
+    }
+  }
+}
+
+#ifdef USE_WIDE_NODES
+static void dfs_raycast_wide_packet(BVHRayCastData *packet,
+                                    const BVHWideNode *wnode,
+                                    const uint rays_mask)
+{
+  const BVHTree *tree = packet[0].tree;
+  float dist[BVH_PACKET_SIZE][BVH_WIDE];
+  float child_dist[BVH_WIDE];
+  uint child_rays[BVH_WIDE];
+  int child_mask = 0;
+  int order[BVH_WIDE];
+  int j;
+
+  for (j = 0; j < BVH_WIDE; j++) {
+    child_dist[j] = FLT_MAX;
+    child_rays[j] = 0;
+  }
+
+  for (int r = 0; r < BVH_PACKET_SIZE; r++) {
+    if (rays_mask & (1u << r)) {
+      int mask = wide_ray_nearest_hit(&packet[r], wnode, dist[r]);
+      child_mask |= mask;
+      for (j = 0; mask; j++, mask >>= 1) {
+        if (mask & 1) {
+          child_rays[j] |= 1u << r;
+          child_dist[j] = min_ff(child_dist[j], dist[r][j]);
+        }
+      }
+    }
+  }
+
+  /* Visit the children in order of the nearest hit of any ray. */
+  const int hit_num = wide_hit_order(child_dist, child_mask, order);
+  for (int k = 0; k < hit_num; k++) {
+    j = order[k];
+    const int child = wnode->children[j];
+    uint rays = 0;
+
+    /* Skip rays that hit something nearer since the bounds were tested. */
+    for (int r = 0; r < BVH_PACKET_SIZE; r++) {
+      if ((child_rays[j] & (1u << r)) && (dist[r][j] < packet[r].hit.dist)) {
+        rays |= 1u << r;
+      }
+    }
+    if (rays == 0) {
+      continue;
+    }
+
+    if (child >= 0) {
+      if (rays & (rays - 1)) {
+        dfs_raycast_wide_packet(packet, &tree->wide_nodes[child], rays);
+      }
+      else {
+        /* A single ray is faster to traverse alone. */
+        dfs_raycast_wide(&packet[batch_packet_first(rays)], &tree->wide_nodes[child]);
+      }
+    }
+    else {
+      const BVHNode *node = &tree->nodearray[BVH_WIDE_LEAF(child)];
+      for (int r = 0; r < BVH_PACKET_SIZE; r++) {
+        if (rays & (1u << r)) {
+          wide_raycast_leaf(&packet[r], node, dist[r][j]);
+        }
+      }
+    }
+  }
+}
+#endif /* USE_WIDE_NODES */
+
+static void raycast_batch_task_cb(void *__restrict userdata,
+                                  const int packet_index,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHBatchData *data = userdata;
+  const BVHBatchQuery *queries = &data->queries[packet_index * BVH_PACKET_SIZE];
+  const int queries_num = min_ii(BVH_PACKET_SIZE,
+                                 data->queries_num - packet_index * BVH_PACKET_SIZE);
+  BVHNode *root = data->tree->nodes[data->tree->leaf_num];
+  BVHRayCastData packet[BVH_PACKET_SIZE];
+  int i;
+
+  for (i = 0; i < queries_num; i++) {
+    BVHRayCastData *ray_data = &packet[i];
+    const int index = queries[i].index;
+
+    LIB_ASSERT_UNIT_V3(data->dir[index]);
+
+    ray_data->tree = data->tree;
+    ray_data->cb = data->ray_cb;
+    ray_data->userdata = data->userdata;
+    copy_v3_v3(ray_data->ray.origin, data->co[index]);
+    copy_v3_v3(ray_data->ray.direction, data->dir[index]);
+    ray_data->ray.radius = data->radius;
+    bvhtree_ray_cast_data_precalc(ray_data, data->flag);
+    ray_data->hit = data->hits[index];
+  }
+
+#ifdef USE_WIDE_NODES
+  if (data->tree->wide_nodes) {
+    dfs_raycast_wide_packet(packet, data->tree->wide_nodes, (1u << queries_num) - 1);
+  }
+  else
+#endif
+      if (root)
+  {
+    dfs_raycast_packet(packet, root, (1u << queries_num) - 1);
+  }
+
+  for (i = 0; i < queries_num; i++) {
+    data->hits[queries[i].index] = packet[i].hit;
+  }
+}
+
+static void find_nearest_batch_task_cb(void *__restrict userdata,
+                                       const int packet_index,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHBatchData *data = userdata;
+  const BVHBatchQuery *queries = &data->queries[packet_index * BVH_PACKET_SIZE];
+  const int queries_num = min_ii(BVH_PACKET_SIZE,
+                                 data->queries_num - packet_index * BVH_PACKET_SIZE);
+
+  for (int i = 0; i < queries_num; i++) {
+    const int index = queries[i].index;
+    lib_bvhtree_find_nearest_ex(data->tree,
+                                data->co[index],
+                                &data->nearest[index],
+                                data->nearest_cb,
+                                data->userdata,
+                                data->flag);
+  }
+}
+
+static void bvhtree_batch_run(BVHBatchData *data, TaskParallelRangeFunc func)
+{
+  const int packets_num = (data->queries_num + BVH_PACKET_SIZE - 1) / BVH_PACKET_SIZE;
+
+  TaskParallelSettings settings;
+  lib_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (data->queries_num > BVH_BATCH_THREAD_THRESHOLD);
+
+  batch_queries_sort(data, &settings);
+
+  settings.min_iter_per_thread = 4;
+  lib_task_parallel_range(0, packets_num, data, func, &settings);
+
+  mem_free(data->queries);
+}
+
+void lib_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int *mask,
+                                int queries_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  if (queries_num == 0) {
+    return;
+  }
+
+  BVHBatchData data = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .radius = radius,
+      .hits = hits,
+      .ray_cb = callback,
+      .userdata = userdata,
+      .flag = flag,
+      .mask = mask,
+      .queries_num = queries_num,
+  };
+  bvhtree_batch_run(&data, raycast_batch_task_cb);
+}
+
+void lib_bvhtree_find_nearest_batch(const BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int *mask,
+                                    int queries_num,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag)
+{
+  if (queries_num == 0) {
+    return;
+  }
+
+  BVHBatchData data = {
+      .tree = tree,
+      .co = co,
+      .nearest = nearest,
+      .nearest_cb = callback,
+      .userdata = userdata,
+      .flag = flag,
+      .mask = mask,
+      .queries_num = queries_num,
+  };
+  bvhtree_batch_run(&data, find_nearest_batch_task_cb);
+}
+
 /* lib_bvhtree_range_query
  * Allocs and fills an array w the indices of node that are on the given spherical range
  * (center, radius).
@@ -11,6 +11,7 @@
 #include "lib_utildefines.h"
 #include "lib_asan.h"
 #include "lib_mempool.h"         /* own include */
+#include "lib_mempool_local.h"   /* own include */
 #include "lib_mempool_private.h" /* own include */
 
 #ifdef WITH_ASAN
@@ -884,6 +885,199 @@ void lib_mempool_destroy(LibMempool *pool)
   mem_free(pool);
 }
 
+/* -------------------------------------------------------------------- */
+/* Thread-local allocation. */
+
+void lib_mempool_local_init(LibMempool *pool, LibMempoolLocal *local)
+{
+  local->pool = pool;
+  local->chunks = NULL;
+  local->chunk_tail = NULL;
+  local->free = NULL;
+  local->free_tail = NULL;
+  local->bump = NULL;
+  local->bump_end = NULL;
+  local->totused = 0;
+}
+
+static void mempool_local_chunk_add(LibMempoolLocal *local)
+{
+  /* The guarded allocator is thread-safe, no locking is needed. */
+  LibMempoolChunk *mpchunk = mempool_chunk_alloc(local->pool);
+
+  mpchunk->next = NULL;
+  if (local->chunk_tail) {
+    local->chunk_tail->next = mpchunk;
+  }
+  else {
+    local->chunks = mpchunk;
+  }
+  local->chunk_tail = mpchunk;
+
+  local->bump = CHUNK_DATA(mpchunk);
+  local->bump_end = local->bump + local->pool->csize;
+}
+
+/* Turn the not yet used part of the last chunk into free elements, so that it is valid for
+ * iteration and can be re-used once merged. */
+static void mempool_local_bump_to_free(LibMempoolLocal *local)
+{
+  LibMempool *pool = local->pool;
+  const uint esize = pool->esize;
+
+  for (; local->bump != local->bump_end; local->bump += esize) {
+    LibFreeNode *curnode = (LibFreeNode *)local->bump;
+    curnode->next = local->free;
+    if (pool->flag & LIB_MEMPOOL_ALLOW_ITER) {
+      curnode->freeword = FREEWORD;
+    }
+    if (local->free == NULL) {
+      local->free_tail = curnode;
+    }
+    local->free = curnode;
+    lib_asan_poison(curnode, esize);
+  }
+
+  local->bump = NULL;
+  local->bump_end = NULL;
+}
+
+/* Prepend the `src_first..src_last` list of free nodes to the `r_first` list. */
+static void mempool_free_list_prepend(LibMempool *pool,
+                                      LibFreeNode **r_first,
+                                      LibFreeNode **r_last,
+                                      LibFreeNode *src_first,
+                                      LibFreeNode *src_last)
+{
+  if (src_first == NULL) {
+    return;
+  }
+  lib_asan_unpoison(src_last, pool->esize - POISON_REDZONE_SIZE);
+  src_last->next = *r_first;
+  lib_asan_poison(src_last, pool->esize);
+  if (r_last != NULL && *r_first == NULL) {
+    *r_last = src_last;
+  }
+  *r_first = src_first;
+}
+
+void *lib_mempool_local_alloc(LibMempoolLocal *local)
+{
+  LibMempool *pool = local->pool;
+  LibFreeNode *free_pop;
+
+  if (local->free != NULL) {
+    free_pop = local->free;
+    lib_asan_unpoison(free_pop, pool->esize - POISON_REDZONE_SIZE);
+    local->free = free_pop->next;
+  }
+  else {
+    if (UNLIKELY(local->bump == local->bump_end)) {
+      mempool_local_chunk_add(local);
+    }
+    free_pop = (LibFreeNode *)local->bump;
+    local->bump += pool->esize;
+  }
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize - POISON_REDZONE_SIZE);
+#endif
+
+  if (pool->flag & LIB_MEMPOOL_ALLOW_ITER) {
+    free_pop->freeword = USEDWORD;
+  }
+  local->totused++;
+
+  return (void *)free_pop;
+}
+
+void *lib_mempool_local_calloc(LibMempoolLocal *local)
+{
+  void *retval = lib_mempool_local_alloc(local);
+
+  memset(retval, 0, (size_t)local->pool->esize - POISON_REDZONE_SIZE);
+
+  return retval;
+}
+
+void lib_mempool_local_free(LibMempoolLocal *local, void *addr)
+{
+  LibMempool *pool = local->pool;
+  LibFreeNode *newhead = addr;
+
+#ifndef NDEBUG
+  /* Enable for debugging. */
+  if (UNLIKELY(mempool_debug_memset)) {
+    memset(addr, 255, pool->esize - POISON_REDZONE_SIZE);
+  }
+#endif
+
+  if (pool->flag & LIB_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+    /* This will detect double free's. */
+    lib_assert(newhead->freeword != FREEWORD);
+#endif
+    newhead->freeword = FREEWORD;
+  }
+
+  newhead->next = local->free;
+  if (local->free == NULL) {
+    local->free_tail = newhead;
+  }
+  local->free = newhead;
+
+  lib_asan_poison(newhead, pool->esize);
+
+  local->totused--;
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+}
+
+void lib_mempool_local_reduce(LibMempoolLocal *dst, LibMempoolLocal *src)
+{
+  lib_assert(dst->pool == src->pool);
+
+  mempool_local_bump_to_free(src);
+
+  if (src->chunks != NULL) {
+    if (dst->chunk_tail) {
+      dst->chunk_tail->next = src->chunks;
+    }
+    else {
+      dst->chunks = src->chunks;
+    }
+    dst->chunk_tail = src->chunk_tail;
+  }
+  mempool_free_list_prepend(dst->pool, &dst->free, &dst->free_tail, src->free, src->free_tail);
+  dst->totused += src->totused;
+
+  lib_mempool_local_init(src->pool, src);
+}
+
+void lib_mempool_local_end(LibMempoolLocal *local)
+{
+  LibMempool *pool = local->pool;
+
+  mempool_local_bump_to_free(local);
+
+  if (local->chunks != NULL) {
+    if (pool->chunk_tail) {
+      pool->chunk_tail->next = local->chunks;
+    }
+    else {
+      lib_assert(pool->chunks == NULL);
+      pool->chunks = local->chunks;
+    }
+    pool->chunk_tail = local->chunk_tail;
+  }
+  mempool_free_list_prepend(pool, &pool->free, NULL, local->free, local->free_tail);
+  pool->totused = (uint)((int)pool->totused + local->totused);
+
+  lib_mempool_local_init(pool, local);
+}
+
 #ifndef NDEBUG
 void lib_mempool_set_mem_debug(void)
 {
@@ -555,6 +555,15 @@ void lib_condition_wait(ThreadCondition *cond, ThreadMutex *mutex)
   pthread_cond_wait(cond, mutex);
 }
 
+static void wait_timeout(struct timespec *timeout, int ms);
+
+bool lib_condition_wait_timeout(ThreadCondition *cond, ThreadMutex *mutex, int ms)
+{
+  struct timespec timeout;
+  wait_timeout(&timeout, ms);
+  return pthread_cond_timedwait(cond, mutex, &timeout) != ETIMEDOUT;
+}
+
 void lib_condition_wait_global_mutex(ThreadCondition *cond, const int type)
 {
   pthread_cond_wait(cond, global_mutex_from_type(type));
@@ -0,0 +1,66 @@
+#pragma once
+
+/** Extensions of the ArrayStore API (see lib_array_store.h).
+ *
+ * - Content defined chunks, for arrays where elements are inserted or removed between states.
+ * - Adding the arrays of a state (positions, custom-data layers... etc) in parallel.
+ */
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ArrayState;
+struct ArrayStore;
+struct ArrayStoreAtSize;
+
+enum {
+  /**
+   * Place chunk boundaries based on the contents of the array (using a rolling hash),
+   * instead of at regular intervals. Inserting or removing elements then only changes
+   * the chunks around the edit, instead of every chunk after it.
+   * Chunk sizes vary between an eighth & double the regular chunk size.
+   */
+  ARRAY_STORE_CONTENT_DEFINED_CHUNKS = (1 << 0),
+};
+
+/**
+ * Create a new array store, see #lib_array_store_create.
+ *
+ * \param flag: Options from #ARRAY_STORE_CONTENT_DEFINED_CHUNKS.
+ */
+struct ArrayStore *lib_array_store_create_ex(uint stride, uint chunk_count, int flag);
+
+/**
+ * Same as #lib_array_store_at_size_ensure, \a flag is only used when the store is created.
+ */
+struct ArrayStore *lib_array_store_at_size_ensure_ex(struct ArrayStoreAtSize *bs_stride,
+                                                     int stride,
+                                                     int chunk_size,
+                                                     int flag);
+
+typedef struct ArrayStoreStateAdd {
+  struct ArrayStore *bs;
+  const void *data;
+  size_t data_len;
+  /** Reference state, must not be added by the same batch (may be NULL). */
+  const struct ArrayState *state_ref;
+
+  /** Set to the new state. */
+  struct ArrayState *state;
+} ArrayStoreStateAdd;
+
+/**
+ * Add many states at once, the same as calling #lib_array_store_state_add for each item
+ * (in order), using multiple threads.
+ *
+ * The arrays are split into chunks in parallel, as are the states of different stores.
+ * States of a single store are added in order by one thread.
+ */
+void lib_array_store_state_add_batch(ArrayStoreStateAdd *items, int items_len);
+
+#ifdef __cplusplus
+}
+#endif
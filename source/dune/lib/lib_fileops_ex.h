@@ -0,0 +1,34 @@
+#pragma once
+
+/** Extensions of the file operations API (see lib_fileops.h).
+ *
+ * - Writing seekable zstd files, which are read in parallel (see lib_filereader_ex.h).
+ */
+
+#include <stdio.h>
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Like #lib_file_zstd_from_mem_at_pos, writing independently compressed frames of
+ * \a frame_size bytes (compressed in parallel) followed by a seek table, so the file can be read
+ * from any position & decompressed in parallel by #lib_filereader_new_zstd_ex.
+ *
+ * \param frame_size: Uncompressed size of the frames, up to 2 GiB. Smaller frames can be
+ * decompressed with more threads, at the cost of a lower compression ratio.
+ * \return The number of bytes written, zero on failure.
+ */
+size_t lib_file_zstd_seekable_from_mem_at_pos(void *buf,
+                                              size_t len,
+                                              FILE *file,
+                                              size_t file_offset,
+                                              int compression_level,
+                                              size_t frame_size);
+
+#ifdef __cplusplus
+}
+#endif
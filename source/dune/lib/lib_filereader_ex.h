@@ -0,0 +1,30 @@
+#pragma once
+
+/** Extensions of the FileReader API (see lib_filereader.h).
+ *
+ * - Decompressing the frames of seekable zstd files in parallel, ahead of reading them.
+ */
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct FileReader;
+
+/**
+ * Create a zstd reader, see #lib_filereader_new_zstd.
+ *
+ * \param read_ahead_frames: When the file is seekable
+ * (see #lib_file_zstd_seekable_from_mem_at_pos), up to this many frames following the frame
+ * being read are decompressed in parallel, on the task scheduler. Zero to decompress one frame
+ * at a time, when it's read.
+ * Reading ahead is meant for reading a file from start to end, seeking elsewhere discards
+ * the frames decompressed ahead.
+ */
+struct FileReader *lib_filereader_new_zstd_ex(struct FileReader *base, int read_ahead_frames);
+
+#ifdef __cplusplus
+}
+#endif
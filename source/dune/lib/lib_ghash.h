@@ -38,6 +38,12 @@ typedef struct GHashIterState {
 enum {
   GHASH_FLAG_ALLOW_DUPES = (1 << 0),  /* Only checked for in debug mode */
   GHASH_FLAG_ALLOW_SHRINK = (1 << 1), /* Allow to shrink buckets' size. */
+  /**
+   * Use an open addressing index probed a group of slots at a time, instead of bucket chains.
+   * Faster lookups, especially on large hashes. Can be set or cleared at any time,
+   * pointers to keys and values remain valid.
+   */
+  GHASH_FLAG_OPEN_ADDRESSING = (1 << 2),
 
 #ifdef GHASH_INTERNAL_API
   /* Internal usage only */
@@ -0,0 +1,83 @@
+#pragma once
+
+/** Extensions of the BVH-tree API (see lib_kdopbvh.h).
+ *
+ * - Building the tree with a surface area heuristic (SAH).
+ * - Building a 4-wide copy of the tree for faster queries.
+ * - Batched ray-casts & nearest queries.
+ */
+
+#include "lib_kdopbvh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  /**
+   * Split nodes where the binned surface area heuristic (SAH) is lowest, instead of at the
+   * median of the largest axis. Gives faster ray-casts & nearest queries on unevenly distributed
+   * primitives (most meshes), at the cost of a slower build.
+   * Only used by k-DOP's containing the X, Y & Z axes (not 18-DOP's).
+   */
+  BVH_BUILD_SAH = (1 << 0),
+  /**
+   * Also build a copy of the tree with up to 4 children per node when balancing, which
+   * ray-casts & nearest queries use to test the bounds of all children at once. Worth its memory
+   * & build time for trees that serve many queries (batched or repeated).
+   * Only used by trees with up to 4 children per node, of k-DOP's containing the X, Y & Z axes.
+   */
+  BVH_BUILD_WIDE = (1 << 1),
+};
+
+/**
+ * Create a new BVH-tree, see #lib_bvhtree_new.
+ *
+ * \param flag: Options from #BVH_BUILD_SAH, #BVH_BUILD_WIDE.
+ */
+BVHTree *lib_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag);
+
+/**
+ * Cast many rays, the result of each is the same as a call to #lib_bvhtree_ray_cast_ex.
+ * Rays are sorted to be cast in coherent groups which share the traversal of the tree,
+ * spread over multiple threads. Trees built with #BVH_BUILD_WIDE are traversed fastest.
+ *
+ * \param co, dir: Origins & (normalized) directions of the rays.
+ * \param mask: Indices of the rays to cast, all rays when NULL.
+ * \param queries_num: The length of \a mask, or the number of rays when \a mask is NULL.
+ * \param hits: Initialized hit of each ray (indexed like \a co), as passed to
+ * #lib_bvhtree_ray_cast_ex, the result is written back to it.
+ * \param callback: May be called from multiple threads at once.
+ */
+void lib_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int *mask,
+                                int queries_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
+/**
+ * Find the nearest primitive to many points, the result for each is the same as a call to
+ * #lib_bvhtree_find_nearest_ex. Like #lib_bvhtree_ray_cast_batch, points are sorted to be
+ * searched in coherent groups, spread over multiple threads.
+ *
+ * \param nearest: Initialized nearest of each point (indexed like \a co), the result is written
+ * back to it.
+ * \param callback: May be called from multiple threads at once.
+ */
+void lib_bvhtree_find_nearest_batch(const BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int *mask,
+                                    int queries_num,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+/** Extensions of the KD-tree API (see lib_kdtree.h), declared for each dimension.
+ *
+ * - Batched nearest queries.
+ * - Balancing without threads.
+ */
+
+#include "lib_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * `lib_kdtree_nd_find_nearest_n_batch`:
+ * Find the `nearest_len_capacity` nearest points to each of `co`, in parallel.
+ *
+ * \param r_nearest: Flat array of `queries_num * nearest_len_capacity` nearest,
+ * those of query `i` start at `i * nearest_len_capacity`, ordered by distance.
+ * \param r_nearest_len: The number of points found for each query (optional).
+ *
+ * `lib_kdtree_nd_balance_ex`:
+ * Like `lib_kdtree_nd_balance`, large trees are balanced with multiple threads only with
+ * `use_threading`. The tree is the same either way.
+ */
+#define _LIB_KDTREE_EX_DECLARE(_dims) \
+  struct KDTree_##_dims##d; \
+  struct KDTreeNearest_##_dims##d; \
+  void lib_kdtree_##_dims##d_find_nearest_n_batch(const struct KDTree_##_dims##d *tree, \
+                                                  const float(*co)[_dims], \
+                                                  uint queries_num, \
+                                                  struct KDTreeNearest_##_dims##d *r_nearest, \
+                                                  uint nearest_len_capacity, \
+                                                  int *r_nearest_len); \
+  void lib_kdtree_##_dims##d_balance_ex(struct KDTree_##_dims##d *tree, bool use_threading);
+
+_LIB_KDTREE_EX_DECLARE(1)
+_LIB_KDTREE_EX_DECLARE(2)
+_LIB_KDTREE_EX_DECLARE(3)
+_LIB_KDTREE_EX_DECLARE(4)
+
+#undef _LIB_KDTREE_EX_DECLARE
+
+#ifdef __cplusplus
+}
+#endif
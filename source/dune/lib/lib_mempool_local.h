@@ -0,0 +1,69 @@
+#pragma once
+
+/** Thread-local allocation into a LibMempool.
+ *
+ * Allows parallel code to allocate elements of a single pool without any locking: every thread
+ * allocates into its own chunks and keeps its own free list, which are merged into the pool at
+ * the end. Intended to be used as the `userdata_chunk` of #lib_task_parallel_range:
+ *
+ * - Initialize the local storage with #lib_mempool_local_init in the main `userdata_chunk`.
+ * - Allocate and free with #lib_mempool_local_alloc and #lib_mempool_local_free from the
+ *   range callback.
+ * - Merge the storage of finished tasks in the `fn_reduce` callback with #lib_mempool_local_reduce.
+ * - After the loop, merge the main `userdata_chunk` into the pool with #lib_mempool_local_end.
+ *
+ * The pool itself must not be used while local storages are in use. Elements allocated from a
+ * local storage can only be freed with the pool functions after #lib_mempool_local_end.
+ * The iteration order of elements allocated by different threads is not deterministic. */
+
+#include "lib_compiler_attrs.h"
+#include "lib_sys_types.h" /* for bool */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct LibFreeNode;
+struct LibMempool;
+struct LibMempoolChunk;
+
+typedef struct LibMempoolLocal {
+  struct LibMempool *pool;
+  /* Chunks allocated by this storage, not yet part of the pool. */
+  struct LibMempoolChunk *chunks;
+  struct LibMempoolChunk *chunk_tail;
+  /* Elements freed into this storage, the tail is only valid when the list is not empty. */
+  struct LibFreeNode *free;
+  struct LibFreeNode *free_tail;
+  /* Not yet used part of the last chunk, elements are handed out from it without having to build
+   * the free list of the whole chunk. */
+  char *bump;
+  char *bump_end;
+  /* Number of allocated minus freed elements, negative when freeing elements of the pool. */
+  int totused;
+} LibMempoolLocal;
+
+void lib_mempool_local_init(struct LibMempool *pool, LibMempoolLocal *local) ATTR_NONNULL();
+
+void *lib_mempool_local_alloc(LibMempoolLocal *local) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT
+    ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void *lib_mempool_local_calloc(LibMempoolLocal *local) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT
+    ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+/**
+ * Free an element allocated from any local storage of the same pool, or from the pool itself.
+ * The memory is only available for re-use by this local storage until it is merged.
+ */
+void lib_mempool_local_free(LibMempoolLocal *local, void *addr) ATTR_NONNULL(1, 2);
+
+/** Move all chunks and free elements of `src` into `dst`, `src` is left empty. */
+void lib_mempool_local_reduce(LibMempoolLocal *dst, LibMempoolLocal *src) ATTR_NONNULL();
+
+/**
+ * Move all chunks and free elements of the local storage into its pool.
+ * Not thread-safe, must be called once all threads finished using local storages of the pool.
+ */
+void lib_mempool_local_end(LibMempoolLocal *local) ATTR_NONNULL();
+
+#ifdef __cplusplus
+}
+#endif
@@ -110,6 +110,8 @@ typedef pthread_cond_t ThreadCondition;
 
 void lib_condition_init(ThreadCondition *cond);
 void lib_condition_wait(ThreadCondition *cond, ThreadMutex *mutex);
+/** Wait at most `ms` milliseconds, returns false when the wait timed out. */
+bool lib_condition_wait_timeout(ThreadCondition *cond, ThreadMutex *mutex, int ms);
 void lib_condition_wait_global_mutex(ThreadCondition *cond, int type);
 void lib_condition_notify_one(ThreadCondition *cond);
 void lib_condition_notify_all(ThreadCondition *cond);
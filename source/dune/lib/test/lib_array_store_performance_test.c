@@ -0,0 +1,273 @@
+#include "testing/testing.h"
+
+#include "mem_guardedalloc.h"
+
+#include "lib_array_store.h"
+#include "lib_array_store_ex.h"
+#include "lib_rand.h"
+#include "lib_time_utildefines.h"
+#include "lib_utildefines.h"
+
+/* Pushes undo states of a mesh-like set of arrays (positions, edges & a few custom-data layers),
+ * editing the arrays between states, reports the time and memory used per state.
+ *
+ * Compares regular chunks with content defined chunks (#ARRAY_STORE_CONTENT_DEFINED_CHUNKS),
+ * adding the arrays of each state one at a time and as a batch. */
+
+#define ARRAY_CHUNK_SIZE 256
+#define STATES_NUM 32
+
+enum {
+  EDIT_TRANSLATE = 0,
+  EDIT_INSERT,
+  EDIT_REMOVE,
+};
+
+static const char *edit_type_name[] = {"translate", "insert", "remove"};
+
+enum {
+  STORE_FIXED = 0,
+  STORE_CDC,
+  STORE_CDC_BATCH,
+};
+
+static const char *store_type_name[] = {
+    "regular chunks", "content defined chunks", "content defined chunks (batch)"};
+
+struct ArrayPerfLayer {
+  const char *name;
+  uint stride;
+  /* Number of elements per vertex. */
+  uint elem_per_vert;
+};
+
+static const ArrayPerfLayer perf_layers[] = {
+    {"position", sizeof(float[3]), 1},
+    {"edge", sizeof(int[2]), 2},
+    {"uv", sizeof(float[2]), 4},
+    {"color", sizeof(uchar[4]), 4},
+    {"crease", sizeof(float), 1},
+    {"flag", sizeof(char), 1},
+};
+
+#define PERF_LAYERS_NUM int(ARRAY_SIZE(perf_layers))
+
+struct ArrayPerfMesh {
+  uchar *layers[PERF_LAYERS_NUM];
+  uint verts_num;
+};
+
+static void perf_layer_fill(RNG *rng, const int layer_index, uchar *data, const uint elem_num)
+{
+  const ArrayPerfLayer *layer = &perf_layers[layer_index];
+  if (STREQ(layer->name, "crease")) {
+    /* Mostly zeroed, as is common for custom-data layers. */
+    memset(data, 0, layer->stride * elem_num);
+    return;
+  }
+  if (STREQ(layer->name, "flag")) {
+    memset(data, 1, layer->stride * elem_num);
+    return;
+  }
+  for (uint i = 0; i < layer->stride * elem_num; i++) {
+    data[i] = uchar(lib_rng_get_uint(rng));
+  }
+}
+
+static void perf_mesh_init(RNG *rng, ArrayPerfMesh *mesh, const uint verts_num)
+{
+  mesh->verts_num = verts_num;
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    const ArrayPerfLayer *layer = &perf_layers[i];
+    const uint elem_num = verts_num * layer->elem_per_vert;
+    mesh->layers[i] = (uchar *)mem_malloc(layer->stride * elem_num, __func__);
+    perf_layer_fill(rng, i, mesh->layers[i], elem_num);
+  }
+}
+
+static void perf_mesh_free(ArrayPerfMesh *mesh)
+{
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    mem_free(mesh->layers[i]);
+  }
+}
+
+/* Edit a range of vertices, with all elements of the layers which belong to them. */
+static void perf_mesh_edit(RNG *rng, ArrayPerfMesh *mesh, const int edit_type, const uint verts_edit)
+{
+  const uint vert_start = lib_rng_get_uint(rng) % (mesh->verts_num - verts_edit);
+  uint verts_num_new = mesh->verts_num;
+  if (edit_type == EDIT_INSERT) {
+    verts_num_new += verts_edit;
+  }
+  else if (edit_type == EDIT_REMOVE) {
+    verts_num_new -= verts_edit;
+  }
+
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    const ArrayPerfLayer *layer = &perf_layers[i];
+    const size_t vert_size = layer->stride * layer->elem_per_vert;
+    uchar *data = mesh->layers[i];
+    uchar *data_edit = &data[vert_start * vert_size];
+    const size_t data_edit_len = verts_edit * vert_size;
+    const size_t data_tail_len = (mesh->verts_num - vert_start) * vert_size;
+
+    switch (edit_type) {
+      case EDIT_TRANSLATE: {
+        if (STREQ(layer->name, "position")) {
+          float(*positions)[3] = (float(*)[3])data_edit;
+          for (uint v = 0; v < verts_edit; v++) {
+            positions[v][2] += 0.1f;
+          }
+        }
+        break;
+      }
+      case EDIT_INSERT: {
+        data = (uchar *)mem_realloc(data, verts_num_new * vert_size);
+        data_edit = &data[vert_start * vert_size];
+        memmove(data_edit + data_edit_len, data_edit, data_tail_len);
+        perf_layer_fill(rng, i, data_edit, verts_edit * layer->elem_per_vert);
+        break;
+      }
+      case EDIT_REMOVE: {
+        memmove(data_edit, data_edit + data_edit_len, data_tail_len - data_edit_len);
+        break;
+      }
+    }
+    mesh->layers[i] = data;
+  }
+  mesh->verts_num = verts_num_new;
+}
+
+static void array_store_perf_run(const int edit_type,
+                                 const int store_type,
+                                 const uint verts_num,
+                                 const uint edits_per_state)
+{
+  const int flag = (store_type == STORE_FIXED) ? 0 : ARRAY_STORE_CONTENT_DEFINED_CHUNKS;
+  RNG *rng = lib_rng_new(0);
+  ArrayPerfMesh mesh;
+  perf_mesh_init(rng, &mesh, verts_num);
+
+  ArrayStore *stores[PERF_LAYERS_NUM];
+  ArrayState *states[STATES_NUM][PERF_LAYERS_NUM];
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    stores[i] = lib_array_store_create_ex(perf_layers[i].stride, ARRAY_CHUNK_SIZE, flag);
+  }
+
+  printf("\n========== %s, %u vertices, %u edits per state, %s ==========\n",
+         edit_type_name[edit_type],
+         verts_num,
+         edits_per_state,
+         store_type_name[store_type]);
+
+  size_t size_first = 0;
+  size_t size_expanded = 0;
+  float time_edit_states = 0.0f;
+
+  TIMEIT_START(states_add);
+
+  for (int state_index = 0; state_index < STATES_NUM; state_index++) {
+    if (state_index != 0) {
+      for (uint i = 0; i < edits_per_state; i++) {
+        perf_mesh_edit(rng, &mesh, edit_type, 16);
+      }
+    }
+
+    const float time_state_start = TIMEIT_VALUE(states_add);
+
+    if (store_type == STORE_CDC_BATCH) {
+      ArrayStoreStateAdd items[PERF_LAYERS_NUM];
+      for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+        items[i].bs = stores[i];
+        items[i].data = mesh.layers[i];
+        items[i].data_len = mesh.verts_num * perf_layers[i].elem_per_vert * perf_layers[i].stride;
+        items[i].state_ref = state_index ? states[state_index - 1][i] : nullptr;
+      }
+      lib_array_store_state_add_batch(items, PERF_LAYERS_NUM);
+      for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+        states[state_index][i] = items[i].state;
+      }
+    }
+    else {
+      for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+        states[state_index][i] = lib_array_store_state_add(
+            stores[i],
+            mesh.layers[i],
+            mesh.verts_num * perf_layers[i].elem_per_vert * perf_layers[i].stride,
+            state_index ? states[state_index - 1][i] : nullptr);
+      }
+    }
+
+    if (state_index != 0) {
+      time_edit_states += TIMEIT_VALUE(states_add) - time_state_start;
+    }
+
+    for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+      size_expanded += lib_array_store_state_size_get(states[state_index][i]);
+    }
+    if (state_index == 0) {
+      for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+        size_first += lib_array_store_calc_size_compacted_get(stores[i]);
+      }
+    }
+  }
+
+  TIMEIT_END(states_add);
+
+  size_t size_compacted = 0;
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    size_compacted += lib_array_store_calc_size_compacted_get(stores[i]);
+  }
+
+  printf("Time per state: %.3f ms\n", (time_edit_states * 1000.0f) / (STATES_NUM - 1));
+  printf("Bytes per state: %zu (%zu expanded)\n",
+         (size_compacted - size_first) / (STATES_NUM - 1),
+         size_expanded / STATES_NUM);
+
+  /* The last state holds the current data. */
+  for (int i = 0; i < PERF_LAYERS_NUM; i++) {
+    size_t data_len;
+    void *data = lib_array_store_state_data_get_alloc(states[STATES_NUM - 1][i], &data_len);
+    EXPECT_EQ(data_len, mesh.verts_num * perf_layers[i].elem_per_vert * perf_layers[i].stride);
+    EXPECT_EQ(memcmp(data, mesh.layers[i], data_len), 0);
+    mem_free(data);
+
+    EXPECT_TRUE(lib_array_store_is_valid(stores[i]));
+    lib_array_store_destroy(stores[i]);
+  }
+
+  perf_mesh_free(&mesh);
+  lib_rng_free(rng);
+}
+
+static void array_store_perf_test(const int edit_type,
+                                  const uint verts_num,
+                                  const uint edits_per_state)
+{
+  array_store_perf_run(edit_type, STORE_FIXED, verts_num, edits_per_state);
+  array_store_perf_run(edit_type, STORE_CDC, verts_num, edits_per_state);
+  array_store_perf_run(edit_type, STORE_CDC_BATCH, verts_num, edits_per_state);
+}
+
+#define ARRAY_STORE_PERF_TESTS(_name, _edit_type) \
+  TEST(array_store, _name##100K) \
+  { \
+    array_store_perf_test(_edit_type, 100000, 1); \
+  } \
+  TEST(array_store, _name##100KScattered) \
+  { \
+    array_store_perf_test(_edit_type, 100000, 32); \
+  } \
+  TEST(array_store, _name##1M) \
+  { \
+    array_store_perf_test(_edit_type, 1000000, 1); \
+  } \
+  TEST(array_store, _name##1MScattered) \
+  { \
+    array_store_perf_test(_edit_type, 1000000, 32); \
+  }
+
+ARRAY_STORE_PERF_TESTS(PerfTranslate, EDIT_TRANSLATE)
+ARRAY_STORE_PERF_TESTS(PerfInsert, EDIT_INSERT)
+ARRAY_STORE_PERF_TESTS(PerfRemove, EDIT_REMOVE)
@@ -0,0 +1,138 @@
+#include "testing/testing.h"
+
+#include <string>
+
+#include "mem_guardedalloc.h"
+
+#include "lib_fileops.h"
+#include "lib_fileops_ex.h"
+#include "lib_filereader.h"
+#include "lib_filereader_ex.h"
+#include "lib_rand.h"
+#include "lib_utildefines.h"
+
+/* Round-trips data through #lib_file_zstd_seekable_from_mem_at_pos & the zstd reader, reading
+ * sequentially and at random positions across frame boundaries, with & without reading ahead.
+ * More frames than #ZSTD_SEEKABLE_GROUP_FRAMES, so frames are compressed in several groups. */
+
+#define DATA_LEN ((4 << 20) + 1234)
+#define FRAME_SIZE (64 << 10)
+#define SEEKS_NUM 500
+
+class ZstdSeekableTest : public testing::Test {
+ public:
+  std::string filepath;
+  char *data;
+  void *file_data;
+  size_t file_len;
+
+  void SetUp() override
+  {
+    filepath = std::string(testing::TempDir()) + "lib_fileops_zstd_test.zst";
+
+    /* Compressible: runs of random bytes. */
+    RNG *rng = lib_rng_new(0);
+    data = (char *)mem_malloc(DATA_LEN, __func__);
+    for (int i = 0; i < DATA_LEN;) {
+      const int run = min_ii(1 + int(lib_rng_get_uint(rng) % 64), DATA_LEN - i);
+      memset(data + i, int(lib_rng_get_uint(rng) & 0xff), size_t(run));
+      i += run;
+    }
+    lib_rng_free(rng);
+
+    FILE *file = lib_fopen(filepath.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    const size_t written = lib_file_zstd_seekable_from_mem_at_pos(
+        data, DATA_LEN, file, 0, 3, FRAME_SIZE);
+    fclose(file);
+    EXPECT_GT(written, 0);
+
+    file_data = lib_file_read_binary_as_mem(filepath.c_str(), 0, &file_len);
+    ASSERT_NE(file_data, nullptr);
+    EXPECT_EQ(file_len, written);
+  }
+
+  void TearDown() override
+  {
+    MEM_SAFE_FREE(file_data);
+    MEM_SAFE_FREE(data);
+    lib_delete(filepath.c_str(), false, false);
+  }
+
+  FileReader *reader_new(const int read_ahead_frames)
+  {
+    return lib_filereader_new_zstd_ex(lib_filereader_new_mem(file_data, file_len),
+                                      read_ahead_frames);
+  }
+
+  void test_sequential(const int read_ahead_frames, const size_t chunk)
+  {
+    FileReader *reader = reader_new(read_ahead_frames);
+    ASSERT_NE(reader, nullptr);
+    ASSERT_NE(reader->seek, nullptr);
+
+    char *buf = (char *)mem_malloc(chunk, __func__);
+    size_t offset = 0;
+    while (offset < DATA_LEN) {
+      const int64_t len = reader->read(reader, buf, chunk);
+      ASSERT_EQ(len, int64_t(min_zz(chunk, DATA_LEN - offset)));
+      ASSERT_EQ(memcmp(buf, data + offset, size_t(len)), 0) << "at " << offset;
+      offset += size_t(len);
+    }
+    EXPECT_EQ(reader->read(reader, buf, chunk), 0);
+
+    mem_free(buf);
+    reader->close(reader);
+  }
+
+  void test_seek(const int read_ahead_frames)
+  {
+    FileReader *reader = reader_new(read_ahead_frames);
+    ASSERT_NE(reader, nullptr);
+
+    const size_t frames_num = (DATA_LEN + FRAME_SIZE - 1) / FRAME_SIZE;
+    char *buf = (char *)mem_malloc(FRAME_SIZE * 3, __func__);
+    RNG *rng = lib_rng_new(read_ahead_frames);
+    for (int i = 0; i < SEEKS_NUM; i++) {
+      /* Just before a frame boundary, reading into the next frames. */
+      const size_t frame = lib_rng_get_uint(rng) % frames_num;
+      const size_t back = lib_rng_get_uint(rng) % 64;
+      const size_t offset = (frame * FRAME_SIZE > back) ? frame * FRAME_SIZE - back : 0;
+      const size_t len = min_zz(1 + lib_rng_get_uint(rng) % (FRAME_SIZE * 3), DATA_LEN - offset);
+
+      ASSERT_EQ(reader->seek(reader, off64_t(offset), SEEK_SET), off64_t(offset));
+      ASSERT_EQ(reader->read(reader, buf, len), int64_t(len));
+      ASSERT_EQ(memcmp(buf, data + offset, len), 0) << "at " << offset << ", " << len;
+    }
+    lib_rng_free(rng);
+
+    EXPECT_EQ(reader->seek(reader, -10, SEEK_END), off64_t(DATA_LEN - 10));
+    EXPECT_EQ(reader->read(reader, buf, 100), 10);
+    EXPECT_EQ(memcmp(buf, data + DATA_LEN - 10, 10), 0);
+
+    mem_free(buf);
+    reader->close(reader);
+  }
+};
+
+TEST_F(ZstdSeekableTest, read)
+{
+  test_sequential(0, 1000);
+  test_sequential(0, FRAME_SIZE * 5 / 2);
+}
+
+TEST_F(ZstdSeekableTest, read_ahead)
+{
+  test_sequential(8, 1000);
+  test_sequential(16, FRAME_SIZE * 5 / 2);
+}
+
+TEST_F(ZstdSeekableTest, seek)
+{
+  test_seek(0);
+}
+
+TEST_F(ZstdSeekableTest, seek_read_ahead)
+{
+  test_seek(8);
+}
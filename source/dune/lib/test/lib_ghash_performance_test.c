@@ -0,0 +1,225 @@
+#include "testing/testing.h"
+
+#define GHASH_INTERNAL_API
+
+#include "mem_guardedalloc.h"
+
+#include "lib_ghash.h"
+#include "lib_rand.h"
+#include "lib_time_utildefines.h"
+#include "lib_utildefines.h"
+
+/* Compares the chained buckets of GHash with its open addressing index
+ * (#GHASH_FLAG_OPEN_ADDRESSING), on pointer, string and integer keys.
+ *
+ * Only sizes up to 1M are run by default, define GHASH_RUN_BIG to also run 10M. */
+
+// #define GHASH_RUN_BIG
+
+#define PRINTF_GHASH_STATS(_gh) \
+  { \
+    double q, lf, var, pempty, poverloaded; \
+    int bigb; \
+    q = lib_ghash_calc_quality_ex((_gh), &lf, &var, &pempty, &poverloaded, &bigb); \
+    printf( \
+        "GHash stats (%u entries):\n\t" \
+        "Quality (the lower the better): %f\n\tVariance (the lower the better): %f\n\tLoad: " \
+        "%f\n\t" \
+        "Empty buckets: %.2f%%\n\tOverloaded buckets: %.2f%% (biggest bucket: %d)\n", \
+        lib_ghash_len(_gh), \
+        q, \
+        var, \
+        lf, \
+        pempty * 100.0, \
+        poverloaded * 100.0, \
+        bigb); \
+  } \
+  void(0)
+
+enum {
+  KEYS_PTR = 0,
+  KEYS_STR,
+  KEYS_INT,
+};
+
+static const char *keys_type_name[] = {"pointer", "string", "int"};
+
+struct GHashPerfKeys {
+  void **keys;
+  /* Storage the pointer and string keys point into. */
+  char *str_buf;
+};
+
+/* Keys in random order, unique for each type. */
+static void ghash_perf_keys_init(GHashPerfKeys *perf_keys, const int keys_type, const uint nbr)
+{
+  RNG *rng = lib_rng_new(0);
+  uint i;
+
+  perf_keys->keys = (void **)mem_malloc(sizeof(*perf_keys->keys) * nbr, __func__);
+  perf_keys->str_buf = nullptr;
+
+  switch (keys_type) {
+    case KEYS_PTR: {
+      /* Addresses of the elements of an array, like most pointer keys. */
+      perf_keys->str_buf = (char *)mem_malloc(sizeof(void *) * nbr, __func__);
+      for (i = 0; i < nbr; i++) {
+        perf_keys->keys[i] = perf_keys->str_buf + sizeof(void *) * i;
+      }
+      break;
+    }
+    case KEYS_STR: {
+      const size_t str_len = 16;
+      perf_keys->str_buf = (char *)mem_malloc(str_len * nbr, __func__);
+      for (i = 0; i < nbr; i++) {
+        char *str = perf_keys->str_buf + str_len * i;
+        snprintf(str, str_len, "key_%u", i);
+        perf_keys->keys[i] = str;
+      }
+      break;
+    }
+    case KEYS_INT: {
+      for (i = 0; i < nbr; i++) {
+        perf_keys->keys[i] = POINTER_FROM_UINT(i * 7919u + 1);
+      }
+      break;
+    }
+  }
+
+  lib_rng_shuffle_array(rng, perf_keys->keys, (uint)sizeof(*perf_keys->keys), nbr);
+  lib_rng_free(rng);
+}
+
+static void ghash_perf_keys_free(GHashPerfKeys *perf_keys)
+{
+  mem_free(perf_keys->keys);
+  MEM_SAFE_FREE(perf_keys->str_buf);
+}
+
+static GHash *ghash_perf_new(const int keys_type, const uint flag)
+{
+  GHash *ghash;
+  switch (keys_type) {
+    case KEYS_PTR:
+      ghash = lib_ghash_new(lib_ghashutil_ptrhash, lib_ghashutil_ptrcmp, __func__);
+      break;
+    case KEYS_STR:
+      ghash = lib_ghash_new(lib_ghashutil_strhash_p, lib_ghashutil_strcmp, __func__);
+      break;
+    default:
+      ghash = lib_ghash_new(lib_ghashutil_inthash_p, lib_ghashutil_intcmp, __func__);
+      break;
+  }
+  lib_ghash_flag_set(ghash, flag);
+  return ghash;
+}
+
+static void ghash_perf_run(const GHashPerfKeys *perf_keys,
+                           const int keys_type,
+                           const uint nbr,
+                           const uint flag)
+{
+  GHash *ghash = ghash_perf_new(keys_type, flag);
+  void **keys = perf_keys->keys;
+  uint i;
+
+  printf("\n========== %s keys, %u entries, %s ==========\n",
+         keys_type_name[keys_type],
+         nbr,
+         (flag & GHASH_FLAG_OPEN_ADDRESSING) ? "open addressing" : "chained");
+
+  {
+    TIMEIT_START(insert);
+
+    for (i = 0; i < nbr; i++) {
+      lib_ghash_insert(ghash, keys[i], POINTER_FROM_UINT(i));
+    }
+
+    TIMEIT_END(insert);
+  }
+
+  PRINTF_GHASH_STATS(ghash);
+
+  {
+    TIMEIT_START(lookup);
+
+    for (i = 0; i < nbr; i++) {
+      void *v = lib_ghash_lookup(ghash, keys[i]);
+      EXPECT_EQ(POINTER_AS_UINT(v), i);
+    }
+
+    TIMEIT_END(lookup);
+  }
+
+  {
+    /* Keys that are not in the GHash, skipping the first character of string keys. */
+    TIMEIT_START(lookup_missing);
+
+    uint found = 0;
+    for (i = 0; i < nbr; i++) {
+      const void *key = (keys_type == KEYS_STR) ? (const void *)((const char *)keys[i] + 1) :
+                                                  POINTER_OFFSET(keys[i], 2);
+      found += lib_ghash_haskey(ghash, key);
+    }
+    EXPECT_EQ(found, 0);
+
+    TIMEIT_END(lookup_missing);
+  }
+
+  {
+    TIMEIT_START(remove);
+
+    for (i = 0; i < nbr; i++) {
+      EXPECT_TRUE(lib_ghash_remove(ghash, keys[i], nullptr, nullptr));
+    }
+
+    TIMEIT_END(remove);
+  }
+
+  EXPECT_EQ(lib_ghash_len(ghash), 0);
+  lib_ghash_free(ghash, nullptr, nullptr);
+}
+
+static void ghash_perf_test(const int keys_type, const uint nbr)
+{
+  GHashPerfKeys perf_keys;
+  ghash_perf_keys_init(&perf_keys, keys_type, nbr);
+
+  ghash_perf_run(&perf_keys, keys_type, nbr, 0);
+  ghash_perf_run(&perf_keys, keys_type, nbr, GHASH_FLAG_OPEN_ADDRESSING);
+
+  ghash_perf_keys_free(&perf_keys);
+}
+
+#define GHASH_PERF_TESTS(_name, _keys_type) \
+  TEST(ghash, _name##1K) \
+  { \
+    ghash_perf_test(_keys_type, 1000); \
+  } \
+  TEST(ghash, _name##10K) \
+  { \
+    ghash_perf_test(_keys_type, 10000); \
+  } \
+  TEST(ghash, _name##100K) \
+  { \
+    ghash_perf_test(_keys_type, 100000); \
+  } \
+  TEST(ghash, _name##1M) \
+  { \
+    ghash_perf_test(_keys_type, 1000000); \
+  } \
+  GHASH_PERF_TEST_BIG(_name, _keys_type)
+
+#ifdef GHASH_RUN_BIG
+#  define GHASH_PERF_TEST_BIG(_name, _keys_type) \
+    TEST(ghash, _name##10M) \
+    { \
+      ghash_perf_test(_keys_type, 10000000); \
+    }
+#else
+#  define GHASH_PERF_TEST_BIG(_name, _keys_type)
+#endif
+
+GHASH_PERF_TESTS(PerfPtr, KEYS_PTR)
+GHASH_PERF_TESTS(PerfStr, KEYS_STR)
+GHASH_PERF_TESTS(PerfInt, KEYS_INT)
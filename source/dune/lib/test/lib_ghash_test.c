@@ -205,3 +205,147 @@ TEST(ghash, Pop)
 
   LIB_ghash_free(ghash, nullptr, nullptr);
 }
+
+/* Same as above, with the open addressing index. */
+TEST(ghash, OpenAddressingInsertLookup)
+{
+  GHash *ghash = lib_ghash_new(lib_ghashutil_inthash_p, lib_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  lib_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+  init_keys(keys, 40);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    lib_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  EXPECT_EQ(lib_ghash_len(ghash), TESTCASE_SIZE);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = lib_ghash_lookup(ghash, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+
+  lib_ghash_free(ghash, nullptr, nullptr);
+}
+
+/* Remove half of the keys, the other half must still be found past the tombstones. */
+TEST(ghash, OpenAddressingInsertRemoveShrink)
+{
+  GHash *ghash = lib_ghash_new(lib_ghashutil_inthash_p, lib_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  lib_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING | GHASH_FLAG_ALLOW_SHRINK);
+  init_keys(keys, 50);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    lib_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    if (i % 2) {
+      void *v = lib_ghash_popkey(ghash, POINTER_FROM_UINT(*k), nullptr);
+      EXPECT_EQ(POINTER_AS_UINT(v), *k);
+    }
+  }
+
+  EXPECT_EQ(lib_ghash_len(ghash), TESTCASE_SIZE / 2);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = lib_ghash_lookup(ghash, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), (i % 2) ? 0 : *k);
+  }
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    if ((i % 2) == 0) {
+      EXPECT_TRUE(lib_ghash_remove(ghash, POINTER_FROM_UINT(*k), nullptr, nullptr));
+    }
+  }
+
+  EXPECT_EQ(lib_ghash_len(ghash), 0);
+  EXPECT_LT(lib_ghash_buckets_len(ghash), TESTCASE_SIZE / 8);
+
+  lib_ghash_free(ghash, nullptr, nullptr);
+}
+
+/* Check copy and pop with the open addressing index. */
+TEST(ghash, OpenAddressingCopyPop)
+{
+  GHash *ghash = lib_ghash_new(lib_ghashutil_inthash_p, lib_ghashutil_intcmp, __func__);
+  GHash *ghash_copy;
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  lib_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+  init_keys(keys, 60);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    lib_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  ghash_copy = lib_ghash_copy(ghash, nullptr, nullptr);
+
+  EXPECT_EQ(lib_ghash_len(ghash_copy), TESTCASE_SIZE);
+  EXPECT_EQ(lib_ghash_buckets_len(ghash_copy), lib_ghash_buckets_len(ghash));
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = lib_ghash_lookup(ghash_copy, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+
+  GHashIterState pop_state = {0};
+  {
+    void *k, *v;
+    i = 0;
+    while (lib_ghash_pop(ghash_copy, &pop_state, &k, &v)) {
+      EXPECT_EQ(k, v);
+      i++;
+    }
+  }
+  EXPECT_EQ(i, TESTCASE_SIZE);
+  EXPECT_EQ(lib_ghash_len(ghash_copy), 0);
+
+  lib_ghash_free(ghash, nullptr, nullptr);
+  lib_ghash_free(ghash_copy, nullptr, nullptr);
+}
+
+/* Switch the index of a filled GHash back and forth, pointers to values must remain valid. */
+TEST(ghash, OpenAddressingToggle)
+{
+  GHash *ghash = lib_ghash_new(lib_ghashutil_inthash_p, lib_ghashutil_intcmp, __func__);
+  unsigned int keys[TESTCASE_SIZE], *k;
+  int i;
+
+  init_keys(keys, 70);
+
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    lib_ghash_insert(ghash, POINTER_FROM_UINT(*k), POINTER_FROM_UINT(*k));
+  }
+
+  void **val_p = lib_ghash_lookup_p(ghash, POINTER_FROM_UINT(keys[0]));
+
+  lib_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+  EXPECT_EQ(lib_ghash_len(ghash), TESTCASE_SIZE);
+  EXPECT_EQ(lib_ghash_lookup_p(ghash, POINTER_FROM_UINT(keys[0])), val_p);
+
+  {
+    GHashIterator gh_iter;
+    i = 0;
+    GHASH_ITER (gh_iter, ghash) {
+      EXPECT_EQ(lib_ghashIterator_getKey(&gh_iter), lib_ghashIterator_getValue(&gh_iter));
+      i++;
+    }
+    EXPECT_EQ(i, TESTCASE_SIZE);
+  }
+
+  lib_ghash_flag_clear(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+  for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+    void *v = lib_ghash_lookup(ghash, POINTER_FROM_UINT(*k));
+    EXPECT_EQ(POINTER_AS_UINT(v), *k);
+  }
+  EXPECT_EQ(lib_ghash_lookup_p(ghash, POINTER_FROM_UINT(keys[0])), val_p);
+
+  lib_ghash_free(ghash, nullptr, nullptr);
+}
@@ -0,0 +1,269 @@
+#include "testing/testing.h"
+
+#include "mem_guardedalloc.h"
+
+#include "lib_kdopbvh.h"
+#include "lib_kdopbvh_ex.h"
+#include "lib_math_vector.h"
+#include "lib_rand.h"
+#include "lib_utildefines.h"
+
+/* Compares nearest queries & ray-casts with a brute-force search, for trees built at the median
+ * and with the SAH (#BVH_BUILD_SAH), with & without a wide copy (#BVH_BUILD_WIDE), of different
+ * tree types & k-DOP's.
+ * Not 18-DOP's, which lack the X, Y & Z axes these queries use.
+ * Batched queries are compared with the same brute-force search, for all & every other query. */
+
+#define POINTS_NUM 2000
+#define QUERIES_NUM 500
+/* Points are spheres of this radius when ray-casting. */
+#define POINT_RADIUS 0.01f
+
+/* Clustered points, half of them in a small box (SAH splits differ from the median there). */
+static void points_init(RNG *rng, float (*points)[3], const int points_num)
+{
+  for (int i = 0; i < points_num; i++) {
+    const float scale = (i % 2) ? 0.1f : 1.0f;
+    for (int j = 0; j < 3; j++) {
+      points[i][j] = (lib_rng_get_float(rng) - 0.5f) * scale;
+    }
+  }
+}
+
+static BVHTree *points_tree_new(const float (*points)[3],
+                                const int points_num,
+                                const char tree_type,
+                                const char axis,
+                                const int flag)
+{
+  BVHTree *tree = lib_bvhtree_new_ex(points_num, 0.0f, tree_type, axis, flag);
+  for (int i = 0; i < points_num; i++) {
+    const float radius[3] = {POINT_RADIUS, POINT_RADIUS, POINT_RADIUS};
+    float bounds[2][3];
+    sub_v3_v3v3(bounds[0], points[i], radius);
+    add_v3_v3v3(bounds[1], points[i], radius);
+    lib_bvhtree_insert(tree, i, bounds[0], 2);
+  }
+  lib_bvhtree_balance(tree);
+  return tree;
+}
+
+static void nearest_point_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+  const float(*points)[3] = (const float(*)[3])userdata;
+  const float dist_sq = len_squared_v3v3(co, points[index]);
+  if (dist_sq < nearest->dist_sq) {
+    nearest->index = index;
+    nearest->dist_sq = dist_sq;
+    copy_v3_v3(nearest->co, points[index]);
+  }
+}
+
+/* Distance along the ray to the sphere of the point, -1 when missed. */
+static float raycast_point_dist(const float point[3], const BVHTreeRay *ray)
+{
+  float offset[3];
+  sub_v3_v3v3(offset, point, ray->origin);
+  const float dist_along = dot_v3v3(offset, ray->direction);
+  const float dist_sq = len_squared_v3(offset) - (dist_along * dist_along);
+  const float radius = POINT_RADIUS + ray->radius;
+  if (dist_sq > radius * radius) {
+    return -1.0f;
+  }
+  return dist_along - sqrtf((radius * radius) - dist_sq);
+}
+
+static void raycast_point_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+  const float(*points)[3] = (const float(*)[3])userdata;
+  const float dist = raycast_point_dist(points[index], ray);
+  if (dist >= 0.0f && dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+  }
+}
+
+static void bvhtree_queries_test(const char tree_type, const char axis, const int flag)
+{
+  RNG *rng = lib_rng_new(tree_type + axis + flag);
+  float(*points)[3] = (float(*)[3])mem_malloc(sizeof(*points) * POINTS_NUM, __func__);
+  points_init(rng, points, POINTS_NUM);
+
+  BVHTree *tree = points_tree_new(points, POINTS_NUM, tree_type, axis, flag);
+  EXPECT_EQ(lib_bvhtree_get_len(tree), POINTS_NUM);
+
+  float(*query_co)[3] = (float(*)[3])mem_malloc(sizeof(*query_co) * QUERIES_NUM, __func__);
+  float(*query_dir)[3] = (float(*)[3])mem_malloc(sizeof(*query_dir) * QUERIES_NUM, __func__);
+  float *dist_sq_expects = (float *)mem_malloc(sizeof(float) * QUERIES_NUM, __func__);
+  float *dist_expects = (float *)mem_malloc(sizeof(float) * QUERIES_NUM, __func__);
+
+  for (int i = 0; i < QUERIES_NUM; i++) {
+    float *co = query_co[i];
+    for (int j = 0; j < 3; j++) {
+      co[j] = lib_rng_get_float(rng) - 0.5f;
+    }
+
+    float dist_sq_expect = FLT_MAX;
+    for (int j = 0; j < POINTS_NUM; j++) {
+      dist_sq_expect = min_ff(dist_sq_expect, len_squared_v3v3(co, points[j]));
+    }
+    dist_sq_expects[i] = dist_sq_expect;
+
+    for (int optimal = 0; optimal < 2; optimal++) {
+      BVHTreeNearest nearest;
+      nearest.index = -1;
+      nearest.dist_sq = FLT_MAX;
+      lib_bvhtree_find_nearest_ex(tree,
+                                  co,
+                                  &nearest,
+                                  nearest_point_cb,
+                                  points,
+                                  optimal ? BVH_NEAREST_OPTIMAL_ORDER : 0);
+      EXPECT_NE(nearest.index, -1);
+      EXPECT_EQ(nearest.dist_sq, dist_sq_expect);
+    }
+
+    /* Rays towards a point, with & without a radius. */
+    float *dir = query_dir[i];
+    sub_v3_v3v3(dir, points[lib_rng_get_uint(rng) % POINTS_NUM], co);
+    normalize_v3(dir);
+
+    for (int use_radius = 0; use_radius < 2; use_radius++) {
+      BVHTreeRay ray;
+      copy_v3_v3(ray.origin, co);
+      copy_v3_v3(ray.direction, dir);
+      ray.radius = use_radius ? POINT_RADIUS : 0.0f;
+
+      float dist_expect = BVH_RAYCAST_DIST_MAX;
+      for (int j = 0; j < POINTS_NUM; j++) {
+        const float dist = raycast_point_dist(points[j], &ray);
+        if (dist >= 0.0f) {
+          dist_expect = min_ff(dist_expect, dist);
+        }
+      }
+
+      BVHTreeRayHit hit;
+      hit.index = -1;
+      hit.dist = BVH_RAYCAST_DIST_MAX;
+      lib_bvhtree_ray_cast_ex(
+          tree, co, dir, ray.radius, &hit, raycast_point_cb, points, BVH_RAYCAST_DEFAULT);
+      EXPECT_EQ(hit.dist, dist_expect);
+      if (!use_radius) {
+        dist_expects[i] = dist_expect;
+      }
+    }
+  }
+
+  /* Batches of all queries & every other query. */
+  int mask[QUERIES_NUM / 2];
+  for (int i = 0; i < QUERIES_NUM / 2; i++) {
+    mask[i] = i * 2;
+  }
+  BVHTreeNearest *nearests = (BVHTreeNearest *)mem_malloc(sizeof(*nearests) * QUERIES_NUM,
+                                                          __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)mem_malloc(sizeof(*hits) * QUERIES_NUM, __func__);
+
+  for (int use_mask = 0; use_mask < 2; use_mask++) {
+    const int *batch_mask = use_mask ? mask : nullptr;
+    const int batch_num = use_mask ? QUERIES_NUM / 2 : QUERIES_NUM;
+    for (int i = 0; i < QUERIES_NUM; i++) {
+      nearests[i].index = -1;
+      nearests[i].dist_sq = FLT_MAX;
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+    }
+
+    lib_bvhtree_find_nearest_batch(
+        tree, query_co, batch_mask, batch_num, nearests, nearest_point_cb, points, 0);
+    lib_bvhtree_ray_cast_batch(tree,
+                               query_co,
+                               query_dir,
+                               batch_mask,
+                               batch_num,
+                               0.0f,
+                               hits,
+                               raycast_point_cb,
+                               points,
+                               BVH_RAYCAST_DEFAULT);
+
+    for (int i = 0; i < QUERIES_NUM; i++) {
+      if (use_mask && (i % 2)) {
+        EXPECT_EQ(nearests[i].index, -1);
+        EXPECT_EQ(hits[i].index, -1);
+        continue;
+      }
+      EXPECT_NE(nearests[i].index, -1);
+      EXPECT_EQ(nearests[i].dist_sq, dist_sq_expects[i]);
+      EXPECT_EQ(hits[i].dist, dist_expects[i]);
+    }
+  }
+
+  mem_free(nearests);
+  mem_free(hits);
+  mem_free(query_co);
+  mem_free(query_dir);
+  mem_free(dist_sq_expects);
+  mem_free(dist_expects);
+  lib_bvhtree_free(tree);
+  mem_free(points);
+  lib_rng_free(rng);
+}
+
+/* Every combination of build options. */
+static const int build_flags[] = {
+    0, BVH_BUILD_SAH, BVH_BUILD_WIDE, BVH_BUILD_SAH | BVH_BUILD_WIDE};
+
+TEST(kdopbvh, Empty)
+{
+  const float co[3] = {0.0f, 0.0f, 0.0f};
+  for (const int flag : build_flags) {
+    BVHTree *tree = lib_bvhtree_new_ex(0, 0.0f, 4, 6, flag);
+    lib_bvhtree_balance(tree);
+    EXPECT_EQ(lib_bvhtree_get_len(tree), 0);
+    EXPECT_EQ(lib_bvhtree_find_nearest(tree, co, nullptr, nullptr, nullptr), -1);
+    lib_bvhtree_free(tree);
+  }
+}
+
+TEST(kdopbvh, Single)
+{
+  const float co[3] = {1.0f, 2.0f, 3.0f};
+  for (const int flag : build_flags) {
+    BVHTree *tree = lib_bvhtree_new_ex(1, 0.0f, 2, 6, flag);
+    lib_bvhtree_insert(tree, 7, co, 1);
+    lib_bvhtree_balance(tree);
+
+    BVHTreeNearest nearest;
+    nearest.index = -1;
+    nearest.dist_sq = FLT_MAX;
+    EXPECT_EQ(lib_bvhtree_find_nearest(tree, co, &nearest, nullptr, nullptr), 7);
+    lib_bvhtree_free(tree);
+  }
+}
+
+#define BVHTREE_QUERIES_TESTS(_name, _flag) \
+  TEST(kdopbvh, _name##Binary) \
+  { \
+    bvhtree_queries_test(2, 6, _flag); \
+  } \
+  TEST(kdopbvh, _name##Quad) \
+  { \
+    bvhtree_queries_test(4, 6, _flag); \
+  } \
+  TEST(kdopbvh, _name##Oct) \
+  { \
+    bvhtree_queries_test(8, 6, _flag); \
+  } \
+  TEST(kdopbvh, _name##Quad26DOP) \
+  { \
+    bvhtree_queries_test(4, 26, _flag); \
+  } \
+  TEST(kdopbvh, _name##Quad14DOP) \
+  { \
+    bvhtree_queries_test(4, 14, _flag); \
+  }
+
+BVHTREE_QUERIES_TESTS(Median, 0)
+BVHTREE_QUERIES_TESTS(SAH, BVH_BUILD_SAH)
+BVHTREE_QUERIES_TESTS(MedianWide, BVH_BUILD_WIDE)
+BVHTREE_QUERIES_TESTS(SAHWide, BVH_BUILD_SAH | BVH_BUILD_WIDE)
@@ -0,0 +1,158 @@
+#include "testing/testing.h"
+
+#include "mem_guardedalloc.h"
+
+#include "lib_kdtree.h"
+#include "lib_kdtree_ex.h"
+#include "lib_math_vector.h"
+#include "lib_rand.h"
+#include "lib_utildefines.h"
+
+/* Compares batched nearest queries with per-point ones, and trees balanced with threads with
+ * trees balanced on one thread. Trees & batches below and above the sizes these use threads at,
+ * with duplicate points (whose order among equally near points depends on the tree). */
+
+#define NEAREST_LEN 8
+/* Above the nodes of a tree (32K) & queries of a batch (1K) using threads. */
+#define POINTS_NUM_LARGE 100000
+#define QUERIES_NUM_LARGE 5000
+
+/* Random points in a unit cube, every fourth one a duplicate of a previous point. */
+static void points_init(RNG *rng, float (*points)[3], const int points_num)
+{
+  for (int i = 0; i < points_num; i++) {
+    if (i % 4 == 3) {
+      copy_v3_v3(points[i], points[lib_rng_get_uint(rng) % uint(i)]);
+    }
+    else {
+      for (int j = 0; j < 3; j++) {
+        points[i][j] = lib_rng_get_float(rng);
+      }
+    }
+  }
+}
+
+static KDTree_3d *points_tree_new(const float (*points)[3],
+                                  const int points_num,
+                                  const bool use_threading)
+{
+  KDTree_3d *tree = lib_kdtree_3d_new(uint(points_num));
+  for (int i = 0; i < points_num; i++) {
+    lib_kdtree_3d_insert(tree, i, points[i]);
+  }
+  lib_kdtree_3d_balance_ex(tree, use_threading);
+  return tree;
+}
+
+/* Queries at random positions and on points (on the splitting planes of their nodes). */
+static float (*queries_new(RNG *rng, const float (*points)[3], int points_num, int queries_num))[3]
+{
+  float(*queries)[3] = (float(*)[3])mem_malloc(sizeof(*queries) * size_t(queries_num), __func__);
+  for (int i = 0; i < queries_num; i++) {
+    if (i % 2) {
+      copy_v3_v3(queries[i], points[lib_rng_get_uint(rng) % uint(points_num)]);
+    }
+    else {
+      for (int j = 0; j < 3; j++) {
+        queries[i][j] = lib_rng_get_float(rng) * 1.2f - 0.1f;
+      }
+    }
+  }
+  return queries;
+}
+
+static void expect_nearest_eq(const KDTreeNearest_3d *a,
+                              const KDTreeNearest_3d *b,
+                              const int nearest_len)
+{
+  for (int i = 0; i < nearest_len; i++) {
+    EXPECT_EQ(a[i].index, b[i].index);
+    EXPECT_EQ(a[i].dist, b[i].dist);
+    EXPECT_V3_NEAR(a[i].co, b[i].co, 0.0f);
+  }
+}
+
+static void test_find_nearest_n_batch(const int points_num, const int queries_num)
+{
+  RNG *rng = lib_rng_new(uint(points_num + queries_num));
+  float(*points)[3] = (float(*)[3])mem_malloc(sizeof(*points) * size_t(points_num), __func__);
+  points_init(rng, points, points_num);
+  float(*queries)[3] = queries_new(rng, points, points_num, queries_num);
+  KDTree_3d *tree = points_tree_new(points, points_num, true);
+
+  KDTreeNearest_3d *nearest_batch = (KDTreeNearest_3d *)mem_malloc(
+      sizeof(*nearest_batch) * size_t(queries_num) * NEAREST_LEN, __func__);
+  int *nearest_len_batch = (int *)mem_malloc(sizeof(int) * size_t(queries_num), __func__);
+  lib_kdtree_3d_find_nearest_n_batch(
+      tree, queries, uint(queries_num), nearest_batch, NEAREST_LEN, nearest_len_batch);
+
+  for (int i = 0; i < queries_num; i++) {
+    KDTreeNearest_3d nearest[NEAREST_LEN];
+    const int nearest_len = lib_kdtree_3d_find_nearest_n(tree, queries[i], nearest, NEAREST_LEN);
+    EXPECT_EQ(nearest_len, min_ii(points_num, NEAREST_LEN));
+    ASSERT_EQ(nearest_len_batch[i], nearest_len);
+    expect_nearest_eq(&nearest_batch[i * NEAREST_LEN], nearest, nearest_len);
+  }
+
+  mem_free(nearest_len_batch);
+  mem_free(nearest_batch);
+  lib_kdtree_3d_free(tree);
+  mem_free(queries);
+  mem_free(points);
+  lib_rng_free(rng);
+}
+
+static void test_balance_threaded(const int points_num)
+{
+  const int queries_num = 1000;
+  RNG *rng = lib_rng_new(uint(points_num));
+  float(*points)[3] = (float(*)[3])mem_malloc(sizeof(*points) * size_t(points_num), __func__);
+  points_init(rng, points, points_num);
+  float(*queries)[3] = queries_new(rng, points, points_num, queries_num);
+  KDTree_3d *tree = points_tree_new(points, points_num, true);
+  KDTree_3d *tree_serial = points_tree_new(points, points_num, false);
+
+  /* The same trees find the same nearest, in the same order among equally near points. */
+  for (int i = 0; i < queries_num; i++) {
+    KDTreeNearest_3d nearest[NEAREST_LEN], nearest_serial[NEAREST_LEN];
+    const int nearest_len = lib_kdtree_3d_find_nearest_n(tree, queries[i], nearest, NEAREST_LEN);
+    ASSERT_EQ(lib_kdtree_3d_find_nearest_n(tree_serial, queries[i], nearest_serial, NEAREST_LEN),
+              nearest_len);
+    expect_nearest_eq(nearest, nearest_serial, nearest_len);
+
+    KDTreeNearest_3d *range = nullptr, *range_serial = nullptr;
+    const int range_len = lib_kdtree_3d_range_search(tree, queries[i], &range, 0.01f);
+    ASSERT_EQ(lib_kdtree_3d_range_search(tree_serial, queries[i], &range_serial, 0.01f),
+              range_len);
+    expect_nearest_eq(range, range_serial, range_len);
+    MEM_SAFE_FREE(range);
+    MEM_SAFE_FREE(range_serial);
+  }
+
+  lib_kdtree_3d_free(tree_serial);
+  lib_kdtree_3d_free(tree);
+  mem_free(queries);
+  mem_free(points);
+  lib_rng_free(rng);
+}
+
+TEST(kdtree, FindNearestNBatchSmall)
+{
+  test_find_nearest_n_batch(5, 10);
+  test_find_nearest_n_batch(1000, 100);
+}
+
+TEST(kdtree, FindNearestNBatchLarge)
+{
+  test_find_nearest_n_batch(POINTS_NUM_LARGE, QUERIES_NUM_LARGE);
+}
+
+TEST(kdtree, BalanceThreadedSmall)
+{
+  test_balance_threaded(1000);
+}
+
+TEST(kdtree, BalanceThreadedLarge)
+{
+  test_balance_threaded(POINTS_NUM_LARGE);
+}
@@ -0,0 +1,140 @@
+#include "testing/testing.h"
+
+#include "mem_guardedalloc.h"
+
+#include "lib_mempool.h"
+#include "lib_mempool_local.h"
+#include "lib_task.h"
+#include "lib_utildefines.h"
+
+/* Allocates & frees elements from the local storages of tasks (#lib_mempool_local_alloc), merging
+ * them with #lib_mempool_local_reduce & #lib_mempool_local_end, then checks the number of
+ * elements of the pool, and that iterating it visits exactly the elements still in use, before &
+ * after allocating from the pool again. */
+
+#define ITER_NUM 20000
+/* Elements allocated in the pool before the loop, every other one is freed by the tasks. */
+#define POOL_ELEMS_NUM 1000
+
+struct MempoolTestElem {
+  int index;
+};
+
+struct MempoolTestData {
+  MempoolTestElem **pool_elems;
+};
+
+/* Allocates 3 elements, frees the middle one & every other element allocated before the loop. */
+static void mempool_local_test_cb(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict tls)
+{
+  MempoolTestData *data = static_cast<MempoolTestData *>(userdata);
+  LibMempoolLocal *local = static_cast<LibMempoolLocal *>(tls->userdata_chunk);
+
+  MempoolTestElem *elems[3];
+  for (int j = 0; j < 3; j++) {
+    elems[j] = static_cast<MempoolTestElem *>(lib_mempool_local_alloc(local));
+    elems[j]->index = POOL_ELEMS_NUM + i * 3 + j;
+  }
+  lib_mempool_local_free(local, elems[1]);
+
+  if (i < POOL_ELEMS_NUM && (i % 2)) {
+    lib_mempool_local_free(local, data->pool_elems[i]);
+  }
+}
+
+static void mempool_local_test_reduce(const void *__restrict /*userdata*/,
+                                      void *__restrict chunk_join,
+                                      void *__restrict chunk)
+{
+  lib_mempool_local_reduce(static_cast<LibMempoolLocal *>(chunk_join),
+                           static_cast<LibMempoolLocal *>(chunk));
+}
+
+static bool mempool_test_is_used(const int index)
+{
+  if (index < POOL_ELEMS_NUM) {
+    return (index % 2) == 0;
+  }
+  if (index < POOL_ELEMS_NUM + ITER_NUM * 3) {
+    return ((index - POOL_ELEMS_NUM) % 3) != 1;
+  }
+  /* Allocated from the pool after the loop. */
+  return true;
+}
+
+static void expect_mempool_elems(LibMempool *pool, const int elems_num, const int expect_num)
+{
+  EXPECT_EQ(lib_mempool_len(pool), expect_num);
+
+  bool *is_visited = static_cast<bool *>(
+      mem_calloc(sizeof(bool) * size_t(elems_num), __func__));
+  int visited_num = 0;
+
+  lib_mempool_iter iter;
+  lib_mempool_iternew(pool, &iter);
+  MempoolTestElem *elem;
+  while ((elem = static_cast<MempoolTestElem *>(lib_mempool_iterstep(&iter)))) {
+    ASSERT_GE(elem->index, 0);
+    ASSERT_LT(elem->index, elems_num);
+    EXPECT_TRUE(mempool_test_is_used(elem->index)) << elem->index;
+    EXPECT_FALSE(is_visited[elem->index]) << elem->index;
+    is_visited[elem->index] = true;
+    visited_num++;
+  }
+  EXPECT_EQ(visited_num, expect_num);
+
+  mem_free(is_visited);
+}
+
+static void test_mempool_local(const bool use_threading)
+{
+  LibMempool *pool = lib_mempool_create(
+      sizeof(MempoolTestElem), 0, 256, LIB_MEMPOOL_ALLOW_ITER);
+
+  MempoolTestElem **pool_elems = static_cast<MempoolTestElem **>(
+      mem_malloc(sizeof(*pool_elems) * POOL_ELEMS_NUM, __func__));
+  for (int i = 0; i < POOL_ELEMS_NUM; i++) {
+    pool_elems[i] = static_cast<MempoolTestElem *>(lib_mempool_alloc(pool));
+    pool_elems[i]->index = i;
+  }
+
+  MempoolTestData data = {pool_elems};
+  LibMempoolLocal local;
+  lib_mempool_local_init(pool, &local);
+
+  TaskParallelSettings settings;
+  lib_parallel_range_settings_defaults(&settings);
+  settings.use_threading = use_threading;
+  settings.min_iter_per_thread = 64;
+  settings.userdata_chunk = &local;
+  settings.userdata_chunk_size = sizeof(local);
+  settings.func_reduce = mempool_local_test_reduce;
+  lib_task_parallel_range(0, ITER_NUM, &data, mempool_local_test_cb, &settings);
+  lib_mempool_local_end(&local);
+
+  const int elems_num = POOL_ELEMS_NUM + ITER_NUM * 3;
+  const int used_num = POOL_ELEMS_NUM / 2 + ITER_NUM * 2;
+  expect_mempool_elems(pool, elems_num, used_num);
+
+  /* The pool allocates from the merged free elements, none of which may be in use. */
+  for (int i = 0; i < ITER_NUM; i++) {
+    MempoolTestElem *elem = static_cast<MempoolTestElem *>(lib_mempool_alloc(pool));
+    elem->index = elems_num + i;
+  }
+  expect_mempool_elems(pool, elems_num + ITER_NUM, used_num + ITER_NUM);
+
+  mem_free(pool_elems);
+  lib_mempool_destroy(pool);
+}
+
+TEST(mempool, LocalAllocFree)
+{
+  test_mempool_local(false);
+}
+
+TEST(mempool, LocalAllocFreeThreaded)
+{
+  test_mempool_local(true);
+}
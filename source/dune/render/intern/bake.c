@@ -47,7 +47,9 @@
 
 #include "mem_guardedalloc.h"
 
+#include "lib_kdopbvh_ex.h"
 #include "lib_math.h"
+#include "lib_task.h"
 
 #include "types_mesh.h"
 #include "types_meshdata.h"
@@ -306,44 +308,389 @@ static void barycentric_differentials_from_position(const float co[3],
 }
 
 /**
- * This function populates pixel_array and returns TRUE if things are correct
+ * Fill the high-poly pixel `pixel_id` from the nearest `hit` of its ray (of direction `dir`, in
+ * world space) on the `hit_mesh` high-poly object.
  */
-static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
-                              TriTessFace *triangle_low,
-                              TriTessFace *triangles[],
-                              BakePixel *pixel_array_low,
-                              BakePixel *pixel_array,
-                              const float mat_low[4][4],
-                              BakeHighPolyData *highpoly,
-                              const float co[3],
-                              const float dir[3],
-                              const int pixel_id,
-                              const int tot_highpoly,
-                              const float max_ray_distance)
+static void bake_highpoly_pixel_from_hit(TriTessFace *triangle_low,
+                                         TriTessFace *triangles[],
+                                         BakePixel *pixel_array_low,
+                                         BakePixel *pixel_array,
+                                         const float mat_low[4][4],
+                                         BakeHighPolyData *highpoly,
+                                         const float dir[3],
+                                         const BVHTreeRayHit *hit,
+                                         const int hit_mesh,
+                                         const size_t pixel_id)
 {
-  int i;
-  int hit_mesh = -1;
-  float hit_distance = max_ray_distance;
-  if (hit_distance == 0.0f) {
-    /* No ray distance set, use maximum. */
-    hit_distance = FLT_MAX;
-  }
+  int primitive_id_high = hit->index;
+  TriTessFace *triangle_high = &triangles[hit_mesh][primitive_id_high];
+  BakePixel *pixel_low = &pixel_array_low[pixel_id];
+  BakePixel *pixel_high = &pixel_array[pixel_id];
+
+  pixel_high->primitive_id = primitive_id_high;
+  pixel_high->object_id = hit_mesh;
+  pixel_high->seed = pixel_id;
+
+  /* ray direction in high poly object space */
+  float dir_high[3];
+  mul_v3_mat3_m4v3(dir_high, highpoly[hit_mesh].imat, dir);
+  normalize_v3(dir_high);
+
+  /* compute position differentials on low poly object */
+  float duco_low[3], dvco_low[3], dxco[3], dyco[3];
+  sub_v3_v3v3(duco_low, triangle_low->mverts[0]->co, triangle_low->mverts[2]->co);
+  sub_v3_v3v3(dvco_low, triangle_low->mverts[1]->co, triangle_low->mverts[2]->co);
+
+  mul_v3_v3fl(dxco, duco_low, pixel_low->du_dx);
+  madd_v3_v3fl(dxco, dvco_low, pixel_low->dv_dx);
+  mul_v3_v3fl(dyco, duco_low, pixel_low->du_dy);
+  madd_v3_v3fl(dyco, dvco_low, pixel_low->dv_dy);
+
+  /* transform from low poly to high poly object space */
+  mul_mat3_m4_v3(mat_low, dxco);
+  mul_mat3_m4_v3(mat_low, dyco);
+  mul_mat3_m4_v3(highpoly[hit_mesh].imat, dxco);
+  mul_mat3_m4_v3(highpoly[hit_mesh].imat, dyco);
+
+  /* transfer position differentials */
+  float tmp[3];
+  mul_v3_v3fl(tmp, dir_high, 1.0f / dot_v3v3(dir_high, triangle_high->normal));
+  madd_v3_v3fl(dxco, tmp, -dot_v3v3(dxco, triangle_high->normal));
+  madd_v3_v3fl(dyco, tmp, -dot_v3v3(dyco, triangle_high->normal));
+
+  /* compute barycentric differentials from position differentials */
+  barycentric_differentials_from_position(hit->co,
+                                          triangle_high->mverts[0]->co,
+                                          triangle_high->mverts[1]->co,
+                                          triangle_high->mverts[2]->co,
+                                          dxco,
+                                          dyco,
+                                          triangle_high->normal,
+                                          true,
+                                          &pixel_high->uv[0],
+                                          &pixel_high->uv[1],
+                                          &pixel_high->du_dx,
+                                          &pixel_high->dv_dx,
+                                          &pixel_high->du_dy,
+                                          &pixel_high->dv_dy);
+
+  /* verify we have valid uvs */
+  lib_assert(pixel_high->uv[0] >= -1e-3f && pixel_high->uv[1] >= -1e-3f &&
+             pixel_high->uv[0] + pixel_high->uv[1] <= 1.0f + 1e-3f);
+}
+
+/* The rays of the low-poly pixels are cast in chunks of #BAKE_HIGHPOLY_CHUNK_SIZE pixels, one
+ * high-poly object after the other. Rays are set up & resolved in parallel, and cast as a batch
+ * (#lib_bvhtree_ray_cast_batch) which sorts them into coherent packets that traverse the tree
+ * together, on multiple threads. Objects are visited in order and the nearest hit is only
+ * replaced by a strictly nearer one, so pixels are the same as when casting one ray at a time.
+ */
+
+/* Pixels of a chunk, bounds the memory of the rays. */
+#define BAKE_HIGHPOLY_CHUNK_SIZE (1 << 18)
 
+typedef struct BakeHighPolyRays {
+  BakePixel *pixel_array_from;
+  BakePixel *pixel_array_to;
+  BakeHighPolyData *highpoly;
+  TriTessFace *tris_low;
+  TriTessFace *tris_cage;
+  TriTessFace **tris_high;
+  float (*mat_low)[4];
+  float (*mat_cage)[4];
+  float (*imat_low)[4];
+  bool is_cage;
+  bool is_custom_cage;
+  float cage_extrusion;
+  float max_ray_distance;
+
+  /* First pixel of the chunk, rays are indexed from it. */
+  size_t pixel_first;
+  /* Rays of the pixels of the chunk which are baked. */
+  int *mask;
+  int mask_num;
+
+  /* Rays in world space. */
+  float (*co)[3];
+  float (*dir)[3];
+
+  /* Rays in the space of the high-poly object being cast, and their hits. */
+  int highpoly_index;
+  float (*co_high)[3];
+  float (*dir_high)[3];
   BVHTreeRayHit *hits;
-  hits = mem_mallocn(sizeof(BVHTreeRayHit) * tot_highpoly, "Bake Highpoly to Lowpoly: BVH Rays");
 
-  for (i = 0; i < tot_highpoly; i++) {
+  /* Nearest hit of the rays, on the #BakeHighPolyRays.hit_mesh object (-1 for none). */
+  BVHTreeRayHit *hits_nearest;
+  int *hit_mesh;
+  float *hit_distance;
+} BakeHighPolyRays;
+
+static TriTessFace *bake_highpoly_rays_tri_low(const BakeHighPolyRays *rays,
+                                               const int primitive_id)
+{
+  return rays->is_cage ? &rays->tris_cage[primitive_id] : &rays->tris_low[primitive_id];
+}
+
+/**
+ * Compute the ray (in world space) of the low-poly `pixel`, from the cage when there is one.
+ */
+static void bake_highpoly_ray_from_pixel(const BakeHighPolyRays *rays,
+                                         const BakePixel *pixel,
+                                         float r_co[3],
+                                         float r_dir[3])
+{
+  const int primitive_id = pixel->primitive_id;
+  const float u = pixel->uv[0];
+  const float v = pixel->uv[1];
+
+  /* calculate from low poly mesh cage */
+  if (rays->is_custom_cage) {
+    calc_point_from_barycentric_cage(rays->tris_low,
+                                     rays->tris_cage,
+                                     rays->mat_low,
+                                     rays->mat_cage,
+                                     primitive_id,
+                                     u,
+                                     v,
+                                     r_co,
+                                     r_dir);
+  }
+  else {
+    calc_point_from_barycentric_extrusion(rays->is_cage ? rays->tris_cage : rays->tris_low,
+                                          rays->mat_low,
+                                          rays->imat_low,
+                                          primitive_id,
+                                          u,
+                                          v,
+                                          rays->cage_extrusion,
+                                          r_co,
+                                          r_dir,
+                                          rays->is_cage);
+  }
+}
+
+static void bake_highpoly_rays_init_cb(void *__restrict userdata,
+                                       const int iter,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BakeHighPolyRays *rays = userdata;
+  const int ray = rays->mask[iter];
+
+  bake_highpoly_ray_from_pixel(
+      rays, &rays->pixel_array_from[rays->pixel_first + ray], rays->co[ray], rays->dir[ray]);
+
+  rays->hit_mesh[ray] = -1;
+  /* No ray distance set, use maximum. */
+  rays->hit_distance[ray] = (rays->max_ray_distance == 0.0f) ? FLT_MAX : rays->max_ray_distance;
+}
+
+static void bake_highpoly_rays_transform_cb(void *__restrict userdata,
+                                            const int iter,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BakeHighPolyRays *rays = userdata;
+  const int ray = rays->mask[iter];
+  const BakeHighPolyData *highpoly = &rays->highpoly[rays->highpoly_index];
+  BVHTreeRayHit *hit = &rays->hits[ray];
+
+  hit->index = -1;
+  /* TODO: we should use FLT_MAX here, but sweep-sphere code isn't prepared for that. */
+  hit->dist = BVH_RAYCAST_DIST_MAX;
+
+  /* Transform the ray from the world space to the `highpoly` space. */
+  mul_v3_m4v3(rays->co_high[ray], highpoly->imat, rays->co[ray]);
+
+  /* rotates */
+  mul_v3_mat3_m4v3(rays->dir_high[ray], highpoly->imat, rays->dir[ray]);
+  normalize_v3(rays->dir_high[ray]);
+}
+
+static void bake_highpoly_rays_nearest_cb(void *__restrict userdata,
+                                          const int iter,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BakeHighPolyRays *rays = userdata;
+  const int ray = rays->mask[iter];
+  const BVHTreeRayHit *hit = &rays->hits[ray];
+
+  if (hit->index != -1) {
+    float distance;
+    float hit_world[3];
+
+    /* distance comparison in world space */
+    mul_v3_m4v3(hit_world, rays->highpoly[rays->highpoly_index].obmat, hit->co);
+    distance = len_squared_v3v3(hit_world, rays->co[ray]);
+
+    if (distance < rays->hit_distance[ray]) {
+      rays->hit_mesh[ray] = rays->highpoly_index;
+      rays->hit_distance[ray] = distance;
+      rays->hits_nearest[ray] = *hit;
+    }
+  }
+}
+
+static void bake_highpoly_rays_store_cb(void *__restrict userdata,
+                                        const int iter,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BakeHighPolyRays *rays = userdata;
+  const int ray = rays->mask[iter];
+  const size_t pixel_id = rays->pixel_first + ray;
+  const int hit_mesh = rays->hit_mesh[ray];
+
+  if (hit_mesh != -1) {
+    const int primitive_id = rays->pixel_array_from[pixel_id].primitive_id;
+    bake_highpoly_pixel_from_hit(bake_highpoly_rays_tri_low(rays, primitive_id),
+                                 rays->tris_high,
+                                 rays->pixel_array_from,
+                                 rays->pixel_array_to,
+                                 rays->mat_low,
+                                 rays->highpoly,
+                                 rays->dir[ray],
+                                 &rays->hits_nearest[ray],
+                                 hit_mesh,
+                                 pixel_id);
+  }
+  else {
+    rays->pixel_array_to[pixel_id].primitive_id = -1;
+    rays->pixel_array_to[pixel_id].object_id = -1;
+    rays->pixel_array_to[pixel_id].seed = 0;
+
+    /* if it fails mask out the original pixel array */
+    rays->pixel_array_from[pixel_id].primitive_id = -1;
+  }
+}
+
+static void bake_highpoly_rays_parallel(BakeHighPolyRays *rays, TaskParallelRangeFunc func)
+{
+  TaskParallelSettings settings;
+  lib_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+  lib_task_parallel_range(0, rays->mask_num, rays, func, &settings);
+}
+
+/**
+ * Cast the rays of the pixels from `pixel_first` to `pixel_last` (exclusive) on all the
+ * high-poly objects, and fill their high-poly pixels.
+ */
+static void bake_highpoly_rays_cast_chunk(BakeHighPolyRays *rays,
+                                          BVHTreeFromMesh *treeData,
+                                          const int tot_highpoly,
+                                          const size_t pixel_first,
+                                          const size_t pixel_last)
+{
+  rays->pixel_first = pixel_first;
+  rays->mask_num = 0;
+
+  for (size_t i = pixel_first; i < pixel_last; i++) {
+    if (rays->pixel_array_from[i].primitive_id == -1) {
+      rays->pixel_array_to[i].primitive_id = -1;
+      continue;
+    }
+    rays->mask[rays->mask_num++] = (int)(i - pixel_first);
+  }
+
+  if (rays->mask_num == 0) {
+    return;
+  }
+
+  bake_highpoly_rays_parallel(rays, bake_highpoly_rays_init_cb);
+
+  for (int i = 0; i < tot_highpoly; i++) {
+    if (treeData[i].tree == NULL) {
+      continue;
+    }
+
+    rays->highpoly_index = i;
+    bake_highpoly_rays_parallel(rays, bake_highpoly_rays_transform_cb);
+
+    /* cast rays */
+    lib_bvhtree_ray_cast_batch(treeData[i].tree,
+                               (const float(*)[3])rays->co_high,
+                               (const float(*)[3])rays->dir_high,
+                               rays->mask,
+                               rays->mask_num,
+                               0.0f,
+                               rays->hits,
+                               treeData[i].raycast_callback,
+                               &treeData[i],
+                               BVH_RAYCAST_DEFAULT);
+
+    bake_highpoly_rays_parallel(rays, bake_highpoly_rays_nearest_cb);
+  }
+
+  bake_highpoly_rays_parallel(rays, bake_highpoly_rays_store_cb);
+}
+
+/**
+ * Cast the rays of all `num_pixels` pixels on the high-poly objects, a chunk at a time.
+ */
+static void bake_highpoly_rays_cast(BakeHighPolyRays *rays,
+                                    BVHTreeFromMesh *treeData,
+                                    const int tot_highpoly,
+                                    const size_t num_pixels)
+{
+  const size_t chunk_size = min_zz(num_pixels, BAKE_HIGHPOLY_CHUNK_SIZE);
+  rays->mask = mem_mallocn(sizeof(*rays->mask) * chunk_size, "Bake Highpoly Rays Mask");
+  rays->co = mem_mallocn(sizeof(*rays->co) * chunk_size, "Bake Highpoly Rays Co");
+  rays->dir = mem_mallocn(sizeof(*rays->dir) * chunk_size, "Bake Highpoly Rays Dir");
+  rays->co_high = mem_mallocn(sizeof(*rays->co_high) * chunk_size, "Bake Highpoly Rays Co");
+  rays->dir_high = mem_mallocn(sizeof(*rays->dir_high) * chunk_size, "Bake Highpoly Rays Dir");
+  rays->hits = mem_mallocn(sizeof(*rays->hits) * chunk_size, "Bake Highpoly to Lowpoly: BVH Rays");
+  rays->hits_nearest = mem_mallocn(sizeof(*rays->hits_nearest) * chunk_size,
+                                   "Bake Highpoly to Lowpoly: Nearest Hits");
+  rays->hit_mesh = mem_mallocn(sizeof(*rays->hit_mesh) * chunk_size, "Bake Highpoly Hit Mesh");
+  rays->hit_distance = mem_mallocn(sizeof(*rays->hit_distance) * chunk_size,
+                                   "Bake Highpoly Hit Distance");
+
+  for (size_t i = 0; i < num_pixels; i += chunk_size) {
+    bake_highpoly_rays_cast_chunk(
+        rays, treeData, tot_highpoly, i, min_zz(i + chunk_size, num_pixels));
+  }
+
+  mem_freen(rays->mask);
+  mem_freen(rays->co);
+  mem_freen(rays->dir);
+  mem_freen(rays->co_high);
+  mem_freen(rays->dir_high);
+  mem_freen(rays->hits);
+  mem_freen(rays->hits_nearest);
+  mem_freen(rays->hit_mesh);
+  mem_freen(rays->hit_distance);
+}
+
+/**
+ * Cast the ray of pixel `pixel_id` on all the high-poly objects, one at a time, and fill its
+ * high-poly pixel from the nearest hit. Returns false when nothing was hit.
+ */
+static bool cast_ray_highpoly(BakeHighPolyRays *rays,
+                              BVHTreeFromMesh *treeData,
+                              const int tot_highpoly,
+                              const size_t pixel_id)
+{
+  float co[3], dir[3];
+  bake_highpoly_ray_from_pixel(rays, &rays->pixel_array_from[pixel_id], co, dir);
+
+  int hit_mesh = -1;
+  /* No ray distance set, use maximum. */
+  float hit_distance = (rays->max_ray_distance == 0.0f) ? FLT_MAX : rays->max_ray_distance;
+  BVHTreeRayHit hit_nearest;
+
+  for (int i = 0; i < tot_highpoly; i++) {
+    const BakeHighPolyData *highpoly = &rays->highpoly[i];
     float co_high[3], dir_high[3];
+    BVHTreeRayHit hit;
 
-    hits[i].index = -1;
+    hit.index = -1;
     /* TODO: we should use FLT_MAX here, but sweep-sphere code isn't prepared for that. */
-    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
 
     /* Transform the ray from the world space to the `highpoly` space. */
-    mul_v3_m4v3(co_high, highpoly[i].imat, co);
+    mul_v3_m4v3(co_high, highpoly->imat, co);
 
     /* rotates */
-    mul_v3_mat3_m4v3(dir_high, highpoly[i].imat, dir);
+    mul_v3_mat3_m4v3(dir_high, highpoly->imat, dir);
     normalize_v3(dir_high);
 
     /* cast ray */
@@ -352,91 +699,68 @@ static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
                            co_high,
                            dir_high,
                            0.0f,
-                           &hits[i],
+                           &hit,
                            treeData[i].raycast_callback,
                            &treeData[i]);
     }
 
-    if (hits[i].index != -1) {
+    if (hit.index != -1) {
       float distance;
       float hit_world[3];
 
       /* distance comparison in world space */
-      mul_v3_m4v3(hit_world, highpoly[i].obmat, hits[i].co);
+      mul_v3_m4v3(hit_world, highpoly->obmat, hit.co);
       distance = len_squared_v3v3(hit_world, co);
 
       if (distance < hit_distance) {
         hit_mesh = i;
         hit_distance = distance;
+        hit_nearest = hit;
       }
     }
   }
 
-  if (hit_mesh != -1) {
-    int primitive_id_high = hits[hit_mesh].index;
-    TriTessFace *triangle_high = &triangles[hit_mesh][primitive_id_high];
-    BakePixel *pixel_low = &pixel_array_low[pixel_id];
-    BakePixel *pixel_high = &pixel_array[pixel_id];
-
-    pixel_high->primitive_id = primitive_id_high;
-    pixel_high->object_id = hit_mesh;
-    pixel_high->seed = pixel_id;
-
-    /* ray direction in high poly object space */
-    float dir_high[3];
-    mul_v3_mat3_m4v3(dir_high, highpoly[hit_mesh].imat, dir);
-    normalize_v3(dir_high);
-
-    /* compute position differentials on low poly object */
-    float duco_low[3], dvco_low[3], dxco[3], dyco[3];
-    sub_v3_v3v3(duco_low, triangle_low->mverts[0]->co, triangle_low->mverts[2]->co);
-    sub_v3_v3v3(dvco_low, triangle_low->mverts[1]->co, triangle_low->mverts[2]->co);
-
-    mul_v3_v3fl(dxco, duco_low, pixel_low->du_dx);
-    madd_v3_v3fl(dxco, dvco_low, pixel_low->dv_dx);
-    mul_v3_v3fl(dyco, duco_low, pixel_low->du_dy);
-    madd_v3_v3fl(dyco, dvco_low, pixel_low->dv_dy);
-
-    /* transform from low poly to high poly object space */
-    mul_mat3_m4_v3(mat_low, dxco);
-    mul_mat3_m4_v3(mat_low, dyco);
-    mul_mat3_m4_v3(highpoly[hit_mesh].imat, dxco);
-    mul_mat3_m4_v3(highpoly[hit_mesh].imat, dyco);
-
-    /* transfer position differentials */
-    float tmp[3];
-    mul_v3_v3fl(tmp, dir_high, 1.0f / dot_v3v3(dir_high, triangle_high->normal));
-    madd_v3_v3fl(dxco, tmp, -dot_v3v3(dxco, triangle_high->normal));
-    madd_v3_v3fl(dyco, tmp, -dot_v3v3(dyco, triangle_high->normal));
-
-    /* compute barycentric differentials from position differentials */
-    barycentric_differentials_from_position(hits[hit_mesh].co,
-                                            triangle_high->mverts[0]->co,
-                                            triangle_high->mverts[1]->co,
-                                            triangle_high->mverts[2]->co,
-                                            dxco,
-                                            dyco,
-                                            triangle_high->normal,
-                                            true,
-                                            &pixel_high->uv[0],
-                                            &pixel_high->uv[1],
-                                            &pixel_high->du_dx,
-                                            &pixel_high->dv_dx,
-                                            &pixel_high->du_dy,
-                                            &pixel_high->dv_dy);
-
-    /* verify we have valid uvs */
-    lib_assert(pixel_high->uv[0] >= -1e-3f && pixel_high->uv[1] >= -1e-3f &&
-               pixel_high->uv[0] + pixel_high->uv[1] <= 1.0f + 1e-3f);
-  }
-  else {
-    pixel_array[pixel_id].primitive_id = -1;
-    pixel_array[pixel_id].object_id = -1;
-    pixel_array[pixel_id].seed = 0;
+  if (hit_mesh == -1) {
+    rays->pixel_array_to[pixel_id].primitive_id = -1;
+    rays->pixel_array_to[pixel_id].object_id = -1;
+    rays->pixel_array_to[pixel_id].seed = 0;
+    return false;
   }
 
-  mem_freen(hits);
-  return hit_mesh != -1;
+  const int primitive_id = rays->pixel_array_from[pixel_id].primitive_id;
+  bake_highpoly_pixel_from_hit(bake_highpoly_rays_tri_low(rays, primitive_id),
+                               rays->tris_high,
+                               rays->pixel_array_from,
+                               rays->pixel_array_to,
+                               rays->mat_low,
+                               rays->highpoly,
+                               dir,
+                               &hit_nearest,
+                               hit_mesh,
+                               pixel_id);
+  return true;
+}
+
+/**
+ * Cast the rays of all `num_pixels` pixels one after the other, the reference the batches are
+ * tested against.
+ */
+static void bake_highpoly_rays_cast_serial(BakeHighPolyRays *rays,
+                                           BVHTreeFromMesh *treeData,
+                                           const int tot_highpoly,
+                                           const size_t num_pixels)
+{
+  for (size_t i = 0; i < num_pixels; i++) {
+    if (rays->pixel_array_from[i].primitive_id == -1) {
+      rays->pixel_array_to[i].primitive_id = -1;
+      continue;
+    }
+
+    if (!cast_ray_highpoly(rays, treeData, tot_highpoly, i)) {
+      /* if it fails mask out the original pixel array */
+      rays->pixel_array_from[i].primitive_id = -1;
+    }
+  }
 }
 
 /**
@@ -528,22 +852,21 @@ static TriTessFace *mesh_calc_tri_tessface(Mesh *me, bool tangent, Mesh *me_eval
   return triangles;
 }
 
-bool render_bake_pixels_populate_from_objects(struct Mesh *me_low,
-                                          BakePixel pixel_array_from[],
-                                          BakePixel pixel_array_to[],
-                                          BakeHighPolyData highpoly[],
-                                          const int tot_highpoly,
-                                          const size_t num_pixels,
-                                          const bool is_custom_cage,
-                                          const float cage_extrusion,
-                                          const float max_ray_distance,
-                                          float mat_low[4][4],
-                                          float mat_cage[4][4],
-                                          struct Mesh *me_cage)
+bool render_bake_pixels_populate_from_objects_ex(struct Mesh *me_low,
+                                                 BakePixel pixel_array_from[],
+                                                 BakePixel pixel_array_to[],
+                                                 BakeHighPolyData highpoly[],
+                                                 const int tot_highpoly,
+                                                 const size_t num_pixels,
+                                                 const bool is_custom_cage,
+                                                 const float cage_extrusion,
+                                                 const float max_ray_distance,
+                                                 float mat_low[4][4],
+                                                 float mat_cage[4][4],
+                                                 struct Mesh *me_cage,
+                                                 const bool use_ray_batch)
 {
   size_t i;
-  int primitive_id;
-  float u, v;
   float imat_low[4][4];
   bool is_cage = me_cage != NULL;
   bool result = true;
@@ -578,6 +901,22 @@ bool render_bake_pixels_populate_from_objects(struct Mesh *me_low,
 
   invert_m4_m4(imat_low, mat_low);
 
+  BakeHighPolyRays rays = {
+      .pixel_array_from = pixel_array_from,
+      .pixel_array_to = pixel_array_to,
+      .highpoly = highpoly,
+      .tris_low = tris_low,
+      .tris_cage = tris_cage,
+      .tris_high = tris_high,
+      .mat_low = mat_low,
+      .mat_cage = mat_cage,
+      .imat_low = imat_low,
+      .is_cage = is_cage,
+      .is_custom_cage = is_custom_cage,
+      .cage_extrusion = cage_extrusion,
+      .max_ray_distance = max_ray_distance,
+  };
+
   for (i = 0; i < tot_highpoly; i++) {
     tris_high[i] = mesh_calc_tri_tessface(highpoly[i].me, false, NULL);
 
@@ -585,7 +924,8 @@ bool render_bake_pixels_populate_from_objects(struct Mesh *me_low,
     dune_mesh_runtime_looptri_ensure(me_highpoly[i]);
 
     if (me_highpoly[i]->runtime.looptris.len != 0) {
-      /* Create a BVH-tree for each `highpoly` object. */
+      /* Create a BVH-tree for each `highpoly` object. Mesh trees are built with the SAH and a
+       * wide copy, which the packets of #lib_bvhtree_ray_cast_batch traverse. */
       dune_bvhtree_from_mesh_get(&treeData[i], me_highpoly[i], BVHTREE_FROM_LOOPTRI, 2);
 
       if (treeData[i].tree == NULL) {
@@ -597,54 +937,11 @@ bool render_bake_pixels_populate_from_objects(struct Mesh *me_low,
     }
   }
 
-  for (i = 0; i < num_pixels; i++) {
-    float co[3];
-    float dir[3];
-    TriTessFace *tri_low;
-
-    primitive_id = pixel_array_from[i].primitive_id;
-
-    if (primitive_id == -1) {
-      pixel_array_to[i].primitive_id = -1;
-      continue;
-    }
-
-    u = pixel_array_from[i].uv[0];
-    v = pixel_array_from[i].uv[1];
-
-    /* calculate from low poly mesh cage */
-    if (is_custom_cage) {
-      calc_point_from_barycentric_cage(
-          tris_low, tris_cage, mat_low, mat_cage, primitive_id, u, v, co, dir);
-      tri_low = &tris_cage[primitive_id];
-    }
-    else if (is_cage) {
-      calc_point_from_barycentric_extrusion(
-          tris_cage, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, true);
-      tri_low = &tris_cage[primitive_id];
-    }
-    else {
-      calc_point_from_barycentric_extrusion(
-          tris_low, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, false);
-      tri_low = &tris_low[primitive_id];
-    }
-
-    /* cast ray */
-    if (!cast_ray_highpoly(treeData,
-                           tri_low,
-                           tris_high,
-                           pixel_array_from,
-                           pixel_array_to,
-                           mat_low,
-                           highpoly,
-                           co,
-                           dir,
-                           i,
-                           tot_highpoly,
-                           max_ray_distance)) {
-      /* if it fails mask out the original pixel array */
-      pixel_array_from[i].primitive_id = -1;
-    }
+  if (use_ray_batch) {
+    bake_highpoly_rays_cast(&rays, treeData, tot_highpoly, num_pixels);
+  }
+  else {
+    bake_highpoly_rays_cast_serial(&rays, treeData, tot_highpoly, num_pixels);
   }
 
   /* garbage collection */
@@ -674,6 +971,34 @@ cleanup:
   return result;
 }
 
+bool render_bake_pixels_populate_from_objects(struct Mesh *me_low,
+                                              BakePixel pixel_array_from[],
+                                              BakePixel pixel_array_to[],
+                                              BakeHighPolyData highpoly[],
+                                              const int tot_highpoly,
+                                              const size_t num_pixels,
+                                              const bool is_custom_cage,
+                                              const float cage_extrusion,
+                                              const float max_ray_distance,
+                                              float mat_low[4][4],
+                                              float mat_cage[4][4],
+                                              struct Mesh *me_cage)
+{
+  return render_bake_pixels_populate_from_objects_ex(me_low,
+                                                     pixel_array_from,
+                                                     pixel_array_to,
+                                                     highpoly,
+                                                     tot_highpoly,
+                                                     num_pixels,
+                                                     is_custom_cage,
+                                                     cage_extrusion,
+                                                     max_ray_distance,
+                                                     mat_low,
+                                                     mat_cage,
+                                                     me_cage,
+                                                     true);
+}
+
 static void bake_differentials(BakeDataZSpan *bd,
                                const float *uv1,
                                const float *uv2,
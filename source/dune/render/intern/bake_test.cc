@@ -0,0 +1,215 @@
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "types_mesh.h"
+#include "types_meshdata.h"
+
+#include "dune_customdata.h"
+#include "dune_lib_id.h"
+#include "dune_mesh.h"
+
+#include "lib_math.h"
+
+#include "rndr_bake.h"
+
+namespace dune::render::tests {
+
+/* A grid of `size` by `size` quads over [-1, 1] on X & Y, raised by `height` with waves of
+ * `amplitude` (none for a flat grid). */
+static Mesh *grid_mesh_new(const int size, const float height, const float amplitude)
+{
+  const int verts_side = size + 1;
+  Mesh *mesh = DUNE_mesh_new_nomain(
+      verts_side * verts_side, 0, 0, size * size * 4, size * size);
+
+  for (int y = 0; y < verts_side; y++) {
+    for (int x = 0; x < verts_side; x++) {
+      MVert *mv = &mesh->mvert[y * verts_side + x];
+      mv->co[0] = 2.0f * float(x) / float(size) - 1.0f;
+      mv->co[1] = 2.0f * float(y) / float(size) - 1.0f;
+      mv->co[2] = height + amplitude * sinf(3.1f * mv->co[0]) * cosf(2.3f * mv->co[1]);
+    }
+  }
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const int poly = y * size + x;
+      const int v = y * verts_side + x;
+      const int corners[4] = {v, v + 1, v + verts_side + 1, v + verts_side};
+      mesh->mpoly[poly].loopstart = poly * 4;
+      mesh->mpoly[poly].totloop = 4;
+      mesh->mpoly[poly].flag = (poly % 3 == 0) ? ME_SMOOTH : 0;
+      for (int i = 0; i < 4; i++) {
+        mesh->mloop[poly * 4 + i].v = uint(corners[i]);
+      }
+    }
+  }
+
+  /* The tangents of the low-poly mesh are computed from its UVs. */
+  MLoopUV *uvs = static_cast<MLoopUV *>(
+      CustomData_add_layer(&mesh->ldata, CD_MLOOPUV, CD_CALLOC, nullptr, mesh->totloop));
+  for (int i = 0; i < mesh->totloop; i++) {
+    copy_v2_v2(uvs[i].uv, mesh->mvert[mesh->mloop[i].v].co);
+  }
+
+  DUNE_mesh_normals_tag_dirty(mesh);
+  return mesh;
+}
+
+/* Low-poly pixels spread inside each triangle of `mesh`, every seventh one not baked. */
+static BakePixel *pixel_array_new(const Mesh *mesh, const int pixels_per_tri, size_t *r_num)
+{
+  const int tris_num = poly_to_tri_count(mesh->totpoly, mesh->totloop);
+  const size_t num_pixels = size_t(tris_num) * pixels_per_tri;
+  BakePixel *pixels = static_cast<BakePixel *>(
+      MEM_callocN(sizeof(BakePixel) * num_pixels, "bake test pixels"));
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    BakePixel *pixel = &pixels[i];
+    const int sample = int(i % pixels_per_tri);
+    pixel->primitive_id = (i % 7 == 3) ? -1 : int(i / pixels_per_tri);
+    pixel->uv[0] = 0.05f + 0.9f * float(sample % 5) / 5.0f;
+    pixel->uv[1] = (1.0f - pixel->uv[0]) * float(sample / 5 + 1) / float(pixels_per_tri / 5 + 2);
+    pixel->du_dx = 0.01f;
+    pixel->dv_dy = 0.01f;
+    pixel->seed = int(i);
+  }
+  *r_num = num_pixels;
+  return pixels;
+}
+
+static void highpoly_init(BakeHighPolyData *highpoly, Mesh *mesh, const float obmat[4][4])
+{
+  memset(highpoly, 0, sizeof(*highpoly));
+  highpoly->me = mesh;
+  copy_m4_m4(highpoly->obmat, obmat);
+  invert_m4_m4(highpoly->imat, highpoly->obmat);
+}
+
+static void expect_pixels_eq(const BakePixel *a, const BakePixel *b, const size_t num_pixels)
+{
+  for (size_t i = 0; i < num_pixels; i++) {
+    EXPECT_EQ(a[i].primitive_id, b[i].primitive_id) << "pixel " << i;
+    EXPECT_EQ(a[i].object_id, b[i].object_id) << "pixel " << i;
+    EXPECT_EQ(a[i].seed, b[i].seed) << "pixel " << i;
+    EXPECT_EQ(a[i].uv[0], b[i].uv[0]) << "pixel " << i;
+    EXPECT_EQ(a[i].uv[1], b[i].uv[1]) << "pixel " << i;
+    EXPECT_EQ(a[i].du_dx, b[i].du_dx) << "pixel " << i;
+    EXPECT_EQ(a[i].du_dy, b[i].du_dy) << "pixel " << i;
+    EXPECT_EQ(a[i].dv_dx, b[i].dv_dx) << "pixel " << i;
+    EXPECT_EQ(a[i].dv_dy, b[i].dv_dy) << "pixel " << i;
+  }
+}
+
+/* Populate the high-poly pixels with & without ray batches, and compare both. */
+static void test_populate_from_objects(Mesh *me_low,
+                                       Mesh *me_cage,
+                                       const bool is_custom_cage,
+                                       const float cage_extrusion,
+                                       const float max_ray_distance)
+{
+  Mesh *me_high_a = grid_mesh_new(37, 0.0f, 0.2f);
+  Mesh *me_high_b = grid_mesh_new(23, 0.1f, 0.3f);
+
+  float mat_low[4][4], mat_cage[4][4], obmat_a[4][4], obmat_b[4][4];
+  unit_m4(mat_low);
+  unit_m4(mat_cage);
+  unit_m4(obmat_a);
+  rotate_m4(obmat_a, 'Z', 0.3f);
+  unit_m4(obmat_b);
+  translate_m4(obmat_b, 0.05f, -0.1f, 0.02f);
+  scale_m4_fl(obmat_b, 1.2f);
+
+  BakeHighPolyData highpoly[2];
+  highpoly_init(&highpoly[0], me_high_a, obmat_a);
+  highpoly_init(&highpoly[1], me_high_b, obmat_b);
+
+  size_t num_pixels;
+  BakePixel *pixels_from = pixel_array_new(me_low, 15, &num_pixels);
+  BakePixel *pixels_from_batch = static_cast<BakePixel *>(MEM_dupallocN(pixels_from));
+  BakePixel *pixels_to = static_cast<BakePixel *>(
+      MEM_callocN(sizeof(BakePixel) * num_pixels, "bake test pixels"));
+  BakePixel *pixels_to_batch = static_cast<BakePixel *>(MEM_dupallocN(pixels_to));
+
+  EXPECT_TRUE(render_bake_pixels_populate_from_objects_ex(me_low,
+                                                          pixels_from,
+                                                          pixels_to,
+                                                          highpoly,
+                                                          2,
+                                                          num_pixels,
+                                                          is_custom_cage,
+                                                          cage_extrusion,
+                                                          max_ray_distance,
+                                                          mat_low,
+                                                          mat_cage,
+                                                          me_cage,
+                                                          false));
+  EXPECT_TRUE(render_bake_pixels_populate_from_objects_ex(me_low,
+                                                          pixels_from_batch,
+                                                          pixels_to_batch,
+                                                          highpoly,
+                                                          2,
+                                                          num_pixels,
+                                                          is_custom_cage,
+                                                          cage_extrusion,
+                                                          max_ray_distance,
+                                                          mat_low,
+                                                          mat_cage,
+                                                          me_cage,
+                                                          true));
+
+  /* Both objects are hit, and some rays miss. */
+  int hits_num[2] = {0, 0}, misses_num = 0;
+  for (size_t i = 0; i < num_pixels; i++) {
+    if (pixels_to[i].primitive_id != -1) {
+      hits_num[pixels_to[i].object_id]++;
+    }
+    else if (pixels_to[i].object_id == -1) {
+      misses_num++;
+    }
+  }
+  EXPECT_GT(hits_num[0], 0);
+  EXPECT_GT(hits_num[1], 0);
+  EXPECT_GT(misses_num, 0);
+
+  expect_pixels_eq(pixels_to, pixels_to_batch, num_pixels);
+  /* Missed pixels are masked out of the low-poly pixels. */
+  expect_pixels_eq(pixels_from, pixels_from_batch, num_pixels);
+
+  MEM_freeN(pixels_from);
+  MEM_freeN(pixels_from_batch);
+  MEM_freeN(pixels_to);
+  MEM_freeN(pixels_to_batch);
+  dune_id_free(nullptr, me_high_a);
+  dune_id_free(nullptr, me_high_b);
+}
+
+TEST(bake, populate_from_objects_batch_no_cage)
+{
+  /* Larger than the high-poly objects, rays of the border miss them. */
+  Mesh *me_low = grid_mesh_new(12, 0.05f, 0.0f);
+  for (int i = 0; i < me_low->totvert; i++) {
+    mul_v2_fl(me_low->mvert[i].co, 1.3f);
+  }
+  test_populate_from_objects(me_low, nullptr, false, 0.5f, 0.0f);
+  test_populate_from_objects(me_low, nullptr, false, 0.5f, 0.4f);
+  dune_id_free(nullptr, me_low);
+}
+
+TEST(bake, populate_from_objects_batch_cage)
+{
+  Mesh *me_low = grid_mesh_new(12, 0.05f, 0.0f);
+  Mesh *me_cage = grid_mesh_new(12, 0.6f, 0.05f);
+  for (Mesh *mesh : {me_low, me_cage}) {
+    for (int i = 0; i < mesh->totvert; i++) {
+      mul_v2_fl(mesh->mvert[i].co, 1.3f);
+    }
+  }
+  /* Rays extruded from the cage, and from the cage to the low-poly mesh. */
+  test_populate_from_objects(me_low, me_cage, false, 0.5f, 0.0f);
+  test_populate_from_objects(me_low, me_cage, true, 0.0f, 0.0f);
+  dune_id_free(nullptr, me_low);
+  dune_id_free(nullptr, me_cage);
+}
+
+}  // namespace dune::render::tests
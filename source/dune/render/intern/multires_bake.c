@@ -8,6 +8,7 @@
 
 #include "lib_listbase.h"
 #include "lib_math.h"
+#include "lib_task.h"
 #include "lib_threads.h"
 
 #include "dune_DerivedMesh.h"
@@ -32,6 +33,8 @@
 #include "IMB_imbuf.h"
 #include "IMB_imbuf_types.h"
 
+#include "atomic_ops.h"
+
 typedef void (*MeshPassKnownData)(DerivedMesh *lores_dm,
                                   DerivedMesh *hires_dm,
                                   void *thread_data,
@@ -79,7 +82,6 @@ typedef struct {
   char *texels;
   const MeshResolvePixelData *data;
   MeshFlushPixel flush_pixel;
-  short *do_update;
 } MeshBakeRast;
 
 typedef struct {
@@ -124,8 +126,7 @@ static void multiresbake_get_normal(const MeshResolvePixelData *data,
 static void init_bake_rast(MeshBakeRast *bake_rast,
                            const ImBuf *ibuf,
                            const MeshResolvePixelData *data,
-                           MeshFlushPixel flush_pixel,
-                           short *do_update)
+                           MeshFlushPixel flush_pixel)
 {
   BakeImBufuserData *userdata = (BakeImBufuserData *)ibuf->userdata;
 
@@ -136,7 +137,6 @@ static void init_bake_rast(MeshBakeRast *bake_rast,
   bake_rast->h = ibuf->y;
   bake_rast->data = data;
   bake_rast->flush_pixel = flush_pixel;
-  bake_rast->do_update = do_update;
 }
 
 static void flush_pixel(const MeshResolvePixelData *data, const int x, const int y)
@@ -209,9 +209,6 @@ static void set_rast_triangle(const MeshBakeRast *bake_rast, const int x, const
     if ((bake_rast->texels[y * w + x]) == 0) {
       bake_rast->texels[y * w + x] = FILTER_MASK_USED;
       flush_pixel(bake_rast->data, x, y);
-      if (bake_rast->do_update) {
-        *bake_rast->do_update = true;
-      }
     }
   }
 }
@@ -324,15 +321,25 @@ static int multiresbake_test_break(MultiresBakeRender *bkr)
 
 /* **** Threading routines **** */
 
-typedef struct MultiresBakeQueue {
-  int cur_tri;
+/* Size in pixels of the UV-space tiles the triangles are baked in. */
+#define MULTIRES_BAKE_TILE_SIZE 64
+
+/* Triangles baked to the image, binned into tiles of the image by the UV position of their
+ * center. A thread bakes all triangles of a tile, neighbors sharing texels and hires grids, and
+ * idle threads steal whole tiles from busy ones. */
+typedef struct MultiresBakeTiles {
+  /* Triangles of tile `i` are `tris[tile_offsets[i]]` to `tris[tile_offsets[i + 1] - 1]`,
+   * tiles without triangles are left out. */
+  int *tris;
+  int *tile_offsets;
+  int tot_tile;
+  /* All triangles of the mesh, for the progress. */
   int tot_tri;
-  SpinLock spin;
-} MultiresBakeQueue;
+} MultiresBakeTiles;
 
 typedef struct MultiresBakeThread {
   /* this data is actually shared between all the threads */
-  MultiresBakeQueue *queue;
+  const MultiresBakeTiles *tiles;
   MultiresBakeRender *bkr;
   Image *image;
   void *bake_data;
@@ -345,75 +352,151 @@ typedef struct MultiresBakeThread {
   float height_min, height_max;
 } MultiresBakeThread;
 
-static int multires_bake_queue_next_tri(MultiresBakeQueue *queue)
+static void multires_bake_tiles_init(MultiresBakeTiles *tiles,
+                                     MultiresBakeRender *bkr,
+                                     Image *ima,
+                                     const MeshResolvePixelData *data,
+                                     const int tot_tri)
 {
-  int face = -1;
+  const int tiles_x = max_ii(1, (data->w + MULTIRES_BAKE_TILE_SIZE - 1) / MULTIRES_BAKE_TILE_SIZE);
+  const int tiles_y = max_ii(1, (data->h + MULTIRES_BAKE_TILE_SIZE - 1) / MULTIRES_BAKE_TILE_SIZE);
+  int *tri_tile = mem_mallocn(sizeof(int) * tot_tri, "multires bake tri tiles");
+  /* Number of triangles of each tile, then index of the next triangle of each tile. */
+  int *tile_tri = mem_callocn(sizeof(int) * tiles_x * tiles_y, "multires bake tile tris");
+  int tot_tile = 0, tot_tile_tri = 0;
+
+  for (int i = 0; i < tot_tri; i++) {
+    const MeshLoopTri *lt = &data->mlooptri[i];
+    const short mat_nr = data->mpoly[lt->poly].mat_nr;
+    Image *tri_image = mat_nr < bkr->ob_image.len ? bkr->ob_image.array[mat_nr] : NULL;
+
+    if (tri_image != ima) {
+      tri_tile[i] = -1;
+      continue;
+    }
+
+    float center[2];
+    mid_v2_v2v2v2(center,
+                  data->mloopuv[lt->tri[0]].uv,
+                  data->mloopuv[lt->tri[1]].uv,
+                  data->mloopuv[lt->tri[2]].uv);
+    const int x = clamp_i((int)(center[0] * data->w) / MULTIRES_BAKE_TILE_SIZE, 0, tiles_x - 1);
+    const int y = clamp_i((int)(center[1] * data->h) / MULTIRES_BAKE_TILE_SIZE, 0, tiles_y - 1);
+    tri_tile[i] = y * tiles_x + x;
+    tile_tri[tri_tile[i]]++;
+  }
 
-  /* TODO: it could worth making it so thread will handle neighbor faces
-   *       for better memory cache utilization **/
+  tiles->tile_offsets = mem_mallocn(sizeof(int) * (tiles_x * tiles_y + 1),
+                                    "multires bake tile offsets");
+  for (int i = 0; i < tiles_x * tiles_y; i++) {
+    if (tile_tri[i] != 0) {
+      tiles->tile_offsets[tot_tile++] = tot_tile_tri;
+      const int tile_tot_tri = tile_tri[i];
+      tile_tri[i] = tot_tile_tri;
+      tot_tile_tri += tile_tot_tri;
+    }
+  }
+  tiles->tile_offsets[tot_tile] = tot_tile_tri;
 
-  lib_spin_lock(&queue->spin);
-  if (queue->cur_tri < queue->tot_tri) {
-    face = queue->cur_tri;
-    queue->cur_tri++;
+  tiles->tris = mem_mallocn(sizeof(int) * max_ii(tot_tile_tri, 1), "multires bake tile tris");
+  for (int i = 0; i < tot_tri; i++) {
+    if (tri_tile[i] != -1) {
+      tiles->tris[tile_tri[tri_tile[i]]++] = i;
+    }
   }
-  lib_spin_unlock(&queue->spin);
 
-  return face;
+  tiles->tot_tile = tot_tile;
+  tiles->tot_tri = tot_tri;
+
+  mem_freen(tri_tile);
+  mem_freen(tile_tri);
 }
 
-static void *do_multires_bake_thread(void *data_v)
+static void multires_bake_tiles_free(MultiresBakeTiles *tiles)
 {
-  MultiresBakeThread *handle = (MultiresBakeThread *)data_v;
+  mem_freen(tiles->tris);
+  mem_freen(tiles->tile_offsets);
+}
+
+/* Publish the progress from any thread, only raising it: tiles finishing concurrently may publish
+ * their counts of baked faces out of order. */
+static void multires_bake_progress_publish(float *progress, const float value)
+{
+  float prev = *progress;
+  while (prev < value) {
+    const float cur = atomic_cas_float(progress, prev, value);
+    if (cur == prev) {
+      break;
+    }
+    prev = cur;
+  }
+}
+
+static void do_multires_bake_tile(void *__restrict userdata,
+                                  const int tile_index,
+                                  const TaskParallelTLS *__restrict tls)
+{
+  const MultiresBakeTiles *tiles = (const MultiresBakeTiles *)userdata;
+  MultiresBakeThread *handle = (MultiresBakeThread *)tls->userdata_chunk;
   MeshResolvePixelData *data = &handle->data;
   MeshBakeRast *bake_rast = &handle->bake_rast;
   MultiresBakeRender *bkr = handle->bkr;
-  int tri_index;
+  int baked_tris = 0;
+
+  /* The handle is this thread's copy of the one passed to the task, point to the copy. */
+  data->thread_data = handle;
+  bake_rast->data = data;
 
-  while ((tri_index = multires_bake_queue_next_tri(handle->queue)) >= 0) {
+  for (int i = tiles->tile_offsets[tile_index]; i < tiles->tile_offsets[tile_index + 1]; i++) {
+    const int tri_index = tiles->tris[i];
     const MeshLoopTri *lt = &data->mlooptri[tri_index];
-    const MeshPoly *mp = &data->mpoly[lt->poly];
-    const short mat_nr = mp->mat_nr;
     const MeshLoopUV *mloopuv = data->mloopuv;
 
     if (multiresbake_test_break(bkr)) {
       break;
     }
 
-    Image *tri_image = mat_nr < bkr->ob_image.len ? bkr->ob_image.array[mat_nr] : NULL;
-    if (tri_image != handle->image) {
-      continue;
-    }
-
     data->tri_index = tri_index;
 
     bake_rasterize(
         bake_rast, mloopuv[lt->tri[0]].uv, mloopuv[lt->tri[1]].uv, mloopuv[lt->tri[2]].uv);
+    baked_tris++;
+  }
 
-    /* tag image buffer for refresh */
-    if (data->ibuf->rect_float) {
-      data->ibuf->userflags |= IB_RECT_INVALID;
-    }
+  if (baked_tris == 0) {
+    return;
+  }
 
-    data->ibuf->userflags |= IB_DISPLAY_BUFFER_INVALID;
+  /* tag image buffer for refresh */
+  if (data->ibuf->rect_float) {
+    data->ibuf->userflags |= IB_RECT_INVALID;
+  }
 
-    /* update progress */
-    lib_spin_lock(&handle->queue->spin);
-    bkr->baked_faces++;
+  data->ibuf->userflags |= IB_DISPLAY_BUFFER_INVALID;
 
-    if (bkr->do_update) {
-      *bkr->do_update = true;
-    }
+  /* update progress, once per tile */
+  const int baked_faces = atomic_add_and_fetch_int32(&bkr->baked_faces, baked_tris);
 
-    if (bkr->progress) {
-      *bkr->progress = ((float)bkr->baked_objects +
-                        (float)bkr->baked_faces / handle->queue->tot_tri) /
-                       bkr->tot_obj;
-    }
-    lib_spin_unlock(&handle->queue->spin);
+  if (bkr->do_update) {
+    atomic_fetch_and_or_int16(bkr->do_update, true);
+  }
+
+  if (bkr->progress) {
+    multires_bake_progress_publish(
+        bkr->progress,
+        ((float)bkr->baked_objects + (float)baked_faces / tiles->tot_tri) / bkr->tot_obj);
   }
+}
+
+static void multires_bake_thread_reduce(const void *__restrict UNUSED(userdata),
+                                        void *__restrict chunk_join,
+                                        void *__restrict chunk)
+{
+  MultiresBakeThread *join = (MultiresBakeThread *)chunk_join;
+  const MultiresBakeThread *handle = (const MultiresBakeThread *)chunk;
 
-  return NULL;
+  join->height_min = min_ff(join->height_min, handle->height_min);
+  join->height_max = max_ff(join->height_max, handle->height_max);
 }
 
 /* some of arrays inside ccgdm are lazy-initialized, which will generally
@@ -451,8 +534,8 @@ static void do_multires_bake(MultiresBakeRender *bkr,
   int tot_tri = dm->getNumLoopTri(dm);
 
   if (tot_tri > 0) {
-    MultiresBakeThread *handles;
-    MultiresBakeQueue queue;
+    MultiresBakeThread handle = {NULL};
+    MultiresBakeTiles tiles;
 
     ImBuf *ibuf = dune_image_acquire_ibuf(ima, NULL, NULL);
     MeshVert *mvert = mesh->getVertArray(dm);
@@ -461,9 +544,6 @@ static void do_multires_bake(MultiresBakeRender *bkr,
     MeshLoopUV *mloopuv = mesh->getLoopDataArray(dm, CD_MLOOPUV);
     float *pvtangent = NULL;
 
-    ListBase threads;
-    int i, tot_thread = bkr->threads > 0 ? bkr->threads : BLI_system_thread_count();
-
     void *bake_data = NULL;
 
     Mesh *temp_mesh = dune_mesh_new_nomain(
@@ -506,81 +586,61 @@ static void do_multires_bake(MultiresBakeRender *bkr,
       bake_data = initBakeData(bkr, ima);
     }
 
-    if (tot_thread > 1) {
-      lib_threadpool_init(&threads, do_multires_bake_thread, tot_thread);
-    }
-
-    handles = mem_callocn(tot_thread * sizeof(MultiresBakeThread), "do_multires_bake handles");
-
     init_ccgdm_arrays(bkr->hires_dm);
 
-    /* faces queue */
-    queue.cur_tri = 0;
-    queue.tot_tri = tot_tri;
-    lib_spin_init(&queue.spin);
-
-    /* fill in threads handles */
-    for (i = 0; i < tot_thread; i++) {
-      MultiresBakeThread *handle = &handles[i];
-
-      handle->bkr = bkr;
-      handle->image = ima;
-      handle->queue = &queue;
-
-      handle->data.mpoly = mpoly;
-      handle->data.mvert = mvert;
-      handle->data.vert_normals = vert_normals;
-      handle->data.mloopuv = mloopuv;
-      handle->data.mlooptri = mlooptri;
-      handle->data.mloop = mloop;
-      handle->data.pvtangent = pvtangent;
-      handle->data.precomputed_normals = poly_normals; /* don't strictly need this */
-      handle->data.w = ibuf->x;
-      handle->data.h = ibuf->y;
-      handle->data.lores_dm = mesh;
-      handle->data.hires_dm = bkr->hires_dm;
-      handle->data.lvl = lvl;
-      handle->data.pass_data = passKnownData;
-      handle->data.thread_data = handle;
-      handle->data.bake_data = bake_data;
-      handle->data.ibuf = ibuf;
-
-      handle->height_min = FLT_MAX;
-      handle->height_max = -FLT_MAX;
-
-      init_bake_rast(&handle->bake_rast, ibuf, &handle->data, flush_pixel, bkr->do_update);
-
-      if (tot_thread > 1) {
-        lib_threadpool_insert(&threads, handle);
-      }
-    }
-
-    /* run threads */
-    if (tot_thread > 1) {
-      lib_threadpool_end(&threads);
-    }
-    else {
-      do_multires_bake_thread(&handles[0]);
-    }
+    /* fill in the thread handle, copied for each thread */
+    handle.bkr = bkr;
+    handle.image = ima;
+    handle.tiles = &tiles;
+
+    handle.data.mpoly = mpoly;
+    handle.data.mvert = mvert;
+    handle.data.vert_normals = vert_normals;
+    handle.data.mloopuv = mloopuv;
+    handle.data.mlooptri = mlooptri;
+    handle.data.mloop = mloop;
+    handle.data.pvtangent = pvtangent;
+    handle.data.precomputed_normals = poly_normals; /* don't strictly need this */
+    handle.data.w = ibuf->x;
+    handle.data.h = ibuf->y;
+    handle.data.lores_dm = mesh;
+    handle.data.hires_dm = bkr->hires_dm;
+    handle.data.lvl = lvl;
+    handle.data.pass_data = passKnownData;
+    handle.data.thread_data = &handle;
+    handle.data.bake_data = bake_data;
+    handle.data.ibuf = ibuf;
+
+    handle.height_min = FLT_MAX;
+    handle.height_max = -FLT_MAX;
+
+    init_bake_rast(&handle.bake_rast, ibuf, &handle.data, flush_pixel);
+
+    /* triangles tiles */
+    multires_bake_tiles_init(&tiles, bkr, ima, &handle.data, tot_tri);
+
+    /* run threads, the task scheduler balances the tiles between threads by work stealing,
+     * only `bkr->threads == 1` is honored (see #MultiresBakeRender.threads) */
+    TaskParallelSettings settings;
+    lib_parallel_range_settings_defaults(&settings);
+    settings.use_threading = bkr->threads != 1;
+    settings.min_iter_per_thread = 1;
+    settings.userdata_chunk = &handle;
+    settings.userdata_chunk_size = sizeof(handle);
+    settings.func_reduce = multires_bake_thread_reduce;
+    lib_task_parallel_range(0, tiles.tot_tile, &tiles, do_multires_bake_tile, &settings);
 
     /* construct bake result */
-    result->height_min = handles[0].height_min;
-    result->height_max = handles[0].height_max;
+    result->height_min = handle.height_min;
+    result->height_max = handle.height_max;
 
-    for (i = 1; i < tot_thread; i++) {
-      result->height_min = min_ff(result->height_min, handles[i].height_min);
-      result->height_max = max_ff(result->height_max, handles[i].height_max);
-    }
-
-    lib_spin_end(&queue.spin);
+    multires_bake_tiles_free(&tiles);
 
     /* finalize baking */
     if (freeBakeData) {
       freeBakeData(bake_data);
     }
 
-    mem_freen(handles);
-
     dune_id_free(NULL, temp_mesh);
 
     dune_image_release_ibuf(ima, ibuf, NULL);
@@ -33,11 +33,14 @@ typedef struct MultiresBakeRender {
 
   int raytrace_structure; /* Optimization structure to be used for AO baking */
   int octree_resolution;  /* Resolution of octree when using octree optimization structure */
-  int threads;            /* Number of threads to be used for baking */
+  /* Number of threads to be used for baking: only 1 (baking on the calling thread) is honored,
+   * any other value bakes with all the threads of the task scheduler. */
+  int threads;
 
   float user_scale; /* User scale used to scale displacement when baking derivative map. */
 
   short *stop;
+  /* Set & raised atomically from the baking threads, once per baked tile. */
   short *do_update;
   float *progress;
 } MultiresBakeRender;
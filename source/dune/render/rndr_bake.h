@@ -82,6 +82,21 @@ bool rndr_bake_pixels_populate_from_obs(struct Mesh *me_low,
                                         float mat_low[4][4],
                                         float mat_cage[4][4],
                                         struct Mesh *me_cage);
+/* Casts the rays one at a time instead of in batches when `use_ray_batch` is false, the same
+ * pixels are filled either way. */
+bool render_bake_pixels_populate_from_objects_ex(struct Mesh *me_low,
+                                                 BakePixel pixel_array_from[],
+                                                 BakePixel pixel_array_to[],
+                                                 BakeHighPolyData highpoly[],
+                                                 int tot_highpoly,
+                                                 size_t num_pixels,
+                                                 bool is_custom_cage,
+                                                 float cage_extrusion,
+                                                 float max_ray_distance,
+                                                 float mat_low[4][4],
+                                                 float mat_cage[4][4],
+                                                 struct Mesh *me_cage,
+                                                 bool use_ray_batch);
 
 void rndr_bake_pixels_populate(struct Mesh *me,
                              struct BakePixel *pixel_array,
@@ -50,6 +50,18 @@ struct MLoopTri_Store {
 };
 
 /* Runtime data, not saved in files. */
+/* Loops using each vertex (in loop order) and the polygon of each loop. Immutable once built, so
+ * copies of a mesh share it, counting their users. */
+typedef struct MeshVertToLoopMap {
+  int users;
+  int totvert;
+  int totloop;
+  int totpoly;
+  int *offsets;
+  int *indices;
+  int *loop_to_poly;
+} MeshVertToLoopMap;
+
 typedef struct Mesh_Runtime {
   /* Eval mesh for obs which do not have effective mods.
    * This mesh is used as a result of mod stack eval.
@@ -114,6 +126,11 @@ typedef struct Mesh_Runtime {
   float (*vert_normals)[3];
   float (*poly_normals)[3];
 
+  /* Cache of the loops using each vertex, to gather vertex normals from the polygon normals.
+   * Shared with the copies of the mesh, freed with the derived normals when the topology changes,
+   * see `mesh_normals.c`. */
+  struct MeshVertToLoopMap *vert_to_loop_map;
+
   void *_pad2;
 } Mesh_Runtime;
 
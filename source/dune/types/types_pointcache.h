@@ -127,14 +127,18 @@ enum {
   PTCACHE_IGNORE_CLEAR = 1 << 13,
 
   PTCACHE_FLAG_INFO_DIRTY = 1 << 14,
+  /* Write the disk cache to a single memory mapped file, instead of a file per frame. */
+  PTCACHE_DISK_PACKED = 1 << 15,
 
   PTCACHE_REDO_NEEDED = PTCACHE_OUTDATED | PTCACHE_FRAMES_SKIPPED,
-  PTCACHE_FLAGS_COPY = PTCACHE_DISK_CACHE | PTCACHE_EXTERNAL | PTCACHE_IGNORE_LIBPATH,
+  PTCACHE_FLAGS_COPY = PTCACHE_DISK_CACHE | PTCACHE_EXTERNAL | PTCACHE_IGNORE_LIBPATH |
+                       PTCACHE_DISK_PACKED,
 };
 
 #define PTCACHE_COMPRESS_NO 0
 #define PTCACHE_COMPRESS_LZO 1
 #define PTCACHE_COMPRESS_LZMA 2
+#define PTCACHE_COMPRESS_ZSTD 3
 
 #ifdef __cplusplus
 }